@@ -0,0 +1,297 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include "cortex-common/stream_sink.h"
+#include "json/value.h"
+#include "utils/spsc_ring.h"
+
+// Status and result
+using InferResult = std::pair<Json::Value, Json::Value>;
+
+// One message from an engine. Streams that are forwarded as is carry their
+// SSE frames in |raw| and leave the JSON values null.
+struct InferMessage {
+  InferMessage() = default;
+  InferMessage(InferMessage&&) = default;
+  InferMessage& operator=(InferMessage&&) = default;
+  InferMessage(const InferMessage&) = delete;
+  InferMessage& operator=(const InferMessage&) = delete;
+
+  InferResult result;
+  std::string raw;
+  bool is_raw = false;
+  bool is_done = false;
+};
+
+// Bounded channel carrying the output of one inference request from the
+// engine (single producer) to the HTTP response (single consumer). Neither
+// side takes a lock on the fast path.
+//
+// The consumer never blocks: it registers a notifier that schedules it on its
+// own event loop whenever new messages arrive. The producer is throttled via
+// StreamSink::Write()/OnWritable() and never blocks either, since it may run
+// on a loop that serves other requests. If it ignores the throttling and fills
+// the channel up completely, the stream is failed: later messages are dropped,
+// the producer is told to cancel and the consumer gets a final error.
+//
+// Producers that don't use the sink, such as remote and python engines, push
+// JSON results with Push(), which can't be throttled. What does not fit in the
+// ring is kept in an unbounded spill queue behind a lock instead, so those
+// streams are neither failed nor blocked.
+class InferChannel : public StreamSink {
+ public:
+  static constexpr size_t kDefaultCapacity = 128;
+
+  explicit InferChannel(size_t capacity = kDefaultCapacity)
+      : ring_(capacity),
+        high_watermark_(ring_.Capacity() * 3 / 4),
+        low_watermark_(ring_.Capacity() / 4) {}
+
+  // Producer side
+
+  void Push(InferResult&& result) {
+    if (closed_) {
+      return;
+    }
+    InferMessage m;
+    m.result = std::move(result);
+    {
+      std::lock_guard<std::mutex> l(spill_mtx_);
+      // Once spilling, messages are queued behind the spilled ones to keep
+      // their order
+      if (!spill_.empty() || !ring_.TryPush(std::move(m))) {
+        spill_.push_back(std::move(m));
+        spilled_ = true;
+      }
+    }
+    Notify();
+  }
+
+  bool Write(std::string&& frames, bool is_done) override {
+    InferMessage m;
+    m.raw = std::move(frames);
+    m.is_raw = true;
+    m.is_done = is_done;
+    Enqueue(std::move(m));
+    return closed_ || overflowed_ || ring_.Size() < high_watermark_;
+  }
+
+  void OnWritable(std::function<void()>&& cb) override {
+    {
+      std::lock_guard<std::mutex> l(flow_mtx_);
+      if (!IsWritable()) {
+        on_writable_ = std::move(cb);
+        flow_waiting_ = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!IsWritable()) {
+          return;
+        }
+        // The consumer caught up in the meantime
+        flow_waiting_ = false;
+        cb = std::exchange(on_writable_, nullptr);
+      }
+    }
+    cb();
+  }
+
+  void OnClosed(std::function<void()>&& cb) override {
+    cancellable_ = true;
+    {
+      std::lock_guard<std::mutex> l(flow_mtx_);
+      if (!closed_) {
+        on_closed_ = std::move(cb);
+        return;
+      }
+    }
+    cb();
+  }
+
+  // Consumer side
+
+  // |notify| is invoked from the producer's thread when messages arrive while
+  // no drain is pending, and once right away to pick up anything pushed
+  // before it was set. It must not block; it should schedule Drain().
+  void SetNotifier(std::function<void()>&& notify) {
+    std::lock_guard<std::mutex> l(notify_mtx_);
+    notifier_ = std::move(notify);
+    notify_pending_ = true;
+    if (notifier_) {
+      notifier_();
+    }
+  }
+
+  // Pops up to |max_messages| messages into |on_message|. Returns true if
+  // messages are left, in which case the consumer must schedule itself again
+  // since no new notification is sent for them.
+  template <typename F>
+  bool Drain(F&& on_message, size_t max_messages = SIZE_MAX) {
+    notify_pending_ = false;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (size_t i = 0; i < max_messages; i++) {
+      auto m = ring_.TryPop();
+      // The ring only holds messages pushed before the spilled ones
+      if (!m && spilled_) {
+        m = PopSpilled();
+      }
+      if (!m) {
+        // Everything pushed before the overflow was delivered
+        if (overflowed_ && !overflow_reported_) {
+          overflow_reported_ = true;
+          on_message(OverflowMessage());
+        }
+        return false;
+      }
+      MaybeWakeProducer();
+      on_message(std::move(*m));
+    }
+    return !ring_.Empty() || spilled_;
+  }
+
+  // The consumer went away, later messages are dropped, a throttled
+  // producer is released and the producer is told to cancel
+  void Close() {
+    closed_ = true;
+    std::function<void()> cb;
+    std::function<void()> on_closed;
+    {
+      std::lock_guard<std::mutex> l(flow_mtx_);
+      cb = std::exchange(on_writable_, nullptr);
+      on_closed = std::exchange(on_closed_, nullptr);
+      flow_waiting_ = false;
+    }
+    {
+      std::lock_guard<std::mutex> l(notify_mtx_);
+      notifier_ = nullptr;
+    }
+    if (cb) {
+      cb();
+    }
+    if (on_closed) {
+      on_closed();
+    }
+  }
+
+  bool IsClosed() const { return closed_; }
+
+  // Whether the producer cancels its request when the channel is closed.
+  // Producers that don't use the sink must be stopped by other means.
+  bool IsCancellable() const { return cancellable_; }
+
+  size_t Capacity() const { return ring_.Capacity(); }
+
+ private:
+  bool IsWritable() const {
+    return closed_ || overflowed_ || ring_.Size() <= low_watermark_;
+  }
+
+  void Enqueue(InferMessage&& m) {
+    if (closed_ || overflowed_) {
+      return;
+    }
+    if (!ring_.TryPush(std::move(m))) {
+      // The producer ignored Write()'s backpressure
+      Overflow();
+    }
+    Notify();
+  }
+
+  void Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!notify_pending_.exchange(true)) {
+      std::lock_guard<std::mutex> l(notify_mtx_);
+      if (notifier_) {
+        notifier_();
+      }
+    }
+  }
+
+  std::optional<InferMessage> PopSpilled() {
+    std::lock_guard<std::mutex> l(spill_mtx_);
+    if (spill_.empty()) {
+      return std::nullopt;
+    }
+    auto m = std::move(spill_.front());
+    spill_.pop_front();
+    spilled_ = !spill_.empty();
+    return m;
+  }
+
+  // Fails the stream without waiting for room
+  void Overflow() {
+    overflowed_ = true;
+    std::function<void()> on_closed;
+    {
+      std::lock_guard<std::mutex> l(flow_mtx_);
+      on_writable_ = nullptr;
+      on_closed = std::exchange(on_closed_, nullptr);
+      flow_waiting_ = false;
+    }
+    if (on_closed) {
+      on_closed();
+    }
+  }
+
+  static InferMessage OverflowMessage() {
+    InferMessage m;
+    auto& [status, res] = m.result;
+    status["is_done"] = true;
+    status["has_error"] = true;
+    status["is_stream"] = true;
+    status["status_code"] = 500;
+    res["message"] = "Stream dropped, the client could not keep up";
+    return m;
+  }
+
+  void MaybeWakeProducer() {
+    if (ring_.Size() > low_watermark_) {
+      return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!flow_waiting_) {
+      return;
+    }
+    std::function<void()> cb;
+    {
+      std::lock_guard<std::mutex> l(flow_mtx_);
+      cb = std::exchange(on_writable_, nullptr);
+      flow_waiting_ = false;
+    }
+    if (cb) {
+      cb();
+    }
+  }
+
+  cortex::utils::SpscRing<InferMessage> ring_;
+  const size_t high_watermark_;
+  const size_t low_watermark_;
+  std::atomic<bool> closed_{false};
+  // Set when the channel filled up, the stream is failed then
+  std::atomic<bool> overflowed_{false};
+  // Only touched by the consumer
+  bool overflow_reported_ = false;
+
+  // Messages pushed while the ring was full, see Push()
+  std::mutex spill_mtx_;
+  std::deque<InferMessage> spill_;
+  std::atomic<bool> spilled_{false};
+
+  // Set while a drain is scheduled or running, so that a burst of messages
+  // only wakes the consumer once
+  std::atomic<bool> notify_pending_{false};
+  std::mutex notify_mtx_;
+  std::function<void()> notifier_;
+
+  // Set while the producer is throttled
+  std::atomic<bool> flow_waiting_{false};
+  std::mutex flow_mtx_;
+  std::function<void()> on_writable_;
+  std::function<void()> on_closed_;
+  std::atomic<bool> cancellable_{false};
+};
@@ -1,8 +1,17 @@
 #pragma once
 
+#include <filesystem>
 #include "common/file.h"
 #include "utils/result.hpp"
 
+// Where a file's content is on disk. The content itself is not read, so that
+// it can be sent straight from the file.
+struct FileContent {
+  std::filesystem::path path;
+  uint64_t size;
+  std::string etag;
+};
+
 class FileRepository {
  public:
   virtual cpp::result<void, std::string> StoreFile(OpenAi::File& file_metadata,
@@ -16,11 +25,11 @@ class FileRepository {
   virtual cpp::result<OpenAi::File, std::string> RetrieveFile(
       const std::string file_id) const = 0;
 
-  virtual cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
-  RetrieveFileContent(const std::string& file_id) const = 0;
+  virtual cpp::result<FileContent, std::string> RetrieveFileContent(
+      const std::string& file_id) const = 0;
 
-  virtual cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
-  RetrieveFileContentByPath(const std::string& path) const = 0;
+  virtual cpp::result<FileContent, std::string> RetrieveFileContentByPath(
+      const std::string& path) const = 0;
 
   virtual cpp::result<void, std::string> DeleteFileLocal(
       const std::string& file_id) = 0;
@@ -9,17 +9,6 @@
 #include <string>
 #include <vector>
 
-#ifdef _WIN32
-#include <io.h>
-#include <windows.h>
-#include <limits>
-#else
-#include <sys/mman.h>  // For memory-mapped file
-#include <unistd.h>    // For file descriptors
-#endif
-
-#include <fcntl.h>  // For file descriptors
-
 #include "chat_template_renderer.h"
 
 #include "gguf_parser.h"
@@ -30,321 +19,67 @@ namespace config {
 #define NOMINMAX
 constexpr int kDefaultMaxContextLength = 8192;
 
-void GGUFHandler::OpenFile(const std::string& file_path) {
-#ifdef _WIN32
-  HANDLE file_handle_ = INVALID_HANDLE_VALUE;
-  HANDLE file_mapping_ = nullptr;
-  file_handle_ =
-      CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
-                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-  if (file_handle_ == INVALID_HANDLE_VALUE) {
-    throw std::runtime_error("Failed to open file");
-  }
-  // Get the file size
-  LARGE_INTEGER file_size_struct;
-  if (!GetFileSizeEx(file_handle_, &file_size_struct)) {
-    CloseHandle(file_handle_);
-    throw std::runtime_error("Failed to get file size");
-  }
-  file_size_ = static_cast<size_t>(file_size_struct.QuadPart);
-
-  // Create a file mapping object
-  file_mapping_ =
-      CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
-  if (file_mapping_ == nullptr) {
-    CloseHandle(file_handle_);
-    throw std::runtime_error("Failed to create file mapping");
-  }
-
-  // Map the file into memory
-  data_ = static_cast<uint8_t*>(
-      MapViewOfFile(file_mapping_, FILE_MAP_READ, 0, 0, file_size_));
-  if (data_ == nullptr) {
-    CloseHandle(file_mapping_);
-    CloseHandle(file_handle_);
-    throw std::runtime_error("Failed to map file");
-  }
-
-  // Close the file handle, as it is no longer needed after mapping
-  CloseHandle(file_handle_);
-
-#else
-  file_size_ = std::filesystem::file_size(file_path);
-
-  int file_descriptor = open(file_path.c_str(), O_RDONLY);
-  // Memory-map the file
-  data_ = static_cast<uint8_t*>(
-      mmap(nullptr, file_size_, PROT_READ, MAP_PRIVATE, file_descriptor, 0));
-  if (data_ == MAP_FAILED) {
-    perror("Error mapping file");
-    close(file_descriptor);
-    throw std::runtime_error("Failed to map file");
-  }
-
-  close(file_descriptor);
-
-#endif
-}
-
-void GGUFHandler::CheckOffset(size_t offset) const {
-  if (offset > file_size_)
-    throw std::runtime_error("Unexpected EOF");
-}
-
-void GGUFHandler::CloseFile() {
-#ifdef _WIN32
-  if (data_ != nullptr) {
-    UnmapViewOfFile(data_);
-    data_ = nullptr;
-  }
-#else
-  if (data_ != nullptr && data_ != MAP_FAILED) {
-    munmap(data_, file_size_);
-  }
-#endif
-}
-
-std::pair<std::size_t, std::string> GGUFHandler::ReadString(
-    std::size_t offset) const {
-  CheckOffset(offset + 8);
-  uint64_t length;
-  std::memcpy(&length, data_ + offset, sizeof(uint64_t));
-
-  CheckOffset(offset + 8 + length);
-  std::string value(reinterpret_cast<const char*>(data_ + offset + 8), length);
-  return {8 + static_cast<std::size_t>(length), value};
-}
-
-size_t GGUFHandler::ReadMetadataValue(int type, std::size_t offset,
-                                      const std::string& key) {
-  switch (type) {
-    case 0:  // UINT8
-      CheckOffset(offset + 1);
-      metadata_uint8_[key] = data_[offset];
-      return 1;
-    case 1:  // INT8
-      CheckOffset(offset + 1);
-      metadata_int8_[key] = static_cast<int8_t>(data_[offset]);
-      return 1;
-    case 2:  // UINT16
-      CheckOffset(offset + 2);
-      metadata_uint16_[key] =
-          *reinterpret_cast<const uint16_t*>(data_ + offset);
-      return 2;
-    case 3:  // INT16
-      CheckOffset(offset + 2);
-      metadata_int16_[key] = *reinterpret_cast<const int16_t*>(data_ + offset);
-      return 2;
-    case 4:  // UINT32
-      CheckOffset(offset + 4);
-      metadata_uint32_[key] =
-          *reinterpret_cast<const uint32_t*>(data_ + offset);
-      return 4;
-    case 5:  // INT32
-      CheckOffset(offset + 4);
-      metadata_int32_[key] = *reinterpret_cast<const int32_t*>(data_ + offset);
-      return 4;
-    case 6:  // FLOAT32
-      CheckOffset(offset + 4);
-      metadata_float_[key] = *reinterpret_cast<const float*>(data_ + offset);
-      return 4;
-    case 7:  // BOOL
-      CheckOffset(offset + 1);
-      metadata_bool_[key] = data_[offset] != 0;
-      return 1;
-    case 8:  // STRING
-    {
-      auto [byte_length, value] = ReadString(offset);
-      metadata_string_[key] = value;
-      return byte_length;
-    }
-    case 9:  // ARRAY
-
-      return ReadArray(offset, key);
-    case 10:  // UINT64
-      CheckOffset(offset + 8);
-      metadata_uint64_[key] =
-          *reinterpret_cast<const uint64_t*>(data_ + offset);
-      return 8;
-    case 11:  // INT64
-      CheckOffset(offset + 8);
-      metadata_int64_[key] = *reinterpret_cast<const int64_t*>(data_ + offset);
-      return 8;
-    case 12:  // FLOAT64
-      CheckOffset(offset + 8);
-      metadata_double_[key] = *reinterpret_cast<const double*>(data_ + offset);
-      return 8;
-    default:
-      throw std::runtime_error("Unsupported metadata type: " +
-                               std::to_string(type));
+// https://github.com/ggml-org/ggml/blob/master/docs/gguf.md
+void GGUFHandler::Parse(const std::string& file_path) {
+  using cortex_utils::GgufIndex;
+  auto index = GgufIndex::Get(file_path);
+  if (index.has_error()) {
+    throw std::runtime_error(index.error());
   }
-}
-
-size_t GGUFHandler::ReadArray(std::size_t offset, const std::string& key) {
-  CheckOffset(offset + 4);
-  uint32_t array_type = *reinterpret_cast<const uint32_t*>(data_ + offset);
-  // std::memcpy(&array_type, data_ + offset, sizeof(uint32_t));
-
-  CheckOffset(offset + 4 + 8);
-  uint64_t array_length =
-      *reinterpret_cast<const uint64_t*>(data_ + offset + 4);
-  // std::memcpy(&array_length, data_ + offset + 4, sizeof(uint64_t));
-  LOG_INFO << "\n"
-           << "Parsing array type: " << array_type
-           << ", array length:" << array_length << "\n";
-  std::size_t array_offset = 12;
-  std::vector<std::string> array_values_string;
-  std::vector<float> array_values_float;
-  uint8_t uint8_value;
-  int8_t int8_value;
-  uint16_t uint16_value;
-  int16_t int16_value;
-  uint32_t uint32_value;
-  int32_t int32_value;
-  float float_value;
-  bool bool_value;
-  std::string string_value;
-  uint64_t uint64_value;
-  int64_t int64_value;
-  double double_value;
-  size_t length;
-
-  for (uint64_t i = 0; i < array_length; ++i) {
-    // auto [byteLength, value] = ReadMetadataValue(array_type, offset + array_offset);
-    // assume that array ony has 2 type string and int
-    switch (array_type) {
-      case 0:
-        CheckOffset(offset + array_offset + 1);
-        uint8_value = data_[offset + array_offset];
-        length = 1;
-        array_values_float.push_back(static_cast<float>(uint8_value));
+  index_ = index.value();
+  const auto& gi = *index_;
+  version_ = gi.version();
+  tensor_count_ = gi.tensors().size();
+  LOG_INFO << "version: " << version_ << "\ntensor count: " << tensor_count_
+           << "\nmetadata key-value pairs: " << gi.kvs().size() << "\n";
+
+  for (const auto& kv : gi.kvs()) {
+    std::string key(kv.key);
+    const char* p = kv.data.data();
+    switch (kv.type) {
+      case cortex_utils::kGgufUint8:
+        metadata_uint8_[key] = GgufIndex::Load<uint8_t>(p);
         break;
-      case 1: {
-        CheckOffset(offset + array_offset + 1);
-        int8_value = static_cast<int8_t>(data_[offset + array_offset]);
-        length = 1;
-        array_values_float.push_back(static_cast<float>(int8_value));
-      }
-
-      break;
-      case 2:
-        CheckOffset(offset + array_offset + 2);
-        uint16_value =
-            *reinterpret_cast<const uint16_t*>(data_ + offset + array_offset);
-        length = 2;
-        array_values_float.push_back(static_cast<float>(uint16_value));
+      case cortex_utils::kGgufInt8:
+        metadata_int8_[key] = GgufIndex::Load<int8_t>(p);
+        break;
+      case cortex_utils::kGgufUint16:
+        metadata_uint16_[key] = GgufIndex::Load<uint16_t>(p);
+        break;
+      case cortex_utils::kGgufInt16:
+        metadata_int16_[key] = GgufIndex::Load<int16_t>(p);
         break;
-      case 3:
-        CheckOffset(offset + array_offset + 2);
-        int16_value =
-            *reinterpret_cast<const int16_t*>(data_ + offset + array_offset);
-        length = 2;
-        array_values_float.push_back(static_cast<float>(int16_value));
+      case cortex_utils::kGgufUint32:
+        metadata_uint32_[key] = GgufIndex::Load<uint32_t>(p);
         break;
-      case 4:
-        CheckOffset(offset + array_offset + 4);
-        uint32_value =
-            *reinterpret_cast<const uint32_t*>(data_ + offset + array_offset);
-        length = 4;
-        array_values_float.push_back(static_cast<float>(uint32_value));
+      case cortex_utils::kGgufInt32:
+        metadata_int32_[key] = GgufIndex::Load<int32_t>(p);
         break;
-      case 5:
-        CheckOffset(offset + array_offset + 4);
-        int32_value =
-            *reinterpret_cast<const int32_t*>(data_ + offset + array_offset);
-        length = 4;
-        array_values_float.push_back(static_cast<float>(int32_value));
+      case cortex_utils::kGgufFloat32:
+        metadata_float_[key] = GgufIndex::Load<float>(p);
         break;
-      case 6:
-        CheckOffset(offset + array_offset + 4);
-        float_value =
-            *reinterpret_cast<const float*>(data_ + offset + array_offset);
-        length = 4;
-        array_values_float.push_back(static_cast<float>(float_value));
+      case cortex_utils::kGgufBool:
+        metadata_bool_[key] = p[0] != 0;
         break;
-      case 7:
-        CheckOffset(offset + array_offset + 1);
-        bool_value = data_[offset + array_offset] != 0;
-        length = 1;
-        array_values_float.push_back(static_cast<float>(bool_value));
+      case cortex_utils::kGgufString:
+        metadata_string_[key] = std::string(kv.data);
         break;
-      case 8: {
-        CheckOffset(offset + array_offset + 8);
-        uint64_t length_ =
-            *reinterpret_cast<const uint64_t*>(data_ + offset + array_offset);
-        std::string value(
-            reinterpret_cast<const char*>(data_ + offset + array_offset + 8),
-            length_);
-        length = 8 + static_cast<std::size_t>(length_);
-        array_values_string.push_back(value);
-      } break;
-      case 10:
-        CheckOffset(offset + array_offset + 8);
-        uint64_value =
-            *reinterpret_cast<const uint64_t*>(data_ + offset + array_offset);
-        length = 8;
-        array_values_float.push_back(static_cast<float>(uint64_value));
+      case cortex_utils::kGgufArray:
+        metadata_array_[key] = GgufIndex::ToArray(kv);
         break;
-      case 11:
-        CheckOffset(offset + array_offset + 8);
-        int64_value =
-            *reinterpret_cast<const int64_t*>(data_ + offset + array_offset);
-        length = 8;
-        array_values_float.push_back(static_cast<float>(int64_value));
+      case cortex_utils::kGgufUint64:
+        metadata_uint64_[key] = GgufIndex::Load<uint64_t>(p);
         break;
-      case 12:
-        CheckOffset(offset + array_offset + 8);
-        double_value =
-            *reinterpret_cast<const double*>(data_ + offset + array_offset);
-        length = 8;
-        array_values_float.push_back(static_cast<float>(double_value));
+      case cortex_utils::kGgufInt64:
+        metadata_int64_[key] = GgufIndex::Load<int64_t>(p);
+        break;
+      case cortex_utils::kGgufFloat64:
+        metadata_double_[key] = GgufIndex::Load<double>(p);
         break;
       default:
         throw std::runtime_error("Unsupported metadata type: " +
-                                 std::to_string(array_type));
-        break;
+                                 std::to_string(kv.type));
     }
-
-    array_offset += length;
-  }
-  if (array_values_string.size() > 0)
-    metadata_array_string_[key] = array_values_string;
-  else
-    metadata_array_float_[key] = array_values_float;
-  return array_offset;
-}
-
-// https://github.com/ggml-org/ggml/blob/master/docs/gguf.md
-void GGUFHandler::Parse(const std::string& file_path) {
-  OpenFile(file_path);
-  CheckOffset(4 + 4 + 8 + 8);
-
-  LOG_INFO << "GGUF magic number: " << *reinterpret_cast<const uint32_t*>(data_)
-           << "\n";
-  if (*reinterpret_cast<const uint32_t*>(data_) != GGUF_MAGIC_NUMBER) {
-    throw std::runtime_error("Not a valid GGUF file");
-  }
-
-  version_ = *reinterpret_cast<const uint32_t*>(data_ + 4);
-  tensor_count_ = *reinterpret_cast<const uint64_t*>(data_ + 8);
-  uint64_t metadata_kv_count = *reinterpret_cast<const uint64_t*>(data_ + 16);
-  LOG_INFO << "version: " << version_ << "\ntensor count: " << tensor_count_
-           << "\nmetadata key-value pairs: " << metadata_kv_count << "\n";
-
-  std::size_t offset = 24;
-
-  for (uint64_t i = 0; i < metadata_kv_count; ++i) {
-    LOG_INFO << "Parsing key-value number " << i << "\n";
-    auto [key_byte_length, key] = ReadString(offset);
-    offset += key_byte_length;
-    LOG_INFO << "key: " << key << "\n";
-    CheckOffset(offset + 4);
-    uint32_t value_type = *reinterpret_cast<const uint32_t*>(data_ + offset);
-    offset += 4;
-    LOG_INFO << "value type number: " << value_type << "\n";
-    size_t value_byte_length = ReadMetadataValue(value_type, offset, key);
-    offset += value_byte_length;
-    LOG_INFO << "-------------------------------------------- " << "\n";
   }
   try {
     PrintMetadata();
@@ -352,7 +87,6 @@ void GGUFHandler::Parse(const std::string& file_path) {
     LOG_ERROR << "Error parsing metadata: " << e.what() << "\n";
   }
   ModelConfigFromMetadata();
-  CloseFile();
 }
 
 void GGUFHandler::PrintMetadata() {
@@ -405,17 +139,14 @@ void GGUFHandler::PrintMetadata() {
   for (const auto& [key, value] : metadata_double_)
     LOG_INFO << key << ": " << value << "\n";
 
-  for (const auto& [key, value] : metadata_array_float_)
-    LOG_INFO << key << "num elements: " << value.size() << "\n";
-
-  for (const auto& [key, value] : metadata_array_string_)
-    LOG_INFO << key << " num elements: " << value.size() << "\n";
+  for (const auto& [key, value] : metadata_array_)
+    LOG_INFO << key << " num elements: " << value.size << "\n";
 }
 
 void GGUFHandler::ModelConfigFromMetadata() {
-  int eos_token, bos_token, max_tokens, version, ngl;
+  int eos_token = -1, bos_token, max_tokens, version, ngl;
   std::string chat_template, name, eos_string, bos_string;
-  std::vector<std::string> tokens, stop;
+  std::vector<std::string> stop;
   model_config_.top_p = 0.95;
   model_config_.temperature = 0.7;
   model_config_.frequency_penalty = 0;
@@ -546,11 +277,6 @@ void GGUFHandler::ModelConfigFromMetadata() {
     else if (key.find("block_count") != std::string::npos)
       ngl = static_cast<int>(value) + 1;
   }
-  for (const auto& [key, value] : metadata_array_string_) {
-    if (key.compare("tokenizer.ggml.tokens") == 0) {
-      tokens = std::move(value);
-    }
-  }
   for (const auto& [key, value] : metadata_string_) {
     if (key.compare("general.name") == 0) {
       name = std::regex_replace(value, std::regex(" "), "-");
@@ -587,14 +313,15 @@ void GGUFHandler::ModelConfigFromMetadata() {
     }
   }
 
-  try {
-    if (tokens.size() > (unsigned)eos_token) {
-      eos_string = tokens[eos_token];
-      stop.push_back(std::move(eos_string));
-    } else {
-      LOG_ERROR << "Can't find stop token";
-    }
-  } catch (const std::exception& e) {
+  std::optional<std::string_view> eos;
+  if (auto it = metadata_array_.find("tokenizer.ggml.tokens");
+      it != metadata_array_.end()) {
+    eos = it->second.StringAt(static_cast<unsigned>(eos_token));
+  }
+  if (eos) {
+    eos_string = std::string(*eos);
+    stop.push_back(std::move(eos_string));
+  } else {
     LOG_ERROR << "Can't find stop token";
   }
 
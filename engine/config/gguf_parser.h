@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "utils/gguf_index.h"
 #include "yaml_config.h"
 
 namespace config {
@@ -34,22 +35,13 @@ constexpr uint32_t GGUF_MAGIC_NUMBER = 1179993927;
 
 class GGUFHandler {
  public:
-  void CloseFile();
   void Parse(const std::string& file_path);
   const ModelConfig& GetModelConfig() const;
   void PrintMetadata();
 
  private:
-  std::pair<std::size_t, std::string> ReadString(std::size_t offset) const;
-  size_t ReadMetadataValue(int type, std::size_t offset,
-                           const std::string& key);
-  size_t ReadArray(std::size_t offset, const std::string& key);
   void ModelConfigFromMetadata();
-  void OpenFile(const std::string& file_path);
-  void CheckOffset(size_t offset) const;
 
-  uint8_t* data_;
-  size_t file_size_;
   uint32_t version_;
   uint64_t tensor_count_;
   ModelConfig model_config_;
@@ -65,8 +57,11 @@ class GGUFHandler {
   std::unordered_map<std::string, uint64_t> metadata_uint64_;
   std::unordered_map<std::string, int64_t> metadata_int64_;
   std::unordered_map<std::string, double> metadata_double_;
-  std::unordered_map<std::string, std::vector<float>> metadata_array_float_;
-  std::unordered_map<std::string, std::vector<std::string>>
-      metadata_array_string_;
+  // Arrays are only decoded when needed: the tokens, scores and merges of a
+  // large vocabulary are hundreds of thousands of elements each
+  std::unordered_map<std::string, cortex_utils::GgufIndex::Array>
+      metadata_array_;
+  // Holds the memory that metadata_array_ views
+  std::shared_ptr<const cortex_utils::GgufIndex> index_;
 };
 }  // namespace config
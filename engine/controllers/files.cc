@@ -196,7 +196,6 @@ void Files::RetrieveFileContent(
     const HttpRequestPtr& req,
     std::function<void(const HttpResponsePtr&)>&& callback,
     const std::string& file_id, std::optional<std::string> thread_id) {
-  (void)req;
   if (thread_id.has_value()) {
     auto msg_res =
         message_service_->RetrieveMessage(thread_id.value(), file_id);
@@ -220,9 +219,9 @@ void Files::RetrieveFileContent(
         return;
       }
 
-      auto resp =
-          cortex_utils::CreateCortexContentResponse(std::move(res.value()));
-      callback(resp);
+      callback(cortex_utils::CreateCortexFileResponse(
+          req, res->path, res->size, res->etag));
+      return;
     } else {
       if (!msg_res->rel_path.has_value()) {
         Json::Value ret;
@@ -245,9 +244,9 @@ void Files::RetrieveFileContent(
         return;
       }
 
-      auto resp = cortex_utils::CreateCortexContentResponse(
-          std::move(content_res.value()));
-      callback(resp);
+      callback(cortex_utils::CreateCortexFileResponse(
+          req, content_res->path, content_res->size, content_res->etag));
+      return;
     }
   }
 
@@ -261,6 +260,6 @@ void Files::RetrieveFileContent(
     return;
   }
 
-  auto resp = cortex_utils::CreateCortexContentResponse(std::move(res.value()));
-  callback(resp);
+  callback(cortex_utils::CreateCortexFileResponse(req, res->path, res->size,
+                                                  res->etag));
 }
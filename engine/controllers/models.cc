@@ -376,6 +376,7 @@ void Models::UpdateModel(const HttpRequestPtr& req,
       message = "Successfully update model ID '" + model_id +
                 "': " + json_body.toStyledString();
     }
+    model_service_->InvalidateModelCatalog(model_id);
     LOG_INFO << message;
     Json::Value ret;
     ret["result"] = "Updated successfully!";
@@ -459,6 +460,7 @@ void Models::ImportModel(
 
     if (db_service_->AddModelEntry(model_entry).value()) {
       yaml_handler.WriteYamlFile(model_yaml_path);
+      model_service_->InvalidateModelCatalog(modelHandle);
       std::string success_message = "Model is imported successfully!";
       LOG_INFO << success_message;
       Json::Value ret;
@@ -703,6 +705,7 @@ void Models::AddRemoteModel(
         std::filesystem::path(model_yaml_path).parent_path());
     if (db_service_->AddModelEntry(model_entry).value()) {
       model_config.SaveToYamlFile(model_yaml_path);
+      model_service_->InvalidateModelCatalog(model_handle);
       std::string success_message = "Model is imported successfully!";
       LOG_INFO << success_message;
       Json::Value ret;
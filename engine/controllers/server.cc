@@ -1,6 +1,8 @@
 #include "server.h"
 
+#include "trantor/net/TcpConnection.h"
 #include "trantor/utils/Logger.h"
+#include "utils/chunk_coalescer.h"
 #include "utils/cortex_utils.h"
 #include "utils/function_calling/common.h"
 
@@ -8,6 +10,208 @@ using namespace inferences;
 
 namespace inferences {
 
+namespace {
+// The IO loop of the connection being handled
+trantor::EventLoop* GetConnectionLoop() {
+  auto loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+  return loop ? loop : drogon::app().getLoop();
+}
+
+// A burst of frames is written at once up to this size
+constexpr const size_t kStreamFlushBytes = 16 * 1024;
+// Frames arriving within this interval after a write are coalesced into the
+// next one
+constexpr const auto kStreamFlushInterval = std::chrono::milliseconds(10);
+// Messages handled per run, so that one busy stream does not starve the other
+// connections of its loop
+constexpr const size_t kMaxMessagesPerDrain = 64;
+// Draining pauses while this much of the response waits in the connection's
+// write buffer, so that a slow client throttles the engine instead of growing
+// the buffer
+constexpr const size_t kStreamMaxBacklogBytes = 256 * 1024;
+// How often a paused stream checks whether the client caught up
+constexpr const auto kStreamBacklogPollInterval = std::chrono::milliseconds(20);
+
+// Forwards the messages of an InferChannel to an async stream response. Runs
+// on the connection's IO loop and only when the channel has messages, so a
+// slow engine or client never occupies the loop. Frames are coalesced and
+// written whole, however large they are.
+class StreamForwarder : public std::enable_shared_from_this<StreamForwarder> {
+ public:
+  StreamForwarder(std::shared_ptr<InferChannel> q,
+                  drogon::ResponseStreamPtr stream,
+                  std::weak_ptr<trantor::TcpConnection> conn,
+                  trantor::EventLoop* loop, std::function<void()>&& stop)
+      : q_(std::move(q)),
+        stream_(std::move(stream)),
+        conn_(std::move(conn)),
+        loop_(loop),
+        stop_(std::move(stop)),
+        coalescer_(kStreamFlushBytes, kStreamFlushInterval) {}
+
+  void Start() {
+    if (auto conn = conn_.lock()) {
+      sent_at_start_ = conn->bytesSent();
+    }
+    // The channel keeps the forwarder alive until Finish() detaches it
+    auto self = shared_from_this();
+    q_->SetNotifier([self] { self->ScheduleDrain(); });
+  }
+
+ private:
+  void ScheduleDrain() {
+    auto self = shared_from_this();
+    loop_->queueInLoop([self] { self->Drain(); });
+  }
+
+  void Drain() {
+    if (finished_) {
+      return;
+    }
+    if (Backlog() > kStreamMaxBacklogBytes) {
+      // Left in the channel, which throttles the engine once full. No
+      // notification comes until the next drain, so poll.
+      if (!backlog_poll_scheduled_) {
+        backlog_poll_scheduled_ = true;
+        auto self = shared_from_this();
+        loop_->runAfter(
+            std::chrono::duration<double>(kStreamBacklogPollInterval),
+            [self] {
+              self->backlog_poll_scheduled_ = false;
+              self->Drain();
+            });
+      }
+      return;
+    }
+    bool more = q_->Drain(
+        [this](InferMessage&& msg) {
+          if (finished_) {
+            return;
+          }
+          bool last = false;
+          auto now = cortex::utils::ChunkCoalescer::Clock::now();
+          bool flush = coalescer_.Append(ToChunk(std::move(msg), last), now);
+          if ((flush || last) && !Flush()) {
+            return;
+          }
+          if (last) {
+            LOG_TRACE << "Done";
+            Finish(true);
+          }
+        },
+        kMaxMessagesPerDrain);
+    if (finished_) {
+      return;
+    }
+    if (more) {
+      ScheduleDrain();
+    }
+    ScheduleFlush();
+  }
+
+  // Returns false if the client is gone
+  bool Flush() {
+    if (coalescer_.Empty()) {
+      return true;
+    }
+    auto chunk = coalescer_.Take(cortex::utils::ChunkCoalescer::Clock::now());
+    queued_bytes_ += ChunkedSize(chunk.size());
+    if (!stream_->send(chunk)) {
+      LOG_TRACE << "Client disconnected";
+      Finish(false);
+      return false;
+    }
+    return true;
+  }
+
+  void ScheduleFlush() {
+    if (coalescer_.Empty() || flush_scheduled_) {
+      return;
+    }
+    auto delay = coalescer_.FlushDeadline() -
+                 cortex::utils::ChunkCoalescer::Clock::now();
+    if (delay <= decltype(delay)::zero()) {
+      Flush();
+      return;
+    }
+    flush_scheduled_ = true;
+    auto self = shared_from_this();
+    loop_->runAfter(std::chrono::duration<double>(delay), [self] {
+      self->flush_scheduled_ = false;
+      if (!self->finished_) {
+        self->Flush();
+      }
+    });
+  }
+
+  // Bytes of the response written to the connection but not sent yet. Counts
+  // from the start of the stream, the headers and earlier responses on the
+  // connection only make it look smaller.
+  size_t Backlog() const {
+    auto conn = conn_.lock();
+    if (!conn) {
+      return 0;
+    }
+    auto sent = conn->bytesSent() - sent_at_start_;
+    return queued_bytes_ > sent ? queued_bytes_ - sent : 0;
+  }
+
+  // A chunk of the chunked transfer coding: its size in hex, CRLF, the data
+  // and CRLF
+  static size_t ChunkedSize(size_t n) {
+    size_t hex_digits = 1;
+    for (auto v = n >> 4; v != 0; v >>= 4) {
+      hex_digits++;
+    }
+    return hex_digits + 2 + n + 2;
+  }
+
+  static std::string ToChunk(InferMessage&& msg, bool& last) {
+    if (msg.is_raw) {
+      // Frames are forwarded exactly as the engine produced them
+      last = msg.is_done;
+      return std::move(msg.raw);
+    }
+    auto& [status, res] = msg.result;
+    last = status["has_error"].asBool() || status["is_done"].asBool();
+    if (status["status_code"].asInt() != k200OK) {
+      return json_helper::DumpJsonString(res);
+    }
+    LOG_DEBUG << "data: " << res["data"].asString();
+    return res["data"].asString();
+  }
+
+  // Once the engine ended the stream, its request is left alone, so that
+  // its connection to the model server is kept alive. When the client went
+  // away, closing the channel cancels the request in engines using the sink,
+  // the others are told to stop.
+  void Finish(bool completed) {
+    finished_ = true;
+    stream_->close();
+    if (completed) {
+      q_->SetNotifier(nullptr);
+      return;
+    }
+    q_->Close();
+    if (!q_->IsCancellable() && stop_) {
+      stop_();
+    }
+  }
+
+  std::shared_ptr<InferChannel> q_;
+  drogon::ResponseStreamPtr stream_;
+  std::weak_ptr<trantor::TcpConnection> conn_;
+  trantor::EventLoop* loop_;
+  std::function<void()> stop_;
+  cortex::utils::ChunkCoalescer coalescer_;
+  size_t sent_at_start_ = 0;
+  size_t queued_bytes_ = 0;
+  bool backlog_poll_scheduled_ = false;
+  bool flush_scheduled_ = false;
+  bool finished_ = false;
+};
+}  // namespace
+
 server::server(std::shared_ptr<InferenceService> inference_service,
                std::shared_ptr<EngineService> engine_service)
     : inference_svc_(inference_service), engine_service_(engine_service) {
@@ -36,21 +240,12 @@ void server::ChatCompletion(
   }
   bool is_stream = (*json_body).get("stream", false).asBool();
   auto model_id = (*json_body).get("model", "invalid_model").asString();
-  auto engine_type = [this, &json_body]() -> std::string {
-    if (!inference_svc_->HasFieldInReq(json_body, "engine")) {
-      return kLlamaRepo;
-    } else {
-      return (*(json_body)).get("engine", kLlamaRepo).asString();
-    }
-  }();
-
   if (auto efm = inference_svc_->GetEngineByModelId(model_id); !efm.empty()) {
-    engine_type = efm;
     (*json_body)["engine"] = efm;
   }
 
   LOG_DEBUG << "request body: " << json_body->toStyledString();
-  auto q = std::make_shared<SyncQueue>();
+  auto q = std::make_shared<InferChannel>();
   auto ir = inference_svc_->HandleChatCompletion(q, json_body);
   if (ir.has_error()) {
     auto err = ir.error();
@@ -62,9 +257,11 @@ void server::ChatCompletion(
   }
   LOG_DEBUG << "Wait to chat completion responses";
   if (is_stream) {
-    ProcessStreamRes(std::move(callback), q, engine_type, model_id);
+    ProcessStreamRes(req, std::move(callback), q,
+                     json_body->get("engine", kLlamaRepo).asString(),
+                     model_id);
   } else {
-    ProcessNonStreamRes(std::move(callback), *q);
+    ProcessNonStreamRes(std::move(callback), q);
   }
   LOG_DEBUG << "Done chat completion";
 }
@@ -72,7 +269,7 @@ void server::ChatCompletion(
 void server::Embedding(const HttpRequestPtr& req,
                        std::function<void(const HttpResponsePtr&)>&& callback) {
   LOG_TRACE << "Start embedding";
-  auto q = std::make_shared<SyncQueue>();
+  auto q = std::make_shared<InferChannel>();
   auto ir = inference_svc_->HandleEmbedding(q, req->getJsonObject());
   if (ir.has_error()) {
     auto err = ir.error();
@@ -83,7 +280,7 @@ void server::Embedding(const HttpRequestPtr& req,
     return;
   }
   LOG_TRACE << "Wait to embedding";
-  ProcessNonStreamRes(std::move(callback), *q);
+  ProcessNonStreamRes(std::move(callback), q);
   LOG_TRACE << "Done embedding";
 }
 
@@ -100,6 +297,41 @@ void server::UnloadModel(
   callback(resp);
 }
 
+void server::StopInferencing(
+    const HttpRequestPtr& req,
+    std::function<void(const HttpResponsePtr&)>&& callback) {
+  auto json_body = req->getJsonObject();
+  if (json_body == nullptr) {
+    Json::Value ret;
+    ret["message"] = "Body can't be empty";
+    auto resp = cortex_utils::CreateCortexHttpJsonResponse(ret);
+    resp->setStatusCode(k400BadRequest);
+    callback(resp);
+    return;
+  }
+  auto model = (*json_body).get("model_id", "").asString();
+  if (model.empty()) {
+    Json::Value ret;
+    ret["message"] = "model_id is required";
+    auto resp = cortex_utils::CreateCortexHttpJsonResponse(ret);
+    resp->setStatusCode(k400BadRequest);
+    callback(resp);
+    return;
+  }
+  auto engine = (*json_body).get("engine", kLlamaRepo).asString();
+  if (auto efm = inference_svc_->GetEngineByModelId(model); !efm.empty()) {
+    engine = efm;
+  }
+  CTL_INF("Stopping inference of model: " + model + ", engine: " + engine);
+  auto stopped = inference_svc_->StopInferencing(engine, model);
+  Json::Value ret;
+  ret["message"] = stopped ? "Stopped inferencing of " + model
+                           : "Engine is not loaded yet: " + engine;
+  auto resp = cortex_utils::CreateCortexHttpJsonResponse(ret);
+  resp->setStatusCode(stopped ? k200OK : k400BadRequest);
+  callback(resp);
+}
+
 void server::ModelStatus(
     const HttpRequestPtr& req,
     std::function<void(const HttpResponsePtr&)>&& callback) {
@@ -123,67 +355,59 @@ void server::GetModels(const HttpRequestPtr& req,
 
 void server::LoadModel(const HttpRequestPtr& req,
                        std::function<void(const HttpResponsePtr&)>&& callback) {
-  auto ir = inference_svc_->LoadModel(req->getJsonObject());
-  auto resp = cortex_utils::CreateCortexHttpJsonResponse(std::get<1>(ir));
-  resp->setStatusCode(
-      static_cast<HttpStatusCode>(std::get<0>(ir)["status_code"].asInt()));
-  callback(resp);
-  LOG_TRACE << "Done load model";
+  inference_svc_->LoadModelAsync(
+      req->getJsonObject(),
+      [callback = std::move(callback)](InferResult&& ir) {
+        auto resp =
+            cortex_utils::CreateCortexHttpJsonResponse(std::get<1>(ir));
+        resp->setStatusCode(static_cast<HttpStatusCode>(
+            std::get<0>(ir)["status_code"].asInt()));
+        callback(resp);
+        LOG_TRACE << "Done load model";
+      });
 }
 
-void server::ProcessStreamRes(std::function<void(const HttpResponsePtr&)> cb,
-                              std::shared_ptr<SyncQueue> q,
+void server::ProcessStreamRes(const HttpRequestPtr& req,
+                              std::function<void(const HttpResponsePtr&)> cb,
+                              std::shared_ptr<InferChannel> q,
                               const std::string& engine_type,
                               const std::string& model_id) {
-  auto err_or_done = std::make_shared<std::atomic_bool>(false);
-  auto chunked_content_provider = [this, q, err_or_done, engine_type, model_id](
-                                      char* buf,
-                                      std::size_t buf_size) -> std::size_t {
-    if (buf == nullptr) {
-      LOG_TRACE << "Buf is null";
-      if (!(*err_or_done)) {
-        inference_svc_->StopInferencing(engine_type, model_id);
-      }
-      return 0;
-    }
-
-    if (*err_or_done) {
-      LOG_TRACE << "Done";
-      return 0;
-    }
-
-    auto [status, res] = q->wait_and_pop();
-
-    if (status["has_error"].asBool() || status["is_done"].asBool()) {
-      *err_or_done = true;
-    }
-
-    std::string str;
-    if (status["status_code"].asInt() != k200OK) {
-      str = json_helper::DumpJsonString(res);
-    } else {
-      str = res["data"].asString();
-    }
-    LOG_DEBUG << "data: " << str;
-    std::size_t n = std::min(str.size(), buf_size);
-    memcpy(buf, str.data(), n);
-
-    return n;
-  };
-
-  auto resp = cortex_utils::CreateCortexStreamResponse(chunked_content_provider,
-                                                       "chat_completions.txt");
+  auto resp = cortex_utils::CreateCortexAsyncStreamResponse(
+      [this, q, conn = req->getConnectionPtr(), engine_type,
+       model_id](drogon::ResponseStreamPtr stream) {
+        auto forwarder = std::make_shared<StreamForwarder>(
+            q, std::move(stream), conn, GetConnectionLoop(),
+            [this, engine_type, model_id] {
+              inference_svc_->StopInferencing(engine_type, model_id);
+            });
+        forwarder->Start();
+      });
   cb(resp);
 }
 
 void server::ProcessNonStreamRes(std::function<void(const HttpResponsePtr&)> cb,
-                                 SyncQueue& q) {
-  auto [status, res] = q.wait_and_pop();
-  LOG_DEBUG << "response: " << res.toStyledString();
-  auto resp = cortex_utils::CreateCortexHttpJsonResponse(res);
-  resp->setStatusCode(
-      static_cast<drogon::HttpStatusCode>(status["status_code"].asInt()));
-  cb(resp);
+                                 std::shared_ptr<InferChannel> q) {
+  auto loop = GetConnectionLoop();
+  std::weak_ptr<InferChannel> weak_q = q;
+  q->SetNotifier([weak_q, loop, cb = std::move(cb)] {
+    auto q = weak_q.lock();
+    if (!q) {
+      return;
+    }
+    loop->queueInLoop([q, cb] {
+      q->Drain(
+          [&q, &cb](InferMessage&& msg) {
+            auto& [status, res] = msg.result;
+            LOG_DEBUG << "response: " << res.toStyledString();
+            auto resp = cortex_utils::CreateCortexHttpJsonResponse(res);
+            resp->setStatusCode(static_cast<drogon::HttpStatusCode>(
+                status["status_code"].asInt()));
+            cb(resp);
+            q->Close();
+          },
+          1);
+    });
+  });
 }
 
 }  // namespace inferences
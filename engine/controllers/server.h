@@ -37,6 +37,7 @@ class server : public drogon::HttpController<server, false>,
   METHOD_ADD(server::LoadModel, "loadmodel", Options, Post);
   METHOD_ADD(server::UnloadModel, "unloadmodel", Options, Post);
   METHOD_ADD(server::ModelStatus, "modelstatus", Options, Post);
+  METHOD_ADD(server::StopInferencing, "stopinferencing", Options, Post);
   METHOD_ADD(server::GetModels, "models", Get);
 
   // Openai compatible path
@@ -63,14 +64,20 @@ class server : public drogon::HttpController<server, false>,
   void GetModels(
       const HttpRequestPtr& req,
       std::function<void(const HttpResponsePtr&)>&& callback) override;
+  // Cancels the model's requests in flight
+  void StopInferencing(const HttpRequestPtr& req,
+                       std::function<void(const HttpResponsePtr&)>&& callback);
 
  private:
-  void ProcessStreamRes(std::function<void(const HttpResponsePtr&)> cb,
-                        std::shared_ptr<SyncQueue> q,
+  // Both forward the engine's output from the connection's IO loop as it
+  // arrives, without blocking the loop while waiting for it
+  void ProcessStreamRes(const HttpRequestPtr& req,
+                        std::function<void(const HttpResponsePtr&)> cb,
+                        std::shared_ptr<InferChannel> q,
                         const std::string& engine_type,
                         const std::string& model_id);
   void ProcessNonStreamRes(std::function<void(const HttpResponsePtr&)> cb,
-                           SyncQueue& q);
+                           std::shared_ptr<InferChannel> q);
 
  private:
   std::shared_ptr<InferenceService> inference_svc_;
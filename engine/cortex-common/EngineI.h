@@ -4,6 +4,7 @@
 #include <functional>
 #include <memory>
 
+#include "cortex-common/stream_sink.h"
 #include "json/value.h"
 #include "trantor/utils/Logger.h"
 class EngineI {
@@ -34,6 +35,17 @@ class EngineI {
   virtual void HandleChatCompletion(
       std::shared_ptr<Json::Value> json_body,
       std::function<void(Json::Value&&, Json::Value&&)>&& callback) = 0;
+  // Streaming chat completion where the engine writes SSE frames straight to
+  // |sink| instead of wrapping every token into Json::Value, honoring its
+  // backpressure. Errors are still reported through |callback|.
+  virtual void HandleStreamingChatCompletion(
+      std::shared_ptr<Json::Value> json_body,
+      std::function<void(Json::Value&&, Json::Value&&)>&& callback,
+      std::shared_ptr<StreamSink> sink) {
+    (void)sink;
+    HandleChatCompletion(json_body, std::move(callback));
+  }
+
   virtual void HandleEmbedding(
       std::shared_ptr<Json::Value> json_body,
       std::function<void(Json::Value&&, Json::Value&&)>&& callback) = 0;
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+// Receives already formatted SSE frames of a streaming response. Engines use
+// it to hand over their output without wrapping every token into Json::Value.
+class StreamSink {
+ public:
+  virtual ~StreamSink() = default;
+
+  // Takes |frames| and returns false once the consumer is saturated. The
+  // engine should then stop producing until the callback passed to
+  // OnWritable() is invoked.
+  virtual bool Write(std::string&& frames, bool is_done) = 0;
+
+  // |cb| is invoked once, possibly from another thread, as soon as Write()
+  // would accept more frames. It is invoked right away if that is already
+  // the case.
+  virtual void OnWritable(std::function<void()>&& cb) = 0;
+
+  // |cb| is invoked once, possibly from another thread, when the consumer
+  // goes away. The engine should then cancel the request instead of
+  // generating output nobody reads. It is invoked right away if the consumer
+  // is gone already.
+  virtual void OnClosed(std::function<void()>&& cb) = 0;
+};
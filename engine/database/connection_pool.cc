@@ -0,0 +1,102 @@
+#include "connection_pool.h"
+#include "utils/logging_utils.h"
+
+namespace cortex::db {
+
+namespace {
+// Waits for locks held by other processes, e.g. the CLI, before failing
+constexpr const int kBusyTimeoutMs = 5000;
+
+SQLite::Database OpenWriter(const std::filesystem::path& path) {
+  SQLite::Database db(path.string(),
+                      SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE |
+                          SQLite::OPEN_NOMUTEX,
+                      kBusyTimeoutMs);
+  // Persistent, readers opened later see it as well
+  db.exec("PRAGMA journal_mode=WAL;");
+  // Durable across application crashes, only a power loss may roll back the
+  // last transactions
+  db.exec("PRAGMA synchronous=NORMAL;");
+  return db;
+}
+}  // namespace
+
+Connection::Connection(SQLite::Database&& db)
+    : owned_(std::move(db)), db_(&*owned_) {}
+
+Connection::Connection(SQLite::Database& db) : db_(&db) {}
+
+SQLite::Statement& Connection::Prepare(const std::string& sql) {
+  auto& stmt = statements_[sql];
+  if (!stmt) {
+    stmt = std::make_unique<SQLite::Statement>(*db_, sql);
+  } else {
+    stmt->tryReset();
+    stmt->clearBindings();
+  }
+  used_.push_back(stmt.get());
+  return *stmt;
+}
+
+void Connection::ResetStatements() noexcept {
+  for (auto* stmt : used_) {
+    stmt->tryReset();
+  }
+  used_.clear();
+}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_),
+      conn_(other.conn_),
+      writer_lock_(std::move(other.writer_lock_)) {
+  other.conn_ = nullptr;
+}
+
+ConnectionPool::Lease::~Lease() {
+  if (!conn_) {
+    return;
+  }
+  conn_->ResetStatements();
+  if (!writer_lock_.owns_lock()) {
+    pool_->ReturnReader(conn_);
+  }
+}
+
+ConnectionPool::ConnectionPool(const std::filesystem::path& path,
+                               size_t n_readers)
+    : writer_(OpenWriter(path)) {
+  for (size_t i = 0; i < n_readers; i++) {
+    readers_.push_back(std::make_unique<Connection>(SQLite::Database(
+        path.string(), SQLite::OPEN_READONLY | SQLite::OPEN_NOMUTEX,
+        kBusyTimeoutMs)));
+    free_readers_.push_back(readers_.back().get());
+  }
+  CTL_DBG("Opened " << path.string() << " with " << n_readers << " readers");
+}
+
+ConnectionPool::ConnectionPool(SQLite::Database& db) : writer_(db) {}
+
+ConnectionPool::Lease ConnectionPool::Reader() {
+  if (readers_.empty()) {
+    return Writer();
+  }
+  std::unique_lock<std::mutex> l(readers_mtx_);
+  readers_cv_.wait(l, [this] { return !free_readers_.empty(); });
+  auto* conn = free_readers_.back();
+  free_readers_.pop_back();
+  return Lease(this, conn, {});
+}
+
+ConnectionPool::Lease ConnectionPool::Writer() {
+  return Lease(this, &writer_, std::unique_lock<std::mutex>(writer_mtx_));
+}
+
+void ConnectionPool::ReturnReader(Connection* conn) {
+  {
+    std::lock_guard<std::mutex> l(readers_mtx_);
+    free_readers_.push_back(conn);
+  }
+  readers_cv_.notify_one();
+}
+
+}  // namespace cortex::db
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cortex::db {
+
+// A database connection and the statements prepared on it. Not thread-safe,
+// only used through a ConnectionPool::Lease.
+class Connection {
+ public:
+  explicit Connection(SQLite::Database&& db);
+  // Uses |db| without owning it
+  explicit Connection(SQLite::Database& db);
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  SQLite::Database& db() { return *db_; }
+
+  // Returns the statement for |sql|, prepared on first use and reset with
+  // its bindings cleared afterwards
+  SQLite::Statement& Prepare(const std::string& sql);
+
+  // Resets the statements used since the last call. A statement that is not
+  // reset keeps its read transaction open, which stops WAL checkpoints.
+  void ResetStatements() noexcept;
+
+ private:
+  std::optional<SQLite::Database> owned_;
+  SQLite::Database* db_;
+  std::unordered_map<std::string, std::unique_ptr<SQLite::Statement>>
+      statements_;
+  std::vector<SQLite::Statement*> used_;
+};
+
+// Connections to the cortex database for concurrent handlers. The database is
+// in WAL mode, where readers do not block the writer or each other: a pool
+// has one writer connection, which writes are serialized on, and a number of
+// read-only connections.
+class ConnectionPool {
+ public:
+  // Exclusive use of a connection, which goes back to the pool on
+  // destruction
+  class Lease {
+   public:
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&&) = delete;
+    ~Lease();
+
+    Connection* operator->() const { return conn_; }
+    Connection& operator*() const { return *conn_; }
+
+   private:
+    friend class ConnectionPool;
+    Lease(ConnectionPool* pool, Connection* conn,
+          std::unique_lock<std::mutex>&& writer_lock)
+        : pool_(pool), conn_(conn), writer_lock_(std::move(writer_lock)) {}
+
+    ConnectionPool* pool_;
+    Connection* conn_;
+    // Held by writer leases
+    std::unique_lock<std::mutex> writer_lock_;
+  };
+
+  // Opens |path|, switching it to WAL mode, with |n_readers| read-only
+  // connections
+  ConnectionPool(const std::filesystem::path& path, size_t n_readers);
+  // Serializes all access to |db| on one connection, for in-memory databases
+  // and tests
+  explicit ConnectionPool(SQLite::Database& db);
+
+  ConnectionPool(const ConnectionPool&) = delete;
+  ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+  // Waits for a free read-only connection. Must not be held by the thread
+  // while it takes another lease.
+  Lease Reader();
+  // Waits for the writer connection. Reads that must see the write's
+  // transaction go through the same lease.
+  Lease Writer();
+
+  // The writer connection without its lock, only for single-threaded setup
+  // such as migrations
+  SQLite::Database& WriterDb() { return writer_.db(); }
+
+ private:
+  void ReturnReader(Connection* conn);
+
+  std::mutex writer_mtx_;
+  Connection writer_;
+  std::mutex readers_mtx_;
+  std::condition_variable readers_cv_;
+  std::vector<std::unique_ptr<Connection>> readers_;
+  std::vector<Connection*> free_readers_;
+};
+
+}  // namespace cortex::db
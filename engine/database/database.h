@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <thread>
 #include "SQLiteCpp/SQLiteCpp.h"
+#include "database/connection_pool.h"
 #include "utils/file_manager_utils.h"
 
 namespace cortex::db {
@@ -16,12 +20,17 @@ class Database {
     return db;
   }
 
-  SQLite::Database& db() { return db_; }
+  // The writer connection without locking, for migrations at startup.
+  // Everything else goes through pool().
+  SQLite::Database& db() { return pool_->WriterDb(); }
+
+  const std::shared_ptr<ConnectionPool>& pool() { return pool_; }
 
  private:
   Database()
-      : db_(file_manager_utils::GetCortexDataPath() / "cortex.db",
-            SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE) {}
-  SQLite::Database db_;
+      : pool_(std::make_shared<ConnectionPool>(
+            file_manager_utils::GetCortexDataPath() / "cortex.db",
+            std::clamp(std::thread::hardware_concurrency(), 2u, 8u))) {}
+  std::shared_ptr<ConnectionPool> pool_;
 };
 }  // namespace cortex::db
@@ -8,12 +8,11 @@ void CreateTable(SQLite::Database& db) {
   (void)db;
 }
 
-Engines::Engines() : db_(cortex::db::Database::GetInstance().db()) {
-  CreateTable(db_);
-}
+Engines::Engines() : pool_(cortex::db::Database::GetInstance().pool()) {}
 
-Engines::Engines(SQLite::Database& db) : db_(db) {
-  CreateTable(db_);
+Engines::Engines(SQLite::Database& db)
+    : pool_(std::make_shared<ConnectionPool>(db)) {
+  CreateTable(db);
 }
 
 Engines::~Engines() {}
@@ -24,8 +23,8 @@ std::optional<EngineEntry> Engines::UpsertEngine(
     const std::string& version, const std::string& variant,
     const std::string& status, const std::string& metadata) {
   try {
-    SQLite::Statement query(
-        db_,
+    auto conn = pool_->Writer();
+    auto& query = conn->Prepare(
         "INSERT INTO engines (engine_name, type, api_key, url, version, "
         "variant, status, metadata) "
         "VALUES (?, ?, ?, ?, ?, ?, ?, ?) "
@@ -67,8 +66,8 @@ std::optional<EngineEntry> Engines::UpsertEngine(
 
 std::optional<std::vector<EngineEntry>> Engines::GetEngines() const {
   try {
-    SQLite::Statement query(
-        db_,
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
         "SELECT id, engine_name, type, api_key, url, version, variant, status, "
         "metadata, date_created, date_updated "
         "FROM engines "
@@ -94,8 +93,8 @@ std::optional<std::vector<EngineEntry>> Engines::GetEngines() const {
 
 std::optional<EngineEntry> Engines::GetEngineById(int id) const {
   try {
-    SQLite::Statement query(
-        db_,
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
         "SELECT id, engine_name, type, api_key, url, version, variant, status, "
         "metadata, date_created, date_updated "
         "FROM engines "
@@ -136,7 +135,8 @@ std::optional<EngineEntry> Engines::GetEngineByNameAndVariant(
 
     queryStr += "ORDER BY date_updated DESC LIMIT 1";
 
-    SQLite::Statement query(db_, queryStr);
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(queryStr);
 
     query.bind(1, engine_name);
 
@@ -162,7 +162,8 @@ std::optional<EngineEntry> Engines::GetEngineByNameAndVariant(
 
 std::optional<std::string> Engines::DeleteEngineById(int id) {
   try {
-    SQLite::Statement query(db_, "DELETE FROM engines WHERE id = ?");
+    auto conn = pool_->Writer();
+    auto& query = conn->Prepare("DELETE FROM engines WHERE id = ?");
 
     query.bind(1, id);
     query.exec();
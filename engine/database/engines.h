@@ -6,6 +6,7 @@
 #include <optional>
 #include <string>
 #include <vector>
+#include "database/connection_pool.h"
 
 namespace cortex::db {
 
@@ -57,7 +58,7 @@ struct EngineEntry {
 
 class Engines {
  private:
-  SQLite::Database& db_;
+  std::shared_ptr<ConnectionPool> pool_;
 
   bool IsUnique(const std::vector<EngineEntry>& entries,
                 const std::string& model_id,
@@ -1,17 +1,15 @@
 #include "file.h"
 #include "utils/logging_utils.h"
-#include "utils/scope_exit.h"
 
 namespace cortex::db {
 
 cpp::result<std::vector<OpenAi::File>, std::string> File::GetFileList() const {
   try {
-    db_.exec("BEGIN TRANSACTION;");
-    cortex::utils::ScopeExit se([this] { db_.exec("COMMIT;"); });
     std::vector<OpenAi::File> entries;
-    SQLite::Statement query(db_,
-                            "SELECT id, object, "
-                            "purpose, filename, created_at, bytes FROM files");
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
+        "SELECT id, object, "
+        "purpose, filename, created_at, bytes FROM files");
 
     while (query.executeStep()) {
       OpenAi::File entry;
@@ -33,10 +31,11 @@ cpp::result<std::vector<OpenAi::File>, std::string> File::GetFileList() const {
 cpp::result<OpenAi::File, std::string> File::GetFileById(
     const std::string& file_id) const {
   try {
-    SQLite::Statement query(db_,
-                            "SELECT id, object, "
-                            "purpose, filename, created_at, bytes FROM files "
-                            "WHERE id = ?");
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
+        "SELECT id, object, "
+        "purpose, filename, created_at, bytes FROM files "
+        "WHERE id = ?");
 
     query.bind(1, file_id);
     if (query.executeStep()) {
@@ -58,8 +57,8 @@ cpp::result<OpenAi::File, std::string> File::GetFileById(
 
 cpp::result<void, std::string> File::AddFileEntry(OpenAi::File& file) {
   try {
-    SQLite::Statement insert(
-        db_,
+    auto conn = pool_->Writer();
+    auto& insert = conn->Prepare(
         "INSERT INTO files (id, object, "
         "purpose, filename, created_at, bytes) VALUES (?, ?, "
         "?, ?, ?, ?)");
@@ -82,7 +81,8 @@ cpp::result<void, std::string> File::AddFileEntry(OpenAi::File& file) {
 cpp::result<void, std::string> File::DeleteFileEntry(
     const std::string& file_id) {
   try {
-    SQLite::Statement del(db_, "DELETE from files WHERE id = ?");
+    auto conn = pool_->Writer();
+    auto& del = conn->Prepare("DELETE from files WHERE id = ?");
     del.bind(1, file_id);
     if (del.exec() == 1) {
       CTL_INF("Deleted: " << file_id);
@@ -6,16 +6,17 @@
 #include <vector>
 #include "common/file.h"
 #include "database.h"
+#include "database/connection_pool.h"
 #include "utils/result.hpp"
 
 namespace cortex::db {
 class File {
-  SQLite::Database& db_;
+  std::shared_ptr<ConnectionPool> pool_;
 
  public:
-  File(SQLite::Database& db) : db_{db} {};
+  File(SQLite::Database& db) : pool_{std::make_shared<ConnectionPool>(db)} {};
 
-  File() : db_(cortex::db::Database::GetInstance().db()) {}
+  File() : pool_(cortex::db::Database::GetInstance().pool()) {}
 
   ~File() {}
 
@@ -1,13 +1,13 @@
 #include "hardware.h"
 #include "database.h"
 #include "utils/logging_utils.h"
-#include "utils/scope_exit.h"
 
 namespace cortex::db {
 
-Hardware::Hardware() : db_(cortex::db::Database::GetInstance().db()) {}
+Hardware::Hardware() : pool_(cortex::db::Database::GetInstance().pool()) {}
 
-Hardware::Hardware(SQLite::Database& db) : db_(db) {}
+Hardware::Hardware(SQLite::Database& db)
+    : pool_(std::make_shared<ConnectionPool>(db)) {}
 
 
 Hardware::~Hardware() {}
@@ -15,11 +15,9 @@ Hardware::~Hardware() {}
 cpp::result<std::vector<HardwareEntry>, std::string>
 Hardware::LoadHardwareList() const {
   try {
-    db_.exec("BEGIN TRANSACTION;");
-    cortex::utils::ScopeExit se([this] { db_.exec("COMMIT;"); });
     std::vector<HardwareEntry> entries;
-    SQLite::Statement query(
-        db_,
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
         "SELECT uuid, type, "
         "hardware_id, software_id, activated, priority FROM hardware");
 
@@ -42,8 +40,8 @@ Hardware::LoadHardwareList() const {
 cpp::result<bool, std::string> Hardware::AddHardwareEntry(
     const HardwareEntry& new_entry) {
   try {
-    SQLite::Statement insert(
-        db_,
+    auto conn = pool_->Writer();
+    auto& insert = conn->Prepare(
         "INSERT INTO hardware (uuid, type, "
         "hardware_id, software_id, activated, priority) VALUES (?, ?, "
         "?, ?, ?, ?)");
@@ -64,8 +62,8 @@ cpp::result<bool, std::string> Hardware::AddHardwareEntry(
 cpp::result<bool, std::string> Hardware::UpdateHardwareEntry(
     const std::string& id, const HardwareEntry& updated_entry) {
   try {
-    SQLite::Statement upd(
-        db_,
+    auto conn = pool_->Writer();
+    auto& upd = conn->Prepare(
         "UPDATE hardware "
         "SET hardware_id = ?, software_id = ?, activated = ?, priority = ? "
         "WHERE uuid = ?");
@@ -87,7 +85,8 @@ cpp::result<bool, std::string> Hardware::UpdateHardwareEntry(
 cpp::result<bool, std::string> Hardware::DeleteHardwareEntry(
     const std::string& id) {
   try {
-    SQLite::Statement del(db_, "DELETE from hardware WHERE uuid = ?");
+    auto conn = pool_->Writer();
+    auto& del = conn->Prepare("DELETE from hardware WHERE uuid = ?");
     del.bind(1, id);
     if (del.exec() == 1) {
       CTL_INF("Deleted: " << id);
@@ -101,8 +100,9 @@ cpp::result<bool, std::string> Hardware::DeleteHardwareEntry(
 
 bool Hardware::HasHardwareEntry(const std::string& id) {
    try {
-    SQLite::Statement query(db_,
-                            "SELECT COUNT(*) FROM hardware WHERE uuid = ?");
+    auto conn = pool_->Reader();
+    auto& query =
+        conn->Prepare("SELECT COUNT(*) FROM hardware WHERE uuid = ?");
     query.bind(1, id);
     if (query.executeStep()) {
       return query.getColumn(0).getInt() > 0;
@@ -118,8 +118,8 @@ cpp::result<bool, std::string> Hardware::UpdateHardwareEntry(const std::string&
                                                      int hw_id,
                                                      int sw_id) const {
  try {
-    SQLite::Statement upd(
-        db_,
+    auto conn = pool_->Writer();
+    auto& upd = conn->Prepare(
         "UPDATE hardware "
         "SET hardware_id = ?, software_id = ? "
         "WHERE uuid = ?");
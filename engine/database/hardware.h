@@ -4,6 +4,7 @@
 #include <trantor/utils/Logger.h>
 #include <string>
 #include <vector>
+#include "database/connection_pool.h"
 #include "utils/json_helper.h"
 #include "utils/result.hpp"
 
@@ -30,7 +31,7 @@ struct HardwareEntry {
 class Hardware {
 
  private:
-  SQLite::Database& db_;
+  std::shared_ptr<ConnectionPool> pool_;
 
  public:
   Hardware();
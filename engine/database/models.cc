@@ -8,7 +8,7 @@
 
 namespace cortex::db {
 
-Models::Models() : db_(cortex::db::Database::GetInstance().db()) {}
+Models::Models() : pool_(cortex::db::Database::GetInstance().pool()) {}
 
 Models::~Models() {}
 
@@ -24,7 +24,8 @@ std::string Models::StatusToString(ModelStatus status) const {
   return "unknown";
 }
 
-Models::Models(SQLite::Database& db) : db_(db) {}
+Models::Models(SQLite::Database& db)
+    : pool_(std::make_shared<ConnectionPool>(db)) {}
 
 ModelStatus Models::StringToStatus(const std::string& status_str) const {
   if (status_str == "remote") {
@@ -40,9 +41,9 @@ ModelStatus Models::StringToStatus(const std::string& status_str) const {
 cpp::result<std::vector<ModelEntry>, std::string> Models::LoadModelList()
     const {
   try {
-    db_.exec("BEGIN TRANSACTION;");
-    cortex::utils::ScopeExit se([this] { db_.exec("COMMIT;"); });
-    return LoadModelListNoLock();
+    // One statement, its snapshot is consistent without a transaction
+    auto conn = pool_->Reader();
+    return LoadModelListNoLock(*conn);
   } catch (const std::exception& e) {
     CTL_WRN(e.what());
     return cpp::fail(e.what());
@@ -56,12 +57,11 @@ bool Models::IsUnique(const std::vector<ModelEntry>& entries,
       [&](const ModelEntry& entry) { return entry.model == model_id; });
 }
 
-cpp::result<std::vector<ModelEntry>, std::string> Models::LoadModelListNoLock()
-    const {
+cpp::result<std::vector<ModelEntry>, std::string> Models::LoadModelListNoLock(
+    Connection& conn) const {
   try {
     std::vector<ModelEntry> entries;
-    SQLite::Statement query(
-        db_,
+    auto& query = conn.Prepare(
         "SELECT model_id, author_repo_id, branch_name, "
         "path_to_model_yaml, model_alias, model_format, "
         "model_source, status, engine, metadata FROM models");
@@ -90,8 +90,8 @@ cpp::result<std::vector<ModelEntry>, std::string> Models::LoadModelListNoLock()
 cpp::result<ModelEntry, std::string> Models::GetModelInfo(
     const std::string& identifier) const {
   try {
-    SQLite::Statement query(
-        db_,
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
         "SELECT model_id, author_repo_id, branch_name, "
         "path_to_model_yaml, model_alias, model_format, "
         "model_source, status, engine, metadata FROM models "
@@ -134,17 +134,17 @@ void Models::PrintModelInfo(const ModelEntry& entry) const {
 
 cpp::result<bool, std::string> Models::AddModelEntry(ModelEntry new_entry) {
   try {
-    db_.exec("BEGIN TRANSACTION;");
-    cortex::utils::ScopeExit se([this] { db_.exec("COMMIT;"); });
-    auto model_list = LoadModelListNoLock();
+    auto conn = pool_->Writer();
+    conn->db().exec("BEGIN TRANSACTION;");
+    cortex::utils::ScopeExit se([&conn] { conn->db().exec("COMMIT;"); });
+    auto model_list = LoadModelListNoLock(*conn);
     if (model_list.has_error()) {
       CTL_WRN(model_list.error());
       return cpp::fail(model_list.error());
     }
     if (IsUnique(model_list.value(), new_entry.model)) {
 
-      SQLite::Statement insert(
-          db_,
+      auto& insert = conn->Prepare(
           "INSERT INTO models (model_id, author_repo_id, branch_name, "
           "path_to_model_yaml, model_alias, model_format, model_source, "
           "status, engine, metadata) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
@@ -175,8 +175,8 @@ cpp::result<bool, std::string> Models::UpdateModelEntry(
     return cpp::fail("Model not found: " + identifier);
   }
   try {
-    SQLite::Statement upd(
-        db_,
+    auto conn = pool_->Writer();
+    auto& upd = conn->Prepare(
         "UPDATE models SET author_repo_id = ?, branch_name = ?, "
         "path_to_model_yaml = ?, model_format = ?, model_source = ?, status = "
         "?, engine = ?, metadata = ? WHERE model_id = ?");
@@ -203,7 +203,8 @@ cpp::result<bool, std::string> Models::DeleteModelEntry(
       return true;
     }
 
-    SQLite::Statement del(db_, "DELETE from models WHERE model_id = ?");
+    auto conn = pool_->Writer();
+    auto& del = conn->Prepare("DELETE from models WHERE model_id = ?");
     del.bind(1, identifier);
     return del.exec() == 1;
   } catch (const std::exception& e) {
@@ -214,9 +215,10 @@ cpp::result<bool, std::string> Models::DeleteModelEntry(
 cpp::result<bool, std::string> Models::DeleteModelEntryWithOrg(
     const std::string& src) {
   try {
-    SQLite::Statement del(db_,
-                          "DELETE from models WHERE model_source LIKE ? AND "
-                          "status = \"downloadable\"");
+    auto conn = pool_->Writer();
+    auto& del = conn->Prepare(
+        "DELETE from models WHERE model_source LIKE ? AND "
+        "status = \"downloadable\"");
     del.bind(1, src + "%");
     return del.exec() == 1;
   } catch (const std::exception& e) {
@@ -227,9 +229,10 @@ cpp::result<bool, std::string> Models::DeleteModelEntryWithOrg(
 cpp::result<bool, std::string> Models::DeleteModelEntryWithRepo(
     const std::string& src) {
   try {
-    SQLite::Statement del(db_,
-                          "DELETE from models WHERE model_source = ? AND "
-                          "status = \"downloadable\"");
+    auto conn = pool_->Writer();
+    auto& del = conn->Prepare(
+        "DELETE from models WHERE model_source = ? AND "
+        "status = \"downloadable\"");
     del.bind(1, src);
     return del.exec() == 1;
   } catch (const std::exception& e) {
@@ -241,9 +244,10 @@ cpp::result<std::vector<std::string>, std::string> Models::FindRelatedModel(
     const std::string& identifier) const {
   try {
     std::vector<std::string> related_models;
-    SQLite::Statement query(db_,
-                            "SELECT model_id FROM models WHERE model_id LIKE ? "
-                            "AND status = \"downloaded\"");
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
+        "SELECT model_id FROM models WHERE model_id LIKE ? "
+        "AND status = \"downloaded\"");
     query.bind(1, "%" + identifier + "%");
 
     while (query.executeStep()) {
@@ -257,8 +261,9 @@ cpp::result<std::vector<std::string>, std::string> Models::FindRelatedModel(
 
 bool Models::HasModel(const std::string& identifier) const {
   try {
-    SQLite::Statement query(db_,
-                            "SELECT COUNT(*) FROM models WHERE model_id = ?");
+    auto conn = pool_->Reader();
+    auto& query =
+        conn->Prepare("SELECT COUNT(*) FROM models WHERE model_id = ?");
     query.bind(1, identifier);
     if (query.executeStep()) {
       return query.getColumn(0).getInt() > 0;
@@ -274,12 +279,13 @@ cpp::result<std::vector<ModelEntry>, std::string> Models::GetModels(
     const std::string& model_src) const {
   try {
     std::vector<ModelEntry> res;
-    SQLite::Statement query(db_,
-                            "SELECT model_id, author_repo_id, branch_name, "
-                            "path_to_model_yaml, model_alias, model_format, "
-                            "model_source, status, engine, metadata FROM "
-                            "models WHERE model_source = "
-                            "? AND status = \"downloadable\"");
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
+        "SELECT model_id, author_repo_id, branch_name, "
+        "path_to_model_yaml, model_alias, model_format, "
+        "model_source, status, engine, metadata FROM "
+        "models WHERE model_source = "
+        "? AND status = \"downloadable\"");
     query.bind(1, model_src);
     while (query.executeStep()) {
       ModelEntry entry;
@@ -305,8 +311,8 @@ cpp::result<std::vector<ModelEntry>, std::string> Models::GetModelSources()
     const {
   try {
     std::vector<ModelEntry> res;
-    SQLite::Statement query(
-        db_,
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare(
         "SELECT model_id, author_repo_id, branch_name, "
         "path_to_model_yaml, model_alias, model_format, "
         "model_source, status, engine, metadata FROM models "
@@ -4,6 +4,7 @@
 #include <trantor/utils/Logger.h>
 #include <string>
 #include <vector>
+#include "database/connection_pool.h"
 #include "utils/result.hpp"
 
 namespace cortex::db {
@@ -26,12 +27,13 @@ struct ModelEntry {
 class Models {
 
  private:
-  SQLite::Database& db_;
+  std::shared_ptr<ConnectionPool> pool_;
 
   bool IsUnique(const std::vector<ModelEntry>& entries,
                 const std::string& model_id) const;
 
-  cpp::result<std::vector<ModelEntry>, std::string> LoadModelListNoLock() const;
+  cpp::result<std::vector<ModelEntry>, std::string> LoadModelListNoLock(
+      Connection& conn) const;
 
   std::string StatusToString(ModelStatus status) const;
   ModelStatus StringToStatus(const std::string& status_str) const;
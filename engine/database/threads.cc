@@ -0,0 +1,146 @@
+#include "threads.h"
+#include <SQLiteCpp/Transaction.h>
+#include "utils/logging_utils.h"
+
+namespace cortex::db {
+
+namespace {
+constexpr const auto kUpsertThread =
+    "INSERT INTO threads (id, created_at, data, modified_at) "
+    "VALUES (?, ?, ?, ?) "
+    "ON CONFLICT(id) DO UPDATE SET created_at = excluded.created_at, "
+    "data = excluded.data, modified_at = excluded.modified_at";
+}  // namespace
+
+cpp::result<std::vector<ThreadEntry>, std::string> Threads::GetThreadEntries(
+    uint8_t limit, const std::string& order, const std::string& after,
+    const std::string& before) const {
+  try {
+    std::vector<ThreadEntry> entries;
+    auto conn = pool_->Reader();
+    // The bounds are the positions of the cursor threads in the
+    // (created_at, id) index, so that the page is a range of it and only its
+    // rows are read
+    std::string sql = "SELECT id, created_at, data FROM threads WHERE 1";
+    if (!after.empty()) {
+      sql +=
+          " AND (created_at, id) > "
+          "(SELECT created_at, id FROM threads WHERE id = ?1)";
+    }
+    if (!before.empty()) {
+      sql +=
+          " AND (created_at, id) < "
+          "(SELECT created_at, id FROM threads WHERE id = ?2)";
+    }
+    sql += order == "desc" ? " ORDER BY created_at DESC, id DESC LIMIT ?3"
+                           : " ORDER BY created_at ASC, id ASC LIMIT ?3";
+    auto& query = conn->Prepare(sql);
+    if (!after.empty()) {
+      query.bind(1, after);
+    }
+    if (!before.empty()) {
+      query.bind(2, before);
+    }
+    query.bind(3, static_cast<int>(limit));
+
+    while (query.executeStep()) {
+      ThreadEntry entry;
+      entry.id = query.getColumn(0).getString();
+      entry.created_at = query.getColumn(1).getInt64();
+      entry.data = query.getColumn(2).getString();
+      entries.push_back(std::move(entry));
+    }
+    return entries;
+  } catch (const std::exception& e) {
+    CTL_WRN(e.what());
+    return cpp::fail(e.what());
+  }
+}
+
+cpp::result<std::unordered_map<std::string, int64_t>, std::string>
+Threads::GetThreadModifiedTimes() const {
+  try {
+    std::unordered_map<std::string, int64_t> times;
+    auto conn = pool_->Reader();
+    auto& query = conn->Prepare("SELECT id, modified_at FROM threads");
+    while (query.executeStep()) {
+      times[query.getColumn(0).getString()] = query.getColumn(1).getInt64();
+    }
+    return times;
+  } catch (const std::exception& e) {
+    CTL_WRN(e.what());
+    return cpp::fail(e.what());
+  }
+}
+
+cpp::result<void, std::string> Threads::UpsertThreadEntry(
+    const ThreadEntry& entry) {
+  try {
+    auto conn = pool_->Writer();
+    auto& upsert = conn->Prepare(kUpsertThread);
+    upsert.bind(1, entry.id);
+    upsert.bind(2, static_cast<int64_t>(entry.created_at));
+    upsert.bind(3, entry.data);
+    upsert.bind(4, entry.modified_at);
+    upsert.exec();
+    return {};
+  } catch (const std::exception& e) {
+    CTL_WRN(e.what());
+    return cpp::fail(e.what());
+  }
+}
+
+cpp::result<void, std::string> Threads::UpsertThreadEntries(
+    const std::vector<ThreadEntry>& entries) {
+  try {
+    auto conn = pool_->Writer();
+    // One transaction instead of one per thread, rolled back on failure
+    SQLite::Transaction transaction(conn->db());
+    for (const auto& entry : entries) {
+      auto& upsert = conn->Prepare(kUpsertThread);
+      upsert.bind(1, entry.id);
+      upsert.bind(2, static_cast<int64_t>(entry.created_at));
+      upsert.bind(3, entry.data);
+      upsert.bind(4, entry.modified_at);
+      upsert.exec();
+    }
+    transaction.commit();
+    return {};
+  } catch (const std::exception& e) {
+    CTL_WRN(e.what());
+    return cpp::fail(e.what());
+  }
+}
+
+cpp::result<void, std::string> Threads::DeleteThreadEntry(
+    const std::string& thread_id) {
+  try {
+    auto conn = pool_->Writer();
+    auto& del = conn->Prepare("DELETE FROM threads WHERE id = ?");
+    del.bind(1, thread_id);
+    del.exec();
+    return {};
+  } catch (const std::exception& e) {
+    CTL_WRN(e.what());
+    return cpp::fail(e.what());
+  }
+}
+
+cpp::result<void, std::string> Threads::DeleteThreadEntries(
+    const std::vector<std::string>& thread_ids) {
+  try {
+    auto conn = pool_->Writer();
+    SQLite::Transaction transaction(conn->db());
+    for (const auto& thread_id : thread_ids) {
+      auto& del = conn->Prepare("DELETE FROM threads WHERE id = ?");
+      del.bind(1, thread_id);
+      del.exec();
+    }
+    transaction.commit();
+    return {};
+  } catch (const std::exception& e) {
+    CTL_WRN(e.what());
+    return cpp::fail(e.what());
+  }
+}
+}  // namespace cortex::db
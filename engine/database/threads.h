@@ -0,0 +1,58 @@
+#pragma once
+
+#include <SQLiteCpp/Database.h>
+#include <trantor/utils/Logger.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "database.h"
+#include "database/connection_pool.h"
+#include "utils/result.hpp"
+
+namespace cortex::db {
+
+struct ThreadEntry {
+  std::string id;
+  uint64_t created_at;
+  // The thread as JSON, a copy of its thread.json
+  std::string data;
+  // When its thread.json was last written, to tell edits made elsewhere
+  int64_t modified_at = 0;
+};
+
+// An index of the threads by creation time, so that listing does not read
+// every thread folder
+class Threads {
+  std::shared_ptr<ConnectionPool> pool_;
+
+ public:
+  Threads(SQLite::Database& db)
+      : pool_{std::make_shared<ConnectionPool>(db)} {};
+
+  Threads() : pool_(cortex::db::Database::GetInstance().pool()) {}
+
+  ~Threads() {}
+
+  // A page of threads ordered by creation time, between the threads |after|
+  // and |before| when they are not empty. A cursor that is not in the index
+  // gives an empty page.
+  cpp::result<std::vector<ThreadEntry>, std::string> GetThreadEntries(
+      uint8_t limit, const std::string& order, const std::string& after,
+      const std::string& before) const;
+
+  // The modification time of every indexed thread, by id
+  cpp::result<std::unordered_map<std::string, int64_t>, std::string>
+  GetThreadModifiedTimes() const;
+
+  cpp::result<void, std::string> UpsertThreadEntry(const ThreadEntry& entry);
+
+  cpp::result<void, std::string> UpsertThreadEntries(
+      const std::vector<ThreadEntry>& entries);
+
+  cpp::result<void, std::string> DeleteThreadEntry(
+      const std::string& thread_id);
+
+  cpp::result<void, std::string> DeleteThreadEntries(
+      const std::vector<std::string>& thread_ids);
+};
+}  // namespace cortex::db
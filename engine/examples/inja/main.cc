@@ -1,11 +1,15 @@
+#include <chrono>
 #include "extensions/template_renderer.h"
 #include "utils/json_helper.h"
+#include "utils/string_utils.h"
 
 void print_help() {
   std::cout << "Usage: \ninja-test [options]\n\n";
   std::cout << "Options:\n";
   std::cout << "  --template  Path to template file\n";
   std::cout << "  --data      Path to data file\n";
+  std::cout << "  --bench     Number of renders to time, with and without the "
+               "template cache\n";
 
   exit(0);
 }
@@ -13,11 +17,14 @@ void print_help() {
 int main(int argc, char* argv[]) {
   std::filesystem::path template_path;
   std::filesystem::path data_path;
+  int bench_iterations = 0;
   for (int i = 0; i < argc; i++) {
     if (strcmp(argv[i], "--template") == 0) {
       template_path = argv[i + 1];
     } else if (strcmp(argv[i], "--data") == 0) {
       data_path = argv[i + 1];
+    } else if (strcmp(argv[i], "--bench") == 0) {
+      bench_iterations = std::stoi(argv[i + 1]);
     } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
       print_help();
     }
@@ -41,5 +48,45 @@ int main(int argc, char* argv[]) {
   std::cout << res << std::endl;
   std::cout << std::endl;
 
+  if (bench_iterations > 0) {
+    // Same work as TemplateRenderer::Render, minus the cache: the template is
+    // parsed on every render, which is what every streamed chunk used to cost
+    inja::Environment env;
+    env.set_trim_blocks(true);
+    env.set_lstrip_blocks(true);
+    env.add_callback("tojson", 1, [](inja::Arguments& args) {
+      if (args.empty()) {
+        return nlohmann::json(nullptr);
+      }
+      const auto& value = *args[0];
+      if (value.is_string()) {
+        return nlohmann::json(
+            "\"" + string_utils::EscapeJson(value.get<std::string>()) + "\"");
+      }
+      return value;
+    });
+
+    auto time_us = [bench_iterations](auto&& render) {
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < bench_iterations; i++) {
+        render();
+      }
+      std::chrono::duration<double, std::micro> elapsed =
+          std::chrono::steady_clock::now() - start;
+      return elapsed.count() / bench_iterations;
+    };
+
+    auto uncached = time_us([&] {
+      nlohmann::json template_data;
+      template_data["input_request"] =
+          extensions::TemplateRenderer::ConvertJsonValue(data);
+      env.render(tpl, template_data);
+    });
+    auto cached = time_us([&] { rdr.Render(tpl, data); });
+    std::cout << "Render cost over " << bench_iterations << " iterations:\n";
+    std::cout << "  parse every time: " << uncached << " us\n";
+    std::cout << "  cached template:  " << cached << " us\n";
+  }
+
   return 0;
 }
\ No newline at end of file
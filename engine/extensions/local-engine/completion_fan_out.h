@@ -0,0 +1,110 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "json/json.h"
+#include "utils/result.hpp"
+
+namespace cortex::local {
+
+// llama-server generates a single choice per request. A completion with
+// n > 1 is therefore sent as n requests, which run concurrently in the
+// model's parallel slots, and their responses are merged afterwards.
+
+// Returns the request for choice |index| of |body|
+inline Json::Value MakeChoiceRequest(const Json::Value& body, int index) {
+  Json::Value req = body;
+  req["n"] = 1;
+  // Let every slot keep the prompt in its KV cache, the choices of a request
+  // and its follow-ups share it
+  if (!req.isMember("cache_prompt")) {
+    req["cache_prompt"] = true;
+  }
+  // The same seed would produce the same choice n times
+  if (index > 0 && req.isMember("seed") && req["seed"].isInt() &&
+      req["seed"].asInt() >= 0) {
+    req["seed"] = req["seed"].asInt() + index;
+  }
+  return req;
+}
+
+// Merges OpenAI compatible chat completions, one choice each, into one
+// response. The prompt is shared, so it is only counted once in the usage.
+inline Json::Value MergeChatCompletions(std::vector<Json::Value>&& responses) {
+  if (responses.empty()) {
+    return Json::Value();
+  }
+  auto result = std::move(responses[0]);
+  auto completion_tokens = result["usage"]["completion_tokens"].asInt();
+  for (size_t i = 1; i < responses.size(); i++) {
+    auto& r = responses[i];
+    if (r["choices"].isArray() && !r["choices"].empty()) {
+      auto choice = r["choices"][0];
+      choice["index"] = static_cast<int>(i);
+      result["choices"].append(choice);
+    }
+    completion_tokens += r["usage"]["completion_tokens"].asInt();
+  }
+  auto prompt_tokens = result["usage"]["prompt_tokens"].asInt();
+  result["usage"]["completion_tokens"] = completion_tokens;
+  result["usage"]["total_tokens"] = prompt_tokens + completion_tokens;
+  return result;
+}
+
+// Collects the responses of the per-choice requests, which may finish in any
+// order and on any thread. |on_done| is invoked exactly once: with all
+// responses ordered by choice index, or with the first error.
+class CompletionFanOut {
+ public:
+  struct Error {
+    int status_code;
+    Json::Value body;
+    // No response came from llama-server, e.g. the transfer failed or was
+    // aborted on shutdown
+    bool transport = false;
+  };
+  using Result = cpp::result<std::vector<Json::Value>, Error>;
+  using OnDone = std::function<void(Result&&)>;
+
+  CompletionFanOut(size_t n, OnDone&& on_done)
+      : responses_(n), remaining_(n), on_done_(std::move(on_done)) {}
+
+  void Complete(size_t index, Json::Value&& response) {
+    OnDone on_done;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (!on_done_) {
+        return;
+      }
+      responses_[index] = std::move(response);
+      if (--remaining_ > 0) {
+        return;
+      }
+      on_done = std::move(on_done_);
+      on_done_ = nullptr;
+    }
+    on_done(std::move(responses_));
+  }
+
+  void Fail(int status_code, Json::Value&& error) {
+    OnDone on_done;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (!on_done_) {
+        return;
+      }
+      on_done = std::move(on_done_);
+      on_done_ = nullptr;
+    }
+    on_done(cpp::fail(Error{status_code, std::move(error)}));
+  }
+
+ private:
+  std::mutex mtx_;
+  std::vector<Json::Value> responses_;
+  size_t remaining_;
+  OnDone on_done_;
+};
+
+}  // namespace cortex::local
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "extensions/local-engine/completion_fan_out.h"
+#include "json/json.h"
+#include "utils/result.hpp"
+
+namespace cortex::local {
+
+// Splits the response to a batched embeddings request into the responses to
+// the requests it was made of: part i gets |counts[i]| consecutive inputs,
+// re-indexed from 0. llama-server only reports the batch's total token count,
+// so it is shared out in proportion to |weights| (e.g. input lengths).
+// Returns an empty vector if the response does not have one embedding per
+// input.
+inline std::vector<Json::Value> SplitEmbeddings(
+    const Json::Value& response, const std::vector<size_t>& counts,
+    const std::vector<size_t>& weights) {
+  size_t total = 0;
+  for (auto c : counts) {
+    total += c;
+  }
+  const auto& data = response["data"];
+  if (!data.isArray() || data.size() != total) {
+    return {};
+  }
+  std::vector<const Json::Value*> by_index(total, nullptr);
+  for (const auto& d : data) {
+    auto i = d.get("index", -1).asInt();
+    if (i < 0 || static_cast<size_t>(i) >= total || by_index[i]) {
+      return {};
+    }
+    by_index[i] = &d;
+  }
+
+  size_t total_weight = 0;
+  for (auto w : weights) {
+    total_weight += w;
+  }
+  auto prompt_tokens = response["usage"].get("prompt_tokens", 0).asUInt64();
+  uint64_t tokens_left = prompt_tokens;
+
+  std::vector<Json::Value> parts;
+  parts.reserve(counts.size());
+  size_t offset = 0;
+  for (size_t p = 0; p < counts.size(); p++) {
+    Json::Value part;
+    part["object"] = response.get("object", "list");
+    part["model"] = response["model"];
+    part["data"] = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < counts[p]; i++) {
+      auto d = *by_index[offset + i];
+      d["index"] = static_cast<Json::UInt>(i);
+      part["data"].append(std::move(d));
+    }
+    offset += counts[p];
+
+    uint64_t tokens = tokens_left;
+    if (p + 1 < counts.size()) {
+      tokens = total_weight == 0
+                   ? prompt_tokens / counts.size()
+                   : prompt_tokens * weights[p] / total_weight;
+      tokens = std::min(tokens, tokens_left);
+    }
+    tokens_left -= tokens;
+    part["usage"]["prompt_tokens"] = static_cast<Json::UInt64>(tokens);
+    part["usage"]["total_tokens"] = static_cast<Json::UInt64>(tokens);
+    parts.push_back(std::move(part));
+  }
+  return parts;
+}
+
+// Coalesces concurrent embeddings requests for the same model and with the
+// same parameters into one upstream request with all of their inputs.
+// llama-server embeds the inputs of a request in one pass over its slots,
+// which is far cheaper than a round trip per input when clients send one
+// sentence at a time.
+//
+// The first request of a batch waits up to |window| for others to join it. A
+// batch is sent early once it has |max_inputs| inputs. If llama-server rejects
+// a batch, or its response cannot be split, its requests are retried one by
+// one, so that one bad input does not fail the others. Transfers that failed
+// or were aborted, and any failure after Stop(), are not retried.
+class EmbeddingBatcher {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Result = cpp::result<Json::Value, CompletionFanOut::Error>;
+  using OnDone = std::function<void(Result&&)>;
+  // Sends an embeddings request for |model| to llama-server
+  using Send = std::function<void(const std::string& model, Json::Value&& body,
+                                  OnDone&& on_done)>;
+
+  explicit EmbeddingBatcher(Send send) : send_(std::move(send)) {
+    writer_["indentation"] = "";
+  }
+
+  EmbeddingBatcher(const EmbeddingBatcher&) = delete;
+  EmbeddingBatcher& operator=(const EmbeddingBatcher&) = delete;
+
+  ~EmbeddingBatcher() { Stop(); }
+
+  // Sends the pending batches right away. Batches that fail from then on
+  // fail their requests instead of retrying them.
+  void Stop() {
+    stopped_->store(true);
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (timer_.joinable()) {
+      timer_.join();
+    }
+  }
+
+  // Only requests with text inputs are batched. Token inputs are rare and
+  // not worth telling apart from the nested arrays they come in.
+  static bool IsBatchable(const Json::Value& body) {
+    const auto& input = body["input"];
+    if (input.isString()) {
+      return true;
+    }
+    if (!input.isArray() || input.empty()) {
+      return false;
+    }
+    for (const auto& i : input) {
+      if (!i.isString()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Queues |body|, which must be batchable, and invokes |on_done| with its
+  // response once its batch is done
+  void Add(const std::string& model, const Json::Value& body,
+           std::chrono::milliseconds window, size_t max_inputs,
+           OnDone&& on_done) {
+    Part part;
+    if (body["input"].isString()) {
+      part.inputs.append(body["input"]);
+    } else {
+      part.inputs = body["input"];
+    }
+    for (const auto& i : part.inputs) {
+      part.weight += i.asString().size();
+    }
+    part.on_done = std::move(on_done);
+
+    auto params = body;
+    params.removeMember("input");
+    // Only requests with the same parameters can share a batch
+    auto key = model + '\n' + Json::writeString(writer_, params);
+
+    Batch full;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      auto [it, created] = pending_.try_emplace(key);
+      auto& batch = it->second;
+      if (created) {
+        batch.model = model;
+        batch.params = std::move(params);
+        batch.deadline = Clock::now() + window;
+      }
+      batch.n_inputs += part.inputs.size();
+      batch.parts.push_back(std::move(part));
+      if (batch.n_inputs < std::max<size_t>(1, max_inputs)) {
+        if (created) {
+          if (!timer_.joinable()) {
+            timer_ = std::thread([this] { RunTimer(); });
+          }
+          cv_.notify_one();
+        }
+        return;
+      }
+      full = std::move(batch);
+      pending_.erase(it);
+    }
+    Dispatch(send_, stopped_, std::move(full));
+  }
+
+ private:
+  // One request of a batch
+  struct Part {
+    Json::Value inputs{Json::arrayValue};
+    size_t weight = 0;
+    OnDone on_done;
+  };
+
+  struct Batch {
+    std::string model;
+    // The request body without its input
+    Json::Value params;
+    std::vector<Part> parts;
+    size_t n_inputs = 0;
+    Clock::time_point deadline;
+  };
+
+  // Takes |send| rather than using send_, because a batch may still finish
+  // once the batcher is gone
+  static void Dispatch(const Send& send,
+                       const std::shared_ptr<std::atomic<bool>>& stopped,
+                       Batch&& batch) {
+    auto body = batch.params;
+    if (batch.parts.size() == 1) {
+      body["input"] = std::move(batch.parts[0].inputs);
+      send(batch.model, std::move(body), std::move(batch.parts[0].on_done));
+      return;
+    }
+    body["input"] = Json::Value(Json::arrayValue);
+    std::vector<size_t> counts;
+    std::vector<size_t> weights;
+    for (const auto& p : batch.parts) {
+      for (const auto& i : p.inputs) {
+        body["input"].append(i);
+      }
+      counts.push_back(p.inputs.size());
+      weights.push_back(p.weight);
+    }
+    auto model = batch.model;
+    send(model, std::move(body),
+         [send, stopped, batch = std::move(batch), counts = std::move(counts),
+          weights = std::move(weights)](Result&& res) mutable {
+           std::vector<Json::Value> responses;
+           if (res.has_value()) {
+             responses = SplitEmbeddings(res.value(), counts, weights);
+           }
+           if (responses.empty()) {
+             // A failed transfer would only fail again, and nothing is
+             // retried once the engine is shutting down
+             if ((res.has_error() && res.error().transport) || *stopped) {
+               auto error = res.has_error() ? res.error() : SplitError();
+               for (auto& p : batch.parts) {
+                 p.on_done(cpp::fail(error));
+               }
+               return;
+             }
+             Retry(send, std::move(batch));
+             return;
+           }
+           for (size_t i = 0; i < responses.size(); i++) {
+             batch.parts[i].on_done(std::move(responses[i]));
+           }
+         });
+  }
+
+  static CompletionFanOut::Error SplitError() {
+    Json::Value error;
+    error["error"] = "Unexpected embeddings response from llama-server";
+    return CompletionFanOut::Error{500, std::move(error)};
+  }
+
+  static void Retry(const Send& send, Batch&& batch) {
+    for (auto& p : batch.parts) {
+      auto body = batch.params;
+      body["input"] = std::move(p.inputs);
+      send(batch.model, std::move(body), std::move(p.on_done));
+    }
+  }
+
+  // Sends batches as their windows end
+  void RunTimer() {
+    std::unique_lock<std::mutex> l(mtx_);
+    while (true) {
+      auto next = Clock::time_point::max();
+      std::vector<Batch> due;
+      auto now = Clock::now();
+      for (auto it = pending_.begin(); it != pending_.end();) {
+        if (stop_ || it->second.deadline <= now) {
+          due.push_back(std::move(it->second));
+          it = pending_.erase(it);
+        } else {
+          next = std::min(next, it->second.deadline);
+          ++it;
+        }
+      }
+      if (!due.empty()) {
+        l.unlock();
+        for (auto& b : due) {
+          Dispatch(send_, stopped_, std::move(b));
+        }
+        l.lock();
+        continue;
+      }
+      if (stop_) {
+        return;
+      }
+      if (next == Clock::time_point::max()) {
+        cv_.wait(l);
+      } else {
+        cv_.wait_until(l, next);
+      }
+    }
+  }
+
+  Send send_;
+  // Shared with the batches in flight, which may finish after the batcher
+  std::shared_ptr<std::atomic<bool>> stopped_ =
+      std::make_shared<std::atomic<bool>>(false);
+  Json::StreamWriterBuilder writer_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  // Batches waiting for their window to end, by model and parameters
+  std::unordered_map<std::string, Batch> pending_;
+  std::thread timer_;
+  bool stop_ = false;
+};
+
+}  // namespace cortex::local
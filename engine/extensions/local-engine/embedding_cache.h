@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cortex::local {
+
+// Bounded LRU cache of embeddings, so that inputs which are embedded again and
+// again (e.g. document chunks that are re-indexed) skip inference. Entries
+// evicted from memory can be spilled to a directory, which is another LRU of
+// its own, and are moved back to memory when they are hit again.
+//
+// The key must identify everything the embedding depends on, see MakeKey().
+class EmbeddingCache {
+ public:
+  using Embedding = std::vector<float>;
+
+  struct Stats {
+    uint64_t hits = 0;
+    // Hits that were read back from the spill directory, included in |hits|
+    uint64_t disk_hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t disk_entries = 0;
+  };
+
+  EmbeddingCache() = default;
+  EmbeddingCache(const EmbeddingCache&) = delete;
+  EmbeddingCache& operator=(const EmbeddingCache&) = delete;
+
+  // |fingerprint| identifies the model file and |params| the request options
+  // other than its model and input, e.g. its serialized JSON. The input is
+  // used as is: whitespace and case change the tokens, and so the embedding.
+  static std::string MakeKey(const std::string& model,
+                             const std::string& fingerprint,
+                             const std::string& params,
+                             const std::string& input) {
+    std::string key;
+    key.reserve(model.size() + fingerprint.size() + params.size() +
+                input.size() + 3);
+    key.append(model).push_back('\0');
+    key.append(fingerprint).push_back('\0');
+    key.append(params).push_back('\0');
+    key.append(input);
+    return key;
+  }
+
+  // Sets the number of entries kept in memory, 0 disables the cache, and
+  // where up to |max_disk_entries| evicted entries are spilled, empty for
+  // nowhere. Cheap when nothing changes, so it can be called per request.
+  void Configure(size_t max_entries, const std::filesystem::path& spill_dir,
+                 size_t max_disk_entries) {
+    std::vector<std::filesystem::path> removed;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (max_entries == max_entries_ && spill_dir == spill_dir_ &&
+          max_disk_entries == max_disk_entries_) {
+        return;
+      }
+      if (spill_dir != spill_dir_ && !spill_dir.empty()) {
+        // Spilled entries only live as long as the process, clear what a
+        // previous one left behind
+        std::error_code ec;
+        std::filesystem::remove_all(spill_dir, ec);
+        std::filesystem::create_directories(spill_dir, ec);
+      }
+      if (spill_dir != spill_dir_ || max_entries == 0) {
+        for (auto const& key : disk_lru_) {
+          removed.push_back(spill_dir_ / FileName(key));
+        }
+        disk_lru_.clear();
+        disk_index_.clear();
+      }
+      max_entries_ = max_entries;
+      spill_dir_ = spill_dir;
+      max_disk_entries_ = spill_dir.empty() ? 0 : max_disk_entries;
+      // Not worth spilling on shrink
+      while (lru_.size() > max_entries_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+        stats_.evictions++;
+      }
+      while (disk_lru_.size() > max_disk_entries_) {
+        removed.push_back(spill_dir_ / FileName(disk_lru_.back()));
+        disk_index_.erase(disk_lru_.back());
+        disk_lru_.pop_back();
+      }
+    }
+    RemoveFiles(removed);
+  }
+
+  bool Enabled() const {
+    std::lock_guard<std::mutex> l(mtx_);
+    return max_entries_ > 0;
+  }
+
+  std::optional<Embedding> Get(const std::string& key) {
+    std::filesystem::path file;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (auto it = index_.find(key); it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        stats_.hits++;
+        return it->second->second;
+      }
+      auto it = disk_index_.find(key);
+      if (it == disk_index_.end()) {
+        stats_.misses++;
+        return std::nullopt;
+      }
+      file = spill_dir_ / FileName(key);
+      disk_lru_.erase(it->second);
+      disk_index_.erase(it);
+    }
+    // Read outside of the lock, the entry is no longer in the disk index
+    auto embedding = ReadFile(file, key);
+    RemoveFiles({file});
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (!embedding) {
+        stats_.misses++;
+        return std::nullopt;
+      }
+      stats_.hits++;
+      stats_.disk_hits++;
+    }
+    Put(key, *embedding);
+    return embedding;
+  }
+
+  void Put(const std::string& key, Embedding embedding) {
+    std::optional<std::pair<std::string, Embedding>> evicted;
+    std::filesystem::path spill_dir;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (max_entries_ == 0) {
+        return;
+      }
+      if (auto it = index_.find(key); it != index_.end()) {
+        it->second->second = std::move(embedding);
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+      }
+      lru_.emplace_front(key, std::move(embedding));
+      index_.emplace(key, lru_.begin());
+      if (lru_.size() <= max_entries_) {
+        return;
+      }
+      index_.erase(lru_.back().first);
+      evicted = std::move(lru_.back());
+      lru_.pop_back();
+      stats_.evictions++;
+      if (max_disk_entries_ == 0) {
+        return;
+      }
+      spill_dir = spill_dir_;
+    }
+    Spill(spill_dir, std::move(evicted->first), evicted->second);
+  }
+
+  Stats GetStats() const {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto stats = stats_;
+    stats.entries = lru_.size();
+    stats.disk_entries = disk_lru_.size();
+    return stats;
+  }
+
+ private:
+  using Lru = std::list<std::pair<std::string, Embedding>>;
+  // Spilled keys, most recent first
+  using DiskLru = std::list<std::string>;
+
+  static std::string FileName(const std::string& key) {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx",
+                  static_cast<unsigned long long>(
+                      std::hash<std::string>{}(key)));
+    return name;
+  }
+
+  // Keys are stored with their embedding: keys whose hashes collide share a
+  // file, and only the last one written is found
+  void Spill(const std::filesystem::path& dir, std::string&& key,
+             const Embedding& embedding) {
+    auto file = dir / FileName(key);
+    auto tmp = file;
+    tmp += ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      uint64_t key_size = key.size();
+      uint64_t n = embedding.size();
+      out.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+      out.write(key.data(), key.size());
+      out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+      out.write(reinterpret_cast<const char*>(embedding.data()),
+                n * sizeof(float));
+      if (!out) {
+        RemoveFiles({tmp});
+        return;
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, file, ec);
+    if (ec) {
+      RemoveFiles({tmp});
+      return;
+    }
+
+    std::vector<std::filesystem::path> removed;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (dir != spill_dir_) {
+        // Reconfigured meanwhile
+        removed.push_back(file);
+      } else if (index_.count(key) == 0 && disk_index_.count(key) == 0) {
+        disk_lru_.push_front(key);
+        disk_index_.emplace(std::move(key), disk_lru_.begin());
+        while (disk_lru_.size() > max_disk_entries_) {
+          removed.push_back(spill_dir_ / FileName(disk_lru_.back()));
+          disk_index_.erase(disk_lru_.back());
+          disk_lru_.pop_back();
+        }
+      }
+    }
+    RemoveFiles(removed);
+  }
+
+  static std::optional<Embedding> ReadFile(const std::filesystem::path& file,
+                                           const std::string& key) {
+    std::ifstream in(file, std::ios::binary);
+    uint64_t key_size = 0;
+    if (!in.read(reinterpret_cast<char*>(&key_size), sizeof(key_size)) ||
+        key_size != key.size()) {
+      return std::nullopt;
+    }
+    std::string stored(key_size, '\0');
+    uint64_t n = 0;
+    if (!in.read(stored.data(), key_size) || stored != key ||
+        !in.read(reinterpret_cast<char*>(&n), sizeof(n))) {
+      return std::nullopt;
+    }
+    Embedding embedding(n);
+    if (!in.read(reinterpret_cast<char*>(embedding.data()), n * sizeof(float))) {
+      return std::nullopt;
+    }
+    return embedding;
+  }
+
+  static void RemoveFiles(const std::vector<std::filesystem::path>& files) {
+    for (const auto& f : files) {
+      std::error_code ec;
+      std::filesystem::remove(f, ec);
+    }
+  }
+
+  mutable std::mutex mtx_;
+  size_t max_entries_ = 0;
+  std::filesystem::path spill_dir_;
+  size_t max_disk_entries_ = 0;
+  // Most recently used first
+  Lru lru_;
+  std::unordered_map<std::string, Lru::iterator> index_;
+  DiskLru disk_lru_;
+  std::unordered_map<std::string, DiskLru::iterator> disk_index_;
+  Stats stats_;
+};
+
+}  // namespace cortex::local
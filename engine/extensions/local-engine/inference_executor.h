@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cortex::local {
+
+// Runs inference I/O jobs (e.g. streaming requests to llama-server) on a
+// dedicated set of threads. Each model has its own concurrency limit, which
+// should match the `--parallel` slots that llama-server was started with, so
+// that one model can keep all of its slots busy without starving the others.
+//
+// A job holds its slot until it returns (Submit) or until it calls the
+// release function it is given (SubmitAsync), which lets jobs that hand the
+// actual transfer to an event loop keep their slot without holding a thread.
+class InferenceExecutor {
+ public:
+  using Task = std::function<void()>;
+  using Release = std::function<void()>;
+  using AsyncTask = std::function<void(Release&&)>;
+  using Clock = std::chrono::steady_clock;
+
+  struct Stats {
+    int limit = 0;
+    int active = 0;
+    size_t queue_depth = 0;
+    uint64_t total = 0;
+    double avg_wait_ms = 0;
+    double max_wait_ms = 0;
+  };
+
+  explicit InferenceExecutor(size_t max_threads)
+      : max_threads_(std::max<size_t>(1, max_threads)) {}
+
+  InferenceExecutor(const InferenceExecutor&) = delete;
+  InferenceExecutor& operator=(const InferenceExecutor&) = delete;
+
+  ~InferenceExecutor() { Stop(); }
+
+  // Stops dispatching jobs: the ones already handed to a worker are run,
+  // those still waiting for a slot and any submitted later are dropped.
+  // Returns once the workers are done, so that the owner can tear down what
+  // the jobs use.
+  void Stop() {
+    std::vector<Pending> dropped;
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      stop_ = true;
+      for (auto& [_, m] : models_) {
+        std::move(m.pending.begin(), m.pending.end(),
+                  std::back_inserter(dropped));
+        m.pending.clear();
+      }
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) {
+      if (t.joinable())
+        t.join();
+    }
+  }
+
+  // Sets the number of jobs that may run concurrently for |model|.
+  void SetModelConcurrency(const std::string& model, int n_parallel) {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto& m = GetOrCreateLocked(model);
+    m.limit = std::max(1, n_parallel);
+    total_limit_ = 0;
+    for (auto const& [_, mi] : models_) {
+      total_limit_ += mi.limit;
+    }
+    EnsureWorkersLocked();
+    ScheduleLocked(m);
+  }
+
+  // Drops the model entry. Jobs that are still waiting for a slot are run
+  // anyway so that their callbacks are always invoked.
+  void RemoveModel(const std::string& model) {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto it = models_.find(model);
+    if (it == models_.end() || stop_)
+      return;
+    for (auto& p : it->second.pending) {
+      ready_.push_back([t = std::move(p.task)] { t([] {}); });
+    }
+    total_limit_ -= it->second.limit;
+    models_.erase(it);
+    cv_.notify_all();
+  }
+
+  void Submit(const std::string& model, Task&& task) {
+    SubmitAsync(model, [t = std::move(task)](Release&& release) {
+      t();
+      release();
+    });
+  }
+
+  void SubmitAsync(const std::string& model, AsyncTask&& task) {
+    {
+      std::lock_guard<std::mutex> l(mtx_);
+      if (stop_)
+        return;
+      auto& m = GetOrCreateLocked(model);
+      if (m.limit == 0) {
+        m.limit = 1;
+        total_limit_ += 1;
+        EnsureWorkersLocked();
+      }
+      m.pending.push_back(Pending{std::move(task), Clock::now()});
+      ScheduleLocked(m);
+    }
+  }
+
+  Stats GetStats(const std::string& model) const {
+    std::lock_guard<std::mutex> l(mtx_);
+    Stats s;
+    if (auto it = models_.find(model); it != models_.end()) {
+      auto const& m = it->second;
+      s.limit = m.limit;
+      s.active = m.active;
+      s.queue_depth = m.pending.size();
+      s.total = m.started;
+      s.avg_wait_ms = m.started == 0 ? 0 : m.total_wait_ms / m.started;
+      s.max_wait_ms = m.max_wait_ms;
+    }
+    return s;
+  }
+
+  size_t GetThreadCount() const {
+    std::lock_guard<std::mutex> l(mtx_);
+    return workers_.size();
+  }
+
+ private:
+  struct Pending {
+    AsyncTask task;
+    Clock::time_point enqueued_at;
+  };
+
+  struct ModelQueue {
+    std::string name;
+    uint64_t id = 0;
+    int limit = 0;
+    int active = 0;
+    std::deque<Pending> pending;
+    uint64_t started = 0;
+    double total_wait_ms = 0;
+    double max_wait_ms = 0;
+  };
+
+  ModelQueue& GetOrCreateLocked(const std::string& model) {
+    auto [it, inserted] = models_.try_emplace(model);
+    if (inserted) {
+      it->second.name = model;
+      it->second.id = ++next_id_;
+    }
+    return it->second;
+  }
+
+  // Grows the pool so that every slot can have a job in flight
+  void EnsureWorkersLocked() {
+    auto target = std::clamp<size_t>(total_limit_, 1, max_threads_);
+    while (workers_.size() < target) {
+      workers_.emplace_back([this] { WorkerLoop(); });
+    }
+  }
+
+  // Moves as many pending jobs of |m| as its free slots allow to the ready
+  // queue. The job releases its slot when it finishes.
+  void ScheduleLocked(ModelQueue& m) {
+    while (!stop_ && m.active < m.limit && !m.pending.empty()) {
+      auto p = std::move(m.pending.front());
+      m.pending.pop_front();
+      m.active++;
+      auto wait_ms = std::chrono::duration<double, std::milli>(
+                         Clock::now() - p.enqueued_at)
+                         .count();
+      m.started++;
+      m.total_wait_ms += wait_ms;
+      m.max_wait_ms = std::max(m.max_wait_ms, wait_ms);
+      auto release = [this, model = m.name, id = m.id,
+                      released = std::make_shared<std::atomic<bool>>(false)] {
+        if (released->exchange(true))
+          return;
+        std::lock_guard<std::mutex> l(mtx_);
+        // The model may have been removed (or reloaded) while the job was
+        // running
+        if (auto it = models_.find(model);
+            it != models_.end() && it->second.id == id) {
+          it->second.active--;
+          ScheduleLocked(it->second);
+        }
+      };
+      ready_.push_back([t = std::move(p.task), release = std::move(release)] {
+        t(release);
+      });
+      cv_.notify_one();
+    }
+  }
+
+  void WorkerLoop() {
+    while (true) {
+      Task t;
+      {
+        std::unique_lock<std::mutex> l(mtx_);
+        cv_.wait(l, [this] { return stop_ || !ready_.empty(); });
+        if (stop_ && ready_.empty())
+          return;
+        t = std::move(ready_.front());
+        ready_.pop_front();
+      }
+      t();
+    }
+  }
+
+  size_t max_threads_;
+  size_t total_limit_ = 0;
+  uint64_t next_id_ = 0;
+  bool stop_ = false;
+  mutable std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<Task> ready_;
+  std::unordered_map<std::string, ModelQueue> models_;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace cortex::local
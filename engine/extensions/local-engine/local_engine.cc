@@ -1,14 +1,19 @@
 #include "local_engine.h"
 #include <algorithm>
+#include <atomic>
+#include <filesystem>
 #include <random>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <string.h>
 #include <unordered_set>
+#include "utils/backoff.h"
 #include "utils/curl_utils.h"
 #include "utils/json_helper.h"
 #include "utils/logging_utils.h"
 #include "utils/process/utils.h"
+#include "utils/sse_utils.h"
 #include "utils/url_parser.h"
 
 namespace cortex::local {
@@ -25,6 +30,18 @@ const std::unordered_set<std::string> kIgnoredParams = {
     "object",       "penalize_nl",     "precision",  "size",
     "stop",         "tfs_z",           "typ_p",      "caching_enabled"};
 
+// llama-server usually answers its first health check within tens of
+// milliseconds, loading the weights can take much longer
+constexpr const auto kHealthPollInitial = std::chrono::milliseconds(10);
+constexpr const auto kHealthPollMax = std::chrono::milliseconds(250);
+constexpr const long kHealthProbeTimeoutMs = 1000;
+// A llama-server that could not bind its port is started again on another
+// one, up to this many times in total
+constexpr const int kMaxSpawnAttempts = 3;
+// A stream answered with an error has a plain JSON body instead of events,
+// which is kept up to this size to be forwarded
+constexpr const size_t kMaxStreamErrorBodyBytes = 64 * 1024;
+
 const std::unordered_map<std::string, std::string> kParamsMap = {
     {"cpu_threads", "--threads"},
     {"n_ubatch", "--ubatch-size"},
@@ -40,15 +57,6 @@ const std::unordered_map<std::string, std::string> kParamsMap = {
     {"reasoning_budget", "--reasoning-budget"},
 };
 
-int GenerateRandomInteger(int min, int max) {
-  static std::random_device rd;   // Seed for the random number engine
-  static std::mt19937 gen(rd());  // Mersenne Twister random number engine
-  std::uniform_int_distribution<> dis(
-      min, max);  // Distribution for the desired range
-
-  return dis(gen);
-}
-
 std::vector<std::string> ConvertJsonToParamsVector(const Json::Value& root) {
   std::vector<std::string> res;
   std::string errors;
@@ -133,8 +141,6 @@ std::vector<std::string> ConvertJsonToParamsVector(const Json::Value& root) {
 }
 
 
-constexpr const auto kMinDataChunkSize = 6u;
-
 struct OaiInfo {
   std::string model;
   bool include_usage = false;
@@ -144,7 +150,18 @@ struct OaiInfo {
 
 struct StreamingCallback {
   std::shared_ptr<http_callback> callback;
-  bool need_stop = true;
+  // Receives the SSE frames if set, otherwise they go through |callback|
+  std::shared_ptr<StreamSink> sink;
+  sse_utils::SseParser parser;
+  // The final frame was handed over
+  bool done = false;
+  // Set once the response turned out to be an event stream, until then its
+  // body is kept in |error_body|
+  bool got_event = false;
+  std::string error_body;
+  // Set while the sink is saturated, the transfer is paused meanwhile
+  std::atomic<bool> throttled{false};
+  uint64_t transfer_id = 0;
   OaiInfo oi;
 };
 
@@ -285,102 +302,104 @@ std::string CreateReturnJson(
   return Json::writeString(writer, root);
 }
 
-size_t WriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
-  auto* sc = static_cast<StreamingCallback*>(userdata);
-  size_t data_length = size * nmemb;
-
-  if (ptr && data_length > kMinDataChunkSize) {
-    std::string chunk(ptr + kMinDataChunkSize, data_length - kMinDataChunkSize);
-    CTL_DBG(chunk);
-    if (sc->oi.oai_endpoint) {
-      if (chunk.find("[DONE]") != std::string::npos) {
-        Json::Value status;
-        status["is_done"] = true;
-        status["has_error"] = false;
-        status["is_stream"] = true;
-        status["status_code"] = 200;
-        Json::Value chunk_json;
-        chunk_json["data"] = "data: [DONE]";
-        sc->need_stop = false;
-        (*sc->callback)(std::move(status), std::move(chunk_json));
-        return data_length;
-      }
-      if (!sc->oi.include_usage &&
-          chunk.find("completion_tokens") != std::string::npos) {
-        return data_length;
-      }
-
-      Json::Value chunk_json;
-      chunk_json["data"] = "data: " + chunk;
-      Json::Value status;
-      status["is_done"] = false;
-      status["has_error"] = false;
-      status["is_stream"] = true;
-      status["status_code"] = 200;
-      (*sc->callback)(std::move(status), std::move(chunk_json));
-    } else {
-      if (chunk.find("[DONE]") != std::string::npos) {
-        Json::Value status;
-        status["is_done"] = true;
-        status["has_error"] = false;
-        status["is_stream"] = true;
-        status["status_code"] = 200;
-        Json::Value chunk_json;
-        chunk_json["data"] = "data: [DONE]";
-        sc->need_stop = false;
-        (*sc->callback)(std::move(status), std::move(chunk_json));
-        return data_length;
-      }
-      auto json_data = json_helper::ParseJsonString(chunk);
-      // DONE
-      if (!json_data.isNull() && json_data.isMember("timings")) {
-        std::optional<Usage> u;
-        if (sc->oi.include_usage) {
-          u = Usage{json_data["tokens_evaluated"].asInt(),
-                    json_data["tokens_predicted"].asInt()};
-        }
-
-        Json::Value chunk_json;
-        chunk_json["data"] =
-            "data: " + CreateReturnJson(GenerateRandomString(20), sc->oi.model,
-                                        "", "stop", sc->oi.include_usage, u);
-        Json::Value status;
-        status["is_done"] = false;
-        status["has_error"] = false;
-        status["is_stream"] = true;
-        status["status_code"] = 200;
-        (*sc->callback)(std::move(status), std::move(chunk_json));
-
-        sc->need_stop = false;
-        return data_length;
-      }
+// Hands |frames| over to the consumer, through the sink if there is one.
+// Returns false if the consumer asked to slow down.
+bool EmitFrames(StreamingCallback* sc, std::string&& frames, bool is_done) {
+  if (is_done) {
+    sc->done = true;
+  }
+  if (sc->sink) {
+    return sc->sink->Write(std::move(frames), is_done);
+  }
+  Json::Value status;
+  status["is_done"] = is_done;
+  status["has_error"] = false;
+  status["is_stream"] = true;
+  status["status_code"] = 200;
+  Json::Value chunk_json;
+  chunk_json["data"] = frames;
+  (*sc->callback)(std::move(status), std::move(chunk_json));
+  return true;
+}
 
-      Json::Value logprobs;
-      if (sc->oi.n_probs > 0) {
-        logprobs = json_data["completion_probabilities"];
-      }
-      std::string to_send;
-      if (json_data.isMember("choices") && json_data["choices"].isArray() &&
-          json_data["choices"].size() > 0) {
-        to_send = json_data["choices"][0].get("text", "").asString();
-      }
-      CTL_DBG(to_send);
-      const std::string str =
-          CreateReturnJson(GenerateRandomString(20), sc->oi.model, to_send, "",
-                           sc->oi.include_usage, std::nullopt, logprobs);
-      Json::Value chunk_json;
-      chunk_json["data"] = "data: " + str;
-      Json::Value status;
-      status["is_done"] = false;
-      status["has_error"] = false;
-      status["is_stream"] = true;
-      status["status_code"] = 200;
-      (*sc->callback)(std::move(status), std::move(chunk_json));
-      return data_length;
+// Converts one event of llama-server's completions endpoint, |data| is the
+// event's payload. Returns true on the final event.
+bool AppendCompletionEvent(StreamingCallback* sc, std::string_view data,
+                           std::string& frames) {
+  CTL_DBG(data);
+  if (data == sse_utils::kDoneData) {
+    frames.append("data: [DONE]\n\n");
+    return true;
+  }
+  auto json_data = json_helper::ParseJsonString(std::string(data));
+  // DONE
+  if (!json_data.isNull() && json_data.isMember("timings")) {
+    std::optional<Usage> u;
+    if (sc->oi.include_usage) {
+      u = Usage{json_data["tokens_evaluated"].asInt(),
+                json_data["tokens_predicted"].asInt()};
     }
+    frames.append("data: ");
+    frames.append(CreateReturnJson(GenerateRandomString(20), sc->oi.model, "",
+                                   "stop", sc->oi.include_usage, u));
+    frames.append("\n\n");
+    return false;
   }
 
-  return data_length;
+  Json::Value logprobs;
+  if (sc->oi.n_probs > 0) {
+    logprobs = json_data["completion_probabilities"];
+  }
+  std::string to_send;
+  if (json_data.isMember("choices") && json_data["choices"].isArray() &&
+      json_data["choices"].size() > 0) {
+    to_send = json_data["choices"][0].get("text", "").asString();
+  }
+  CTL_DBG(to_send);
+  frames.append("data: ");
+  frames.append(CreateReturnJson(GenerateRandomString(20), sc->oi.model,
+                                 to_send, "", sc->oi.include_usage,
+                                 std::nullopt, logprobs));
+  frames.append("\n\n");
+  return false;
+}
+
+// Handles one chunk of llama-server's response body. All complete events of
+// the chunk are handed over in a single message. Returns false if the
+// consumer asked to slow down.
+bool WriteStreamData(StreamingCallback* sc, const char* ptr, size_t size) {
+  std::string frames;
+  bool done = sc->done;
+  sc->parser.Feed(std::string_view(ptr, size),
+                  [sc, &frames, &done](std::string_view frame,
+                                       std::string_view data) {
+                    sc->got_event = true;
+                    if (done) {
+                      return;
+                    }
+                    if (!sc->oi.oai_endpoint) {
+                      done = AppendCompletionEvent(sc, data, frames);
+                      return;
+                    }
+                    // OpenAI compatible: forward llama-server's frames
+                    // untouched
+                    if (data == sse_utils::kDoneData) {
+                      frames.append("data: [DONE]\n\n");
+                      done = true;
+                      return;
+                    }
+                    if (!sc->oi.include_usage &&
+                        data.find("completion_tokens") !=
+                            std::string_view::npos) {
+                      return;
+                    }
+                    frames.append(frame);
+                    frames.append("\n\n");
+                  });
+  if (frames.empty() || sc->done) {
+    return true;
+  }
+  return EmitFrames(sc, std::move(frames), done);
 }
 
 Json::Value ConvertLogitBiasToArray(const Json::Value& input) {
@@ -435,22 +454,91 @@ Json::Value CreateFullReturnJson(
   return root;
 }
 
+size_t DiscardCallback(char*, size_t size, size_t nmemb, void*) {
+  return size * nmemb;
+}
+
+// Returns the status code of llama-server's health endpoint, or 0 if the
+// server does not accept connections yet
+long ProbeHealth(CURL* curl, const ServerAddress& s) {
+  auto url = url_parser::Url{
+      /*.protocol*/ "http",
+      /*.host*/ s.Authority(),
+      /*.pathParams*/ {"health"},
+      /*.queries*/ {},
+  }.ToFullPath();
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  if (!s.unix_socket.empty()) {
+    curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, s.unix_socket.c_str());
+  }
+  curl_easy_setopt(curl, CURLOPT_NOPROXY, "*");
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, kHealthProbeTimeoutMs);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardCallback);
+  if (curl_easy_perform(curl) != CURLE_OK) {
+    return 0;
+  }
+  long http_status = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_status);
+  return http_status;
+}
+
+// Changes when the model file is replaced, e.g. downloaded again, without
+// hashing gigabytes of weights
+std::string ModelFingerprint(const std::string& path) {
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return path;
+  }
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return path;
+  }
+  return path + ":" + std::to_string(size) + ":" +
+         std::to_string(mtime.time_since_epoch().count());
+}
+
 }  // namespace
 
 LocalEngine::~LocalEngine() {
-  for (auto& [_, si] : server_map_) {
-    (void)cortex::process::KillProcess(si.process_info);
+  // Sends the batches still waiting, then lets the jobs already dispatched
+  // start their transfers. Nothing reaches the stream loops after this, so
+  // the transfers they abort when destroyed are not retried through them.
+  embedding_batcher_.Stop();
+  executor_.Stop();
+
+  decltype(loads_) loads;
+  {
+    std::lock_guard<std::mutex> l(loads_mtx_);
+    loads.swap(loads_);
+  }
+  for (auto& [_, load] : loads) {
+    load->cancelled = true;
+  }
+  for (auto& [_, load] : loads) {
+    if (load->thread.joinable()) {
+      load->thread.join();
+    }
+  }
+  for (auto& [_, si] : servers_.Clear()) {
+    (void)cortex::process::KillProcess(si->process_info);
+    ReleaseEndpoint(*si);
   }
-  server_map_.clear();
 }
 void LocalEngine::HandleChatCompletion(std::shared_ptr<Json::Value> json_body,
                                        http_callback&& callback) {
+  // Without a sink every frame goes through |callback|
+  HandleStreamingChatCompletion(json_body, std::move(callback), nullptr);
+}
+
+void LocalEngine::HandleStreamingChatCompletion(
+    std::shared_ptr<Json::Value> json_body, http_callback&& callback,
+    std::shared_ptr<StreamSink> sink) {
   auto model_id = json_body->get("model", "").asString();
   if (model_id.empty()) {
     CTL_WRN("Model is empty");
   }
-  if (server_map_.find(model_id) != server_map_.end()) {
-    auto& s = server_map_[model_id];
+  if (auto s = servers_.Find(model_id)) {
     auto oaicompat = [&json_body]() -> bool {
       if (json_body->isMember("logprobs") &&
           (*json_body)["logprobs"].asBool()) {
@@ -459,11 +547,13 @@ void LocalEngine::HandleChatCompletion(std::shared_ptr<Json::Value> json_body,
       return true;
     }();
     if (oaicompat) {
-      HandleOpenAiChatCompletion(
-          json_body, const_cast<http_callback&&>(callback), model_id);
+      HandleOpenAiChatCompletion(json_body,
+                                 const_cast<http_callback&&>(callback),
+                                 std::move(sink), model_id, *s);
     } else {
-      HandleNonOpenAiChatCompletion(
-          json_body, const_cast<http_callback&&>(callback), model_id);
+      HandleNonOpenAiChatCompletion(json_body,
+                                    const_cast<http_callback&&>(callback),
+                                    std::move(sink), model_id, *s);
     }
   } else {
     Json::Value error;
@@ -483,46 +573,219 @@ void LocalEngine::HandleEmbedding(std::shared_ptr<Json::Value> json_body,
   if (model_id.empty()) {
     CTL_WRN("Model is empty");
   }
-  if (server_map_.find(model_id) != server_map_.end()) {
-    auto& s = server_map_[model_id];
-    auto url = url_parser::Url{
-        /*.protocol*/ "http",
-        /*.host*/ s.host + ":" + std::to_string(s.port),
-        /*.pathParams*/ {"v1", "embeddings"},
-        /* .queries = */ {},
-    };
-
-    auto response = curl_utils::SimplePostJson(url.ToFullPath(),
-                                               json_body->toStyledString());
+  if (!servers_.Find(model_id)) {
+    Json::Value error;
+    error["error"] = "Model is not loaded yet: " + model_id;
+    Json::Value status;
+    status["is_done"] = true;
+    status["has_error"] = true;
+    status["is_stream"] = false;
+    status["status_code"] = 400;
+    callback(std::move(status), std::move(error));
+    return;
+  }
 
-    if (response.has_error()) {
-      CTL_WRN("Error: " << response.error());
-      Json::Value error;
-      error["error"] = response.error();
+  EmbeddingBatcher::OnDone on_done = [callback = std::move(callback)](
+                                         UpstreamResult&& res) {
+    if (res.has_error()) {
+      CTL_WRN("Error: " << res.error().body.toStyledString());
       Json::Value status;
       status["is_done"] = true;
       status["has_error"] = true;
       status["is_stream"] = false;
-      status["status_code"] = 400;
-      callback(std::move(status), std::move(error));
-    } else {
-      Json::Value status;
-      status["is_done"] = true;
-      status["has_error"] = false;
-      status["is_stream"] = false;
-      status["status_code"] = 200;
-      callback(std::move(status), std::move(response.value()));
+      status["status_code"] = res.error().status_code;
+      callback(std::move(status), std::move(res.error().body));
+      return;
     }
-  } else {
-    Json::Value error;
-    error["error"] = "Model is not loaded yet: " + model_id;
     Json::Value status;
     status["is_done"] = true;
-    status["has_error"] = true;
+    status["has_error"] = false;
     status["is_stream"] = false;
-    status["status_code"] = 400;
-    callback(std::move(status), std::move(error));
+    status["status_code"] = 200;
+    callback(std::move(status), std::move(res.value()));
+  };
+
+  auto config = file_manager_utils::GetCortexConfigSnapshot();
+  embedding_cache_.Configure(
+      std::max(0, config->embeddingCacheMaxEntries),
+      config->embeddingCacheDiskEntries > 0
+          ? file_manager_utils::GetCortexDataPath() / "cache" / "embeddings"
+          : std::filesystem::path(),
+      std::max(0, config->embeddingCacheDiskEntries));
+  if (embedding_cache_.Enabled() &&
+      ServeFromEmbeddingCache(model_id, *json_body, on_done)) {
+    return;
+  }
+
+  auto window = std::chrono::milliseconds(config->embeddingBatchWindowMs);
+  if (window.count() > 0 && EmbeddingBatcher::IsBatchable(*json_body)) {
+    embedding_batcher_.Add(model_id, *json_body, window,
+                           std::max(1, config->embeddingBatchMaxInputs),
+                           std::move(on_done));
+  } else {
+    PostEmbeddings(model_id, std::move(*json_body), std::move(on_done));
+  }
+}
+
+bool LocalEngine::ServeFromEmbeddingCache(const std::string& model,
+                                          Json::Value& body,
+                                          EmbeddingBatcher::OnDone& on_done) {
+  // Only float embeddings of text inputs are cached
+  if (!EmbeddingBatcher::IsBatchable(body) ||
+      body.get("encoding_format", "float").asString() != "float") {
+    return false;
+  }
+  auto s = servers_.Find(model);
+  if (!s) {
+    return false;
+  }
+
+  auto params = body;
+  params.removeMember("model");
+  params.removeMember("input");
+  Json::StreamWriterBuilder writer;
+  writer["indentation"] = "";
+  auto params_str = Json::writeString(writer, params);
+
+  Json::Value inputs;
+  if (body["input"].isString()) {
+    inputs.append(body["input"]);
+  } else {
+    inputs = body["input"];
+  }
+  // Embeddings by input index, empty for misses
+  std::vector<std::optional<EmbeddingCache::Embedding>> found(inputs.size());
+  std::vector<std::string> miss_keys;
+  std::vector<Json::ArrayIndex> misses;
+  Json::Value miss_inputs(Json::arrayValue);
+  for (Json::ArrayIndex i = 0; i < inputs.size(); i++) {
+    auto key = EmbeddingCache::MakeKey(model, s->model_fingerprint, params_str,
+                                       inputs[i].asString());
+    found[i] = embedding_cache_.Get(key);
+    if (!found[i]) {
+      miss_keys.push_back(std::move(key));
+      misses.push_back(i);
+      miss_inputs.append(inputs[i]);
+    }
+  }
+
+  auto respond = [model, found = std::move(found)](
+                     Json::Value&& usage,
+                     std::vector<EmbeddingCache::Embedding>&& fetched) {
+    Json::Value res;
+    res["object"] = "list";
+    res["model"] = model;
+    res["data"] = Json::Value(Json::arrayValue);
+    size_t next = 0;
+    for (size_t i = 0; i < found.size(); i++) {
+      const auto& e = found[i] ? *found[i] : fetched[next++];
+      Json::Value d;
+      d["object"] = "embedding";
+      d["index"] = static_cast<Json::UInt>(i);
+      d["embedding"] = Json::Value(Json::arrayValue);
+      for (auto v : e) {
+        d["embedding"].append(v);
+      }
+      res["data"].append(std::move(d));
+    }
+    res["usage"] = std::move(usage);
+    return res;
+  };
+
+  if (misses.empty()) {
+    Json::Value usage;
+    usage["prompt_tokens"] = 0;
+    usage["total_tokens"] = 0;
+    on_done(respond(std::move(usage), {}));
+    return true;
+  }
+  if (misses.size() == inputs.size()) {
+    // Nothing to merge, only the results are cached
+    on_done = [this, miss_keys = std::move(miss_keys),
+               on_done = std::move(on_done)](UpstreamResult&& res) {
+      if (res.has_value()) {
+        for (const auto& d : res.value()["data"]) {
+          auto i = d.get("index", -1).asInt();
+          if (i >= 0 && static_cast<size_t>(i) < miss_keys.size()) {
+            if (auto e = ToEmbedding(d["embedding"])) {
+              embedding_cache_.Put(miss_keys[i], std::move(*e));
+            }
+          }
+        }
+      }
+      on_done(std::move(res));
+    };
+    return false;
+  }
+
+  body["input"] = std::move(miss_inputs);
+  on_done = [this, miss_keys = std::move(miss_keys),
+             respond = std::move(respond),
+             on_done = std::move(on_done)](UpstreamResult&& res) mutable {
+    if (res.has_error()) {
+      on_done(std::move(res));
+      return;
+    }
+    const auto& data = res.value()["data"];
+    std::vector<EmbeddingCache::Embedding> fetched(miss_keys.size());
+    std::vector<bool> filled(miss_keys.size(), false);
+    for (const auto& d : data) {
+      auto i = d.get("index", -1).asInt();
+      auto e = ToEmbedding(d["embedding"]);
+      if (i < 0 || static_cast<size_t>(i) >= miss_keys.size() || !e) {
+        continue;
+      }
+      fetched[i] = std::move(*e);
+      filled[i] = true;
+    }
+    if (std::find(filled.begin(), filled.end(), false) != filled.end()) {
+      Json::Value error;
+      error["error"] = "Unexpected embeddings response from llama-server";
+      on_done(cpp::fail(UpstreamError{500, std::move(error)}));
+      return;
+    }
+    for (size_t i = 0; i < miss_keys.size(); i++) {
+      embedding_cache_.Put(miss_keys[i], fetched[i]);
+    }
+    on_done(respond(std::move(res.value()["usage"]), std::move(fetched)));
+  };
+  return false;
+}
+
+std::optional<EmbeddingCache::Embedding> LocalEngine::ToEmbedding(
+    const Json::Value& v) {
+  if (!v.isArray()) {
+    return std::nullopt;
   }
+  EmbeddingCache::Embedding e;
+  e.reserve(v.size());
+  for (const auto& x : v) {
+    if (!x.isNumeric()) {
+      return std::nullopt;
+    }
+    e.push_back(x.asFloat());
+  }
+  return e;
+}
+
+void LocalEngine::PostEmbeddings(const std::string& model, Json::Value&& body,
+                                 EmbeddingBatcher::OnDone&& on_done) {
+  // The model may have been unloaded while the request was batched
+  auto s = servers_.Find(model);
+  if (!s) {
+    Json::Value error;
+    error["error"] = "Model is not loaded yet: " + model;
+    on_done(cpp::fail(UpstreamError{400, std::move(error)}));
+    return;
+  }
+  auto url = url_parser::Url{
+      /*.protocol*/ "http",
+      /*.host*/ s->Authority(),
+      /*.pathParams*/ {"v1", "embeddings"},
+      /* .queries = */ {},
+  };
+  PostJson(model, url.ToFullPath(), s->unix_socket, body.toStyledString(),
+           std::move(on_done));
 }
 
 void LocalEngine::LoadModel(std::shared_ptr<Json::Value> json_body,
@@ -531,7 +794,8 @@ void LocalEngine::LoadModel(std::shared_ptr<Json::Value> json_body,
   if (model_id.empty()) {
     CTL_WRN("Model is empty");
   }
-  if (server_map_.find(model_id) != server_map_.end()) {
+  std::unique_lock<std::mutex> lifecycle(lifecycle_mtx_);
+  if (servers_.Find(model_id)) {
     CTL_INF("Model " << model_id << " is already loaded");
     Json::Value error;
     error["error"] = "Model " + model_id + " is already loaded";
@@ -545,65 +809,50 @@ void LocalEngine::LoadModel(std::shared_ptr<Json::Value> json_body,
   }
   
   CTL_INF("Start loading model");
-  auto wait_for_server_up = [this](const std::string& model,
-                                   const std::string& host, int port) {
-    auto url = url_parser::Url{
-        /*.protocol*/ "http",
-        /*.host*/ host + ":" + std::to_string(port),
-        /*.pathParams*/ {"health"},
-        /*.queries*/ {},
-    };
-    while (server_map_.find(model) != server_map_.end()) {
-      auto res = curl_utils::SimpleGet(url.ToFullPath());
-      if (res.has_error()) {
-        LOG_INFO << "Wait for server up ..";
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-      } else {
-        return true;
-      }
-    }
-    return false;
-  };
-
   LOG_DEBUG << "Start to spawn llama-server";
 
-  server_map_[model_id].host = "127.0.0.1";
-  server_map_[model_id].port = GenerateRandomInteger(39400, 39999);
-  auto& s = server_map_[model_id];
+  ServerAddress s;
   s.pre_prompt = json_body->get("pre_prompt", "").asString();
   s.user_prompt = json_body->get("user_prompt", "USER: ").asString();
   s.ai_prompt = json_body->get("ai_prompt", "ASSISTANT: ").asString();
   s.system_prompt =
       json_body->get("system_prompt", "ASSISTANT's RULE: ").asString();
+  s.model_fingerprint = ModelFingerprint(
+      json_body->get("model_path", json_body->get("llama_model_path", ""))
+          .asString());
   std::vector<std::string> params = ConvertJsonToParamsVector(*json_body);
-  params.push_back("--host");
-  params.push_back(s.host);
-  params.push_back("--port");
-  params.push_back(std::to_string(s.port));
-
-
   params.push_back("--jinja");
 
-  std::vector<std::string> v;
-  v.reserve(params.size() + 1);
   auto engine_dir = engine_service_.GetEngineDirPath(kLlamaRepo);
   if (engine_dir.has_error()) {
     CTL_WRN(engine_dir.error());
-    server_map_.erase(model_id);
+    Json::Value error;
+    error["error"] = engine_dir.error();
+    Json::Value status;
+    status["is_done"] = true;
+    status["has_error"] = true;
+    status["is_stream"] = false;
+    status["status_code"] = 500;
+    callback(std::move(status), std::move(error));
     return;
   }
   auto exe = (engine_dir.value().first / kLlamaServer).string();
 
-  v.push_back(exe);
-  v.insert(v.end(), params.begin(), params.end());
+  SpawnOptions opts;
+  opts.command.reserve(params.size() + 1);
+  opts.command.push_back(exe);
+  opts.command.insert(opts.command.end(), params.begin(), params.end());
+  opts.log_path =
+      (file_manager_utils::GetCortexLogPath() / "logs" / "cortex.log").string();
+#if !defined(_WIN32)
+  opts.unix_socket =
+      file_manager_utils::GetCortexConfigSnapshot()->llamaServerUnixSocket;
+#endif
+  CTL_DBG("log: " << opts.log_path);
   engine_service_.RegisterEngineLibPath();
 
-  auto log_path =
-      (file_manager_utils::GetCortexLogPath() / "logs" / "cortex.log").string();
-  CTL_DBG("log: " << log_path);
-  auto result = cortex::process::SpawnProcess(v, log_path, log_path);
-  if (result.has_error()) {
-    CTL_ERR("Fail to spawn process. " << result.error());
+  if (auto res = SpawnServer(s, opts); res.has_error()) {
+    CTL_ERR("Fail to spawn process. " << res.error());
     Json::Value error;
     error["error"] = "Fail to spawn process";
     Json::Value status;
@@ -612,33 +861,201 @@ void LocalEngine::LoadModel(std::shared_ptr<Json::Value> json_body,
     status["is_stream"] = false;
     status["status_code"] = 500;
     callback(std::move(status), std::move(error));
-    server_map_.erase(model_id);
     return;
   }
+  s.start_time = std::chrono::system_clock::now().time_since_epoch() /
+                 std::chrono::milliseconds(1);
+  // Cannot fail, loads and unloads are serialized
+  auto server = std::make_shared<const ServerAddress>(std::move(s));
+  servers_.Insert(model_id, server);
+
+  // The caller is answered once the server is up, from the loader thread.
+  auto load = std::make_shared<ModelLoad>();
+  load->thread = std::thread(
+      [this, load, model_id, server, opts = std::move(opts),
+       n_parallel = json_body->get("n_parallel", 1).asInt(),
+       callback = std::move(callback)]() mutable {
+        WaitForServerUp(load, model_id, std::move(server), opts, n_parallel,
+                        std::move(callback));
+      });
+
+  std::shared_ptr<ModelLoad> previous;
+  {
+    std::lock_guard<std::mutex> l(loads_mtx_);
+    previous = std::exchange(loads_[model_id], load);
+  }
+  // A failed load of the same model, joined without blocking other loads and
+  // unloads
+  lifecycle.unlock();
+  if (previous && previous->thread.joinable()) {
+    previous->thread.join();
+  }
+}
+
+cpp::result<void, std::string> LocalEngine::SpawnServer(
+    ServerAddress& s, const SpawnOptions& opts) {
+  auto command = opts.command;
+  s.host = "127.0.0.1";
+  s.port = 0;
+  s.unix_socket.clear();
+#if !defined(_WIN32)
+  if (opts.unix_socket) {
+    // llama-server listens on a unix socket if its host ends with .sock
+    s.unix_socket = (std::filesystem::temp_directory_path() /
+                     ("cortex-" + std::to_string(getpid()) + "-" +
+                      std::to_string(++socket_seq_) + ".sock"))
+                        .string();
+    std::error_code ec;
+    std::filesystem::remove(s.unix_socket, ec);
+    command.insert(command.end(), {"--host", s.unix_socket});
+  }
+#endif
+  if (s.unix_socket.empty()) {
+    auto port = port_allocator_.Acquire();
+    if (!port) {
+      return cpp::fail("No free port for llama-server in " +
+                       std::to_string(kServerPortFirst) + "-" +
+                       std::to_string(kServerPortLast));
+    }
+    s.port = *port;
+    command.insert(command.end(),
+                   {"--host", s.host, "--port", std::to_string(s.port)});
+  }
 
+  auto result =
+      cortex::process::SpawnProcess(command, opts.log_path, opts.log_path);
+  if (result.has_error()) {
+    ReleaseEndpoint(s);
+    return cpp::fail(result.error());
+  }
   s.process_info = result.value();
-  if (wait_for_server_up(model_id, s.host, s.port)) {
-    s.start_time = std::chrono::system_clock::now().time_since_epoch() /
-                   std::chrono::milliseconds(1);
-    Json::Value response;
-    response["status"] = "Model loaded successfully with pid: " +
-                         std::to_string(s.process_info.pid);
-    Json::Value status;
-    status["is_done"] = true;
-    status["has_error"] = false;
-    status["is_stream"] = false;
-    status["status_code"] = 200;
-    callback(std::move(status), std::move(response));
+  return {};
+}
+
+void LocalEngine::ReleaseEndpoint(const ServerAddress& s) {
+  if (!s.unix_socket.empty()) {
+    std::error_code ec;
+    std::filesystem::remove(s.unix_socket, ec);
+  } else if (s.port != 0) {
+    port_allocator_.Release(s.port);
+  }
+}
+
+void LocalEngine::WaitForServerUp(std::shared_ptr<ModelLoad> load,
+                                  const std::string& model_id,
+                                  ServerEntry server,
+                                  const SpawnOptions& opts,
+                                  int n_parallel, http_callback&& callback) {
+  auto start = std::chrono::steady_clock::now();
+  cortex::utils::ExponentialBackoff backoff(kHealthPollInitial,
+                                            kHealthPollMax);
+  std::string error_msg;
+  int attempt = 1;
+  // Whether the current process has answered over HTTP at all
+  bool answered = false;
+  CURL* curl = curl_easy_init();
+  while (curl) {
+    if (load->cancelled) {
+      error_msg = "Model load was cancelled: " + model_id;
+      break;
+    }
+    // llama-server answers 503 while it is loading the model
+    auto http_status = ProbeHealth(curl, *server);
+    if (http_status == 200) {
+      break;
+    }
+    answered = answered || http_status != 0;
+    if (!cortex::process::IsProcessAlive(server->process_info)) {
+      if (answered || attempt >= kMaxSpawnAttempts) {
+        error_msg = "llama-server exited before it was ready, see cortex.log";
+        break;
+      }
+      // Exiting without ever listening means it could not bind, most likely
+      // another process took the port after it was probed. The old port stays
+      // reserved until a new one is picked, so it is not handed out again.
+      CTL_WRN("llama-server for " << model_id
+                                  << " exited before listening, retrying");
+      auto next = *server;
+      if (auto res = SpawnServer(next, opts); res.has_error()) {
+        error_msg = "Fail to spawn process: " + res.error();
+        break;
+      }
+      auto respawned = std::make_shared<const ServerAddress>(std::move(next));
+      if (!servers_.Replace(model_id, server, respawned)) {
+        // Unloaded meanwhile
+        (void)cortex::process::KillProcess(respawned->process_info);
+        ReleaseEndpoint(*respawned);
+        error_msg = "Model load was cancelled: " + model_id;
+        break;
+      }
+      ReleaseEndpoint(*server);
+      server = std::move(respawned);
+      attempt++;
+      backoff.Reset();
+      continue;
+    }
+    std::this_thread::sleep_for(backoff.Next());
+  }
+  if (curl) {
+    curl_easy_cleanup(curl);
   } else {
-    server_map_.erase(model_id);
+    error_msg = "Failed to init CURL";
+  }
+
+  if (!error_msg.empty()) {
+    CTL_ERR("Failed to load model " << model_id << ": " << error_msg);
+    // A cancelled load's server is stopped by whoever cancelled it
+    if (!load->cancelled && servers_.Erase(model_id, server)) {
+      (void)cortex::process::KillProcess(server->process_info);
+      ReleaseEndpoint(*server);
+    }
     Json::Value error;
-    error["error"] = "Wait for server up timeout";
+    error["error"] = error_msg;
     Json::Value status;
     status["is_done"] = true;
     status["has_error"] = true;
     status["is_stream"] = false;
     status["status_code"] = 500;
     callback(std::move(status), std::move(error));
+    return;
+  }
+
+  auto load_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  CTL_INF("Model " << model_id << " is ready, started in " << load_time_ms
+                   << " ms");
+  // One in-flight request per llama-server slot
+  executor_.SetModelConcurrency(model_id, n_parallel);
+  load->load_time_ms = load_time_ms;
+  load->ready = true;
+
+  Json::Value response;
+  response["status"] = "Model loaded successfully with pid: " +
+                       std::to_string(server->process_info.pid);
+  response["load_time_ms"] = static_cast<Json::Int64>(load_time_ms);
+  Json::Value status;
+  status["is_done"] = true;
+  status["has_error"] = false;
+  status["is_stream"] = false;
+  status["status_code"] = 200;
+  callback(std::move(status), std::move(response));
+}
+
+void LocalEngine::CancelLoad(const std::string& model_id) {
+  std::shared_ptr<ModelLoad> load;
+  {
+    std::lock_guard<std::mutex> l(loads_mtx_);
+    if (auto it = loads_.find(model_id); it != loads_.end()) {
+      load = std::move(it->second);
+      loads_.erase(it);
+    }
+  }
+  if (load) {
+    load->cancelled = true;
+    if (load->thread.joinable()) {
+      load->thread.join();
+    }
   }
 }
 
@@ -649,25 +1066,28 @@ void LocalEngine::UnloadModel(std::shared_ptr<Json::Value> json_body,
     CTL_WRN("Model is empty");
   }
 
-  if (server_map_.find(model_id) != server_map_.end()) {
-    auto& s = server_map_[model_id];
+  std::lock_guard<std::mutex> lifecycle(lifecycle_mtx_);
+  CancelLoad(model_id);
+  if (auto s = servers_.Find(model_id)) {
 #if defined(_WIN32) || defined(_WIN64)
-    auto sent = cortex::process::KillProcess(s.process_info);
+    auto sent = cortex::process::KillProcess(s->process_info);
 #else
-    auto sent = (kill(s.process_info.pid, SIGTERM) != -1);
+    auto sent = (kill(s->process_info.pid, SIGTERM) != -1);
 #endif
     if (sent) {
       LOG_INFO << "SIGINT signal sent to child process";
       Json::Value response;
       response["status"] = "Model unloaded successfully with pid: " +
-                           std::to_string(s.process_info.pid);
+                           std::to_string(s->process_info.pid);
       Json::Value status;
       status["is_done"] = true;
       status["has_error"] = false;
       status["is_stream"] = false;
       status["status_code"] = 200;
       callback(std::move(status), std::move(response));
-      server_map_.erase(model_id);
+      servers_.Erase(model_id, s);
+      ReleaseEndpoint(*s);
+      executor_.RemoveModel(model_id);
     } else {
       LOG_ERROR << "Failed to send SIGINT signal to child process";
       Json::Value error;
@@ -697,7 +1117,18 @@ void LocalEngine::GetModelStatus(std::shared_ptr<Json::Value> json_body,
   if (model_id.empty()) {
     CTL_WRN("Model is empty");
   }
-  if (server_map_.find(model_id) != server_map_.end()) {
+  if (servers_.Find(model_id)) {
+    if (!IsModelReady(model_id)) {
+      Json::Value error;
+      error["error"] = "Model is still loading: " + model_id;
+      Json::Value status;
+      status["is_done"] = true;
+      status["has_error"] = true;
+      status["is_stream"] = false;
+      status["status_code"] = 503;
+      callback(std::move(status), std::move(error));
+      return;
+    }
     Json::Value response;
     response["status"] = "Model is loaded";
     Json::Value status;
@@ -723,21 +1154,47 @@ void LocalEngine::GetModels(std::shared_ptr<Json::Value> json_body,
   Json::Value json_resp;
   Json::Value model_array(Json::arrayValue);
   {
-    for (const auto& [m, s] : server_map_) {
+    for (const auto& [m, s] : *servers_.Snapshot()) {
       Json::Value val;
       val["id"] = m;
       val["engine"] = kLlamaEngine;
-      val["start_time"] = s.start_time;
+      val["start_time"] = s->start_time;
       val["model_size"] = 0u;
       val["vram"] = 0u;
       val["ram"] = 0u;
       val["object"] = "model";
+      auto stats = executor_.GetStats(m);
+      val["n_parallel"] = stats.limit;
+      val["active_requests"] = stats.active;
+      val["queue_depth"] = static_cast<Json::UInt64>(stats.queue_depth);
+      val["avg_queue_wait_ms"] = stats.avg_wait_ms;
+      val["max_queue_wait_ms"] = stats.max_wait_ms;
+      {
+        std::lock_guard<std::mutex> l(loads_mtx_);
+        if (auto it = loads_.find(m); it != loads_.end()) {
+          val["ready"] = it->second->ready.load();
+          val["load_time_ms"] =
+              static_cast<Json::Int64>(it->second->load_time_ms.load());
+        }
+      }
       model_array.append(val);
     }
   }
 
   json_resp["object"] = "list";
   json_resp["data"] = model_array;
+  auto cache = embedding_cache_.GetStats();
+  json_resp["embedding_cache"]["hits"] = static_cast<Json::UInt64>(cache.hits);
+  json_resp["embedding_cache"]["disk_hits"] =
+      static_cast<Json::UInt64>(cache.disk_hits);
+  json_resp["embedding_cache"]["misses"] =
+      static_cast<Json::UInt64>(cache.misses);
+  json_resp["embedding_cache"]["evictions"] =
+      static_cast<Json::UInt64>(cache.evictions);
+  json_resp["embedding_cache"]["entries"] =
+      static_cast<Json::UInt64>(cache.entries);
+  json_resp["embedding_cache"]["disk_entries"] =
+      static_cast<Json::UInt64>(cache.disk_entries);
 
   Json::Value status;
   status["is_done"] = true;
@@ -751,7 +1208,8 @@ void LocalEngine::GetModels(std::shared_ptr<Json::Value> json_body,
 
 void LocalEngine::HandleOpenAiChatCompletion(
     std::shared_ptr<Json::Value> json_body, http_callback&& callback,
-    const std::string& model) {
+    std::shared_ptr<StreamSink> sink, const std::string& model,
+    const ServerAddress& s) {
   CTL_DBG("Hanle OpenAI chat completion");
   auto is_stream = (*json_body).get("stream", false).asBool();
   auto include_usage = [&json_body, is_stream]() -> bool {
@@ -770,125 +1228,52 @@ void LocalEngine::HandleOpenAiChatCompletion(
   auto n = [&json_body, is_stream]() -> int {
     if (is_stream)
       return 1;
-    return (*json_body).get("n", 1).asInt();
+    return std::max(1, (*json_body).get("n", 1).asInt());
   }();
 
-  auto& s = server_map_.at(model);
   // Format logit_bias
   if (json_body->isMember("logit_bias")) {
     auto logit_bias = ConvertLogitBiasToArray((*json_body)["logit_bias"]);
     (*json_body)["logit_bias"] = logit_bias;
   }
-  // llama.cpp server only supports n = 1
+  // llama.cpp server only supports n = 1, choices are requested separately
   (*json_body)["n"] = 1;
 
   auto url = url_parser::Url{
       /*.protocol*/ "http",
-      /*.host*/ s.host + ":" + std::to_string(s.port),
+      /*.host*/ s.Authority(),
       /*.pathParams*/ {"v1", "chat", "completions"},
       /*.queries*/ {},
   };
 
   if (is_stream) {
-    q_.RunInQueue([s, json_body, callback, model, url = std::move(url)] {
-      auto curl = curl_easy_init();
-      if (!curl) {
-        CTL_WRN("Failed to initialize CURL");
-        return;
-      }
-
-      curl_easy_setopt(curl, CURLOPT_URL, url.ToFullPath().c_str());
-      curl_easy_setopt(curl, CURLOPT_POST, 1L);
-      CTL_INF(url.ToFullPath());
-
-      struct curl_slist* headers = nullptr;
-      headers = curl_slist_append(headers, "Content-Type: application/json");
-      curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-      auto json_str = json_body->toStyledString();
-      curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_str.c_str());
-      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, json_str.length());
-      curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
-
-      StreamingCallback sc;
-      OaiInfo oi{model, false /*include_usage*/, true /*oai_endpoint*/,
-                 0 /*n_probs*/};
-      sc.callback = std::make_shared<http_callback>(callback);
-      sc.need_stop = true;
-      sc.oi = oi;
-
-      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-      curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sc);
-      auto res = curl_easy_perform(curl);
-
-      if (res != CURLE_OK) {
-        CTL_WRN("CURL request failed: " << curl_easy_strerror(res));
-
-        Json::Value status;
-        status["is_done"] = true;
-        status["has_error"] = true;
-        status["is_stream"] = true;
-        status["status_code"] = 500;
-
-        Json::Value error;
-        error["error"] = curl_easy_strerror(res);
-        callback(std::move(status), std::move(error));
-      }
-      curl_easy_cleanup(curl);
-      if (sc.need_stop) {
-        CTL_DBG("No stop message received, need to stop");
-        Json::Value status;
-        status["is_done"] = true;
-        status["has_error"] = false;
-        status["is_stream"] = true;
-        status["status_code"] = 200;
-        (*sc.callback)(std::move(status), Json::Value());
-      }
-    });
-
+    ProxyStream(model, url.ToFullPath(), s.unix_socket,
+                json_body->toStyledString(),
+                std::move(callback), std::move(sink),
+                true /*oai_endpoint*/, 0 /*n_probs*/);
   } else {
-    Json::Value result;
     // multiple choices
-    for (int i = 0; i < n; i++) {
-      auto response = curl_utils::SimplePostJson(url.ToFullPath(),
-                                                 json_body->toStyledString());
-
-      if (response.has_value()) {
-        auto r = response.value();
-        if (i == 0) {
-          result = r;
-        } else {
-          r["choices"][0]["index"] = i;
-          result["choices"].append(r["choices"][0]);
-          result["usage"]["completion_tokens"] =
-              result["usage"]["completion_tokens"].asInt() +
-              r["usage"]["completion_tokens"].asInt();
-          result["usage"]["prompt_tokens"] =
-              result["usage"]["prompt_tokens"].asInt() +
-              r["usage"]["prompt_tokens"].asInt();
-          result["usage"]["total_tokens"] =
-              result["usage"]["total_tokens"].asInt() +
-              r["usage"]["total_tokens"].asInt();
-        }
-
-        if (i == n - 1) {
+    FanOutCompletion(
+        model, url.ToFullPath(), s.unix_socket, *json_body, n,
+        [callback = std::move(callback)](CompletionFanOut::Result&& res) {
+          if (res.has_error()) {
+            CTL_WRN("Error: " << res.error().body.toStyledString());
+            Json::Value status;
+            status["is_done"] = true;
+            status["has_error"] = true;
+            status["is_stream"] = false;
+            status["status_code"] = res.error().status_code;
+            callback(std::move(status), std::move(res.error().body));
+            return;
+          }
           Json::Value status;
           status["is_done"] = true;
           status["has_error"] = false;
           status["is_stream"] = false;
           status["status_code"] = 200;
-          callback(std::move(status), std::move(result));
-        }
-      } else {
-        CTL_WRN("Error: " << response.error());
-        Json::Value status;
-        status["is_done"] = true;
-        status["has_error"] = true;
-        status["is_stream"] = false;
-        status["status_code"] = 500;
-        callback(std::move(status), std::move(response.value()));
-        break;
-      }
-    }
+          callback(std::move(status),
+                   MergeChatCompletions(std::move(res.value())));
+        });
   }
 }
 
@@ -896,7 +1281,8 @@ void LocalEngine::HandleOpenAiChatCompletion(
 // llama-server upstream is fully OpenAI API Compatible
 void LocalEngine::HandleNonOpenAiChatCompletion(
     std::shared_ptr<Json::Value> json_body, http_callback&& callback,
-    const std::string& model) {
+    std::shared_ptr<StreamSink> sink, const std::string& model,
+    const ServerAddress& s) {
   CTL_DBG("Hanle NonOpenAI chat completion");
   auto is_stream = (*json_body).get("stream", false).asBool();
   auto include_usage = [&json_body, is_stream]() -> bool {
@@ -915,10 +1301,9 @@ void LocalEngine::HandleNonOpenAiChatCompletion(
   auto n = [&json_body, is_stream]() -> int {
     if (is_stream)
       return 1;
-    return (*json_body).get("n", 1).asInt();
+    return std::max(1, (*json_body).get("n", 1).asInt());
   }();
 
-  auto& s = server_map_.at(model);
 
   // Format logit_bias
   if (json_body->isMember("logit_bias")) {
@@ -967,43 +1352,126 @@ void LocalEngine::HandleNonOpenAiChatCompletion(
 
   auto url = url_parser::Url{
       /*.protocol*/ "http",
-      /*.host*/ s.host + ":" + std::to_string(s.port),
+      /*.host*/ s.Authority(),
       /*.pathParams*/ {"v1", "completions"},
       /*.queries*/ {},
   };
 
   if (is_stream) {
-    q_.RunInQueue([s, json_body, callback, n_probs, model,
-                   url = std::move(url)] {
-      auto curl = curl_easy_init();
-      if (!curl) {
-        CTL_WRN("Failed to initialize CURL");
-        return;
-      }
-
-      curl_easy_setopt(curl, CURLOPT_URL, url.ToFullPath().c_str());
-      curl_easy_setopt(curl, CURLOPT_POST, 1L);
-
-      struct curl_slist* headers = nullptr;
-      headers = curl_slist_append(headers, "Content-Type: application/json");
-      curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-      auto json_str = json_body->toStyledString();
-      curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_str.c_str());
-      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, json_str.length());
-      curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
-
-      StreamingCallback sc;
-      OaiInfo oi{model, false /*include_usage*/, false /*oai_endpoint*/,
-                 n_probs};
-      sc.callback = std::make_shared<http_callback>(callback);
-      sc.need_stop = true;
-      sc.oi = oi;
-
-      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-      curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sc);
-      auto res = curl_easy_perform(curl);
+    ProxyStream(model, url.ToFullPath(), s.unix_socket,
+                json_body->toStyledString(),
+                std::move(callback), std::move(sink),
+                false /*oai_endpoint*/, n_probs);
+  } else {
+    // multiple choices
+    FanOutCompletion(
+        model, url.ToFullPath(), s.unix_socket, *json_body, n,
+        [callback = std::move(callback), model,
+         n_probs](CompletionFanOut::Result&& res) {
+          if (res.has_error()) {
+            CTL_WRN("Error: " << res.error().body.toStyledString());
+            Json::Value status;
+            status["is_done"] = true;
+            status["has_error"] = true;
+            status["is_stream"] = false;
+            status["status_code"] = res.error().status_code;
+            callback(std::move(status), std::move(res.error().body));
+            return;
+          }
+          auto& responses = res.value();
+          for (auto& r : responses) {
+            Json::Value logprobs;
+            std::string to_send = r["content"].asString();
+            string_utils::LTrim(to_send);
+            if (n_probs > 0) {
+              logprobs = r["completion_probabilities"];
+            }
+            r = CreateFullReturnJson(
+                GenerateRandomString(20), model, to_send, "_",
+                r["tokens_evaluated"].asInt(), r["tokens_predicted"].asInt(),
+                Json::Value("stop"), logprobs);
+          }
+          Json::Value status;
+          status["is_done"] = true;
+          status["has_error"] = false;
+          status["is_stream"] = false;
+          status["status_code"] = 200;
+          callback(std::move(status),
+                   MergeChatCompletions(std::move(responses)));
+        });
+  }
+}
 
-      if (res != CURLE_OK) {
+void LocalEngine::ProxyStream(const std::string& model, std::string url,
+                              std::string unix_socket, std::string body,
+                              http_callback&& callback,
+                              std::shared_ptr<StreamSink> sink,
+                              bool oai_endpoint, int n_probs) {
+  // The sink's callbacks may run after the transfer, and the loop, are gone.
+  // Cancellation is registered before the request is queued, so that the
+  // consumer knows right away that the request stops when it goes away.
+  auto handle = std::make_shared<curl_utils::TransferHandle>();
+  if (sink) {
+    sink->OnClosed([handle] { handle->Cancel(); });
+  }
+  executor_.SubmitAsync(model, [this, model, url = std::move(url),
+                                unix_socket = std::move(unix_socket),
+                                body = std::move(body),
+                                callback = std::move(callback),
+                                sink = std::move(sink), oai_endpoint, n_probs,
+                                handle](InferenceExecutor::Release&& release) {
+    CTL_INF(url);
+    auto& loop = GetStreamLoop(model);
+    auto sc = std::make_shared<StreamingCallback>();
+    sc->callback = std::make_shared<http_callback>(callback);
+    sc->sink = sink;
+    sc->transfer_id = loop.ReserveId();
+    sc->oi = OaiInfo{model, false /*include_usage*/, oai_endpoint, n_probs};
+
+    curl_utils::CurlMultiLoop::Request req;
+    req.id = sc->transfer_id;
+    req.url = url;
+    req.body = body;
+    req.headers = {"Content-Type: application/json"};
+    req.unix_socket_path = unix_socket;
+    req.on_data = [sc, handle](const char* data, size_t size) {
+      using DataAction = curl_utils::CurlMultiLoop::DataAction;
+      if (sc->throttled) {
+        // Leave the data in llama-server's socket until the client catches up
+        return DataAction::kPause;
+      }
+      bool writable = WriteStreamData(sc.get(), data, size);
+      if (!sc->got_event &&
+          sc->error_body.size() + size <= kMaxStreamErrorBodyBytes) {
+        sc->error_body.append(data, size);
+      } else if (!sc->error_body.empty()) {
+        std::string().swap(sc->error_body);
+      }
+      if (!writable) {
+        sc->throttled = true;
+        std::weak_ptr<StreamingCallback> weak_sc = sc;
+        sc->sink->OnWritable([weak_sc, handle] {
+          if (auto sc = weak_sc.lock()) {
+            sc->throttled = false;
+            handle->Resume();
+          }
+        });
+      }
+      return DataAction::kContinue;
+    };
+    auto request_id = TrackRequest(model, loop, sc->transfer_id);
+    req.on_done = [this, model, request_id, sc, handle,
+                   release = std::move(release)](CURLcode res,
+                                                 long http_status) {
+      handle->Disarm();
+      UntrackRequest(model, request_id);
+      if (res == CURLE_ABORTED_BY_CALLBACK) {
+        // Cancelled, end the stream if the client is still there
+        CTL_INF("Request to llama-server cancelled");
+        if (!sc->done) {
+          EmitFrames(sc.get(), std::string(), true);
+        }
+      } else if (res != CURLE_OK) {
         CTL_WRN("CURL request failed: " << curl_easy_strerror(res));
 
         Json::Value status;
@@ -1014,74 +1482,156 @@ void LocalEngine::HandleNonOpenAiChatCompletion(
 
         Json::Value error;
         error["error"] = curl_easy_strerror(res);
-        callback(std::move(status), std::move(error));
-      }
-      curl_easy_cleanup(curl);
-      if (sc.need_stop) {
-        CTL_DBG("No stop message received, need to stop");
+        (*sc->callback)(std::move(status), std::move(error));
+      } else if (http_status != 200 && !sc->got_event) {
+        // llama-server rejected the request, its error is forwarded as is
+        CTL_WRN("llama-server answered " << http_status << ": "
+                                         << sc->error_body);
         Json::Value status;
         status["is_done"] = true;
-        status["has_error"] = false;
+        status["has_error"] = true;
         status["is_stream"] = true;
-        status["status_code"] = 200;
-        (*sc.callback)(std::move(status), Json::Value());
+        status["status_code"] = static_cast<int>(http_status);
+
+        auto error = json_helper::ParseJsonString(sc->error_body);
+        if (!error.isObject()) {
+          error = Json::Value(Json::objectValue);
+          error["message"] = sc->error_body;
+        }
+        sc->done = true;
+        (*sc->callback)(std::move(status), std::move(error));
+      } else if (!sc->done) {
+        CTL_DBG("No stop message received, need to stop");
+        EmitFrames(sc.get(), std::string(), true);
       }
-    });
+      release();
+    };
+    auto transfer_id = sc->transfer_id;
+    loop.Add(std::move(req));
+    handle->Bind(loop, transfer_id);
+  });
+}
 
-  } else {
+void LocalEngine::FanOutCompletion(const std::string& model,
+                                   const std::string& url,
+                                   const std::string& unix_socket,
+                                   const Json::Value& body, int n,
+                                   CompletionFanOut::OnDone&& on_done) {
+  auto fan_out = std::make_shared<CompletionFanOut>(n, std::move(on_done));
+  for (int i = 0; i < n; i++) {
+    PostJson(model, url, unix_socket,
+             MakeChoiceRequest(body, i).toStyledString(),
+             [fan_out, i](UpstreamResult&& res) {
+               if (res.has_error()) {
+                 fan_out->Fail(res.error().status_code,
+                               std::move(res.error().body));
+               } else {
+                 fan_out->Complete(i, std::move(res.value()));
+               }
+             });
+  }
+}
 
-    Json::Value result;
-    int prompt_tokens = 0;
-    int predicted_tokens = 0;
-    // multiple choices
-    for (int i = 0; i < n; i++) {
-      auto response = curl_utils::SimplePostJson(url.ToFullPath(),
-                                                 json_body->toStyledString());
-      if (response.has_value()) {
-        auto r = response.value();
-        Json::Value logprobs;
-        prompt_tokens += r["tokens_evaluated"].asInt();
-        predicted_tokens += r["tokens_predicted"].asInt();
-        std::string to_send = r["content"].asString();
-        string_utils::LTrim(to_send);
-        if (n_probs > 0) {
-          logprobs = r["completion_probabilities"];
-        }
-        if (i == 0) {
-          result = CreateFullReturnJson(
-              GenerateRandomString(20), model, to_send, "_", prompt_tokens,
-              predicted_tokens, Json::Value("stop"), logprobs);
-        } else {
-          auto choice = CreateFullReturnJson(
-              GenerateRandomString(20), model, to_send, "_", prompt_tokens,
-              predicted_tokens, Json::Value("stop"), logprobs)["choices"][0];
-          choice["index"] = i;
-          result["choices"].append(choice);
-          result["usage"]["completion_tokens"] = predicted_tokens;
-          result["usage"]["prompt_tokens"] = prompt_tokens;
-          result["usage"]["total_tokens"] = predicted_tokens + prompt_tokens;
-        }
+void LocalEngine::PostJson(const std::string& model, const std::string& url,
+                           const std::string& unix_socket, std::string body,
+                           std::function<void(UpstreamResult&&)>&& on_done) {
+  executor_.SubmitAsync(model, [this, model, url, unix_socket,
+                                body = std::move(body),
+                                on_done = std::move(on_done)](
+                                   InferenceExecutor::Release&& release) {
+    auto& loop = GetStreamLoop(model);
+    auto response = std::make_shared<std::string>();
+
+    curl_utils::CurlMultiLoop::Request req;
+    req.id = loop.ReserveId();
+    req.url = url;
+    req.body = body;
+    req.headers = {"Content-Type: application/json"};
+    req.unix_socket_path = unix_socket;
+    req.on_data = [response](const char* data, size_t size) {
+      response->append(data, size);
+      return curl_utils::CurlMultiLoop::DataAction::kContinue;
+    };
+    auto request_id = TrackRequest(model, loop, req.id);
+    req.on_done = [this, model, request_id, response, on_done,
+                   release = std::move(release)](CURLcode res,
+                                                 long http_status) {
+      UntrackRequest(model, request_id);
+      release();
+      if (res != CURLE_OK) {
+        CTL_WRN("CURL request failed: " << curl_easy_strerror(res));
+        Json::Value error;
+        error["error"] = curl_easy_strerror(res);
+        on_done(cpp::fail(UpstreamError{500, std::move(error), true}));
+        return;
+      }
+      Json::Value root;
+      Json::Reader reader;
+      if (!reader.parse(*response, root)) {
+        Json::Value error;
+        error["error"] = "Failed to parse response from llama-server";
+        on_done(cpp::fail(UpstreamError{500, std::move(error)}));
+        return;
+      }
+      if (http_status != 200) {
+        on_done(cpp::fail(
+            UpstreamError{static_cast<int>(http_status), std::move(root)}));
+        return;
+      }
+      on_done(std::move(root));
+    };
+    loop.Add(std::move(req));
+  });
+}
 
-        if (i == n - 1) {
-          Json::Value status;
-          status["is_done"] = true;
-          status["has_error"] = false;
-          status["is_stream"] = false;
-          status["status_code"] = 200;
-          callback(std::move(status), std::move(result));
-        }
-      } else {
-        CTL_WRN("Error: " << response.error());
-        Json::Value status;
-        status["is_done"] = true;
-        status["has_error"] = true;
-        status["is_stream"] = false;
-        status["status_code"] = 500;
-        callback(std::move(status), std::move(response.value()));
-        break;
+bool LocalEngine::IsModelReady(const std::string& model_id) const {
+  std::lock_guard<std::mutex> l(loads_mtx_);
+  auto it = loads_.find(model_id);
+  return it != loads_.end() && it->second->ready;
+}
+
+void LocalEngine::StopInferencing(const std::string& model_id) {
+  std::vector<std::pair<curl_utils::CurlMultiLoop*, uint64_t>> transfers;
+  {
+    std::lock_guard<std::mutex> l(inflight_mtx_);
+    if (auto it = inflight_.find(model_id); it != inflight_.end()) {
+      for (auto const& [_, t] : it->second) {
+        transfers.push_back(t);
       }
     }
   }
+  CTL_INF("Cancelling " << transfers.size() << " request(s) of " << model_id);
+  // Closing the connections makes llama-server free the slots
+  for (auto const& [loop, transfer_id] : transfers) {
+    loop->Cancel(transfer_id);
+  }
+}
+
+uint64_t LocalEngine::TrackRequest(const std::string& model,
+                                   curl_utils::CurlMultiLoop& loop,
+                                   uint64_t transfer_id) {
+  auto request_id = ++next_request_id_;
+  std::lock_guard<std::mutex> l(inflight_mtx_);
+  inflight_[model][request_id] = {&loop, transfer_id};
+  return request_id;
+}
+
+void LocalEngine::UntrackRequest(const std::string& model,
+                                 uint64_t request_id) {
+  std::lock_guard<std::mutex> l(inflight_mtx_);
+  if (auto it = inflight_.find(model); it != inflight_.end()) {
+    it->second.erase(request_id);
+    if (it->second.empty()) {
+      inflight_.erase(it);
+    }
+  }
+}
+
+curl_utils::CurlMultiLoop& LocalEngine::GetStreamLoop(
+    const std::string& model) {
+  // Pin each model to one loop so that its keep-alive connections are reused
+  auto i = std::hash<std::string>{}(model) % stream_loops_.size();
+  return *stream_loops_[i];
 }
 
 }  // namespace cortex::local
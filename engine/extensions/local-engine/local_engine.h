@@ -1,33 +1,80 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 #include "cortex-common/EngineI.h"
+#include "extensions/local-engine/completion_fan_out.h"
+#include "extensions/local-engine/embedding_batcher.h"
+#include "extensions/local-engine/embedding_cache.h"
+#include "extensions/local-engine/inference_executor.h"
+#include "extensions/local-engine/model_registry.h"
+#include "extensions/local-engine/port_allocator.h"
 #include "json/json.h"
 #include "services/engine_service.h"
+#include "utils/curl_multi_loop.h"
+#include "utils/port_utils.h"
 #include "utils/process/utils.h"
-#include "utils/task_queue.h"
+#include "utils/result.hpp"
 
 namespace cortex::local {
 using http_callback = std::function<void(Json::Value&&, Json::Value&&)>;
 
+// Upper bound of threads used to dispatch requests to llama-server. The
+// transfers themselves are driven by the stream loops and do not hold a thread.
+constexpr const size_t kDefaultMaxInferenceThreads = 4;
+// Number of curl_multi event loops proxying streams from llama-server
+constexpr const size_t kDefaultStreamLoops = 2;
+// Ports handed out to llama-server processes
+constexpr const int kServerPortFirst = 39400;
+constexpr const int kServerPortLast = 39999;
+
 struct ServerAddress {
   std::string host;
-  int port;
-  cortex::process::ProcessInfo process_info;
+  int port = 0;
+  // Set if llama-server listens on a unix socket instead of host:port
+  std::string unix_socket;
+  // Checking or killing the process updates it. Only the model's loader
+  // thread, and after it UnloadModel(), do that.
+  mutable cortex::process::ProcessInfo process_info;
   std::string pre_prompt;
   std::string user_prompt;
   std::string ai_prompt;
   std::string system_prompt;
   uint64_t start_time;
+  // Identifies the model file for the embedding cache
+  std::string model_fingerprint;
+
+  // Authority of llama-server's URLs. With a unix socket the host is only
+  // used for the Host header.
+  std::string Authority() const {
+    return unix_socket.empty() ? host + ":" + std::to_string(port)
+                               : "localhost";
+  }
 };
 
+using UpstreamError = CompletionFanOut::Error;
+using UpstreamResult = cpp::result<Json::Value, UpstreamError>;
+using ServerEntry = ModelRegistry<ServerAddress>::Entry;
+
 class LocalEngine : public EngineI {
  public:
-  LocalEngine(EngineService& engine_service, TaskQueue& q)
-      : engine_service_(engine_service), q_(q) {}
+  explicit LocalEngine(
+      EngineService& engine_service,
+      size_t max_inference_threads = kDefaultMaxInferenceThreads,
+      size_t stream_loops = kDefaultStreamLoops)
+      : engine_service_(engine_service), executor_(max_inference_threads) {
+    for (size_t i = 0; i < std::max<size_t>(1, stream_loops); i++) {
+      stream_loops_.push_back(std::make_unique<curl_utils::CurlMultiLoop>(
+          "local_stream_" + std::to_string(i)));
+    }
+  }
   ~LocalEngine();
 
   void Load(EngineLoadOption opts) final {}
@@ -36,6 +83,9 @@ class LocalEngine : public EngineI {
 
   void HandleChatCompletion(std::shared_ptr<Json::Value> json_body,
                             http_callback&& callback) final;
+  void HandleStreamingChatCompletion(std::shared_ptr<Json::Value> json_body,
+                                     http_callback&& callback,
+                                     std::shared_ptr<StreamSink> sink) final;
   void HandleEmbedding(std::shared_ptr<Json::Value> json_body,
                        http_callback&& callback) final;
   void LoadModel(std::shared_ptr<Json::Value> json_body,
@@ -54,22 +104,138 @@ class LocalEngine : public EngineI {
   }
   void SetLogLevel(trantor::Logger::LogLevel logLevel) final {}
 
-  // Stop inflight chat completion in stream mode
-  void StopInferencing(const std::string& model_id) final {}
+  // Cancels the model's requests in flight. A single streaming request is
+  // cancelled when its sink is closed.
+  void StopInferencing(const std::string& model_id) final;
 
  private:
+  // A llama-server process between spawn and readiness, kept afterwards for
+  // its load time
+  struct ModelLoad {
+    std::thread thread;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> ready{false};
+    std::atomic<int64_t> load_time_ms{0};
+  };
+
+  struct SpawnOptions {
+    std::vector<std::string> command;
+    std::string log_path;
+    bool unix_socket = false;
+  };
+
+  // Starts llama-server on a newly allocated endpoint of |s|
+  cpp::result<void, std::string> SpawnServer(ServerAddress& s,
+                                             const SpawnOptions& opts);
+
+  // Returns the port, or removes the socket file, of a stopped server
+  void ReleaseEndpoint(const ServerAddress& s);
+
+  // Runs on the load's thread: polls llama-server's health endpoint with
+  // exponential backoff until it is up, its process exits or the load is
+  // cancelled, and then answers the LoadModel() caller. A server that exits
+  // without ever answering is respawned on another endpoint.
+  void WaitForServerUp(std::shared_ptr<ModelLoad> load,
+                       const std::string& model_id, ServerEntry server,
+                       const SpawnOptions& opts, int n_parallel,
+                       http_callback&& callback);
+
+  // Stops waiting for the model's server, if that is still going on
+  void CancelLoad(const std::string& model_id);
+
+  bool IsModelReady(const std::string& model_id) const;
+
   void HandleOpenAiChatCompletion(std::shared_ptr<Json::Value> json_body,
                                   http_callback&& callback,
-                                  const std::string& model);
+                                  std::shared_ptr<StreamSink> sink,
+                                  const std::string& model,
+                                  const ServerAddress& s);
 
   void HandleNonOpenAiChatCompletion(std::shared_ptr<Json::Value> json_body,
                                      http_callback&& callback,
-                                     const std::string& model);
+                                     std::shared_ptr<StreamSink> sink,
+                                     const std::string& model,
+                                     const ServerAddress& s);
+
+  // Proxies a streaming request to llama-server through one of the stream
+  // loops, holding one of the model's slots until the transfer is done. The
+  // transfer is paused while |sink| is saturated.
+  void ProxyStream(const std::string& model, std::string url,
+                   std::string unix_socket, std::string body,
+                   http_callback&& callback,
+                   std::shared_ptr<StreamSink> sink, bool oai_endpoint,
+                   int n_probs);
+
+  // Requests the |n| choices of a non-streaming completion concurrently, one
+  // slot each, and hands the responses to |on_done| on a stream loop thread
+  void FanOutCompletion(const std::string& model, const std::string& url,
+                        const std::string& unix_socket,
+                        const Json::Value& body, int n,
+                        CompletionFanOut::OnDone&& on_done);
+
+  // Posts |body| to llama-server in one of the model's slots and hands the
+  // parsed response to |on_done| on a stream loop thread
+  void PostJson(const std::string& model, const std::string& url,
+                const std::string& unix_socket, std::string body,
+                std::function<void(UpstreamResult&&)>&& on_done);
+
+  // Answers |body| from the embedding cache if every input is cached and
+  // returns true. Otherwise leaves only the missing inputs in |body| and
+  // wraps |on_done| to cache their embeddings and merge in the cached ones.
+  bool ServeFromEmbeddingCache(const std::string& model, Json::Value& body,
+                               EmbeddingBatcher::OnDone& on_done);
+
+  // Returns |v| if it is a flat array of numbers
+  static std::optional<EmbeddingCache::Embedding> ToEmbedding(
+      const Json::Value& v);
+
+  // Sends an embeddings request, batched or not, to the model's server
+  void PostEmbeddings(const std::string& model, Json::Value&& body,
+                      EmbeddingBatcher::OnDone&& on_done);
+
+  curl_utils::CurlMultiLoop& GetStreamLoop(const std::string& model);
+
+  // Registers a transfer to llama-server for StopInferencing() until
+  // UntrackRequest() is called from its done callback
+  uint64_t TrackRequest(const std::string& model,
+                        curl_utils::CurlMultiLoop& loop, uint64_t transfer_id);
+  void UntrackRequest(const std::string& model, uint64_t request_id);
 
  private:
-  std::unordered_map<std::string, ServerAddress> server_map_;
+  // Looked up without locking by every request. Entries are immutable, a
+  // respawned server replaces its entry.
+  ModelRegistry<ServerAddress> servers_;
+  // Serializes LoadModel() and UnloadModel()
+  std::mutex lifecycle_mtx_;
   EngineService& engine_service_;
-  TaskQueue& q_;
+  // Must outlive the stream loops, aborted transfers release their slots
+  InferenceExecutor executor_;
+  // Transfers in flight by model and request id. Must outlive the stream
+  // loops, which finish their transfers on shutdown.
+  std::mutex inflight_mtx_;
+  std::unordered_map<
+      std::string,
+      std::unordered_map<uint64_t,
+                         std::pair<curl_utils::CurlMultiLoop*, uint64_t>>>
+      inflight_;
+  std::atomic<uint64_t> next_request_id_{0};
+  // Must outlive the stream loops, which finish their transfers on shutdown
+  EmbeddingCache embedding_cache_;
+  // Must outlive the stream loops too. It is stopped, and the executor with
+  // it, before they are torn down, so that the batches they abort are not
+  // sent again.
+  EmbeddingBatcher embedding_batcher_{
+      [this](const std::string& model, Json::Value&& body,
+             EmbeddingBatcher::OnDone&& on_done) {
+        PostEmbeddings(model, std::move(body), std::move(on_done));
+      }};
+  std::vector<std::unique_ptr<curl_utils::CurlMultiLoop>> stream_loops_;
+  mutable std::mutex loads_mtx_;
+  std::unordered_map<std::string, std::shared_ptr<ModelLoad>> loads_;
+  PortAllocator port_allocator_{
+      kServerPortFirst, kServerPortLast,
+      [](int port) { return port_utils::IsPortAvailable("127.0.0.1", port); }};
+  std::atomic<uint64_t> socket_seq_{0};
 };
 
 }  // namespace cortex::local
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace cortex::local {
+
+// Read-mostly map from model id to an immutable entry. Readers load the
+// current map with one atomic shared_ptr load and never wait for writers.
+// Writers copy the map, change the copy and publish it, so a reader keeps a
+// consistent view, and the entries it holds stay valid, however long it
+// takes.
+//
+// Entries are replaced rather than modified. The conditional writes take the
+// entry the caller saw, so that a stale writer cannot clobber a newer one.
+template <typename T>
+class ModelRegistry {
+ public:
+  using Entry = std::shared_ptr<const T>;
+  using Map = std::unordered_map<std::string, Entry>;
+
+  ModelRegistry() : map_(std::make_shared<const Map>()) {}
+
+  ModelRegistry(const ModelRegistry&) = delete;
+  ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+  // Returns the model's entry or nullptr
+  Entry Find(const std::string& model) const {
+    auto map = Snapshot();
+    auto it = map->find(model);
+    return it == map->end() ? nullptr : it->second;
+  }
+
+  std::shared_ptr<const Map> Snapshot() const {
+    return std::atomic_load(&map_);
+  }
+
+  // Adds |entry| unless the model has one already
+  bool Insert(const std::string& model, Entry entry) {
+    return Update([&](Map& m) {
+      return m.emplace(model, std::move(entry)).second;
+    });
+  }
+
+  // Replaces the model's entry if it is still |expected|
+  bool Replace(const std::string& model, const Entry& expected, Entry entry) {
+    return Update([&](Map& m) {
+      auto it = m.find(model);
+      if (it == m.end() || it->second != expected) {
+        return false;
+      }
+      it->second = std::move(entry);
+      return true;
+    });
+  }
+
+  // Removes the model's entry if it is still |expected|
+  bool Erase(const std::string& model, const Entry& expected) {
+    return Update([&](Map& m) {
+      auto it = m.find(model);
+      if (it == m.end() || it->second != expected) {
+        return false;
+      }
+      m.erase(it);
+      return true;
+    });
+  }
+
+  // Removes all entries and returns them
+  Map Clear() {
+    std::lock_guard<std::mutex> l(write_mtx_);
+    auto old = std::atomic_load(&map_);
+    std::atomic_store(&map_, std::make_shared<const Map>());
+    return *old;
+  }
+
+ private:
+  // Applies |f| to a copy of the map and publishes the copy if |f| returns
+  // true
+  template <typename F>
+  bool Update(F&& f) {
+    std::lock_guard<std::mutex> l(write_mtx_);
+    auto copy = std::make_shared<Map>(*std::atomic_load(&map_));
+    if (!f(*copy)) {
+      return false;
+    }
+    std::atomic_store(&map_, std::shared_ptr<const Map>(std::move(copy)));
+    return true;
+  }
+
+  // Serializes writers only
+  std::mutex write_mtx_;
+  // Only accessed with std::atomic_load() and std::atomic_store()
+  std::shared_ptr<const Map> map_;
+};
+
+}  // namespace cortex::local
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+
+namespace cortex::local {
+
+// Hands out ports for llama-server processes. The lowest port of the range
+// that is neither handed out already nor bound by another process is picked,
+// so allocation is deterministic and the port is known to be free right
+// before it is passed to the child.
+//
+// A process may still take the port between the probe and the child's bind.
+// The caller detects that from the child exiting and acquires another port.
+class PortAllocator {
+ public:
+  using Probe = std::function<bool(int port)>;
+
+  PortAllocator(int first, int last, Probe is_available)
+      : first_(first), last_(last), is_available_(std::move(is_available)) {}
+
+  std::optional<int> Acquire() {
+    std::lock_guard<std::mutex> l(mtx_);
+    for (int port = first_; port <= last_; port++) {
+      if (in_use_.count(port) > 0) {
+        continue;
+      }
+      if (is_available_(port)) {
+        in_use_.insert(port);
+        return port;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void Release(int port) {
+    std::lock_guard<std::mutex> l(mtx_);
+    in_use_.erase(port);
+  }
+
+  size_t InUse() const {
+    std::lock_guard<std::mutex> l(mtx_);
+    return in_use_.size();
+  }
+
+ private:
+  const int first_;
+  const int last_;
+  Probe is_available_;
+  mutable std::mutex mtx_;
+  std::unordered_set<int> in_use_;
+};
+
+}  // namespace cortex::local
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace remote_engine {
+
+// Token bucket allowing |requests_per_minute| requests per minute, in bursts
+// of up to the same amount. Thread safe.
+class RateLimiter {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit RateLimiter(int requests_per_minute,
+                       Clock::time_point now = Clock::now())
+      : capacity_(std::max(1, requests_per_minute)),
+        tokens_(capacity_),
+        last_refill_(now) {}
+
+  // Takes one token, returns false if there is none left
+  bool TryAcquire(Clock::time_point now = Clock::now()) {
+    std::lock_guard<std::mutex> l(mtx_);
+    Refill(now);
+    if (tokens_ < 1.0) {
+      return false;
+    }
+    tokens_ -= 1.0;
+    return true;
+  }
+
+  // Time until the next token is available
+  std::chrono::milliseconds RetryAfter(Clock::time_point now = Clock::now()) {
+    std::lock_guard<std::mutex> l(mtx_);
+    Refill(now);
+    if (tokens_ >= 1.0) {
+      return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds(
+        static_cast<long long>((1.0 - tokens_) * 60000.0 / capacity_) + 1);
+  }
+
+  int GetRequestsPerMinute() const { return capacity_; }
+
+ private:
+  void Refill(Clock::time_point now) {
+    if (now <= last_refill_) {
+      return;
+    }
+    std::chrono::duration<double> elapsed = now - last_refill_;
+    tokens_ = std::min<double>(capacity_,
+                               tokens_ + elapsed.count() * capacity_ / 60.0);
+    last_refill_ = now;
+  }
+
+  std::mutex mtx_;
+  const int capacity_;
+  double tokens_;
+  Clock::time_point last_refill_;
+};
+
+}  // namespace remote_engine
@@ -1,4 +1,5 @@
 #include "remote_engine.h"
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <regex>
@@ -12,6 +13,7 @@ namespace {
 constexpr const int k200OK = 200;
 constexpr const int k400BadRequest = 400;
 [[maybe_unused]] constexpr const int k409Conflict = 409;
+constexpr const int k429TooManyRequests = 429;
 [[maybe_unused]] constexpr const int k500InternalServerError = 500;
 [[maybe_unused]] constexpr const int kFileLoggerOption = 0;
 
@@ -111,7 +113,7 @@ CurlResponse RemoteEngine::MakeStreamingChatCompletionRequest(
     const ModelConfig& config, const std::string& body,
     const std::function<void(Json::Value&&, Json::Value&&)>& callback) {
 
-  CURL* curl = curl_easy_init();
+  CURL* curl = curl_utils::ThreadLocalHandle();
   CurlResponse response;
 
   if (!curl) {
@@ -120,11 +122,19 @@ CurlResponse RemoteEngine::MakeStreamingChatCompletionRequest(
     return response;
   }
 
-  std::string full_url = chat_url_;
+  std::string full_url;
+  std::vector<std::string> header;
+  std::string stream_template;
+  {
+    std::shared_lock l(settings_mtx_);
+    full_url = chat_url_;
+    header = header_;
+    stream_template = chat_res_template_;
+  }
   CTL_DBG("full_url: " << full_url);
 
   struct curl_slist* headers = nullptr;
-  for (auto const& h : header_) {
+  for (auto const& h : header) {
     headers = curl_slist_append(headers, h.c_str());
   }
 
@@ -133,8 +143,6 @@ CurlResponse RemoteEngine::MakeStreamingChatCompletionRequest(
   headers = curl_slist_append(headers, "Cache-Control: no-cache");
   headers = curl_slist_append(headers, "Connection: keep-alive");
 
-  std::string stream_template = chat_res_template_;
-
   StreamContext context{
       std::make_shared<std::function<void(Json::Value&&, Json::Value&&)>>(
           callback),
@@ -155,6 +163,7 @@ CurlResponse RemoteEngine::MakeStreamingChatCompletionRequest(
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamWriteCallback);
   curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
   curl_easy_setopt(curl, CURLOPT_TRANSFER_ENCODING, 1L);
+  curl_share_.Attach(curl);
 
   CURLcode res = curl_easy_perform(curl);
 
@@ -174,7 +183,6 @@ CurlResponse RemoteEngine::MakeStreamingChatCompletionRequest(
   }
 
   curl_slist_free_all(headers);
-  curl_easy_cleanup(curl);
   if (context.need_stop) {
     CTL_DBG("No stop message received, need to stop");
     Json::Value status;
@@ -221,8 +229,10 @@ static size_t WriteCallback(char* ptr, size_t size, size_t nmemb,
   return size * nmemb;
 }
 
-RemoteEngine::RemoteEngine(const std::string& engine_name)
-    : engine_name_(engine_name), q_(1 /*n_parallel*/, engine_name) {
+RemoteEngine::RemoteEngine(const std::string& engine_name,
+                           int max_concurrent_requests)
+    : engine_name_(engine_name),
+      q_(std::max(1, max_concurrent_requests), engine_name) {
   curl_global_init(CURL_GLOBAL_ALL);
 }
 
@@ -286,7 +296,7 @@ CurlResponse RemoteEngine::MakeChatCompletionRequest(
     const ModelConfig& config, const std::string& body,
     const std::string& method) {
 	(void) config;
-  CURL* curl = curl_easy_init();
+  CURL* curl = curl_utils::ThreadLocalHandle();
   CurlResponse response;
 
   if (!curl) {
@@ -294,11 +304,17 @@ CurlResponse RemoteEngine::MakeChatCompletionRequest(
     response.error_message = "Failed to initialize CURL";
     return response;
   }
-  std::string full_url = chat_url_;
+  std::string full_url;
+  std::vector<std::string> header;
+  {
+    std::shared_lock l(settings_mtx_);
+    full_url = chat_url_;
+    header = header_;
+  }
   CTL_DBG("full_url: " << full_url);
 
   struct curl_slist* headers = nullptr;
-  for (auto const& h : header_) {
+  for (auto const& h : header) {
     headers = curl_slist_append(headers, h.c_str());
   }
 
@@ -314,6 +330,7 @@ CurlResponse RemoteEngine::MakeChatCompletionRequest(
   std::string response_string;
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
   curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
+  curl_share_.Attach(curl);
 
   CURLcode res = curl_easy_perform(curl);
   if (res != CURLE_OK) {
@@ -324,7 +341,6 @@ CurlResponse RemoteEngine::MakeChatCompletionRequest(
   }
 
   curl_slist_free_all(headers);
-  curl_easy_cleanup(curl);
   return response;
 }
 
@@ -339,11 +355,21 @@ bool RemoteEngine::LoadModelConfig(const std::string& model,
     // model_config.url = ;
     // Optional fields
     if (auto s = config["header_template"]; s && !s.as<std::string>().empty()) {
+      std::unique_lock l(settings_mtx_);
       header_ = ReplaceHeaderPlaceholders(s.as<std::string>(), body);
       for (auto const& h : header_) {
         CTL_DBG("header: " << h);
       }
     }
+    if (body["inference_params"].isObject()) {
+      if (auto rpm =
+              body["inference_params"].get("requests_per_minute", 0).asInt();
+          rpm > 0) {
+        model_config.rate_limiter = std::make_shared<RateLimiter>(rpm);
+        CTL_INF("Rate limit for " << model << ": " << rpm
+                                  << " requests per minute");
+      }
+    }
 
     model_config.is_loaded = true;
 
@@ -415,6 +441,7 @@ void RemoteEngine::LoadModel(
   const std::string& model = (*json_body)["model"].asString();
   const std::string& model_path = (*json_body)["model_path"].asString();
 
+  std::unique_lock settings_lock(settings_mtx_);
   metadata_ = (*json_body)["metadata"];
   if (!metadata_["transform_req"].isNull() &&
       !metadata_["transform_req"]["chat_completions"].isNull() &&
@@ -451,6 +478,20 @@ void RemoteEngine::LoadModel(
       CTL_DBG("header: " << h);
     }
   }
+  std::vector<std::string> templates{chat_req_template_, chat_res_template_};
+  settings_lock.unlock();
+
+  // Parse the transform templates once here rather than on the first request
+  for (const auto& t : templates) {
+    if (t.empty()) {
+      continue;
+    }
+    try {
+      renderer_.Compile(t);
+    } catch (const std::exception& e) {
+      CTL_WRN("Failed to parse transform template: " << e.what());
+    }
+  }
 
   if (!LoadModelConfig(model, model_path, *json_body)) {
     Json::Value error;
@@ -549,9 +590,12 @@ void RemoteEngine::HandleChatCompletion(
 
     // Get template string with error check
     std::string template_str;
-    if (!chat_req_template_.empty()) {
-      CTL_DBG("Use engine transform request template: " << chat_req_template_);
+    {
+      std::shared_lock l(settings_mtx_);
       template_str = chat_req_template_;
+    }
+    if (!template_str.empty()) {
+      CTL_DBG("Use engine transform request template: " << template_str);
     } else {
       CTL_WRN("Required transform request template");
     }
@@ -570,94 +614,120 @@ void RemoteEngine::HandleChatCompletion(
     result = (*json_body).toStyledString();
   }
 
-  if (is_stream) {
-    q_.runTaskInQueue([this, model_config, result, cb = std::move(callback)] {
-      MakeStreamingChatCompletionRequest(*model_config, result, cb);
-    });
-  } else {
-
-    auto response = MakeChatCompletionRequest(*model_config, result);
+  if (model_config->rate_limiter &&
+      !model_config->rate_limiter->TryAcquire()) {
+    auto retry_after = model_config->rate_limiter->RetryAfter();
+    Json::Value status;
+    status["is_done"] = true;
+    status["has_error"] = true;
+    status["is_stream"] = false;
+    status["status_code"] = k429TooManyRequests;
+    Json::Value error;
+    error["error"] = "Rate limit exceeded for model " + model +
+                     ", retry after " + std::to_string(retry_after.count()) +
+                     " ms";
+    callback(std::move(status), std::move(error));
+    return;
+  }
 
-    if (response.error) {
-      Json::Value status;
-      status["is_done"] = true;
-      status["has_error"] = true;
-      status["is_stream"] = false;
-      status["status_code"] = k400BadRequest;
-      Json::Value error;
-      error["error"] = response.error_message;
-      callback(std::move(status), std::move(error));
-      return;
+  // Both kinds of requests block on the upstream server, so they run on the
+  // engine's workers, at most max_concurrent_requests at a time
+  q_.runTaskInQueue([this, config = *model_config, result, is_stream,
+                     cb = std::move(callback)] {
+    if (is_stream) {
+      MakeStreamingChatCompletionRequest(config, result, cb);
+    } else {
+      MakeNonStreamingChatCompletionRequest(config, result, cb);
     }
+  });
+}
 
-    Json::Value response_json;
-    Json::Reader reader;
-    if (!reader.parse(response.body, response_json)) {
-      Json::Value status;
-      status["is_done"] = true;
-      status["has_error"] = true;
-      status["is_stream"] = false;
-      status["status_code"] = k500InternalServerError;
-      Json::Value error;
-      error["error"] = "Failed to parse response";
-      LOG_WARN << "Failed to parse response: " << response.body;
-      callback(std::move(status), std::move(error));
-      return;
+void RemoteEngine::MakeNonStreamingChatCompletionRequest(
+    const ModelConfig& config, const std::string& body,
+    const std::function<void(Json::Value&&, Json::Value&&)>& callback) {
+  auto response = MakeChatCompletionRequest(config, body);
+
+  if (response.error) {
+    Json::Value status;
+    status["is_done"] = true;
+    status["has_error"] = true;
+    status["is_stream"] = false;
+    status["status_code"] = k400BadRequest;
+    Json::Value error;
+    error["error"] = response.error_message;
+    callback(std::move(status), std::move(error));
+    return;
+  }
+
+  Json::Value response_json;
+  Json::Reader reader;
+  if (!reader.parse(response.body, response_json)) {
+    Json::Value status;
+    status["is_done"] = true;
+    status["has_error"] = true;
+    status["is_stream"] = false;
+    status["status_code"] = k500InternalServerError;
+    Json::Value error;
+    error["error"] = "Failed to parse response";
+    LOG_WARN << "Failed to parse response: " << response.body;
+    callback(std::move(status), std::move(error));
+    return;
+  }
+
+  // Transform Response
+  std::string response_str;
+  try {
+    std::string template_str;
+    {
+      std::shared_lock l(settings_mtx_);
+      template_str = chat_res_template_;
+    }
+    if (!template_str.empty()) {
+      CTL_DBG("Use engine transform response template: " << template_str);
+    } else {
+      CTL_WRN("Required transform response template");
     }
 
-    // Transform Response
-    std::string response_str;
     try {
-      std::string template_str;
-      if (!chat_res_template_.empty()) {
-        CTL_DBG(
-            "Use engine transform response template: " << chat_res_template_);
-        template_str = chat_res_template_;
-      } else {
-        CTL_WRN("Required transform response template");
-      }
-
-      try {
-        response_json["stream"] = false;
-        if (!response_json.isMember("model")) {
-          response_json["model"] = model;
-        }
-        response_str = renderer_.Render(template_str, response_json);
-      } catch (const std::exception& e) {
-        throw std::runtime_error("Template rendering error: " +
-                                 std::string(e.what()));
+      response_json["stream"] = false;
+      if (!response_json.isMember("model")) {
+        response_json["model"] = config.model;
       }
+      response_str = renderer_.Render(template_str, response_json);
     } catch (const std::exception& e) {
-      // Log error and potentially rethrow or handle accordingly
-      LOG_WARN << "Error: " << e.what();
-      LOG_WARN << "Response: " << response.body;
-      LOG_WARN << "Using original body";
-      response_str = response_json.toStyledString();
-    }
-
-    Json::Reader reader_final;
-    Json::Value response_json_final;
-    if (!reader_final.parse(response_str, response_json_final)) {
-      Json::Value status;
-      status["is_done"] = true;
-      status["has_error"] = true;
-      status["is_stream"] = false;
-      status["status_code"] = k500InternalServerError;
-      Json::Value error;
-      error["error"] = "Failed to parse response";
-      callback(std::move(status), std::move(error));
-      LOG_WARN << "Failed to parse response: " << response_str;
-      return;
+      throw std::runtime_error("Template rendering error: " +
+                               std::string(e.what()));
     }
+  } catch (const std::exception& e) {
+    // Log error and potentially rethrow or handle accordingly
+    LOG_WARN << "Error: " << e.what();
+    LOG_WARN << "Response: " << response.body;
+    LOG_WARN << "Using original body";
+    response_str = response_json.toStyledString();
+  }
 
+  Json::Reader reader_final;
+  Json::Value response_json_final;
+  if (!reader_final.parse(response_str, response_json_final)) {
     Json::Value status;
     status["is_done"] = true;
-    status["has_error"] = false;
+    status["has_error"] = true;
     status["is_stream"] = false;
-    status["status_code"] = k200OK;
-
-    callback(std::move(status), std::move(response_json_final));
+    status["status_code"] = k500InternalServerError;
+    Json::Value error;
+    error["error"] = "Failed to parse response";
+    callback(std::move(status), std::move(error));
+    LOG_WARN << "Failed to parse response: " << response_str;
+    return;
   }
+
+  Json::Value status;
+  status["is_done"] = true;
+  status["has_error"] = false;
+  status["is_stream"] = false;
+  status["status_code"] = k200OK;
+
+  callback(std::move(status), std::move(response_json_final));
 }
 
 void RemoteEngine::GetModelStatus(
@@ -8,14 +8,20 @@
 #include <string>
 #include <unordered_map>
 #include "cortex-common/remote_enginei.h"
+#include "extensions/remote-engine/rate_limiter.h"
 #include "extensions/template_renderer.h"
 #include "trantor/utils/ConcurrentTaskQueue.h"
+#include "utils/curl_share.h"
 #include "utils/engine_constants.h"
 #include "utils/file_logger.h"
 // Helper for CURL response
 
 namespace remote_engine {
 
+// Upstream requests in flight at once, per engine. Can be overridden with the
+// engine's "max_concurrent_requests" metadata.
+constexpr const int kDefaultMaxConcurrentRequests = 8;
+
 struct StreamContext {
   std::shared_ptr<std::function<void(Json::Value&&, Json::Value&&)>> callback;
   std::string buffer;
@@ -43,18 +49,24 @@ class RemoteEngine : public RemoteEngineI {
     std::string version;
     std::string url;
     bool is_loaded{false};
+    // Set if the model has a requests_per_minute limit
+    std::shared_ptr<RateLimiter> rate_limiter;
   };
 
   // Thread-safe model config storage
   mutable std::shared_mutex models_mtx_;
   std::unordered_map<std::string, ModelConfig> models_;
   extensions::TemplateRenderer renderer_;
+  // Guards the engine settings below, which are read by concurrent requests
+  mutable std::shared_mutex settings_mtx_;
   Json::Value metadata_;
   std::string chat_req_template_;
   std::string chat_res_template_;
   std::vector<std::string> header_;
   std::string engine_name_;
   std::string chat_url_;
+  // Must outlive the workers of q_, whose easy handles are attached to it
+  curl_utils::CurlShare curl_share_;
   trantor::ConcurrentTaskQueue q_;
 
   // Helper functions
@@ -64,6 +76,9 @@ class RemoteEngine : public RemoteEngineI {
   CurlResponse MakeStreamingChatCompletionRequest(
       const ModelConfig& config, const std::string& body,
       const std::function<void(Json::Value&&, Json::Value&&)>& callback);
+  void MakeNonStreamingChatCompletionRequest(
+      const ModelConfig& config, const std::string& body,
+      const std::function<void(Json::Value&&, Json::Value&&)>& callback);
   CurlResponse MakeGetModelsRequest(const std::string& url,
                                     const std::string& api_key,
                                     const std::string& header_template);
@@ -74,7 +89,9 @@ class RemoteEngine : public RemoteEngineI {
   ModelConfig* GetModelConfig(const std::string& model);
 
  public:
-  explicit RemoteEngine(const std::string& engine_name);
+  explicit RemoteEngine(
+      const std::string& engine_name,
+      int max_concurrent_requests = kDefaultMaxConcurrentRequests);
   virtual ~RemoteEngine();
 
   // Main interface implementations
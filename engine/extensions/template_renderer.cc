@@ -31,9 +31,37 @@ TemplateRenderer::TemplateRenderer() {
   });
 }
 
+std::shared_ptr<const inja::Template> TemplateRenderer::Compile(
+    const std::string& tmpl) {
+  auto key = std::hash<std::string>{}(tmpl);
+  {
+    std::shared_lock l(mtx_);
+    if (auto it = templates_.find(key);
+        it != templates_.end() && it->second.source == tmpl) {
+      return it->second.tmpl;
+    }
+  }
+
+  std::unique_lock l(mtx_);
+  if (auto it = templates_.find(key);
+      it != templates_.end() && it->second.source == tmpl) {
+    return it->second.tmpl;
+  }
+  auto compiled = std::make_shared<const inja::Template>(env_.parse(tmpl));
+  if (templates_.size() >= kMaxCachedTemplates) {
+    LOG_DEBUG << "Template cache is full, clearing it";
+    templates_.clear();
+  }
+  // On a hash collision the newer template replaces the older one
+  templates_[key] = CompiledTemplate{tmpl, compiled};
+  return compiled;
+}
+
 std::string TemplateRenderer::Render(const std::string& tmpl,
                                      const Json::Value& data) {
   try {
+    auto compiled = Compile(tmpl);
+
     // Convert Json::Value to nlohmann::json
     auto json_data = ConvertJsonValue(data);
 
@@ -46,7 +74,11 @@ std::string TemplateRenderer::Render(const std::string& tmpl,
     LOG_DEBUG << "Data: " << template_data.dump(2);
 
     // Render template
-    std::string result = env_.render(tmpl, template_data);
+    std::string result;
+    {
+      std::shared_lock l(mtx_);
+      result = env_.render(*compiled, template_data);
+    }
 
     // Clean up any potential double quotes in JSON strings
     // result = std::regex_replace(result, std::regex("\\\"\\\""), "\"");
@@ -128,6 +160,7 @@ std::string TemplateRenderer::RenderFile(const std::string& template_path,
     auto json_data = ConvertJsonValue(data);
 
     // Load and render template
+    std::unique_lock l(mtx_);
     return env_.render_file(template_path, json_data);
   } catch (const std::exception& e) {
     throw std::runtime_error(std::string("Template file rendering failed: ") +
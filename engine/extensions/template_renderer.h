@@ -1,8 +1,10 @@
 #pragma once
 
 #include <memory>
-
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include "json/json.h"
 #include "trantor/utils/Logger.h"
 // clang-format off
@@ -26,7 +28,11 @@ class TemplateRenderer {
   // Convert nlohmann::json to Json::Value
   static Json::Value ConvertNlohmannJson(const nlohmann::json& input);
 
-  // Render template with data
+  // Parse template, or return it from the cache if it was parsed before
+  std::shared_ptr<const inja::Template> Compile(const std::string& tmpl);
+
+  // Render template with data. The parsed template is cached, so rendering
+  // the same template again only costs the rendering itself. Thread safe.
   std::string Render(const std::string& tmpl, const Json::Value& data);
 
   // Load template from file and render
@@ -34,7 +40,20 @@ class TemplateRenderer {
                          const Json::Value& data);
 
  private:
+  struct CompiledTemplate {
+    std::string source;
+    std::shared_ptr<const inja::Template> tmpl;
+  };
+
+  // Templates come from engine and model configs, so there are only a few of
+  // them. The cache is simply dropped if that is not the case.
+  static constexpr size_t kMaxCachedTemplates = 64;
+
+  // Parsing may add templates to env_, rendering only reads it
+  std::shared_mutex mtx_;
   inja::Environment env_;
+  // Keyed by the hash of the template source
+  std::unordered_map<size_t, CompiledTemplate> templates_;
 };
 
 }  // namespace remote_engine
\ No newline at end of file
@@ -37,6 +37,7 @@
 #include "utils/file_logger.h"
 #include "utils/file_manager_utils.h"
 #include "utils/logging_utils.h"
+#include "utils/route_table.h"
 #include "utils/system_info_utils.h"
 #include "utils/task_queue.h"
 
@@ -182,7 +183,8 @@ void RunServer(bool ignore_cout) {
   auto file_repo =
       std::make_shared<FileFsRepository>(data_folder_path, db_service);
   auto msg_repo = std::make_shared<MessageFsRepository>(data_folder_path);
-  auto thread_repo = std::make_shared<ThreadFsRepository>(data_folder_path);
+  auto thread_repo =
+      std::make_shared<ThreadFsRepository>(data_folder_path, db_service);
   auto assistant_repo =
       std::make_shared<AssistantFsRepository>(data_folder_path);
 
@@ -199,7 +201,7 @@ void RunServer(bool ignore_cout) {
   auto task_queue = std::make_shared<cortex::TaskQueue>(
       std::min(2u, std::thread::hardware_concurrency()), "background_task");
   auto engine_service = std::make_shared<EngineService>(
-      download_service, dylib_path_manager, db_service, task_queue);
+      download_service, dylib_path_manager, db_service);
   auto inference_svc = std::make_shared<InferenceService>(engine_service);
   auto model_src_svc = std::make_shared<ModelSourceService>(db_service);
 
@@ -272,51 +274,60 @@ void RunServer(bool ignore_cout) {
       .setClientMaxBodySize(256 * 1024 * 1024)   // Max 256MiB body size
       .setClientMaxMemoryBodySize(1024 * 1024);  // 1MiB before writing to disk
 
-  auto validate_api_key = [config_service](const drogon::HttpRequestPtr& req) {
-    auto api_keys = config_service->GetApiServerConfiguration()->api_keys;
+  // API keys of a config snapshot, hashed for the per-request check
+  struct ApiKeys {
+    std::shared_ptr<const config_yaml_utils::CortexConfig> config;
+    std::unordered_set<std::string> keys;
+  };
+  auto validate_api_key = [](const drogon::HttpRequestPtr& req) {
     static const std::unordered_set<std::string> public_endpoints = {
         "/openapi.json", "/healthz", "/processManager/destroy", "/events"};
+    static std::shared_ptr<const ApiKeys> api_keys;
 
-    if (req->getHeader("Authorization").empty() &&
-        req->path() == "/v1/configs") {
+    const auto& path = req->path();
+    const auto& auth_header = req->getHeader("Authorization");
+    if (auth_header.empty() && path == "/v1/configs") {
       CTL_WRN("Require API key to access /v1/configs");
       return false;
     }
 
+    // Rebuilt only when the config changed
+    auto config = file_manager_utils::GetCortexConfigSnapshot();
+    auto keys = std::atomic_load(&api_keys);
+    if (!keys || keys->config != config) {
+      keys = std::make_shared<const ApiKeys>(ApiKeys{
+          config, {config->apiKeys.begin(), config->apiKeys.end()}});
+      std::atomic_store(&api_keys, keys);
+    }
+
     // If API key is not set, skip validation
-    if (api_keys.empty()) {
+    if (keys->keys.empty()) {
       return true;
     }
 
     // If path is public or is static file, skip validation
-    if (public_endpoints.find(req->path()) != public_endpoints.end() ||
-        req->path() == "/") {
+    if (public_endpoints.find(path) != public_endpoints.end() || path == "/") {
       return true;
     }
 
     // Check for API key in the header
-    auto auth_header = req->getHeader("Authorization");
-
-    std::string prefix = "Bearer ";
-    if (auth_header.substr(0, prefix.size()) == prefix) {
-      std::string received_api_key = auth_header.substr(prefix.size());
-      if (std::find(api_keys.begin(), api_keys.end(), received_api_key) !=
-          api_keys.end()) {
-        return true;  // API key is valid
-      }
+    constexpr std::string_view prefix = "Bearer ";
+    if (auth_header.compare(0, prefix.size(), prefix) == 0 &&
+        keys->keys.count(auth_header.substr(prefix.size())) > 0) {
+      return true;  // API key is valid
     }
 
     CTL_WRN("Unauthorized: Invalid API Key\n");
     return false;
   };
 
-  auto handle_cors = [config_service](const drogon::HttpRequestPtr& req,
-                                      const drogon::HttpResponsePtr& resp) {
+  auto handle_cors = [](const drogon::HttpRequestPtr& req,
+                        const drogon::HttpResponsePtr& resp) {
     const std::string& origin = req->getHeader("Origin");
     CTL_INF("Origin: " << origin);
 
-    auto allowed_origins =
-        config_service->GetApiServerConfiguration()->allowed_origins;
+    auto config = file_manager_utils::GetCortexConfigSnapshot();
+    const auto& allowed_origins = config->allowedOrigins;
 
     auto is_contains_asterisk =
         std::find(allowed_origins.begin(), allowed_origins.end(), "*");
@@ -343,37 +354,24 @@ void RunServer(bool ignore_cout) {
           drogon::AdviceChainCallback&& pass) {
         // Handle OPTIONS preflight requests
         if (req->method() == drogon::HttpMethod::Options) {
-          auto resp = HttpResponse::newHttpResponse();
-          auto handlers = drogon::app().getHandlersInfo();
-          bool has_ep = [req, &handlers]() {
-            for (auto const& h : handlers) {
-              if (string_utils::AreUrlPathsEqual(req->path(), std::get<0>(h)))
-                return true;
+          // Every handler is registered by the time requests come in
+          static const auto routes = [] {
+            cortex::utils::RouteTable routes;
+            for (auto const& h : drogon::app().getHandlersInfo()) {
+              routes.Add(std::get<0>(h),
+                         drogon::to_string_view(std::get<1>(h)));
             }
-            return false;
+            return routes;
           }();
-          if (!has_ep) {
+          auto resp = HttpResponse::newHttpResponse();
+          auto supported_methods = routes.Methods(req->path());
+          if (supported_methods.empty()) {
             resp->setStatusCode(drogon::HttpStatusCode::k404NotFound);
             stop(resp);
             return;
           }
 
           handle_cors(req, resp);
-          std::string supported_methods = [req, &handlers]() {
-            std::string methods;
-            for (auto const& h : handlers) {
-              if (string_utils::AreUrlPathsEqual(req->path(), std::get<0>(h))) {
-                auto m = drogon::to_string_view(std::get<1>(h));
-                if (methods.find(m) == std::string::npos) {
-                  methods += drogon::to_string_view(std::get<1>(h));
-                  methods += ", ";
-                }
-              }
-            }
-            if (methods.size() < 2)
-              return std::string();
-            return methods.substr(0, methods.size() - 2);
-          }();
 
           // Add more info to header
           resp->addHeader("Access-Control-Allow-Methods", supported_methods);
@@ -402,9 +400,9 @@ void RunServer(bool ignore_cout) {
 
   // CORS
   drogon::app().registerPostHandlingAdvice(
-      [config_service, &handle_cors](const drogon::HttpRequestPtr& req,
-                                     const drogon::HttpResponsePtr& resp) {
-        if (!config_service->GetApiServerConfiguration()->cors) {
+      [&handle_cors](const drogon::HttpRequestPtr& req,
+                     const drogon::HttpResponsePtr& resp) {
+        if (!file_manager_utils::GetCortexConfigSnapshot()->enableCors) {
           CTL_INF("CORS is disabled!");
           return;
         }
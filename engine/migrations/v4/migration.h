@@ -0,0 +1,63 @@
+#pragma once
+
+#include <SQLiteCpp/Database.h>
+#include <string>
+#include "utils/logging_utils.h"
+#include "utils/result.hpp"
+
+namespace cortex::migr::v4 {
+inline cpp::result<bool, std::string> MigrateFolderStructureUp() {
+  return true;
+}
+
+inline cpp::result<bool, std::string> MigrateFolderStructureDown() {
+  return true;
+}
+
+// Database
+inline cpp::result<bool, std::string> MigrateDBUp(SQLite::Database& db) {
+  try {
+    db.exec(
+        "CREATE TABLE IF NOT EXISTS schema_version ( version INTEGER PRIMARY "
+        "KEY);");
+
+    // threads, an index of the thread.json files for listing. The threads
+    // that exist already are added by ThreadFsRepository on first use.
+    {
+      SQLite::Statement query(db,
+                              "SELECT name FROM sqlite_master WHERE "
+                              "type='table' AND name='threads'");
+      auto table_exists = query.executeStep();
+
+      if (!table_exists) {
+        db.exec(
+            "CREATE TABLE threads ("
+            "id TEXT PRIMARY KEY,"
+            "created_at INTEGER,"
+            "data TEXT,"
+            "modified_at INTEGER"
+            ")");
+        db.exec(
+            "CREATE INDEX IF NOT EXISTS threads_created_at ON threads "
+            "(created_at, id)");
+      }
+    }
+
+    return true;
+  } catch (const std::exception& e) {
+    CTL_WRN("Migration up failed: " << e.what());
+    return cpp::fail(e.what());
+  }
+};
+
+inline cpp::result<bool, std::string> MigrateDBDown(SQLite::Database& db) {
+  try {
+    db.exec("DROP INDEX IF EXISTS threads_created_at");
+    db.exec("DROP TABLE IF EXISTS threads");
+    return true;
+  } catch (const std::exception& e) {
+    CTL_WRN("Migration down failed: " << e.what());
+    return cpp::fail(e.what());
+  }
+}
+};  // namespace cortex::migr::v4
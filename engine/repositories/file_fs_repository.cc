@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <fstream>
 #include "database/file.h"
+#include "utils/http_range_utils.h"
 #include "utils/logging_utils.h"
 #include "utils/result.hpp"
 
@@ -128,48 +129,50 @@ cpp::result<OpenAi::File, std::string> FileFsRepository::RetrieveFile(
   return res.value();
 }
 
-cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
-FileFsRepository::RetrieveFileContent(const std::string& file_id) const {
+namespace {
+// Looks the file up without reading it
+cpp::result<FileContent, std::string> StatFileContent(
+    const std::filesystem::path& file_path) {
+  std::error_code ec;
+  auto status = std::filesystem::status(file_path, ec);
+  if (ec || !std::filesystem::is_regular_file(status)) {
+    return cpp::fail("File not found: " + file_path.string());
+  }
+  auto size = std::filesystem::file_size(file_path, ec);
+  if (ec) {
+    return cpp::fail("Failed to read file: " + file_path.string());
+  }
+  auto mtime = std::filesystem::last_write_time(file_path, ec);
+  if (ec) {
+    return cpp::fail("Failed to read file: " + file_path.string());
+  }
+  return FileContent{file_path, size, http_range_utils::MakeETag(mtime, size)};
+}
+}  // namespace
+
+cpp::result<FileContent, std::string> FileFsRepository::RetrieveFileContent(
+    const std::string& file_id) const {
   auto file_container_path = GetFilePath();
   auto file_metadata = RetrieveFile(file_id);
   if (file_metadata.has_error()) {
     return cpp::fail(file_metadata.error());
   }
   auto file_path = file_container_path / file_metadata->filename;
-  if (!std::filesystem::exists(file_path)) {
+  auto content = StatFileContent(file_path);
+  if (content.has_error()) {
     return cpp::fail("File content not found: " + file_path.string());
   }
-  size_t size = std::filesystem::file_size(file_path);
-  auto buffer = std::make_unique<char[]>(size);
-  std::ifstream file(file_path, std::ios::binary);
-  if (!file.read(buffer.get(), size)) {
-    return cpp::fail("Failed to read file: " + file_path.string());
-  }
-
-  return std::make_pair(std::move(buffer), size);
+  return content;
 }
 
-cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
+cpp::result<FileContent, std::string>
 FileFsRepository::RetrieveFileContentByPath(const std::string& path) const {
-  auto file_path = data_folder_path_ / path;
-  if (!std::filesystem::exists(file_path)) {
+  auto content = StatFileContent(data_folder_path_ / path);
+  if (content.has_error()) {
+    CTL_ERR("Failed to retrieve file content: " << content.error());
     return cpp::fail("File not found: " + path);
   }
-
-  try {
-    size_t size = std::filesystem::file_size(file_path);
-    auto buffer = std::make_unique<char[]>(size);
-
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file.read(buffer.get(), size)) {
-      return cpp::fail("Failed to read file: " + file_path.string());
-    }
-
-    return std::make_pair(std::move(buffer), size);
-  } catch (const std::exception& e) {
-    CTL_ERR("Failed to retrieve file content: " << e.what());
-    return cpp::fail("Failed to retrieve file content");
-  }
+  return content;
 }
 
 cpp::result<void, std::string> FileFsRepository::DeleteFileLocal(
@@ -20,11 +20,11 @@ class FileFsRepository : public FileRepository {
   cpp::result<OpenAi::File, std::string> RetrieveFile(
       const std::string file_id) const override;
 
-  cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
-  RetrieveFileContent(const std::string& file_id) const override;
+  cpp::result<FileContent, std::string> RetrieveFileContent(
+      const std::string& file_id) const override;
 
-  cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
-  RetrieveFileContentByPath(const std::string& path) const override;
+  cpp::result<FileContent, std::string> RetrieveFileContentByPath(
+      const std::string& path) const override;
 
   cpp::result<void, std::string> DeleteFileLocal(
       const std::string& file_id) override;
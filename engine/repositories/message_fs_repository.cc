@@ -4,41 +4,185 @@
 #include <mutex>
 #include "utils/result.hpp"
 
+namespace {
+// Logs up to this size are compacted as soon as they hold superseded records
+// or tombstones. Larger ones wait until those take as much as the live records.
+constexpr const uint64_t kCompactionSmallLogBytes = 1024 * 1024;
+
+struct IndexEntry {
+  bool tombstone;
+  std::string id;
+  uint64_t offset;
+  uint64_t length;
+  std::string run_id;
+};
+
+void WriteIndexEntry(std::ostream& out, const IndexEntry& e) {
+  out << (e.tombstone ? '-' : '+') << '\t' << e.id << '\t' << e.offset << '\t'
+      << e.length << '\t' << e.run_id << '\n';
+}
+
+std::optional<IndexEntry> ParseIndexEntry(const std::string& line) {
+  std::vector<std::string> fields;
+  size_t begin = 0;
+  while (fields.size() < 4) {
+    auto end = line.find('\t', begin);
+    if (end == std::string::npos) {
+      return std::nullopt;
+    }
+    fields.push_back(line.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  if ((fields[0] != "+" && fields[0] != "-") || fields[1].empty()) {
+    return std::nullopt;
+  }
+  try {
+    IndexEntry e{fields[0] == "-", fields[1], std::stoull(fields[2]),
+                 std::stoull(fields[3]), line.substr(begin)};
+    // A record holds at least its newline
+    if (e.length == 0) {
+      return std::nullopt;
+    }
+    return e;
+  } catch (const std::exception&) {
+    return std::nullopt;
+  }
+}
+
+std::filesystem::path TempPath(const std::filesystem::path& path) {
+  auto tmp = path;
+  tmp += ".tmp";
+  return tmp;
+}
+
+// Writes records to a log and their entries to its index
+class LogWriter {
+ public:
+  LogWriter(const std::filesystem::path& log_path,
+            const std::filesystem::path& index_path, uint64_t offset,
+            std::ios::openmode mode)
+      : log_(log_path, std::ios::binary | mode),
+        index_(index_path, std::ios::binary | mode),
+        offset_(offset) {}
+
+  explicit operator bool() const { return log_ && index_; }
+
+  IndexEntry Write(const std::string& id, const std::string& run_id,
+                   const std::string& line, bool tombstone) {
+    IndexEntry e{tombstone, id, offset_, line.size(), run_id};
+    log_.write(line.data(), line.size());
+    WriteIndexEntry(index_, e);
+    offset_ += line.size();
+    return e;
+  }
+
+  // The log is flushed first: an index entry past the end of the log makes
+  // the index be rebuilt, while records past the end of the index are found
+  // by reading the log from there
+  cpp::result<void, std::string> Close() {
+    log_.close();
+    if (log_.fail()) {
+      return cpp::fail("Failed to write messages");
+    }
+    index_.close();
+    if (index_.fail()) {
+      return cpp::fail("Failed to write message index");
+    }
+    return {};
+  }
+
+ private:
+  std::ofstream log_;
+  std::ofstream index_;
+  uint64_t offset_;
+};
+
+cpp::result<std::string, std::string> ReadBytes(std::ifstream& file,
+                                                uint64_t offset,
+                                                uint64_t length) {
+  std::string buf(length, '\0');
+  file.clear();
+  file.seekg(offset);
+  file.read(buf.data(), length);
+  if (static_cast<uint64_t>(file.gcount()) != length) {
+    return cpp::fail("Failed to read message at offset " +
+                     std::to_string(offset));
+  }
+  return buf;
+}
+
+// Whether the record of |id| is still at |offset| in the log, which another
+// application may have rewritten
+bool RecordMatches(std::ifstream& file, const std::string& id,
+                   uint64_t offset, uint64_t length) {
+  auto bytes = ReadBytes(file, offset, length);
+  return bytes.has_value() && !bytes->empty() && bytes->front() == '{' &&
+         bytes->back() == '\n' &&
+         bytes->find('"' + id + '"') != std::string::npos;
+}
+
+// Replaces the log and its index with the temporary files next to them.
+// The index is removed first: a log without one is indexed from scratch, so
+// a crash between the renames loses nothing.
+cpp::result<void, std::string> ReplaceLog(
+    const std::filesystem::path& log_path,
+    const std::filesystem::path& index_path) {
+  std::error_code ec;
+  std::filesystem::remove(index_path, ec);
+  std::filesystem::rename(TempPath(log_path), log_path, ec);
+  if (ec) {
+    return cpp::fail("Failed to replace " + log_path.string() + ": " +
+                     ec.message());
+  }
+  std::filesystem::rename(TempPath(index_path), index_path, ec);
+  if (ec) {
+    CTL_WRN("Failed to replace " << index_path.string() << ": "
+                                 << ec.message());
+  }
+  return {};
+}
+}  // namespace
+
+MessageFsRepository::~MessageFsRepository() {
+  {
+    std::lock_guard<std::mutex> lock(compaction_mutex_);
+    stopped_ = true;
+  }
+  compaction_cv_.notify_all();
+  if (compaction_thread_.joinable()) {
+    compaction_thread_.join();
+  }
+}
+
 std::filesystem::path MessageFsRepository::GetMessagePath(
     const std::string& thread_id) const {
   return data_folder_path_ / kThreadContainerFolderName / thread_id /
          kMessageFile;
 }
 
+std::filesystem::path MessageFsRepository::GetIndexPath(
+    const std::string& thread_id) const {
+  return data_folder_path_ / kThreadContainerFolderName / thread_id /
+         kMessageIndexFile;
+}
+
 cpp::result<void, std::string> MessageFsRepository::CreateMessage(
     OpenAi::Message& message) {
   CTL_INF("CreateMessage for thread " + message.thread_id);
   auto path = GetMessagePath(message.thread_id);
-
-  std::ofstream file(path, std::ios::app);
-  if (!file) {
-    return cpp::fail("Failed to open file for writing: " + path.string());
-  }
-
-  auto mutex = GrabMutex(message.thread_id);
-  std::shared_lock<std::shared_mutex> lock(*mutex);
-
-  auto json_str = message.ToSingleLineJsonString();
-  if (json_str.has_error()) {
-    return cpp::fail(json_str.error());
+  if (!std::filesystem::exists(path)) {
+    std::ofstream file(path, std::ios::app);
+    if (!file) {
+      return cpp::fail("Failed to open file for writing: " + path.string());
+    }
   }
-  file << json_str.value();
 
-  file.flush();
-  if (file.fail()) {
-    return cpp::fail("Failed to write to file: " + path.string());
+  auto log = GrabLog(message.thread_id);
+  std::unique_lock<std::shared_mutex> lock(log->mutex);
+  if (auto res = Refresh(message.thread_id, *log); res.has_error()) {
+    return res;
   }
-  file.close();
-  if (file.fail()) {
-    return cpp::fail("Failed to close file after writing: " + path.string());
-  }
-
-  return {};
+  return Append(message.thread_id, *log, message.id, &message);
 }
 
 cpp::result<std::vector<OpenAi::Message>, std::string>
@@ -53,202 +197,451 @@ MessageFsRepository::ListMessages(const std::string& thread_id, uint8_t limit,
   if (limit == 0) {
     return std::vector<OpenAi::Message>();
   }
-  if (!after.empty() && !before.empty() && after >= before) {
-    return cpp::fail("Invalid range: 'after' must be less than 'before'");
-  }
 
-  auto mutex = GrabMutex(thread_id);
-  std::shared_lock<std::shared_mutex> lock(*mutex);
-
-  auto read_result = ReadMessageFromFile(thread_id);
-  if (read_result.has_error()) {
-    return cpp::fail(read_result.error());
+  auto log = GrabLog(thread_id);
+  auto lock = LockShared(thread_id, *log);
+  if (lock.has_error()) {
+    return cpp::fail(lock.error());
   }
 
-  std::vector<OpenAi::Message> messages = std::move(read_result.value());
-
-  if (messages.empty()) {
-    return messages;
-  }
-
-  // Filter by run_id
-  if (!run_id.empty()) {
-    messages.erase(std::remove_if(messages.begin(), messages.end(),
-                                  [&run_id](const OpenAi::Message& msg) {
-                                    return msg.run_id != run_id;
-                                  }),
-                   messages.end());
-  }
-
-  auto start_it = messages.begin();
-  auto end_it = messages.end();
-
+  // Only the index is walked to select the page. A cursor that is no longer
+  // live, e.g. deleted, falls back to comparing ids.
+  auto& records = log->records;
+  auto start_it = records.begin();
   if (!after.empty()) {
-    start_it = std::find_if(
-        messages.begin(), messages.end(),
-        [&after](const OpenAi::Message& msg) { return msg.id > after; });
+    if (auto pos = log->positions.find(after); pos != log->positions.end()) {
+      start_it = records.upper_bound(pos->second);
+    } else {
+      start_it = std::find_if(records.begin(), records.end(),
+                              [&after](const auto& r) {
+                                return r.second.id > after;
+                              });
+    }
   }
-
+  auto end_it = records.end();
   if (!before.empty()) {
-    end_it = std::find_if(
-        start_it, messages.end(),
-        [&before](const OpenAi::Message& msg) { return msg.id >= before; });
+    if (auto pos = log->positions.find(before); pos != log->positions.end()) {
+      end_it = records.lower_bound(pos->second);
+    } else {
+      end_it = std::find_if(start_it, records.end(), [&before](const auto& r) {
+        return r.second.id >= before;
+      });
+    }
   }
-
+  if (end_it != records.end() &&
+      (start_it == records.end() || end_it->first < start_it->first)) {
+    return cpp::fail("Invalid range: 'after' must be less than 'before'");
+  }
+  std::vector<const Record*> page;
+  auto select = [&](auto begin, auto end) {
+    for (auto it = begin; it != end && page.size() < limit; ++it) {
+      if (run_id.empty() || it->second.run_id == run_id) {
+        page.push_back(&it->second);
+      }
+    }
+  };
   if (order == "desc") {
-    std::reverse(start_it, end_it);
+    select(std::make_reverse_iterator(end_it),
+           std::make_reverse_iterator(start_it));
+  } else {
+    select(start_it, end_it);
   }
 
-  const size_t available_messages = std::distance(start_it, end_it);
-  const size_t result_size =
-      std::min(static_cast<size_t>(limit), available_messages);
-
-  CTL_INF("Available messages: " + std::to_string(available_messages) +
-          ", result size: " + std::to_string(result_size));
+  CTL_INF("Messages in thread: " + std::to_string(records.size()) +
+          ", result size: " + std::to_string(page.size()));
 
   std::vector<OpenAi::Message> result;
-  result.reserve(result_size);
-  std::move(start_it, start_it + result_size, std::back_inserter(result));
+  if (page.empty()) {
+    return result;
+  }
+  auto path = GetMessagePath(thread_id);
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return cpp::fail("Failed to open file: " + path.string());
+  }
+  result.reserve(page.size());
+  for (const auto* record : page) {
+    auto msg = ReadRecord(file, *record);
+    if (msg.has_error()) {
+      CTL_WRN("Failed to parse message " << record->id << ": " << msg.error());
+      continue;
+    }
+    result.push_back(std::move(msg.value()));
+  }
 
   return result;
 }
 
 cpp::result<OpenAi::Message, std::string> MessageFsRepository::RetrieveMessage(
     const std::string& thread_id, const std::string& message_id) const {
-  auto mutex = GrabMutex(thread_id);
-  std::unique_lock<std::shared_mutex> lock(*mutex);
-
-  auto messages = ReadMessageFromFile(thread_id);
-  if (messages.has_error()) {
-    return cpp::fail(messages.error());
+  auto log = GrabLog(thread_id);
+  auto lock = LockShared(thread_id, *log);
+  if (lock.has_error()) {
+    return cpp::fail(lock.error());
   }
 
-  for (auto& msg : messages.value()) {
-    if (msg.id == message_id) {
-      return std::move(msg);
-    }
+  auto it = log->positions.find(message_id);
+  if (it == log->positions.end()) {
+    return cpp::fail("Message not found");
   }
 
-  return cpp::fail("Message not found");
+  auto path = GetMessagePath(thread_id);
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return cpp::fail("Failed to open file: " + path.string());
+  }
+  return ReadRecord(file, log->records.at(it->second));
 }
 
 cpp::result<void, std::string> MessageFsRepository::ModifyMessage(
     OpenAi::Message& message) {
-  auto mutex = GrabMutex(message.thread_id);
-  std::unique_lock<std::shared_mutex> lock(*mutex);
-
-  auto messages = ReadMessageFromFile(message.thread_id);
-  if (messages.has_error()) {
-    return cpp::fail(messages.error());
+  auto log = GrabLog(message.thread_id);
+  std::unique_lock<std::shared_mutex> lock(log->mutex);
+  if (auto res = Refresh(message.thread_id, *log); res.has_error()) {
+    return res;
   }
 
-  auto path = GetMessagePath(message.thread_id);
-  std::ofstream file(path, std::ios::trunc);
-  if (!file) {
-    return cpp::fail("Failed to open file for writing: " + path.string());
+  if (log->positions.find(message.id) == log->positions.end()) {
+    return cpp::fail("Message not found");
   }
+  return Append(message.thread_id, *log, message.id, &message);
+}
 
-  bool found = false;
-  for (auto& msg : messages.value()) {
-    if (msg.id == message.id) {
-      file << message.ToSingleLineJsonString().value();
-      found = true;
-    } else {
-      file << msg.ToSingleLineJsonString().value();
-    }
+cpp::result<void, std::string> MessageFsRepository::DeleteMessage(
+    const std::string& thread_id, const std::string& message_id) {
+  auto log = GrabLog(thread_id);
+  std::unique_lock<std::shared_mutex> lock(log->mutex);
+  if (auto res = Refresh(thread_id, *log); res.has_error()) {
+    return res;
   }
 
-  file.flush();
-  if (file.fail()) {
-    return cpp::fail("Failed to write to file: " + path.string());
-  }
-  file.close();
-  if (file.fail()) {
-    return cpp::fail("Failed to close file after writing: " + path.string());
+  if (log->positions.find(message_id) == log->positions.end()) {
+    return cpp::fail("Message not found");
   }
+  return Append(thread_id, *log, message_id, nullptr);
+}
 
-  if (!found) {
-    return cpp::fail("Message not found");
+MessageFsRepository::MessageLog* MessageFsRepository::GrabLog(
+    const std::string& thread_id) const {
+  std::lock_guard<std::mutex> lock(mutex_map_mutex_);
+  auto& log = logs_[thread_id];
+  if (!log) {
+    log = std::make_unique<MessageLog>();
   }
-  return {};
+  return log.get();
 }
 
-cpp::result<void, std::string> MessageFsRepository::DeleteMessage(
-    const std::string& thread_id, const std::string& message_id) {
+bool MessageFsRepository::IsCurrent(const std::string& thread_id,
+                                    const MessageLog& log) const {
+  if (!log.loaded) {
+    return false;
+  }
   auto path = GetMessagePath(thread_id);
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  if (ec || size != log.size) {
+    return false;
+  }
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  return !ec && mtime == log.mtime;
+}
 
-  auto mutex = GrabMutex(thread_id);
-  std::unique_lock<std::shared_mutex> lock(*mutex);
-  auto messages = ReadMessageFromFile(thread_id);
-  if (messages.has_error()) {
-    return cpp::fail(messages.error());
+cpp::result<void, std::string> MessageFsRepository::Refresh(
+    const std::string& thread_id, MessageLog& log) const {
+  auto path = GetMessagePath(thread_id);
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    log.loaded = false;
+    return cpp::fail("Failed to open file: " + path.string());
+  }
+  if (IsCurrent(thread_id, log)) {
+    return {};
   }
 
-  std::ofstream file(path, std::ios::trunc);
-  if (!file) {
-    return cpp::fail("Failed to open file for writing: " + path.string());
+  auto apply = [&log](const IndexEntry& e) {
+    Put(log, Record{e.id, e.offset, e.length, e.run_id}, e.tombstone);
+    if (e.offset + e.length >= log.size) {
+      log.size = e.offset + e.length;
+      log.tail = Tail{e.offset, e.length, e.id};
+    }
+  };
+  auto reset = [&log] {
+    log.size = 0;
+    log.live_bytes = 0;
+    log.tail.reset();
+    log.records.clear();
+    log.positions.clear();
+  };
+
+  auto index_path = GetIndexPath(thread_id);
+  bool rebuild = false;
+  if (!log.loaded) {
+    reset();
+    std::ifstream index(index_path, std::ios::binary);
+    std::string line;
+    std::optional<IndexEntry> last;
+    rebuild = !index;
+    while (!rebuild && std::getline(index, line)) {
+      last = ParseIndexEntry(line);
+      if (!last || last->offset + last->length > file_size) {
+        rebuild = true;
+      } else {
+        apply(*last);
+      }
+    }
+    // The log may have been rewritten by another application since
+    if (!rebuild && last) {
+      std::ifstream file(path, std::ios::binary);
+      rebuild = !RecordMatches(file, last->id, last->offset, last->length);
+    }
+  } else if (file_size <= log.size) {
+    rebuild = true;
+  } else if (log.tail) {
+    // Appended to by another writer if the last record is still in place,
+    // rewritten to a larger log otherwise
+    std::ifstream file(path, std::ios::binary);
+    rebuild = !RecordMatches(file, log.tail->id, log.tail->offset,
+                             log.tail->length);
+  }
+  if (rebuild) {
+    CTL_INF("Indexing messages of thread " << thread_id);
+    reset();
+  }
+
+  if (log.size < file_size || rebuild) {
+    std::ofstream index_out(
+        index_path, std::ios::binary | (rebuild ? std::ios::trunc : std::ios::app));
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      return cpp::fail("Failed to open file: " + path.string());
+    }
+    file.seekg(log.size);
+    uint64_t offset = log.size;
+    std::string line;
+    while (std::getline(file, line) && !file.eof()) {
+      uint64_t length = line.size() + 1;
+      Json::Value root;
+      Json::Reader reader;
+      if (reader.parse(line, root) && root.isObject() &&
+          root["id"].isString() && !root["id"].asString().empty()) {
+        IndexEntry e{root["deleted"].isBool() && root["deleted"].asBool(),
+                     root["id"].asString(), offset, length,
+                     root["run_id"].isString() ? root["run_id"].asString()
+                                               : std::string()};
+        apply(e);
+        WriteIndexEntry(index_out, e);
+      } else {
+        CTL_WRN("Skipping malformed message record at offset "
+                << offset << " in " << path.string());
+      }
+      offset += length;
+    }
+    log.size = offset;
+    // A record without its newline yet is left alone: it may still be
+    // written by another application, or torn by a crash, which only a
+    // writer cuts off
+    index_out.close();
+    if (index_out.fail()) {
+      CTL_WRN("Failed to write message index: " << index_path.string());
+    }
   }
 
-  bool found = false;
-  for (auto& msg : messages.value()) {
-    if (msg.id != message_id) {
-      file << msg.ToSingleLineJsonString().value();
-    } else {
-      found = true;
+  log.mtime = std::filesystem::last_write_time(path, ec);
+  log.loaded = true;
+  return {};
+}
+
+cpp::result<std::shared_lock<std::shared_mutex>, std::string>
+MessageFsRepository::LockShared(const std::string& thread_id,
+                                MessageLog& log) const {
+  {
+    std::shared_lock<std::shared_mutex> lock(log.mutex);
+    if (IsCurrent(thread_id, log)) {
+      return lock;
+    }
+  }
+  {
+    std::unique_lock<std::shared_mutex> lock(log.mutex);
+    if (auto res = Refresh(thread_id, log); res.has_error()) {
+      return cpp::fail(res.error());
     }
   }
+  // Writers in between keep the index current
+  return std::shared_lock<std::shared_mutex>(log.mutex);
+}
 
-  file.flush();
-  if (file.fail()) {
-    return cpp::fail("Failed to write to file: " + path.string());
+cpp::result<void, std::string> MessageFsRepository::Append(
+    const std::string& thread_id, MessageLog& log,
+    const std::string& message_id, OpenAi::Message* message) {
+  std::string line;
+  std::string run_id;
+  if (message) {
+    auto json_str = message->ToSingleLineJsonString();
+    if (json_str.has_error()) {
+      return cpp::fail(json_str.error());
+    }
+    line = std::move(json_str.value());
+    run_id = message->run_id.value_or("");
+  } else {
+    Json::Value tombstone;
+    tombstone["id"] = message_id;
+    tombstone["deleted"] = true;
+    line = Json::FastWriter().write(tombstone);
   }
-  file.close();
-  if (file.fail()) {
-    return cpp::fail("Failed to close file after writing: " + path.string());
+  if (line.empty() || line.back() != '\n') {
+    line += '\n';
   }
 
-  if (!found) {
-    return cpp::fail("Message not found");
+  auto path = GetMessagePath(thread_id);
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(path, ec);
+  if (!ec && file_size > log.size) {
+    // A record torn by a crash, which this one would extend
+    CTL_WRN("Truncating incomplete message record in " << path.string());
+    std::filesystem::resize_file(path, log.size, ec);
+    if (ec) {
+      return cpp::fail("Failed to truncate " + path.string() + ": " +
+                       ec.message());
+    }
+  }
+  LogWriter writer(path, GetIndexPath(thread_id), log.size, std::ios::app);
+  if (!writer) {
+    return cpp::fail("Failed to open file for writing: " + path.string());
+  }
+  auto e = writer.Write(message_id, run_id, line, message == nullptr);
+  if (auto res = writer.Close(); res.has_error()) {
+    // Whatever made it to the files is found by the next refresh
+    log.loaded = false;
+    return cpp::fail(res.error() + ": " + path.string());
   }
 
+  Put(log, Record{message_id, e.offset, e.length, run_id}, message == nullptr);
+  log.size = e.offset + e.length;
+  log.tail = Tail{e.offset, e.length, message_id};
+  log.mtime = std::filesystem::last_write_time(path, ec);
+
+  ScheduleCompaction(thread_id, log);
   return {};
 }
 
-cpp::result<std::vector<OpenAi::Message>, std::string>
-MessageFsRepository::ReadMessageFromFile(const std::string& thread_id) const {
-  LOG_TRACE << "Reading messages from file for thread " << thread_id;
-  auto path = GetMessagePath(thread_id);
+void MessageFsRepository::Put(MessageLog& log, Record&& record,
+                              bool tombstone) {
+  auto pos = log.positions.find(record.id);
+  if (pos != log.positions.end()) {
+    auto& current = log.records.at(pos->second);
+    log.live_bytes -= current.length;
+    if (!tombstone) {
+      log.live_bytes += record.length;
+      current = std::move(record);
+      return;
+    }
+    log.records.erase(pos->second);
+    log.positions.erase(pos);
+  } else if (!tombstone) {
+    auto offset = record.offset;
+    log.live_bytes += record.length;
+    log.positions[record.id] = offset;
+    log.records[offset] = std::move(record);
+  }
+}
 
-  std::ifstream file(path);
+cpp::result<OpenAi::Message, std::string> MessageFsRepository::ReadRecord(
+    std::ifstream& file, const Record& record) const {
+  auto bytes = ReadBytes(file, record.offset, record.length);
+  if (bytes.has_error()) {
+    return cpp::fail(bytes.error());
+  }
+  return OpenAi::Message::FromJsonString(std::move(bytes.value()));
+}
+
+cpp::result<void, std::string> MessageFsRepository::CompactMessages(
+    const std::string& thread_id) {
+  auto log = GrabLog(thread_id);
+  std::unique_lock<std::shared_mutex> lock(log->mutex);
+  log->compaction_queued = false;
+  if (auto res = Refresh(thread_id, *log); res.has_error()) {
+    return res;
+  }
+  if (log->live_bytes == log->size) {
+    return {};
+  }
+
+  auto path = GetMessagePath(thread_id);
+  auto index_path = GetIndexPath(thread_id);
+  std::ifstream file(path, std::ios::binary);
   if (!file) {
     return cpp::fail("Failed to open file: " + path.string());
   }
-
-  std::vector<OpenAi::Message> messages;
-  std::string line;
-  while (std::getline(file, line)) {
-    if (line.empty())
-      continue;
-    auto msg_parse_result = OpenAi::Message::FromJsonString(std::move(line));
-    if (msg_parse_result.has_error()) {
-      CTL_WRN("Failed to parse message: " + msg_parse_result.error());
-      continue;
+  auto size_before = log->size;
+  {
+    LogWriter writer(TempPath(path), TempPath(index_path), 0, std::ios::trunc);
+    if (!writer) {
+      return cpp::fail("Failed to open file for writing: " +
+                       TempPath(path).string());
+    }
+    for (const auto& [_, record] : log->records) {
+      auto bytes = ReadBytes(file, record.offset, record.length);
+      if (bytes.has_error()) {
+        return cpp::fail(bytes.error());
+      }
+      writer.Write(record.id, record.run_id, bytes.value(), false);
     }
+    if (auto res = writer.Close(); res.has_error()) {
+      return res;
+    }
+  }
+  file.close();
 
-    messages.push_back(std::move(msg_parse_result.value()));
+  auto res = ReplaceLog(path, index_path);
+  log->loaded = false;
+  if (res.has_error()) {
+    return res;
+  }
+  if (auto refresh = Refresh(thread_id, *log); refresh.has_error()) {
+    return refresh;
   }
+  CTL_INF("Compacted messages of thread " << thread_id << ": " << size_before
+                                          << " -> " << log->size << " bytes");
+  return {};
+}
 
-  return messages;
+void MessageFsRepository::ScheduleCompaction(const std::string& thread_id,
+                                             MessageLog& log) {
+  auto garbage = log.size - log.live_bytes;
+  if (!background_compaction_ || log.compaction_queued || garbage == 0 ||
+      (log.size > kCompactionSmallLogBytes && garbage < log.live_bytes)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(compaction_mutex_);
+    if (stopped_) {
+      return;
+    }
+    compaction_queue_.push_back(thread_id);
+  }
+  log.compaction_queued = true;
+  compaction_cv_.notify_one();
 }
 
-std::shared_mutex* MessageFsRepository::GrabMutex(
-    const std::string& thread_id) const {
-  std::lock_guard<std::mutex> lock(mutex_map_mutex_);
-  auto& thread_mutex = thread_mutexes_[thread_id];
-  if (!thread_mutex) {
-    thread_mutex = std::make_unique<std::shared_mutex>();
+void MessageFsRepository::CompactionLoop() {
+  while (true) {
+    std::string thread_id;
+    {
+      std::unique_lock<std::mutex> lock(compaction_mutex_);
+      compaction_cv_.wait(
+          lock, [this] { return stopped_ || !compaction_queue_.empty(); });
+      if (stopped_) {
+        return;
+      }
+      thread_id = std::move(compaction_queue_.front());
+      compaction_queue_.pop_front();
+    }
+    if (auto res = CompactMessages(thread_id); res.has_error()) {
+      CTL_WRN("Failed to compact messages of thread " << thread_id << ": "
+                                                      << res.error());
+    }
   }
-  return thread_mutex.get();
 }
 
 cpp::result<void, std::string> MessageFsRepository::InitializeMessages(
@@ -265,34 +658,33 @@ cpp::result<void, std::string> MessageFsRepository::InitializeMessages(
         path.parent_path().string());
   }
 
-  auto mutex = GrabMutex(thread_id);
-  std::unique_lock<std::shared_mutex> lock(*mutex);
+  auto log = GrabLog(thread_id);
+  std::unique_lock<std::shared_mutex> lock(log->mutex);
 
-  std::ofstream file(path, std::ios::trunc);
-  if (!file) {
-    return cpp::fail("Failed to create message file: " + path.string());
-  }
+  auto index_path = GetIndexPath(thread_id);
+  {
+    LogWriter writer(TempPath(path), TempPath(index_path), 0, std::ios::trunc);
+    if (!writer) {
+      return cpp::fail("Failed to create message file: " + path.string());
+    }
 
-  if (messages.has_value()) {
-    for (auto& message : messages.value()) {
-      auto json_str = message.ToSingleLineJsonString();
-      if (json_str.has_error()) {
-        CTL_WRN("Failed to serialize message: " + json_str.error());
-        continue;
+    if (messages.has_value()) {
+      for (auto& message : messages.value()) {
+        auto json_str = message.ToSingleLineJsonString();
+        if (json_str.has_error()) {
+          CTL_WRN("Failed to serialize message: " + json_str.error());
+          continue;
+        }
+        writer.Write(message.id, message.run_id.value_or(""), json_str.value(),
+                     false);
       }
-      file << json_str.value();
     }
-  }
 
-  file.flush();
-  if (file.fail()) {
-    return cpp::fail("Failed to write to file: " + path.string());
-  }
-
-  file.close();
-  if (file.fail()) {
-    return cpp::fail("Failed to close file after writing: " + path.string());
+    if (auto res = writer.Close(); res.has_error()) {
+      return cpp::fail(res.error() + ": " + path.string());
+    }
   }
 
-  return {};
+  log->loaded = false;
+  return ReplaceLog(path, index_path);
 }
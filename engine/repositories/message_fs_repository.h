@@ -1,12 +1,27 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <map>
 #include <shared_mutex>
+#include <thread>
 #include <unordered_map>
 #include "common/repository/message_repository.h"
 
+// Messages of a thread are kept in an append-only log, messages.jsonl, with
+// one JSON record per line. Modifying a message appends its new version and
+// deleting one appends a tombstone, a {"id": ..., "deleted": true} record. The
+// sidecar messages.idx has a line per record with its offset in the log, so
+// that lookups and pages read only the records they return.
+//
+// Logs with superseded records or tombstones are compacted in the background:
+// right away while they are small, once those take half of the log otherwise.
+// Until then, readers that don't know tombstones, such as older versions,
+// see deleted messages as empty ones and edited messages more than once.
 class MessageFsRepository : public MessageRepository {
   constexpr static auto kMessageFile = "messages.jsonl";
+  constexpr static auto kMessageIndexFile = "messages.idx";
   constexpr static auto kThreadContainerFolderName = "threads";
 
  public:
@@ -32,32 +47,109 @@ class MessageFsRepository : public MessageRepository {
       const std::string& thread_id,
       std::optional<std::vector<OpenAi::Message>> messages) override;
 
-  explicit MessageFsRepository(const std::filesystem::path& data_folder_path)
-      : data_folder_path_{data_folder_path} {
+  // Rewrites the log of |thread_id| with only its live messages
+  cpp::result<void, std::string> CompactMessages(const std::string& thread_id);
+
+  explicit MessageFsRepository(const std::filesystem::path& data_folder_path,
+                               bool background_compaction = true)
+      : data_folder_path_{data_folder_path},
+        background_compaction_{background_compaction} {
     CTL_INF("Constructing MessageFsRepository..");
     auto thread_container_path = data_folder_path_ / kThreadContainerFolderName;
 
     if (!std::filesystem::exists(thread_container_path)) {
       std::filesystem::create_directories(thread_container_path);
     }
+    compaction_thread_ = std::thread(&MessageFsRepository::CompactionLoop, this);
   }
 
-  ~MessageFsRepository() = default;
+  ~MessageFsRepository();
 
  private:
-  cpp::result<std::vector<OpenAi::Message>, std::string> ReadMessageFromFile(
-      const std::string& thread_id) const;
+  // Location of a live message in the log
+  struct Record {
+    std::string id;
+    uint64_t offset;
+    uint64_t length;
+    std::string run_id;
+  };
+
+  // The last record of a log
+  struct Tail {
+    uint64_t offset;
+    uint64_t length;
+    std::string id;
+  };
+
+  // The in-memory copy of a thread's index, valid while the log has the size
+  // and modification time it had when the index was last updated
+  struct MessageLog {
+    std::shared_mutex mutex;
+    bool loaded = false;
+    uint64_t size = 0;
+    std::filesystem::file_time_type mtime;
+    // Bytes of the log taken by live records
+    uint64_t live_bytes = 0;
+    // Live messages in the order they were created, keyed by the offset of
+    // their first record. Edits keep that position and compaction writes
+    // the messages in this order, so it never changes. Ids can't be used:
+    // ULIDs made in the same millisecond don't sort by creation.
+    std::map<uint64_t, Record> records;
+    // Position in |records| of each live message
+    std::unordered_map<std::string, uint64_t> positions;
+    // Checked to tell records appended by another writer from a rewrite
+    std::optional<Tail> tail;
+    bool compaction_queued = false;
+  };
+
+  std::filesystem::path GetMessagePath(const std::string& thread_id) const;
+
+  std::filesystem::path GetIndexPath(const std::string& thread_id) const;
+
+  MessageLog* GrabLog(const std::string& thread_id) const;
+
+  bool IsCurrent(const std::string& thread_id, const MessageLog& log) const;
+
+  // Brings |log| up to date with the files, reading the index and indexing
+  // records appended by other writers. Needs the unique lock of |log|.
+  cpp::result<void, std::string> Refresh(const std::string& thread_id,
+                                         MessageLog& log) const;
+
+  // Takes the shared lock of |log|, refreshing it first if needed
+  cpp::result<std::shared_lock<std::shared_mutex>, std::string> LockShared(
+      const std::string& thread_id, MessageLog& log) const;
+
+  // Appends a record for |message|, or a tombstone for |message_id| when
+  // |message| is null. Needs the unique lock of a refreshed |log|.
+  cpp::result<void, std::string> Append(const std::string& thread_id,
+                                        MessageLog& log,
+                                        const std::string& message_id,
+                                        OpenAi::Message* message);
+
+  // Applies a record, or a tombstone, of |record.id| to |log|. A new message
+  // takes the position of its record, an edited one keeps its own.
+  static void Put(MessageLog& log, Record&& record, bool tombstone);
+
+  cpp::result<OpenAi::Message, std::string> ReadRecord(
+      std::ifstream& file, const Record& record) const;
+
+  void ScheduleCompaction(const std::string& thread_id, MessageLog& log);
+
+  void CompactionLoop();
 
   /**
    * The path to the data folder.
    */
   std::filesystem::path data_folder_path_;
 
-  std::filesystem::path GetMessagePath(const std::string& thread_id) const;
-
-  std::shared_mutex* GrabMutex(const std::string& thread_id) const;
+  bool background_compaction_;
 
   mutable std::mutex mutex_map_mutex_;
-  mutable std::unordered_map<std::string, std::unique_ptr<std::shared_mutex>>
-      thread_mutexes_;
+  mutable std::unordered_map<std::string, std::unique_ptr<MessageLog>> logs_;
+
+  std::mutex compaction_mutex_;
+  std::condition_variable compaction_cv_;
+  std::deque<std::string> compaction_queue_;
+  bool stopped_ = false;
+  std::thread compaction_thread_;
 };
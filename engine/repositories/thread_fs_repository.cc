@@ -2,13 +2,132 @@
 #include <algorithm>
 #include <fstream>
 #include <mutex>
+#include <set>
+#include <tuple>
 #include "common/assistant.h"
 #include "utils/result.hpp"
 
+namespace {
+// Compared for equality only, to tell whether the file changed since
+int64_t ModifiedTime(const std::filesystem::path& path) {
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  return ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+}
+}  // namespace
+
 cpp::result<std::vector<OpenAi::Thread>, std::string>
 ThreadFsRepository::ListThreads(uint8_t limit, const std::string& order,
                                 const std::string& after,
                                 const std::string& before) const {
+  if (!index_ready_ && db_service_) {
+    // Other listings meanwhile read the folders
+    std::unique_lock lock(reconcile_mutex_, std::try_to_lock);
+    if (lock.owns_lock() && !index_ready_) {
+      IndexExistingThreads();
+    }
+  }
+  if (!index_ready_) {
+    return ScanThreads(limit, order, after, before);
+  }
+
+  auto entries = db_service_->GetThreadEntries(limit, order, after, before);
+  if (entries.has_error()) {
+    CTL_WRN("Failed to list threads from index: " << entries.error());
+    return ScanThreads(limit, order, after, before);
+  }
+
+  std::vector<OpenAi::Thread> threads;
+  threads.reserve(entries->size());
+  for (const auto& entry : entries.value()) {
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(entry.data, root)) {
+      CTL_WRN("Failed to parse indexed thread: " << entry.id);
+      continue;
+    }
+    auto thread = OpenAi::Thread::FromJson(root);
+    if (thread.has_value()) {
+      threads.push_back(std::move(thread.value()));
+    }
+  }
+  return threads;
+}
+
+void ThreadFsRepository::InvalidateIndex() const {
+  // Bumped first: a reconciliation that misses it has not marked the index
+  // as ready yet, and one that sees it unmarks it
+  index_failures_++;
+  index_ready_ = false;
+}
+
+void ThreadFsRepository::IndexExistingThreads() const {
+  auto failures = index_failures_.load();
+  auto indexed = db_service_->GetThreadModifiedTimes();
+  if (indexed.has_error()) {
+    CTL_WRN("Thread index is not available: " << indexed.error());
+    return;
+  }
+  // Ids of indexed threads whose folder is gone
+  std::set<std::string> stale;
+  for (const auto& [id, _] : indexed.value()) {
+    stale.insert(id);
+  }
+
+  std::vector<ThreadEntry> entries;
+  try {
+    for (const auto& dir : std::filesystem::directory_iterator(
+             data_folder_path_ / kThreadContainerFolderName)) {
+      if (!dir.is_directory() ||
+          !std::filesystem::exists(dir.path() / kThreadFileName)) {
+        continue;
+      }
+      auto thread_id = dir.path().filename().string();
+      auto mtime = ModifiedTime(dir.path() / kThreadFileName);
+      // Only threads created or edited by another application since are read
+      if (stale.erase(thread_id) > 0 && indexed->at(thread_id) == mtime) {
+        continue;
+      }
+      auto thread = LoadThread(thread_id);
+      if (thread.has_error()) {
+        continue;
+      }
+      auto json = thread->ToJson();
+      if (json.has_error()) {
+        continue;
+      }
+      entries.push_back({thread->id, thread->created_at,
+                         Json::FastWriter().write(json.value()), mtime});
+    }
+  } catch (const std::exception& e) {
+    CTL_WRN("Failed to index threads: " << e.what());
+    return;
+  }
+
+  // All or nothing, the index is only listed from when it has every thread
+  if (auto res = db_service_->UpsertThreadEntries(entries); res.has_error()) {
+    CTL_WRN("Failed to index threads: " << res.error());
+    return;
+  }
+  std::vector<std::string> removed(stale.begin(), stale.end());
+  if (auto res = db_service_->DeleteThreadEntries(removed); res.has_error()) {
+    CTL_WRN("Failed to index threads: " << res.error());
+    return;
+  }
+  if (!entries.empty() || !removed.empty()) {
+    CTL_INF("Indexed " << entries.size() << " threads, removed "
+                       << removed.size());
+  }
+  index_ready_ = true;
+  if (index_failures_ != failures) {
+    index_ready_ = false;
+  }
+}
+
+cpp::result<std::vector<OpenAi::Thread>, std::string>
+ThreadFsRepository::ScanThreads(uint8_t limit, const std::string& order,
+                                const std::string& after,
+                                const std::string& before) const {
   std::vector<OpenAi::Thread> threads;
 
   try {
@@ -26,13 +145,6 @@ ThreadFsRepository::ListThreads(uint8_t limit, const std::string& order,
         continue;
 
       auto current_thread_id = entry.path().filename().string();
-
-      // Apply pagination filters
-      if (!after.empty() && current_thread_id <= after)
-        continue;
-      if (!before.empty() && current_thread_id >= before)
-        continue;
-
       std::shared_lock thread_lock(GrabThreadMutex(current_thread_id));
       auto thread_result = LoadThread(current_thread_id);
 
@@ -43,24 +155,46 @@ ThreadFsRepository::ListThreads(uint8_t limit, const std::string& order,
       thread_lock.unlock();
     }
 
-    // Sort threads based on order parameter using created_at
-    if (order == "desc") {
-      std::sort(all_threads.begin(), all_threads.end(),
-                [](const OpenAi::Thread& a, const OpenAi::Thread& b) {
-                  return a.created_at > b.created_at;  // Descending order
-                });
-    } else {
-      std::sort(all_threads.begin(), all_threads.end(),
-                [](const OpenAi::Thread& a, const OpenAi::Thread& b) {
-                  return a.created_at < b.created_at;  // Ascending order
-                });
+    // Ordered like the index, by creation time and then id
+    std::sort(all_threads.begin(), all_threads.end(),
+              [](const OpenAi::Thread& a, const OpenAi::Thread& b) {
+                return std::tie(a.created_at, a.id) <
+                       std::tie(b.created_at, b.id);
+              });
+
+    // Apply pagination filters. As with the index, the page is between the
+    // cursor threads, and empty when one of them does not exist.
+    auto find = [&all_threads](const std::string& id) {
+      return std::find_if(
+          all_threads.begin(), all_threads.end(),
+          [&id](const OpenAi::Thread& t) { return t.id == id; });
+    };
+    auto begin = all_threads.begin();
+    auto end = all_threads.end();
+    if (!after.empty()) {
+      auto it = find(after);
+      if (it == all_threads.end()) {
+        return threads;
+      }
+      begin = std::next(it);
+    }
+    if (!before.empty()) {
+      end = find(before);
+      if (end == all_threads.end()) {
+        return threads;
+      }
+    }
+    if (begin >= end) {
+      return threads;
     }
 
     // Apply limit
     size_t thread_count =
-        std::min(static_cast<size_t>(limit), all_threads.size());
+        std::min(static_cast<size_t>(limit),
+                 static_cast<size_t>(std::distance(begin, end)));
     for (size_t i = 0; i < thread_count; i++) {
-      threads.push_back(std::move(all_threads[i]));
+      threads.push_back(
+          std::move(order == "desc" ? *std::prev(end, i + 1) : *(begin + i)));
     }
 
     return threads;
@@ -146,9 +280,20 @@ cpp::result<void, std::string> ThreadFsRepository::SaveThread(
     if (!file) {
       return cpp::fail("Failed to open file: " + path.string());
     }
-    file << thread.ToJson()->toStyledString();
+    auto json = thread.ToJson();
+    file << json->toStyledString();
     file.flush();
     file.close();
+
+    if (db_service_) {
+      auto res = db_service_->UpsertThreadEntry(
+          {thread.id, thread.created_at, Json::FastWriter().write(*json),
+           ModifiedTime(path)});
+      if (res.has_error()) {
+        CTL_WRN("Failed to index thread " << thread.id << ": " << res.error());
+        InvalidateIndex();
+      }
+    }
     return {};
   } catch (const std::exception& e) {
     file.close();
@@ -189,6 +334,14 @@ cpp::result<void, std::string> ThreadFsRepository::DeleteThread(
     } catch (const std::exception& e) {
       return cpp::fail(std::string("Failed to delete thread: ") + e.what());
     }
+    if (db_service_) {
+      if (auto res = db_service_->DeleteThreadEntry(thread_id);
+          res.has_error()) {
+        CTL_WRN("Failed to remove thread " << thread_id
+                                           << " from index: " << res.error());
+        InvalidateIndex();
+      }
+    }
   }
 
   std::unique_lock map_lock(map_mutex_);
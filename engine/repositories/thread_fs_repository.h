@@ -1,11 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <filesystem>
+#include <mutex>
 #include <shared_mutex>
 #include <unordered_map>
 #include "common/assistant.h"
 #include "common/repository/thread_repository.h"
 #include "common/thread.h"
+#include "services/database_service.h"
 #include "utils/logging_utils.h"
 
 // this interface is for backward supporting Jan
@@ -48,15 +51,50 @@ class ThreadFsRepository : public ThreadRepository,
 
   cpp::result<void, std::string> SaveThread(OpenAi::Thread& thread);
 
+  /**
+   * List threads by reading every thread folder, when the index is not
+   * available. Pages are the same as the index's, cursors included.
+   */
+  cpp::result<std::vector<OpenAi::Thread>, std::string> ScanThreads(
+      uint8_t limit, const std::string& order, const std::string& after,
+      const std::string& before) const;
+
+  /**
+   * Bring the index in line with the thread folders, which other
+   * applications such as Jan or older versions may have added, edited or
+   * removed. Only the thread files missing from the index or modified since
+   * they were indexed are read.
+   */
+  void IndexExistingThreads() const;
+
+  // Stops listing from the index, which missed a change, until it is
+  // reconciled with the thread folders again
+  void InvalidateIndex() const;
+
+  std::shared_ptr<DatabaseService> db_service_ = nullptr;
+  // Whether the index has every thread and can be listed from
+  mutable std::atomic<bool> index_ready_{false};
+  // Bumped by InvalidateIndex(), so that a reconciliation running meanwhile
+  // does not mark the index as ready
+  mutable std::atomic<uint64_t> index_failures_{0};
+  // Held by the listing that reconciles the index
+  mutable std::mutex reconcile_mutex_;
+
  public:
-  explicit ThreadFsRepository(const std::filesystem::path& data_folder_path)
-      : data_folder_path_{data_folder_path} {
+  // Without |db_service|, listing reads the thread folders
+  explicit ThreadFsRepository(
+      const std::filesystem::path& data_folder_path,
+      std::shared_ptr<DatabaseService> db_service = nullptr)
+      : data_folder_path_{data_folder_path}, db_service_(db_service) {
     CTL_INF("Constructing ThreadFsRepository..");
     auto thread_container_path = data_folder_path_ / kThreadContainerFolderName;
 
     if (!std::filesystem::exists(thread_container_path)) {
       std::filesystem::create_directories(thread_container_path);
     }
+    if (db_service_) {
+      IndexExistingThreads();
+    }
   }
 
   cpp::result<void, std::string> CreateThread(OpenAi::Thread& thread) override;
@@ -48,13 +48,13 @@ ConfigService::UpdateApiServerConfiguration(const Json::Value& json) {
 
 cpp::result<ApiServerConfiguration, std::string>
 ConfigService::GetApiServerConfiguration() {
-  auto config = file_manager_utils::GetCortexConfig();
+  auto config = file_manager_utils::GetCortexConfigSnapshot();
   return ApiServerConfiguration{
-      config.enableCors,       config.allowedOrigins,
-      config.verifyProxySsl,   config.verifyProxyHostSsl,
-      config.proxyUrl,         config.proxyUsername,
-      config.proxyPassword,    config.noProxy,
-      config.verifyPeerSsl,    config.verifyHostSsl,
-      config.huggingFaceToken, config.gitHubToken,
-      config.apiKeys};
+      config->enableCors,       config->allowedOrigins,
+      config->verifyProxySsl,   config->verifyProxyHostSsl,
+      config->proxyUrl,         config->proxyUsername,
+      config->proxyPassword,    config->noProxy,
+      config->verifyPeerSsl,    config->verifyHostSsl,
+      config->huggingFaceToken, config->gitHubToken,
+      config->apiKeys};
 }
@@ -60,6 +60,42 @@ cpp::result<void, std::string> DatabaseService::DeleteFileEntry(
 }
 // end file
 
+// begin threads
+// Without mtx_: the connection pool serializes the writes, and listing
+// threads does not wait behind model updates
+cpp::result<std::vector<ThreadEntry>, std::string>
+DatabaseService::GetThreadEntries(uint8_t limit, const std::string& order,
+                                  const std::string& after,
+                                  const std::string& before) const {
+  return cortex::db::Threads().GetThreadEntries(limit, order, after, before);
+}
+
+cpp::result<std::unordered_map<std::string, int64_t>, std::string>
+DatabaseService::GetThreadModifiedTimes() const {
+  return cortex::db::Threads().GetThreadModifiedTimes();
+}
+
+cpp::result<void, std::string> DatabaseService::UpsertThreadEntry(
+    const ThreadEntry& entry) {
+  return cortex::db::Threads().UpsertThreadEntry(entry);
+}
+
+cpp::result<void, std::string> DatabaseService::UpsertThreadEntries(
+    const std::vector<ThreadEntry>& entries) {
+  return cortex::db::Threads().UpsertThreadEntries(entries);
+}
+
+cpp::result<void, std::string> DatabaseService::DeleteThreadEntry(
+    const std::string& thread_id) {
+  return cortex::db::Threads().DeleteThreadEntry(thread_id);
+}
+
+cpp::result<void, std::string> DatabaseService::DeleteThreadEntries(
+    const std::vector<std::string>& thread_ids) {
+  return cortex::db::Threads().DeleteThreadEntries(thread_ids);
+}
+// end threads
+
 // begin hardware
 cpp::result<std::vector<HardwareEntry>, std::string>
 DatabaseService::LoadHardwareList() const {
@@ -113,32 +149,51 @@ cpp::result<ModelEntry, std::string> DatabaseService::GetModelInfo(
 cpp::result<bool, std::string> DatabaseService::AddModelEntry(
     ModelEntry new_entry) {
   std::lock_guard<std::mutex> l(mtx_);
-  return cortex::db::Models().AddModelEntry(new_entry);
+  auto res = cortex::db::Models().AddModelEntry(new_entry);
+  if (res.has_value()) {
+    models_version_++;
+  }
+  return res;
 }
 
 cpp::result<bool, std::string> DatabaseService::UpdateModelEntry(
     const std::string& identifier, const ModelEntry& updated_entry) {
   std::lock_guard<std::mutex> l(mtx_);
-  return cortex::db::Models().UpdateModelEntry(identifier, updated_entry);
+  auto res = cortex::db::Models().UpdateModelEntry(identifier, updated_entry);
+  if (res.has_value()) {
+    models_version_++;
+  }
+  return res;
 }
 
 cpp::result<bool, std::string> DatabaseService::DeleteModelEntry(
     const std::string& identifier) {
   std::lock_guard<std::mutex> l(mtx_);
-  return cortex::db::Models().DeleteModelEntry(identifier);
+  auto res = cortex::db::Models().DeleteModelEntry(identifier);
+  if (res.has_value()) {
+    models_version_++;
+  }
+  return res;
 }
 
 cpp::result<bool, std::string> DatabaseService::DeleteModelEntryWithOrg(
     const std::string& src) {
   std::lock_guard<std::mutex> l(mtx_);
-  return cortex::db::Models().DeleteModelEntryWithOrg(src);
+  auto res = cortex::db::Models().DeleteModelEntryWithOrg(src);
+  if (res.has_value()) {
+    models_version_++;
+  }
+  return res;
 }
 
 cpp::result<bool, std::string> DatabaseService::DeleteModelEntryWithRepo(
     const std::string& src) {
-
   std::lock_guard<std::mutex> l(mtx_);
-  return cortex::db::Models().DeleteModelEntryWithRepo(src);
+  auto res = cortex::db::Models().DeleteModelEntryWithRepo(src);
+  if (res.has_value()) {
+    models_version_++;
+  }
+  return res;
 }
 
 cpp::result<std::vector<std::string>, std::string>
@@ -1,13 +1,16 @@
 #pragma once
+#include <atomic>
 #include <mutex>
 #include "database/engines.h"
 #include "database/file.h"
 #include "database/hardware.h"
 #include "database/models.h"
+#include "database/threads.h"
 
 using EngineEntry = cortex::db::EngineEntry;
 using HardwareEntry = cortex::db::HardwareEntry;
 using ModelEntry = cortex::db::ModelEntry;
+using ThreadEntry = cortex::db::ThreadEntry;
 
 class DatabaseService {
  public:
@@ -36,6 +39,20 @@ class DatabaseService {
 
   cpp::result<void, std::string> DeleteFileEntry(const std::string& file_id);
 
+  // threads
+  cpp::result<std::vector<ThreadEntry>, std::string> GetThreadEntries(
+      uint8_t limit, const std::string& order, const std::string& after,
+      const std::string& before) const;
+  cpp::result<std::unordered_map<std::string, int64_t>, std::string>
+  GetThreadModifiedTimes() const;
+  cpp::result<void, std::string> UpsertThreadEntry(const ThreadEntry& entry);
+  cpp::result<void, std::string> UpsertThreadEntries(
+      const std::vector<ThreadEntry>& entries);
+  cpp::result<void, std::string> DeleteThreadEntry(
+      const std::string& thread_id);
+  cpp::result<void, std::string> DeleteThreadEntries(
+      const std::vector<std::string>& thread_ids);
+
   // hardware
   cpp::result<std::vector<HardwareEntry>, std::string> LoadHardwareList() const;
   cpp::result<bool, std::string> AddHardwareEntry(
@@ -68,7 +85,11 @@ class DatabaseService {
   cpp::result<std::vector<ModelEntry>, std::string> GetModels(
       const std::string& model_src) const;
   cpp::result<std::vector<ModelEntry>, std::string> GetModelSources() const;
+  // Changes with every write to the models table, for caches of what was
+  // read from it
+  uint64_t ModelsVersion() const { return models_version_; }
 
  private:
   mutable std::mutex mtx_;
+  std::atomic<uint64_t> models_version_{0};
 };
\ No newline at end of file
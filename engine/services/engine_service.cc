@@ -48,6 +48,15 @@ std::string Repo2Engine(const std::string& r) {
   }
   return r;
 };
+
+int GetMaxConcurrentRequests(const Json::Value& engine_json) {
+  const auto& metadata = engine_json["metadata"];
+  if (metadata.isObject() && metadata["max_concurrent_requests"].isInt() &&
+      metadata["max_concurrent_requests"].asInt() > 0) {
+    return metadata["max_concurrent_requests"].asInt();
+  }
+  return remote_engine::kDefaultMaxConcurrentRequests;
+}
 }  // namespace
 
 cpp::result<void, std::string> EngineService::InstallEngineAsync(
@@ -834,8 +843,9 @@ cpp::result<void, std::string> EngineService::LoadEngine(
     }
 
     if (!IsEngineLoaded(engine_name)) {
-      engines_[engine_name].engine =
-          new remote_engine::RemoteEngine(engine_name);
+      engines_[engine_name].engine = new remote_engine::RemoteEngine(
+          engine_name,
+          GetMaxConcurrentRequests(exist_engine.value().ToJson()));
       CTL_INF("Loaded engine: " << engine_name);
     }
     return {};
@@ -845,7 +855,7 @@ cpp::result<void, std::string> EngineService::LoadEngine(
 #if defined(_WIN32) || defined(_WIN64) || defined(__linux__)
     CTL_INF("CPU Info: " << cortex::cpuid::CpuInfo().to_string());
 #endif
-    engines_[ne].engine = new cortex::local::LocalEngine(*this, *(q_.get()));
+    engines_[ne].engine = new cortex::local::LocalEngine(*this);
     CTL_INF("Loaded engine: " << engine_name);
   } else {
     CTL_INF("Engine has already been loaded: " << engine_name);
@@ -1162,7 +1172,8 @@ cpp::result<Json::Value, std::string> EngineService::GetRemoteModels(
   }
 
   if (!IsEngineLoaded(engine_name)) {
-    engines_[engine_name].engine = new remote_engine::RemoteEngine(engine_name);
+    engines_[engine_name].engine = new remote_engine::RemoteEngine(
+        engine_name, GetMaxConcurrentRequests(exist_engine.value().ToJson()));
 
     CTL_INF("Loaded engine: " << engine_name);
   }
@@ -1188,8 +1199,8 @@ cpp::result<Json::Value, std::string> EngineService::GetRemoteModels(
 
 bool EngineService::IsRemoteEngine(const std::string& engine_name) const {
   auto ne = Repo2Engine(engine_name);
-  auto local_engines = file_manager_utils::GetCortexConfig().supportedEngines;
-  for (auto const& le : local_engines) {
+  auto config = file_manager_utils::GetCortexConfigSnapshot();
+  for (auto const& le : config->supportedEngines) {
     if (le == ne)
       return false;
   }
@@ -1198,5 +1209,5 @@ bool EngineService::IsRemoteEngine(const std::string& engine_name) const {
 
 cpp::result<std::vector<std::string>, std::string>
 EngineService::GetSupportedEngineNames() {
-  return file_manager_utils::GetCortexConfig().supportedEngines;
+  return file_manager_utils::GetCortexConfigSnapshot()->supportedEngines;
 }
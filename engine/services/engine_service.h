@@ -19,7 +19,6 @@
 #include "utils/github_release_utils.h"
 #include "utils/result.hpp"
 #include "utils/system_info_utils.h"
-#include "utils/task_queue.h"
 
 struct EngineUpdateResult {
   std::string engine;
@@ -60,13 +59,11 @@ class EngineService : public EngineServiceI {
   };
   HardwareInfo hw_inf_;
   std::shared_ptr<DatabaseService> db_service_ = nullptr;
-  std::shared_ptr<cortex::TaskQueue> q_ = nullptr;
 
  public:
   EngineService(std::shared_ptr<DownloadService> download_service,
                 std::shared_ptr<cortex::DylibPathManager> dylib_path_manager,
-                std::shared_ptr<DatabaseService> db_service,
-                std::shared_ptr<cortex::TaskQueue> q)
+                std::shared_ptr<DatabaseService> db_service)
       : download_service_{download_service},
         dylib_path_manager_{dylib_path_manager},
         hw_inf_{
@@ -75,8 +72,7 @@ class EngineService : public EngineServiceI {
             system_info_utils::GetDriverAndCudaVersion()
                 .second  //  cuda_driver_version.
         },
-        db_service_(db_service),
-        q_(q) {}
+        db_service_(db_service) {}
 
   EngineService(std::shared_ptr<cortex::DylibPathManager> dylib_path_manager)
       : dylib_path_manager_(dylib_path_manager),
@@ -44,12 +44,12 @@ cpp::result<void, std::string> FileService::DeleteFileLocal(
   return file_repository_->DeleteFileLocal(file_id);
 }
 
-cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
-FileService::RetrieveFileContent(const std::string& file_id) const {
+cpp::result<FileContent, std::string> FileService::RetrieveFileContent(
+    const std::string& file_id) const {
   return file_repository_->RetrieveFileContent(file_id);
 }
 
-cpp::result<std::pair<std::unique_ptr<char[]>, size_t>, std::string>
-FileService::RetrieveFileContentByPath(const std::string& path) const {
+cpp::result<FileContent, std::string> FileService::RetrieveFileContentByPath(
+    const std::string& path) const {
   return file_repository_->RetrieveFileContentByPath(path);
 }
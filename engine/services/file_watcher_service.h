@@ -127,6 +127,7 @@ class FileWatcherService {
         CTL_INF("File removed: " + std::string(paths[i]));
         CTL_INF("File event detected: " + std::string(paths[i]) +
                 " flags: " + std::to_string(eventFlags[i]));
+        watcher->model_service_->OnModelFileChanged(paths[i]);
         watcher->model_service_->ForceIndexingModelList();
       }
     }
@@ -195,7 +196,8 @@ class FileWatcherService {
     while (running_) {
       if (!ReadDirectoryChangesW(
               dir_handle, buffer, sizeof(buffer), TRUE,
-              FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME,
+              FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                  FILE_NOTIFY_CHANGE_LAST_WRITE,
               &bytesReturned, &overlapped, NULL)) {
         break;
       }
@@ -214,11 +216,16 @@ class FileWatcherService {
 
       FILE_NOTIFY_INFORMATION* event = (FILE_NOTIFY_INFORMATION*)buffer;
       do {
+        std::wstring fileName(event->FileName,
+                              event->FileNameLength / sizeof(wchar_t));
+        std::string file_name_str(fileName.begin(), fileName.end());
+        if (event->Action == FILE_ACTION_REMOVED ||
+            event->Action == FILE_ACTION_MODIFIED ||
+            event->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+          model_service_->OnModelFileChanged(
+              (std::filesystem::path(watch_path_) / file_name_str).string());
+        }
         if (event->Action == FILE_ACTION_REMOVED) {
-          std::wstring fileName(event->FileName,
-                                event->FileNameLength / sizeof(wchar_t));
-
-          std::string file_name_str(fileName.begin(), fileName.end());
           model_service_->ForceIndexingModelList();
         }
 
@@ -238,7 +245,8 @@ class FileWatcherService {
 #else  // Linux
 
   void AddWatch(const std::string& dirPath) {
-    const int watch_flags = IN_DELETE | IN_DELETE_SELF | IN_CREATE;
+    const int watch_flags = IN_DELETE | IN_DELETE_SELF | IN_CREATE |
+                            IN_CLOSE_WRITE | IN_MOVED_TO;
     wd = inotify_add_watch(fd, dirPath.c_str(), watch_flags);
     if (wd < 0) {
       throw std::runtime_error("Failed to add watch on " + dirPath + ": " +
@@ -346,6 +354,15 @@ class FileWatcherService {
           struct inotify_event* event =
               reinterpret_cast<struct inotify_event*>(&buffer[i]);
 
+          if (event->len > 0 &&
+              (event->mask & (IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_TO))) {
+            if (auto it = watch_descriptors.find(event->wd);
+                it != watch_descriptors.end()) {
+              model_service_->OnModelFileChanged(
+                  (std::filesystem::path(it->second) / event->name).string());
+            }
+          }
+
           if (event->mask & (IN_DELETE | IN_DELETE_SELF)) {
             try {
               model_service_->ForceIndexingModelList();
@@ -1,11 +1,40 @@
 #include "inference_service.h"
 #include <drogon/HttpTypes.h>
+#include <future>
 #include "utils/engine_constants.h"
 #include "utils/function_calling/common.h"
 #include "utils/jinja_utils.h"
 
+namespace {
+// Invokes the wrapped callback at most once. An engine that drops the load
+// callback without invoking it, on any path, answers with an error then, so
+// that no caller waits forever.
+class LoadCallback {
+ public:
+  explicit LoadCallback(std::function<void(InferResult&&)>&& on_done)
+      : on_done_(std::move(on_done)) {}
+
+  ~LoadCallback() {
+    Json::Value r;
+    Json::Value stt;
+    r["message"] = "Engine returned without answering the load request";
+    stt["status_code"] = drogon::k500InternalServerError;
+    (*this)(std::make_pair(stt, r));
+  }
+
+  void operator()(InferResult&& ir) {
+    if (auto on_done = std::exchange(on_done_, nullptr)) {
+      on_done(std::move(ir));
+    }
+  }
+
+ private:
+  std::function<void(InferResult&&)> on_done_;
+};
+}  // namespace
+
 cpp::result<void, InferResult> InferenceService::HandleChatCompletion(
-    std::shared_ptr<SyncQueue> q, std::shared_ptr<Json::Value> json_body) {
+    std::shared_ptr<InferChannel> q, std::shared_ptr<Json::Value> json_body) {
   std::string engine_type;
   if (!HasFieldInReq(json_body, "engine")) {
     engine_type = kLlamaRepo;
@@ -50,11 +79,15 @@ cpp::result<void, InferResult> InferenceService::HandleChatCompletion(
     if (!tool_choice.isNull()) {
       res["tool_choice"] = tool_choice;
     }
-    q->push(std::make_pair(status, res));
+    q->Push(std::make_pair(std::move(status), std::move(res)));
   };
   if (std::holds_alternative<EngineI*>(engine_result.value())) {
-    std::get<EngineI*>(engine_result.value())
-        ->HandleChatCompletion(json_body, std::move(cb));
+    auto engine = std::get<EngineI*>(engine_result.value());
+    if (json_body->get("stream", false).asBool()) {
+      engine->HandleStreamingChatCompletion(json_body, std::move(cb), q);
+    } else {
+      engine->HandleChatCompletion(json_body, std::move(cb));
+    }
   } else {
     std::get<RemoteEngineI*>(engine_result.value())
         ->HandleChatCompletion(json_body, std::move(cb));
@@ -64,7 +97,7 @@ cpp::result<void, InferResult> InferenceService::HandleChatCompletion(
 }
 
 cpp::result<void, InferResult> InferenceService::HandleEmbedding(
-    std::shared_ptr<SyncQueue> q, std::shared_ptr<Json::Value> json_body) {
+    std::shared_ptr<InferChannel> q, std::shared_ptr<Json::Value> json_body) {
   std::string engine_type;
   if (!HasFieldInReq(json_body, "engine")) {
     engine_type = kLlamaRepo;
@@ -83,7 +116,7 @@ cpp::result<void, InferResult> InferenceService::HandleEmbedding(
   }
 
   auto cb = [q](Json::Value status, Json::Value res) {
-    q->push(std::make_pair(status, res));
+    q->Push(std::make_pair(std::move(status), std::move(res)));
   };
   if (std::holds_alternative<EngineI*>(engine_result.value())) {
     std::get<EngineI*>(engine_result.value())
@@ -95,8 +128,9 @@ cpp::result<void, InferResult> InferenceService::HandleEmbedding(
   return {};
 }
 
-InferResult InferenceService::LoadModel(
-    std::shared_ptr<Json::Value> json_body) {
+void InferenceService::LoadModelAsync(
+    std::shared_ptr<Json::Value> json_body,
+    std::function<void(InferResult&&)>&& on_done) {
   std::string engine_type;
   if (!HasFieldInReq(json_body, "engine")) {
     engine_type = kLlamaRepo;
@@ -104,24 +138,39 @@ InferResult InferenceService::LoadModel(
     engine_type = (*(json_body)).get("engine", kLlamaRepo).asString();
   }
 
-  Json::Value r;
-  Json::Value stt;
   auto load_engine_result = engine_service_->LoadEngine(engine_type);
   if (load_engine_result.has_error()) {
     LOG_ERROR << "Could not load engine: " << load_engine_result.error();
 
+    Json::Value r;
+    Json::Value stt;
     r["message"] = "Could not load engine " + engine_type + ": " +
                    load_engine_result.error();
     stt["status_code"] = drogon::k500InternalServerError;
-    return std::make_pair(stt, r);
+    on_done(std::make_pair(stt, r));
+    return;
   }
 
+  // Save model config to reload if needed
+  auto model_id = json_body->get("model", "").asString();
+  saved_models_[model_id] = json_body;
+
   // might need mutex here
   auto engine_result = engine_service_->GetLoadedEngine(engine_type);
+  if (engine_result.has_error()) {
+    Json::Value r;
+    Json::Value stt;
+    r["message"] = "Engine is not loaded yet";
+    stt["status_code"] = drogon::k500InternalServerError;
+    on_done(std::make_pair(stt, r));
+    return;
+  }
 
-  auto cb = [&stt, &r](Json::Value status, Json::Value res) {
-    stt = status;
-    r = res;
+  // Local engines answer once the model server is up, possibly from another
+  // thread
+  auto done = std::make_shared<LoadCallback>(std::move(on_done));
+  auto cb = [done](Json::Value status, Json::Value res) {
+    (*done)(std::make_pair(std::move(status), std::move(res)));
   };
   if (std::holds_alternative<EngineI*>(engine_result.value())) {
     std::get<EngineI*>(engine_result.value())
@@ -130,10 +179,16 @@ InferResult InferenceService::LoadModel(
     std::get<RemoteEngineI*>(engine_result.value())
         ->LoadModel(json_body, std::move(cb));
   }
-  // Save model config to reload if needed
-  auto model_id = json_body->get("model", "").asString();
-  saved_models_[model_id] = json_body;
-  return std::make_pair(stt, r);
+}
+
+InferResult InferenceService::LoadModel(
+    std::shared_ptr<Json::Value> json_body) {
+  auto promise = std::make_shared<std::promise<InferResult>>();
+  auto result = promise->get_future();
+  LoadModelAsync(json_body, [promise](InferResult&& ir) {
+    promise->set_value(std::move(ir));
+  });
+  return result.get();
 }
 
 InferResult InferenceService::UnloadModel(const std::string& engine_name,
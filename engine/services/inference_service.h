@@ -1,47 +1,28 @@
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
-#include <queue>
+#include "common/infer_channel.h"
 #include "extensions/remote-engine/remote_engine.h"
 #include "services/engine_service.h"
 #include "services/model_service.h"
 #include "utils/result.hpp"
 
-// Status and result
-using InferResult = std::pair<Json::Value, Json::Value>;
-
-struct SyncQueue {
-  void push(InferResult&& p) {
-    std::unique_lock<std::mutex> l(mtx);
-    q.push(p);
-    cond.notify_one();
-  }
-
-  InferResult wait_and_pop() {
-    std::unique_lock<std::mutex> l(mtx);
-    cond.wait(l, [this] { return !q.empty(); });
-    auto res = q.front();
-    q.pop();
-    return res;
-  }
-
-  std::mutex mtx;
-  std::condition_variable cond;
-  std::queue<InferResult> q;
-};
-
 class InferenceService {
  public:
   explicit InferenceService(std::shared_ptr<EngineService> engine_service)
       : engine_service_{engine_service} {}
 
   cpp::result<void, InferResult> HandleChatCompletion(
-      std::shared_ptr<SyncQueue> q, std::shared_ptr<Json::Value> json_body);
+      std::shared_ptr<InferChannel> q, std::shared_ptr<Json::Value> json_body);
 
   cpp::result<void, InferResult> HandleEmbedding(
-      std::shared_ptr<SyncQueue> q, std::shared_ptr<Json::Value> json_body);
+      std::shared_ptr<InferChannel> q, std::shared_ptr<Json::Value> json_body);
+
+  // |on_done| is invoked exactly once, when the model is ready or failed to
+  // load, possibly from another thread
+  void LoadModelAsync(std::shared_ptr<Json::Value> json_body,
+                      std::function<void(InferResult&&)>&& on_done);
 
+  // Blocks until the model is ready or failed to load
   InferResult LoadModel(std::shared_ptr<Json::Value> json_body);
 
   InferResult UnloadModel(const std::string& engine,
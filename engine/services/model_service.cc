@@ -1,11 +1,14 @@
 #include "model_service.h"
 #include <curl/multi.h>
 #include <drogon/HttpTypes.h>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <optional>
 #include <ostream>
+#include <thread>
+#include <unordered_set>
 #include "config/gguf_parser.h"
 #include "config/yaml_config.h"
 #include "database/models.h"
@@ -21,6 +24,7 @@
 #include "utils/huggingface_utils.h"
 #include "utils/logging_utils.h"
 #include "utils/result.hpp"
+#include "utils/scope_exit.h"
 #include "utils/set_permission_utils.h"
 #include "utils/string_utils.h"
 #include "utils/widechar_conv.h"
@@ -152,6 +156,35 @@ cpp::result<DownloadTask, std::string> GetDownloadTask(
       /* .type = */ DownloadType::Model,
       /* .items = */ download_items};
 }
+
+// Changes when the file is replaced or rewritten, empty if it is missing
+std::string FileFingerprint(const std::string& path) {
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return {};
+  }
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return {};
+  }
+  return path + ":" + std::to_string(size) + ":" +
+         std::to_string(mtime.time_since_epoch().count());
+}
+
+std::string NormalizePath(const std::string& path) {
+  return std::filesystem::path(path).lexically_normal().string();
+}
+
+std::optional<hardware::GgufLayout> TryReadGgufLayout(
+    const std::string& path) {
+  try {
+    return hardware::ReadGgufLayout(path);
+  } catch (const std::exception& e) {
+    CTL_WRN("Failed to read " << path << ": " << e.what());
+    return std::nullopt;
+  }
+}
 }  // namespace
 
 ModelService::ModelService(std::shared_ptr<DatabaseService> db_service,
@@ -165,9 +198,9 @@ ModelService::ModelService(std::shared_ptr<DatabaseService> db_service,
       download_service_{download_service},
       inference_svc_(inference_service),
       engine_svc_(engine_svc),
-      task_queue_(task_queue){
-          // ProcessBgrTasks();
-      };
+      task_queue_(task_queue) {
+  ProcessBgrTasks();
+};
 
 void ModelService::ForceIndexingModelList() {
   CTL_INF("Force indexing model list");
@@ -210,8 +243,14 @@ void ModelService::ForceIndexingModelList() {
 
 std::optional<config::ModelConfig> ModelService::GetDownloadedModel(
     const std::string& modelId) const {
+  if (auto mc = FindModelConfig(modelId)) {
+    return *mc;
+  }
+  return std::nullopt;
+}
 
-  config::YamlHandler yaml_handler;
+std::optional<config::ModelConfig> ModelService::LoadDownloadedModel(
+    const std::string& modelId) const {
   auto model_entry = db_service_->GetModelInfo(modelId);
   if (!model_entry.has_value()) {
     return std::nullopt;
@@ -233,6 +272,33 @@ std::optional<config::ModelConfig> ModelService::GetDownloadedModel(
   }
 }
 
+std::shared_ptr<const config::ModelConfig> ModelService::FindModelConfig(
+    const std::string& model_id) const {
+  return catalog_.Get(model_id, [this](const std::string& id) {
+    std::shared_ptr<const config::ModelConfig> mc;
+    if (auto res = LoadDownloadedModel(id)) {
+      mc = std::make_shared<const config::ModelConfig>(std::move(*res));
+    }
+    return mc;
+  });
+}
+
+void ModelService::InvalidateModelCatalog(const std::string& model_id) {
+  catalog_.Invalidate(model_id);
+}
+
+void ModelService::InvalidateModelCatalog() {
+  catalog_.Clear();
+}
+
+void ModelService::OnModelFileChanged(const std::string& path) {
+  InvalidateEstimation(path);
+  auto ext = std::filesystem::path(path).extension();
+  if (ext == ".yml" || ext == ".yaml") {
+    InvalidateModelCatalog();
+  }
+}
+
 cpp::result<DownloadTask, std::string> ModelService::HandleDownloadUrlAsync(
     const std::string& url, std::optional<std::string> temp_model_id,
     std::optional<std::string> temp_name) {
@@ -344,31 +410,60 @@ ModelService::EstimateModel(const std::string& model_handle,
             fs::path(model_entry.value().path_to_model_yaml))
             .string());
     auto mc = yaml_handler.GetModelConfig();
-    assert(hw_service_);
-    auto hw_info = hw_service_->GetHardwareInfo();
-    int64_t free_vram_MiB = 0;
-    for (const auto& gpu : hw_info.gpus) {
-      free_vram_MiB += gpu.free_vram;
+    auto layout = GetGgufLayout(
+        fmu::ToAbsoluteCortexDataPath(fs::path(mc.files[0])).string());
+    if (!layout) {
+      return std::nullopt;
     }
-
-#if defined(__APPLE__) && defined(__MACH__)
-    free_vram_MiB = hw_info.ram.available_MiB;
-#endif
-
     return hardware::EstimateLLaMACppRun(
-        fmu::ToAbsoluteCortexDataPath(fs::path(mc.files[0])).string(),
-        {/* .ngl = */ mc.ngl,
-         /* .ctx_len = */ mc.ctx_len,
-         /* .n_batch = */ n_batch,
-         /* .n_ubatch = */ n_ubatch,
-         /* .kv_cache_type = */ kv_cache,
-         /* .free_vram_MiB = */ free_vram_MiB});
+        *layout, {/* .ngl = */ mc.ngl,
+                  /* .ctx_len = */ mc.ctx_len,
+                  /* .n_batch = */ n_batch,
+                  /* .n_ubatch = */ n_ubatch,
+                  /* .kv_cache_type = */ kv_cache,
+                  /* .free_vram_MiB = */ GetFreeVramMiB()});
   } catch (const std::exception& e) {
     return cpp::fail("Fail to get model status with ID '" + model_handle +
                      "': " + e.what());
   }
 }
 
+void ModelService::InvalidateEstimation(const std::string& path) {
+  std::lock_guard l(es_mtx_);
+  layouts_.erase(NormalizePath(path));
+}
+
+int64_t ModelService::GetFreeVramMiB() const {
+  assert(hw_service_);
+  auto hw_info = hw_service_->GetHardwareInfo();
+  int64_t free_vram_MiB = 0;
+  for (const auto& gpu : hw_info.gpus) {
+    free_vram_MiB += gpu.free_vram;
+  }
+
+#if defined(__APPLE__) && defined(__MACH__)
+  free_vram_MiB = hw_info.ram.available_MiB;
+#endif
+  return free_vram_MiB;
+}
+
+std::optional<hardware::GgufLayout> ModelService::GetGgufLayout(
+    const std::string& path) {
+  auto key = NormalizePath(path);
+  auto fingerprint = FileFingerprint(key);
+  {
+    std::lock_guard l(es_mtx_);
+    if (auto it = layouts_.find(key);
+        it != layouts_.end() && it->second.fingerprint == fingerprint) {
+      return it->second.layout;
+    }
+  }
+  auto layout = TryReadGgufLayout(key);
+  std::lock_guard l(es_mtx_);
+  layouts_[key] = CachedLayout{fingerprint, layout};
+  return layout;
+}
+
 bool ModelService::HasModel(const std::string& id) const {
   return db_service_->HasModel(id);
 }
@@ -1083,43 +1178,138 @@ ModelService::GetModelMetadata(const std::string& model_id) const {
 
 std::string ModelService::GetEngineByModelId(
     const std::string& model_id) const {
-  namespace fs = std::filesystem;
-  namespace fmu = file_manager_utils;
-  auto model_entry = db_service_->GetModelInfo(model_id);
-  if (model_entry.has_error()) {
-    CTL_WRN("Error: " + model_entry.error());
+  auto mc = FindModelConfig(model_id);
+  if (!mc) {
+    CTL_WRN("Error: Model not found: " + model_id);
     return "";
   }
-  config::YamlHandler yaml_handler;
-  yaml_handler.ModelConfigFromFile(
-      fmu::ToAbsoluteCortexDataPath(
-          fs::path(model_entry.value().path_to_model_yaml))
-          .string());
-  auto mc = yaml_handler.GetModelConfig();
-  CTL_DBG(mc.engine);
-  return mc.engine;
+  CTL_DBG(mc->engine);
+  return mc->engine;
 }
 
 void ModelService::ProcessBgrTasks() {
   CTL_INF("Start processing background tasks")
-  auto cb = [this] {
-    CTL_DBG("Estimate model resource usage");
-    auto list_entry = db_service_->LoadModelList();
-    if (list_entry) {
-      for (const auto& model_entry : list_entry.value()) {
-        // Only process local models
-        if (model_entry.status == cortex::db::ModelStatus::Downloaded) {
-          auto es = EstimateModel(model_entry.model);
-          if (es.has_value()) {
-            std::lock_guard l(es_mtx_);
-            es_[model_entry.model] = es.value();
-          }
+  auto cb = [this] { RefreshEstimations(); };
+
+  auto clone = cb;
+  task_queue_.RunInQueue(std::move(cb));
+  task_queue_.RunEvery(std::chrono::seconds(60), std::move(clone));
+}
+
+void ModelService::RefreshEstimations() {
+  namespace fs = std::filesystem;
+  namespace fmu = file_manager_utils;
+  // The timer may fire again while a slow first pass is still parsing
+  if (refreshing_.exchange(true)) {
+    return;
+  }
+  // Also reset when a step throws, or estimations would never refresh again
+  cortex::utils::ScopeExit se([this] { refreshing_ = false; });
+  auto start = std::chrono::steady_clock::now();
+  CTL_DBG("Estimate model resource usage");
+
+  struct Job {
+    std::string model;
+    std::string path;
+    std::string fingerprint;
+    int ngl;
+    int ctx_len;
+  };
+  std::vector<Job> jobs;
+  auto list_entry = db_service_->LoadModelList();
+  if (list_entry) {
+    config::YamlHandler yaml_handler;
+    for (const auto& model_entry : list_entry.value()) {
+      // Only process local models
+      if (model_entry.status != cortex::db::ModelStatus::Downloaded) {
+        continue;
+      }
+      try {
+        yaml_handler.ModelConfigFromFile(
+            fmu::ToAbsoluteCortexDataPath(
+                fs::path(model_entry.path_to_model_yaml))
+                .string());
+        auto mc = yaml_handler.GetModelConfig();
+        yaml_handler.Reset();
+        if (mc.files.empty()) {
+          continue;
         }
+        auto path = NormalizePath(
+            fmu::ToAbsoluteCortexDataPath(fs::path(mc.files[0])).string());
+        auto fingerprint = FileFingerprint(path);
+        jobs.push_back(
+            Job{model_entry.model, path, fingerprint, mc.ngl, mc.ctx_len});
+      } catch (const std::exception& e) {
+        CTL_WRN("Failed to read model config of " << model_entry.model << ": "
+                                                  << e.what());
       }
     }
+  }
+
+  // Only new and changed files are parsed, several at a time
+  std::vector<const Job*> stale;
+  {
+    std::lock_guard l(es_mtx_);
+    std::unordered_set<std::string> seen;
+    for (const auto& job : jobs) {
+      auto it = layouts_.find(job.path);
+      if ((it == layouts_.end() || it->second.fingerprint != job.fingerprint) &&
+          seen.insert(job.path).second) {
+        stale.push_back(&job);
+      }
+    }
+  }
+  std::vector<std::optional<hardware::GgufLayout>> parsed(stale.size());
+  std::atomic<size_t> next{0};
+  auto parse = [&] {
+    for (auto i = next++; i < stale.size(); i = next++) {
+      parsed[i] = TryReadGgufLayout(stale[i]->path);
+    }
   };
+  std::vector<std::thread> workers;
+  auto n_workers = std::min<size_t>(
+      stale.size(), std::clamp(std::thread::hardware_concurrency(), 1u, 4u));
+  for (size_t i = 1; i < n_workers; i++) {
+    workers.emplace_back(parse);
+  }
+  parse();
+  for (auto& w : workers) {
+    w.join();
+  }
 
-  auto clone = cb;
-  task_queue_.RunInQueue(std::move(cb));
-  task_queue_.RunEvery(std::chrono::seconds(60), std::move(clone));
+  // Free VRAM moves between cycles, estimating from a parsed layout is cheap
+  auto free_vram_MiB = jobs.empty() ? 0 : GetFreeVramMiB();
+  {
+    std::lock_guard l(es_mtx_);
+    for (size_t i = 0; i < stale.size(); i++) {
+      layouts_[stale[i]->path] = CachedLayout{stale[i]->fingerprint, parsed[i]};
+    }
+    std::unordered_map<std::string, std::optional<hardware::Estimation>> es;
+    std::unordered_set<std::string> paths;
+    for (const auto& job : jobs) {
+      paths.insert(job.path);
+      const auto& layout = layouts_[job.path].layout;
+      if (!layout) {
+        continue;
+      }
+      es[job.model] = hardware::EstimateLLaMACppRun(
+          *layout, {/* .ngl = */ job.ngl,
+                    /* .ctx_len = */ job.ctx_len,
+                    /* .n_batch = */ 2048,
+                    /* .n_ubatch = */ 2048,
+                    /* .kv_cache_type = */ "f16",
+                    /* .free_vram_MiB = */ free_vram_MiB});
+    }
+    // Drops the estimations and layouts of deleted models
+    es_ = std::move(es);
+    for (auto it = layouts_.begin(); it != layouts_.end();) {
+      it = paths.count(it->first) ? std::next(it) : layouts_.erase(it);
+    }
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  CTL_INF("Estimated " << jobs.size() << " models, parsed " << stale.size()
+                       << " model files in " << elapsed << " ms");
 }
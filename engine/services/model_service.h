@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <string>
@@ -11,6 +12,7 @@
 #include "services/hardware_service.h"
 #include "utils/hardware/gguf/gguf_file_estimate.h"
 #include "utils/task_queue.h"
+#include "utils/versioned_cache.h"
 
 class InferenceService;
 
@@ -80,18 +82,46 @@ class ModelService {
       const std::string& model_handle, const std::string& kv_cache = "f16",
       int n_batch = 2048, int n_ubatch = 2048);
 
+  // Forgets what was read from the model file at |path|, for changes that
+  // keep its size and modification time
+  void InvalidateEstimation(const std::string& path);
+
   cpp::result<std::shared_ptr<ModelMetadata>, std::string> GetModelMetadata(
       const std::string& model_id) const;
 
   std::string GetEngineByModelId(const std::string& model_id) const;
 
+  // Drops the cached config of |model_id|, for writes to its model.yml that
+  // do not go through the database
+  void InvalidateModelCatalog(const std::string& model_id);
+  void InvalidateModelCatalog();
+
+  // Called by the file watcher for files that are written, renamed or
+  // deleted under the models folder
+  void OnModelFileChanged(const std::string& path);
+
  private:
+  // The config of a model in the database, or nullptr for an id that is not
+  std::shared_ptr<const config::ModelConfig> FindModelConfig(
+      const std::string& model_id) const;
+
+  std::optional<config::ModelConfig> LoadDownloadedModel(
+      const std::string& model_id) const;
+
   cpp::result<std::optional<std::string>, std::string> MayFallbackToCpu(
       const std::string& model_path, int ngl, int ctx_len, int n_batch = 2048,
       int n_ubatch = 2048, const std::string& kv_cache_type = "f16");
 
   void ProcessBgrTasks();
 
+  // Re-estimates the downloaded models, parsing only the files that are new
+  // or changed since the last time
+  void RefreshEstimations();
+
+  int64_t GetFreeVramMiB() const;
+
+  std::optional<hardware::GgufLayout> GetGgufLayout(const std::string& path);
+
   int GetCpuThreads() const;
 
   std::shared_ptr<DatabaseService> db_service_;
@@ -101,7 +131,22 @@ class ModelService {
   std::unordered_set<std::string> bypass_stop_check_set_;
   std::shared_ptr<EngineServiceI> engine_svc_ = nullptr;
 
+  struct CachedLayout {
+    // path:size:mtime of the file it was read from
+    std::string fingerprint;
+    std::optional<hardware::GgufLayout> layout;
+  };
+
   std::mutex es_mtx_;
   std::unordered_map<std::string, std::optional<hardware::Estimation>> es_;
+  // By model file path
+  std::unordered_map<std::string, CachedLayout> layouts_;
+  std::atomic<bool> refreshing_{false};
+
+  // Model configs by id, so that routing a request to its engine does not
+  // read the database and model.yml every time. Cleared whenever the models
+  // table changes.
+  mutable cortex::utils::VersionedCache<config::ModelConfig> catalog_{
+      [this] { return db_service_->ModelsVersion(); }};
   cortex::TaskQueue& task_queue_;
 };
@@ -15,6 +15,10 @@ namespace hu = huggingface_utils;
 
 namespace {
 constexpr const int kModeSourceCacheSecs = 600;
+constexpr const auto kSyncHubInterval = std::chrono::hours(1);
+// Concurrent repository refreshes during a sync
+constexpr const size_t kMaxSyncJobs = 4;
+constexpr const int kProbeTimeoutSecs = 30;
 
 std::string GenSourceId(const std::string& author_hub,
                         const std::string& model_name) {
@@ -56,18 +60,37 @@ std::vector<ModelInfo> ParseJsonString(const std::string& json_str) {
   return models;
 }
 
+// The hub listing which changes whenever the models of a repository do. For
+// cortexso, models are branches, which the refs listing covers.
+std::string GetProbeUrl(const std::string& hub_author,
+                        const std::string& model_name) {
+  url_parser::Url url = {
+      /* .protocol = */ "https",
+      /* .host = */ kHuggingFaceHost,
+      /* .pathParams = */ {"api", "models", hub_author, model_name},
+      /* .queries = */ {},
+  };
+  if (hub_author == "cortexso") {
+    url.pathParams.push_back("refs");
+  }
+  return url.ToFullPath();
+}
+
 }  // namespace
 
 ModelSourceService::ModelSourceService(
     std::shared_ptr<DatabaseService> db_service)
     : db_service_(db_service) {
-  // TODO(sang) temporariy comment out because of race condition bug
-  // sync_db_thread_ = std::thread(&ModelSourceService::SyncModelSource, this);
   running_ = true;
+  sync_db_thread_ = std::thread(&ModelSourceService::SyncModelSource, this);
 }
 
 ModelSourceService::~ModelSourceService() {
-  running_ = false;
+  {
+    std::lock_guard l(sync_mtx_);
+    running_ = false;
+  }
+  sync_cv_.notify_all();
   if (sync_db_thread_.joinable()) {
     sync_db_thread_.join();
   }
@@ -98,16 +121,13 @@ cpp::result<bool, std::string> ModelSourceService::AddModelSource(
     } else {  // Repo
       auto const& hub_author = r.pathParams[0];
       auto const& model_name = r.pathParams[1];
-      // Return cache value
-      if (auto key = GenSourceId(hub_author, model_name);
-          src_cache_.find(key) != src_cache_.end()) {
-        auto now = std::chrono::system_clock::now();
-        if (std::chrono::duration_cast<std::chrono::seconds>(now -
-                                                             src_cache_.at(key))
-                .count() < kModeSourceCacheSecs) {
-          CTL_DBG("Return cache value for model source: " << model_source);
-          return true;
-        }
+      auto source_id = GenSourceId(hub_author, model_name);
+      auto source_mtx = GetSourceMutex(source_id);
+      std::lock_guard source_lock(*source_mtx);
+      // Return cache value, a refresh may just have finished
+      if (IsCached(source_id)) {
+        CTL_DBG("Return cache value for model source: " << model_source);
+        return true;
       }
 
       if (r.pathParams[0] == "cortexso") {
@@ -155,6 +175,9 @@ cpp::result<bool, std::string> ModelSourceService::RemoveModelSource(
         return cpp::fail(del_res.error());
       }
     } else {
+      auto source_mtx =
+          GetSourceMutex(GenSourceId(r.pathParams[0], r.pathParams[1]));
+      std::lock_guard source_lock(*source_mtx);
       if (auto del_res = db_service_->DeleteModelEntryWithRepo(model_source);
           del_res.has_error()) {
         CTL_INF(del_res.error());
@@ -297,8 +320,7 @@ cpp::result<bool, std::string> ModelSourceService::AddHfRepo(
       }
     }
   }
-  src_cache_[GenSourceId(hub_author, model_name)] =
-      std::chrono::system_clock::now();
+  MarkCached(GenSourceId(hub_author, model_name));
   return true;
 }
 
@@ -477,8 +499,7 @@ cpp::result<bool, std::string> ModelSourceService::AddCortexsoRepo(
       "Duration ms: " << std::chrono::duration_cast<std::chrono::milliseconds>(
                              end - begin)
                              .count());
-  src_cache_[GenSourceId(hub_author, model_name)] =
-      std::chrono::system_clock::now();
+  MarkCached(GenSourceId(hub_author, model_name));
   return true;
 }
 
@@ -547,73 +568,150 @@ cpp::result<std::string, std::string> ModelSourceService::AddCortexsoRepoBranch(
   return {};
 }
 
-void ModelSourceService::SyncModelSource() {
-  while (running_) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    auto now = std::chrono::system_clock::now();
-    auto config = file_manager_utils::GetCortexConfig();
-    auto last_check =
-        std::chrono::system_clock::time_point(
-            std::chrono::milliseconds(config.checkedForSyncHubAt)) +
-        std::chrono::hours(1);
-    if (now > last_check) {
-      CTL_DBG("Start to sync cortex.db");
-
-      auto res = db_service_->GetModelSources();
-      if (res.has_error()) {
-        CTL_INF(res.error());
-      } else {
-        for (auto const& src : res.value()) {
-          CTL_DBG(src.model_source);
-        }
+bool ModelSourceService::IsCached(const std::string& source_id) {
+  std::lock_guard l(cache_mtx_);
+  auto it = src_cache_.find(source_id);
+  return it != src_cache_.end() &&
+         std::chrono::system_clock::now() - it->second <
+             std::chrono::seconds(kModeSourceCacheSecs);
+}
 
-        std::unordered_set<std::string> orgs;
-        std::vector<std::string> repos;
-        for (auto const& src : res.value()) {
-          auto url_res = url_parser::FromUrlString(src.model_source);
-          if (url_res.has_value()) {
-            if (url_res->pathParams.size() == 1) {
-              orgs.insert(src.model_source);
-            } else if (url_res->pathParams.size() == 2) {
-              repos.push_back(src.model_source);
-            }
-          }
-        }
+void ModelSourceService::MarkCached(const std::string& source_id) {
+  std::lock_guard l(cache_mtx_);
+  src_cache_[source_id] = std::chrono::system_clock::now();
+}
 
-        // Get list to update
-        std::vector<std::string> update_cand(orgs.begin(), orgs.end());
-        auto get_org = [](const std::string& rp) {
-          return rp.substr(0, rp.find_last_of("/"));
-        };
-        for (auto const& repo : repos) {
-          if (orgs.find(get_org(repo)) != orgs.end()) {
-            update_cand.push_back(repo);
-          }
-        }
+std::shared_ptr<std::mutex> ModelSourceService::GetSourceMutex(
+    const std::string& source_id) {
+  std::lock_guard l(cache_mtx_);
+  auto& mtx = source_mtxs_[source_id];
+  if (!mtx) {
+    mtx = std::make_shared<std::mutex>();
+  }
+  return mtx;
+}
 
-        // Sync cortex.db with the upstream data
-        for (auto const& c : update_cand) {
-          if (auto res = AddModelSource(c); res.has_error()) {
-            CTL_INF(res.error();)
-          }
-        }
-      }
+cpp::result<bool, std::string> ModelSourceService::SyncRepo(
+    const std::string& model_source) {
+  auto url_res = url_parser::FromUrlString(model_source);
+  if (url_res.has_error()) {
+    return cpp::fail(url_res.error());
+  }
+  auto const& hub_author = url_res->pathParams[0];
+  auto const& model_name = url_res->pathParams[1];
+  auto source_id = GenSourceId(hub_author, model_name);
+  auto source_mtx = GetSourceMutex(source_id);
+  std::lock_guard source_lock(*source_mtx);
+  if (IsCached(source_id)) {
+    return true;
+  }
+
+  std::string etag;
+  {
+    std::lock_guard l(cache_mtx_);
+    if (auto it = etags_.find(model_source); it != etags_.end()) {
+      etag = it->second;
+    }
+  }
+  // Shutting down interrupts the probe instead of waiting for its timeout
+  auto probe = curl_utils::ConditionalGet(GetProbeUrl(hub_author, model_name),
+                                          etag, kProbeTimeoutSecs,
+                                          [this] { return !running_; });
+  if (probe.has_error()) {
+    return cpp::fail(probe.error());
+  }
+  if (!running_) {
+    return cpp::fail("Sync stopped");
+  }
+  if (probe->not_modified) {
+    CTL_DBG("Model source is up to date: " << model_source);
+    MarkCached(source_id);
+    return true;
+  }
 
-      CTL_DBG("Done sync cortex.db");
+  auto res = hub_author == "cortexso"
+                 ? AddCortexsoRepo(model_source, hub_author, model_name)
+                 : AddHfRepo(model_source, hub_author, model_name);
+  // Only a complete refresh may be skipped next time
+  if (res.has_value() && !probe->etag.empty()) {
+    std::lock_guard l(cache_mtx_);
+    etags_[model_source] = probe->etag;
+  }
+  return res;
+}
 
-      auto now = std::chrono::system_clock::now();
-      auto config = file_manager_utils::GetCortexConfig();
-      config.checkedForSyncHubAt =
-          std::chrono::duration_cast<std::chrono::milliseconds>(
-              now.time_since_epoch())
-              .count();
+void ModelSourceService::SyncModelSourcesOnce() {
+  auto begin = std::chrono::steady_clock::now();
+  auto res = db_service_->GetModelSources();
+  if (res.has_error()) {
+    CTL_INF(res.error());
+    return;
+  }
+
+  // Organization sources are not supported yet, see AddModelSource
+  std::vector<std::string> repos;
+  std::unordered_set<std::string> seen;
+  for (auto const& src : res.value()) {
+    auto url_res = url_parser::FromUrlString(src.model_source);
+    if (url_res.has_value() && url_res->pathParams.size() == 2 &&
+        seen.insert(src.model_source).second) {
+      repos.push_back(src.model_source);
+    }
+  }
 
-      auto upd_config_res =
-          config_yaml_utils::CortexConfigMgr::GetInstance().DumpYamlConfig(
-              config, file_manager_utils::GetConfigurationPath().string());
-      if (upd_config_res.has_error()) {
-        CTL_ERR("Failed to update config file: " << upd_config_res.error());
+  // Sync cortex.db with the upstream data
+  std::atomic<size_t> next{0};
+  auto sync = [&] {
+    for (auto i = next++; i < repos.size() && running_; i = next++) {
+      if (auto r = SyncRepo(repos[i]); r.has_error()) {
+        CTL_INF(repos[i] << ": " << r.error());
       }
     }
+  };
+  std::vector<std::thread> workers;
+  auto n_workers = std::min(repos.size(), kMaxSyncJobs);
+  for (size_t i = 1; i < n_workers; i++) {
+    workers.emplace_back(sync);
+  }
+  sync();
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  CTL_INF("Synced " << repos.size() << " model sources in "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - begin)
+                           .count()
+                    << " ms");
+}
+
+void ModelSourceService::SyncModelSource() {
+  auto next_sync =
+      std::chrono::system_clock::time_point(std::chrono::milliseconds(
+          file_manager_utils::GetCortexConfigSnapshot()->checkedForSyncHubAt)) +
+      kSyncHubInterval;
+
+  std::unique_lock l(sync_mtx_);
+  while (!sync_cv_.wait_until(l, next_sync, [this] { return !running_; })) {
+    l.unlock();
+    CTL_DBG("Start to sync cortex.db");
+    SyncModelSourcesOnce();
+    CTL_DBG("Done sync cortex.db");
+
+    auto now = std::chrono::system_clock::now();
+    next_sync = now + kSyncHubInterval;
+    auto config = file_manager_utils::GetCortexConfig();
+    config.checkedForSyncHubAt =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch())
+            .count();
+
+    auto upd_config_res =
+        config_yaml_utils::CortexConfigMgr::GetInstance().DumpYamlConfig(
+            config, file_manager_utils::GetConfigurationPath().string());
+    if (upd_config_res.has_error()) {
+      CTL_ERR("Failed to update config file: " << upd_config_res.error());
+    }
+    l.lock();
   }
 }
@@ -1,5 +1,8 @@
 #pragma once
 #include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
@@ -91,14 +94,38 @@ class ModelSourceService {
       const std::string& model_name, const std::string& branch,
       const std::string& metadata, const std::string& desc);
 
+  // Sleeps until the next sync is due, or the service stops
   void SyncModelSource();
 
+  // Refreshes the repositories of all model sources, several at a time
+  void SyncModelSourcesOnce();
+
+  // Refreshes |model_source| unless its hub listing has the ETag it had at
+  // the last refresh
+  cpp::result<bool, std::string> SyncRepo(const std::string& model_source);
+
+  bool IsCached(const std::string& source_id);
+  void MarkCached(const std::string& source_id);
+
+  // Serializes the refreshes and removal of one repository. A refresh reads
+  // the source's models and then adds and deletes rows, which must not
+  // interleave with another refresh of the same source.
+  std::shared_ptr<std::mutex> GetSourceMutex(const std::string& source_id);
+
  private:
   std::shared_ptr<DatabaseService> db_service_ = nullptr;
   std::thread sync_db_thread_;
   std::atomic<bool> running_;
+  std::mutex sync_mtx_;
+  std::condition_variable sync_cv_;
 
   std::unordered_map<std::string, std::vector<ModelInfo>> cortexso_repos_;
   using TimePoint = std::chrono::time_point<std::chrono::system_clock>;
+  // Guards src_cache_ and etags_, which handlers and the sync thread share
+  std::mutex cache_mtx_;
   std::unordered_map<std::string, TimePoint> src_cache_;
+  // ETag of the hub listing by model source, as of its last refresh
+  std::unordered_map<std::string, std::string> etags_;
+  // By source id, guarded by cache_mtx_
+  std::unordered_map<std::string, std::shared_ptr<std::mutex>> source_mtxs_;
 };
\ No newline at end of file
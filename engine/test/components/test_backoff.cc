@@ -0,0 +1,30 @@
+#include "gtest/gtest.h"
+#include "utils/backoff.h"
+
+using cortex::utils::ExponentialBackoff;
+using namespace std::chrono_literals;
+
+class BackoffTest : public ::testing::Test {};
+
+TEST_F(BackoffTest, DoublesUpToMax) {
+  ExponentialBackoff backoff(10ms, 50ms);
+  EXPECT_EQ(backoff.Next(), 10ms);
+  EXPECT_EQ(backoff.Next(), 20ms);
+  EXPECT_EQ(backoff.Next(), 40ms);
+  EXPECT_EQ(backoff.Next(), 50ms);
+  EXPECT_EQ(backoff.Next(), 50ms);
+}
+
+TEST_F(BackoffTest, ResetStartsOver) {
+  ExponentialBackoff backoff(5ms, 100ms);
+  backoff.Next();
+  backoff.Next();
+  backoff.Reset();
+  EXPECT_EQ(backoff.Next(), 5ms);
+}
+
+TEST_F(BackoffTest, MaxBelowInitialKeepsInitial) {
+  ExponentialBackoff backoff(20ms, 10ms);
+  EXPECT_EQ(backoff.Next(), 20ms);
+  EXPECT_EQ(backoff.Next(), 20ms);
+}
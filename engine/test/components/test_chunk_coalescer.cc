@@ -0,0 +1,51 @@
+#include <string>
+#include "gtest/gtest.h"
+#include "utils/chunk_coalescer.h"
+
+using cortex::utils::ChunkCoalescer;
+using namespace std::chrono_literals;
+
+class ChunkCoalescerTest : public ::testing::Test {
+ protected:
+  ChunkCoalescer::Clock::time_point t0_ = ChunkCoalescer::Clock::now();
+};
+
+TEST_F(ChunkCoalescerTest, FirstChunkIsFlushedRightAway) {
+  ChunkCoalescer c(1024, 10ms);
+  EXPECT_TRUE(c.Append("data: a\n\n", t0_));
+  EXPECT_EQ(c.Take(t0_), "data: a\n\n");
+  EXPECT_TRUE(c.Empty());
+}
+
+TEST_F(ChunkCoalescerTest, BurstIsCoalescedUntilInterval) {
+  ChunkCoalescer c(1024, 10ms);
+  c.Append("a", t0_);
+  c.Take(t0_);
+
+  EXPECT_FALSE(c.Append("b", t0_ + 1ms));
+  EXPECT_FALSE(c.Append("c", t0_ + 2ms));
+  EXPECT_EQ(c.FlushDeadline(), t0_ + 10ms);
+  EXPECT_TRUE(c.Append("d", t0_ + 10ms));
+  EXPECT_EQ(c.Take(t0_ + 10ms), "bcd");
+}
+
+TEST_F(ChunkCoalescerTest, ByteBudgetForcesFlush) {
+  ChunkCoalescer c(8, 10ms);
+  c.Append("a", t0_);
+  c.Take(t0_);
+
+  EXPECT_FALSE(c.Append("1234", t0_ + 1ms));
+  EXPECT_TRUE(c.Append("5678", t0_ + 1ms));
+  EXPECT_EQ(c.Size(), 8u);
+}
+
+TEST_F(ChunkCoalescerTest, LargeFrameIsKeptWhole) {
+  ChunkCoalescer c(16, 10ms);
+  c.Append("a", t0_);
+  c.Take(t0_);
+
+  // Bigger than any write buffer, must not be truncated
+  std::string frame = "data: " + std::string(100000, 'x') + "\n\n";
+  EXPECT_TRUE(c.Append(std::string(frame), t0_ + 1ms));
+  EXPECT_EQ(c.Take(t0_ + 1ms), frame);
+}
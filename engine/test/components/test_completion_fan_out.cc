@@ -0,0 +1,111 @@
+#include <thread>
+#include <vector>
+#include "extensions/local-engine/completion_fan_out.h"
+#include "gtest/gtest.h"
+
+using cortex::local::CompletionFanOut;
+
+class CompletionFanOutTest : public ::testing::Test {};
+
+namespace {
+Json::Value MakeCompletion(const std::string& content, int prompt_tokens,
+                           int completion_tokens) {
+  Json::Value r;
+  r["object"] = "chat.completion";
+  Json::Value choice;
+  choice["index"] = 0;
+  choice["message"]["role"] = "assistant";
+  choice["message"]["content"] = content;
+  r["choices"].append(choice);
+  r["usage"]["prompt_tokens"] = prompt_tokens;
+  r["usage"]["completion_tokens"] = completion_tokens;
+  r["usage"]["total_tokens"] = prompt_tokens + completion_tokens;
+  return r;
+}
+}  // namespace
+
+TEST_F(CompletionFanOutTest, ChoiceRequestsDifferOnlyInSeed) {
+  Json::Value body;
+  body["n"] = 3;
+  body["seed"] = 42;
+  body["messages"][0]["content"] = "Hello";
+
+  auto first = cortex::local::MakeChoiceRequest(body, 0);
+  auto second = cortex::local::MakeChoiceRequest(body, 1);
+  EXPECT_EQ(first["n"].asInt(), 1);
+  EXPECT_TRUE(first["cache_prompt"].asBool());
+  EXPECT_EQ(first["seed"].asInt(), 42);
+  EXPECT_EQ(second["seed"].asInt(), 43);
+  EXPECT_EQ(first["messages"], second["messages"]);
+
+  body["seed"] = -1;
+  body["cache_prompt"] = false;
+  auto random = cortex::local::MakeChoiceRequest(body, 2);
+  EXPECT_EQ(random["seed"].asInt(), -1);
+  EXPECT_FALSE(random["cache_prompt"].asBool());
+}
+
+TEST_F(CompletionFanOutTest, MergesChoicesAndUsage) {
+  std::vector<Json::Value> responses;
+  responses.push_back(MakeCompletion("a", 10, 3));
+  responses.push_back(MakeCompletion("b", 10, 4));
+  responses.push_back(MakeCompletion("c", 10, 5));
+
+  auto res = cortex::local::MergeChatCompletions(std::move(responses));
+  ASSERT_EQ(res["choices"].size(), 3u);
+  for (Json::ArrayIndex i = 0; i < 3; i++) {
+    EXPECT_EQ(res["choices"][i]["index"].asUInt(), i);
+  }
+  EXPECT_EQ(res["choices"][2]["message"]["content"].asString(), "c");
+  EXPECT_EQ(res["usage"]["prompt_tokens"].asInt(), 10);
+  EXPECT_EQ(res["usage"]["completion_tokens"].asInt(), 12);
+  EXPECT_EQ(res["usage"]["total_tokens"].asInt(), 22);
+}
+
+TEST_F(CompletionFanOutTest, OrdersResponsesFromConcurrentRequests) {
+  constexpr int kChoices = 8;
+  int calls = 0;
+  std::vector<Json::Value> result;
+  CompletionFanOut fan_out(kChoices, [&](CompletionFanOut::Result&& r) {
+    calls++;
+    ASSERT_TRUE(r.has_value());
+    result = std::move(r.value());
+  });
+
+  std::vector<std::thread> threads;
+  for (int i = kChoices - 1; i >= 0; i--) {
+    threads.emplace_back([&fan_out, i] {
+      fan_out.Complete(i, MakeCompletion(std::to_string(i), 1, 1));
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(calls, 1);
+  ASSERT_EQ(result.size(), static_cast<size_t>(kChoices));
+  for (int i = 0; i < kChoices; i++) {
+    EXPECT_EQ(result[i]["choices"][0]["message"]["content"].asString(),
+              std::to_string(i));
+  }
+}
+
+TEST_F(CompletionFanOutTest, ReportsFirstErrorOnce) {
+  int calls = 0;
+  int status_code = 0;
+  CompletionFanOut fan_out(3, [&](CompletionFanOut::Result&& r) {
+    calls++;
+    ASSERT_TRUE(r.has_error());
+    status_code = r.error().status_code;
+  });
+
+  fan_out.Complete(0, MakeCompletion("a", 1, 1));
+  Json::Value error;
+  error["error"] = "slot unavailable";
+  fan_out.Fail(503, std::move(error));
+  fan_out.Fail(500, Json::Value());
+  fan_out.Complete(2, MakeCompletion("c", 1, 1));
+
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(status_code, 503);
+}
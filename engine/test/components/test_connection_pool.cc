@@ -0,0 +1,104 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include "database/connection_pool.h"
+#include "gtest/gtest.h"
+
+namespace cortex::db {
+namespace {
+constexpr const auto kTestDb = "./test_pool.db";
+}
+
+class ConnectionPoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Remove();
+    pool_ = std::make_unique<ConnectionPool>(kTestDb, 2);
+    pool_->Writer()->db().exec(
+        "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT)");
+  }
+
+  void TearDown() override {
+    pool_.reset();
+    Remove();
+  }
+
+  static void Remove() {
+    for (auto suffix : {"", "-wal", "-shm"}) {
+      std::filesystem::remove(std::string(kTestDb) + suffix);
+    }
+  }
+
+  static int Count(ConnectionPool::Lease& conn) {
+    auto& query = conn->Prepare("SELECT COUNT(*) FROM items");
+    query.executeStep();
+    return query.getColumn(0).getInt();
+  }
+
+  std::unique_ptr<ConnectionPool> pool_;
+};
+
+TEST_F(ConnectionPoolTest, UsesWal) {
+  auto conn = pool_->Reader();
+  auto& query = conn->Prepare("PRAGMA journal_mode");
+  ASSERT_TRUE(query.executeStep());
+  EXPECT_EQ(query.getColumn(0).getString(), "wal");
+}
+
+TEST_F(ConnectionPoolTest, ReusesPreparedStatements) {
+  auto conn = pool_->Writer();
+  auto& insert = conn->Prepare("INSERT INTO items (name) VALUES (?)");
+  insert.bind(1, "a");
+  insert.exec();
+  auto& again = conn->Prepare("INSERT INTO items (name) VALUES (?)");
+  EXPECT_EQ(&insert, &again);
+  again.bind(1, "b");
+  again.exec();
+  EXPECT_EQ(Count(conn), 2);
+}
+
+TEST_F(ConnectionPoolTest, ReadersDoNotWaitForWriter) {
+  auto writer = pool_->Writer();
+  writer->db().exec("BEGIN TRANSACTION;");
+  writer->db().exec("INSERT INTO items (name) VALUES ('uncommitted')");
+  {
+    // Sees the last committed state
+    auto reader = pool_->Reader();
+    EXPECT_EQ(Count(reader), 0);
+  }
+  writer->db().exec("COMMIT;");
+  auto reader = pool_->Reader();
+  EXPECT_EQ(Count(reader), 1);
+}
+
+TEST_F(ConnectionPoolTest, ReadersAreReadOnly) {
+  auto reader = pool_->Reader();
+  EXPECT_THROW(reader->db().exec("INSERT INTO items (name) VALUES ('x')"),
+               std::exception);
+}
+
+TEST_F(ConnectionPoolTest, WaitsForFreeReader) {
+  auto first = pool_->Reader();
+  auto second = std::make_unique<ConnectionPool::Lease>(pool_->Reader());
+  std::atomic<bool> leased{false};
+  std::thread t([&] {
+    auto third = pool_->Reader();
+    leased = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(leased);
+  second.reset();
+  t.join();
+  EXPECT_TRUE(leased);
+}
+
+TEST_F(ConnectionPoolTest, SingleConnectionServesReadsAndWrites) {
+  SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+  ConnectionPool pool(db);
+  pool.Writer()->db().exec("CREATE TABLE items (id INTEGER PRIMARY KEY)");
+  pool.Writer()->db().exec("INSERT INTO items DEFAULT VALUES");
+  auto reader = pool.Reader();
+  EXPECT_EQ(Count(reader), 1);
+}
+}  // namespace cortex::db
@@ -199,4 +199,52 @@ TEST_F(CortexConfigTest, FromYaml_IncompleteConfigUsesDefaults) {
             default_config.latestRelease);  // Default value
 }
 
+TEST_F(CortexConfigTest, Snapshot_ReusesParsedConfig) {
+  auto& mgr = cyu::CortexConfigMgr::GetInstance();
+  auto result = mgr.DumpYamlConfig(default_config, test_file_path);
+  EXPECT_FALSE(result.has_error());
+
+  int parsed = 0;
+  auto default_cfg = [this, &parsed] {
+    parsed++;
+    return default_config;
+  };
+  auto first = mgr.Snapshot(test_file_path, default_cfg);
+  auto second = mgr.Snapshot(test_file_path, default_cfg);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(parsed, 0);
+  EXPECT_EQ(first->logFolderPath, default_config.logFolderPath);
+}
+
+TEST_F(CortexConfigTest, Snapshot_SeesDumpedConfig) {
+  auto& mgr = cyu::CortexConfigMgr::GetInstance();
+  auto default_cfg = [this] { return default_config; };
+  EXPECT_FALSE(mgr.DumpYamlConfig(default_config, test_file_path).has_error());
+  auto before = mgr.Snapshot(test_file_path, default_cfg);
+
+  auto config = default_config;
+  config.apiKeys = {"key"};
+  EXPECT_FALSE(mgr.DumpYamlConfig(config, test_file_path).has_error());
+  auto after = mgr.Snapshot(test_file_path, default_cfg);
+  EXPECT_NE(before, after);
+  EXPECT_EQ(after->apiKeys, std::vector<std::string>{"key"});
+  EXPECT_TRUE(before->apiKeys.empty());
+}
+
+TEST_F(CortexConfigTest, Snapshot_ReloadsFileChangedOnDisk) {
+  auto& mgr = cyu::CortexConfigMgr::GetInstance();
+  auto default_cfg = [this] { return default_config; };
+  EXPECT_FALSE(mgr.DumpYamlConfig(default_config, test_file_path).has_error());
+  mgr.Snapshot(test_file_path, default_cfg, std::chrono::milliseconds(0));
+
+  std::ofstream out_file(test_file_path);
+  out_file << "logFolderPath: edited_by_hand\n";
+  out_file.close();
+
+  auto config =
+      mgr.Snapshot(test_file_path, default_cfg, std::chrono::milliseconds(0));
+  EXPECT_EQ(config->logFolderPath, "edited_by_hand");
+  EXPECT_EQ(config->dataFolderPath, default_config.dataFolderPath);
+}
+
 }  // namespace config_yaml_utils
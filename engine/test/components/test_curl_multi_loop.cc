@@ -0,0 +1,139 @@
+#include <chrono>
+#include <future>
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "common/infer_channel.h"
+#include "gtest/gtest.h"
+#include "utils/curl_multi_loop.h"
+
+using curl_utils::CurlMultiLoop;
+using namespace std::chrono_literals;
+
+class CurlMultiLoopTest : public ::testing::Test {};
+
+#if !defined(_WIN32)
+namespace {
+// A server that accepts connections into its backlog and never answers, like
+// llama-server busy with a long prompt
+class SilentServer {
+ public:
+  SilentServer() {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    listen(fd_, 8);
+    socklen_t len = sizeof(addr);
+    getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+  }
+  ~SilentServer() { close(fd_); }
+
+  std::string Url() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/completion";
+  }
+
+ private:
+  int fd_;
+  int port_;
+};
+}  // namespace
+
+TEST_F(CurlMultiLoopTest, CancelAbortsTransferRightAway) {
+  SilentServer server;
+  CurlMultiLoop loop("test");
+  std::promise<CURLcode> done;
+
+  CurlMultiLoop::Request req;
+  req.url = server.Url();
+  req.body = "{}";
+  req.on_done = [&done](CURLcode code, long) { done.set_value(code); };
+  auto id = loop.Add(std::move(req));
+  loop.Cancel(id);
+
+  auto f = done.get_future();
+  ASSERT_EQ(f.wait_for(2s), std::future_status::ready);
+  EXPECT_EQ(f.get(), CURLE_ABORTED_BY_CALLBACK);
+  EXPECT_EQ(loop.GetInflightCount(), 0u);
+}
+
+TEST_F(CurlMultiLoopTest, HandleCancelledBeforeBindCancelsTransfer) {
+  SilentServer server;
+  CurlMultiLoop loop("test");
+  auto sink = std::make_shared<InferChannel>();
+  auto handle = std::make_shared<curl_utils::TransferHandle>();
+  sink->OnClosed([handle] { handle->Cancel(); });
+  // The client leaves while the request is queued
+  sink->Close();
+
+  std::promise<CURLcode> done;
+  CurlMultiLoop::Request req;
+  req.id = loop.ReserveId();
+  req.url = server.Url();
+  req.body = "{}";
+  req.on_done = [&done, handle](CURLcode code, long) {
+    handle->Disarm();
+    done.set_value(code);
+  };
+  auto id = loop.Add(std::move(req));
+  handle->Bind(loop, id);
+
+  auto f = done.get_future();
+  ASSERT_EQ(f.wait_for(2s), std::future_status::ready);
+  EXPECT_EQ(f.get(), CURLE_ABORTED_BY_CALLBACK);
+}
+#endif
+
+TEST_F(CurlMultiLoopTest, CancelOfUnknownTransferIsIgnored) {
+  CurlMultiLoop loop("test");
+  loop.Cancel(12345);
+  EXPECT_EQ(loop.GetInflightCount(), 0u);
+}
+
+TEST_F(CurlMultiLoopTest, AddAfterStopFailsRequest) {
+  CurlMultiLoop loop("test");
+  loop.Stop();
+
+  bool done = false;
+  CURLcode result = CURLE_OK;
+  CurlMultiLoop::Request req;
+  req.url = "http://127.0.0.1:1/completion";
+  req.on_done = [&](CURLcode code, long) {
+    done = true;
+    result = code;
+  };
+  loop.Add(std::move(req));
+  EXPECT_TRUE(done);
+  EXPECT_EQ(result, CURLE_ABORTED_BY_CALLBACK);
+  EXPECT_EQ(loop.GetInflightCount(), 0u);
+}
+
+TEST_F(CurlMultiLoopTest, SinkClosedAfterTransferAndLoopAreGone) {
+  auto sink = std::make_shared<InferChannel>();
+  {
+    CurlMultiLoop loop("test");
+    auto id = loop.ReserveId();
+    auto handle = std::make_shared<curl_utils::TransferHandle>(loop, id);
+    std::promise<void> done;
+
+    CurlMultiLoop::Request req;
+    req.id = id;
+    req.url = "http://127.0.0.1:1/completion";
+    req.on_done = [&done, handle](CURLcode, long) {
+      handle->Disarm();
+      done.set_value();
+    };
+    loop.Add(std::move(req));
+    sink->OnClosed([handle] { handle->Cancel(); });
+    ASSERT_EQ(done.get_future().wait_for(2s), std::future_status::ready);
+  }
+  // The client hangs up once the loop is destroyed
+  sink->Close();
+  EXPECT_TRUE(sink->IsClosed());
+}
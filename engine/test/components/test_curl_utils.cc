@@ -0,0 +1,144 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "gtest/gtest.h"
+#include "utils/curl_utils.h"
+
+class CurlUtilsTest : public ::testing::Test {};
+
+#if !defined(_WIN32)
+namespace {
+// A hub that serves one model listing under a fixed ETag and answers 304 when
+// the client already has it
+class MockHub {
+ public:
+  explicit MockHub(std::string etag) : etag_(std::move(etag)) {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    listen(fd_, 8);
+    socklen_t len = sizeof(addr);
+    getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this] { Serve(); });
+  }
+
+  ~MockHub() {
+    shutdown(fd_, SHUT_RDWR);
+    close(fd_);
+    thread_.join();
+  }
+
+  std::string Url() const {
+    return "http://127.0.0.1:" + std::to_string(port_) +
+           "/api/models/cortexso/tinyllama/refs";
+  }
+
+  int full_responses() const { return full_responses_; }
+
+ private:
+  void Serve() {
+    while (true) {
+      auto conn = accept(fd_, nullptr, nullptr);
+      if (conn < 0) {
+        return;
+      }
+      std::string req;
+      char buf[1024];
+      while (req.find("\r\n\r\n") == std::string::npos) {
+        auto n = recv(conn, buf, sizeof(buf), 0);
+        if (n <= 0) {
+          break;
+        }
+        req.append(buf, n);
+      }
+      std::string res;
+      if (req.find("If-None-Match: " + etag_ + "\r\n") != std::string::npos) {
+        res = "HTTP/1.1 304 Not Modified\r\nETag: " + etag_ +
+              "\r\nConnection: close\r\n\r\n";
+      } else {
+        std::string body = R"({"branches":[{"name":"1b-gguf"}]})";
+        res = "HTTP/1.1 200 OK\r\nETag: " + etag_ +
+              "\r\nContent-Length: " + std::to_string(body.size()) +
+              "\r\nConnection: close\r\n\r\n" + body;
+        full_responses_++;
+      }
+      send(conn, res.data(), res.size(), 0);
+      close(conn);
+    }
+  }
+
+  std::string etag_;
+  int fd_;
+  int port_;
+  std::thread thread_;
+  std::atomic<int> full_responses_{0};
+};
+}  // namespace
+
+TEST_F(CurlUtilsTest, ConditionalGetSkipsUnchangedListing) {
+  MockHub hub("W/\"abc123\"");
+
+  auto first = curl_utils::ConditionalGet(hub.Url(), "");
+  ASSERT_TRUE(first.has_value()) << first.error();
+  EXPECT_FALSE(first->not_modified);
+  EXPECT_EQ(first->etag, "W/\"abc123\"");
+  EXPECT_NE(first->body.find("1b-gguf"), std::string::npos);
+
+  auto second = curl_utils::ConditionalGet(hub.Url(), first->etag);
+  ASSERT_TRUE(second.has_value()) << second.error();
+  EXPECT_TRUE(second->not_modified);
+  EXPECT_TRUE(second->body.empty());
+  EXPECT_EQ(second->etag, first->etag);
+  EXPECT_EQ(hub.full_responses(), 1);
+
+  auto stale = curl_utils::ConditionalGet(hub.Url(), "W/\"old\"");
+  ASSERT_TRUE(stale.has_value());
+  EXPECT_FALSE(stale->not_modified);
+  EXPECT_EQ(hub.full_responses(), 2);
+}
+
+TEST_F(CurlUtilsTest, ConditionalGetStopsWhenAborted) {
+  // Accepts connections into its backlog and never answers
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  listen(fd, 8);
+  socklen_t len = sizeof(addr);
+  getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  auto url = "http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)) +
+             "/api/models/cortexso/tinyllama/refs";
+
+  std::atomic<bool> stop{false};
+  std::thread stopper([&stop] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    stop = true;
+  });
+  auto start = std::chrono::steady_clock::now();
+  auto res = curl_utils::ConditionalGet(url, "", 30,
+                                        [&stop] { return stop.load(); });
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  stopper.join();
+  close(fd);
+
+  EXPECT_TRUE(res.has_error());
+  EXPECT_LT(elapsed, std::chrono::seconds(3));
+}
+#endif
+
+TEST_F(CurlUtilsTest, ConditionalGetFailsWithoutServer) {
+  EXPECT_TRUE(curl_utils::ConditionalGet("http://127.0.0.1:1/api/models", "")
+                  .has_error());
+}
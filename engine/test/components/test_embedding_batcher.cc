@@ -0,0 +1,222 @@
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "extensions/local-engine/embedding_batcher.h"
+#include "gtest/gtest.h"
+
+using cortex::local::EmbeddingBatcher;
+using namespace std::chrono_literals;
+
+class EmbeddingBatcherTest : public ::testing::Test {};
+
+namespace {
+// Embeds each input as [its length, its index] and counts a token per input
+Json::Value Embed(const Json::Value& body) {
+  Json::Value r;
+  r["object"] = "list";
+  r["model"] = body["model"];
+  for (Json::ArrayIndex i = 0; i < body["input"].size(); i++) {
+    Json::Value d;
+    d["object"] = "embedding";
+    d["index"] = i;
+    d["embedding"].append(
+        static_cast<int>(body["input"][i].asString().size()));
+    d["embedding"].append(i);
+    r["data"].append(d);
+  }
+  r["usage"]["prompt_tokens"] = body["input"].size();
+  r["usage"]["total_tokens"] = body["input"].size();
+  return r;
+}
+
+Json::Value Request(const std::string& model, Json::Value input) {
+  Json::Value body;
+  body["model"] = model;
+  body["input"] = std::move(input);
+  return body;
+}
+
+// Records the requests sent upstream and answers them later
+struct Upstream {
+  std::mutex mtx;
+  std::vector<std::pair<Json::Value, EmbeddingBatcher::OnDone>> sent;
+
+  EmbeddingBatcher::Send Sender() {
+    return [this](const std::string&, Json::Value&& body,
+                  EmbeddingBatcher::OnDone&& on_done) {
+      std::lock_guard<std::mutex> l(mtx);
+      sent.emplace_back(std::move(body), std::move(on_done));
+    };
+  }
+
+  size_t Size() {
+    std::lock_guard<std::mutex> l(mtx);
+    return sent.size();
+  }
+};
+}  // namespace
+
+TEST_F(EmbeddingBatcherTest, OnlyTextInputsAreBatchable) {
+  EXPECT_TRUE(EmbeddingBatcher::IsBatchable(Request("m", "hello")));
+  Json::Value texts;
+  texts.append("a");
+  texts.append("b");
+  EXPECT_TRUE(EmbeddingBatcher::IsBatchable(Request("m", texts)));
+  Json::Value tokens;
+  tokens.append(1);
+  tokens.append(2);
+  EXPECT_FALSE(EmbeddingBatcher::IsBatchable(Request("m", tokens)));
+  EXPECT_FALSE(
+      EmbeddingBatcher::IsBatchable(Request("m", Json::arrayValue)));
+}
+
+TEST_F(EmbeddingBatcherTest, SplitsResponseByRequest) {
+  Json::Value inputs;
+  inputs.append("a");
+  inputs.append("bb");
+  inputs.append("cccc");
+  auto parts =
+      cortex::local::SplitEmbeddings(Embed(Request("m", inputs)), {1, 2},
+                                     {1, 6});
+  ASSERT_EQ(parts.size(), 2u);
+  ASSERT_EQ(parts[0]["data"].size(), 1u);
+  EXPECT_EQ(parts[0]["data"][0]["embedding"][0].asInt(), 1);
+  ASSERT_EQ(parts[1]["data"].size(), 2u);
+  EXPECT_EQ(parts[1]["data"][0]["index"].asInt(), 0);
+  EXPECT_EQ(parts[1]["data"][0]["embedding"][0].asInt(), 2);
+  EXPECT_EQ(parts[1]["data"][1]["index"].asInt(), 1);
+  EXPECT_EQ(parts[1]["data"][1]["embedding"][0].asInt(), 4);
+  EXPECT_EQ(parts[0]["usage"]["prompt_tokens"].asInt() +
+                parts[1]["usage"]["prompt_tokens"].asInt(),
+            3);
+  EXPECT_EQ(parts[1]["model"].asString(), "m");
+}
+
+TEST_F(EmbeddingBatcherTest, MissingEmbeddingsFailTheSplit) {
+  auto response = Embed(Request("m", "a"));
+  EXPECT_TRUE(cortex::local::SplitEmbeddings(response, {1, 1}, {1, 1}).empty());
+}
+
+TEST_F(EmbeddingBatcherTest, CoalescesRequestsWithinWindow) {
+  Upstream upstream;
+  std::vector<Json::Value> results(3);
+  {
+    EmbeddingBatcher batcher(upstream.Sender());
+    for (int i = 0; i < 3; i++) {
+      batcher.Add("m", Request("m", std::string(i + 1, 'x')), 50ms, 64,
+                  [&results, i](EmbeddingBatcher::Result&& res) {
+                    ASSERT_TRUE(res.has_value());
+                    results[i] = std::move(res.value());
+                  });
+    }
+    EXPECT_EQ(upstream.Size(), 0u);
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (upstream.Size() == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(5ms);
+    }
+  }
+  ASSERT_EQ(upstream.sent.size(), 1u);
+  auto& [body, on_done] = upstream.sent[0];
+  EXPECT_EQ(body["input"].size(), 3u);
+  on_done(Embed(body));
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(results[i]["data"].size(), 1u);
+    EXPECT_EQ(results[i]["data"][0]["embedding"][0].asInt(), i + 1);
+    EXPECT_EQ(results[i]["data"][0]["index"].asInt(), 0);
+  }
+}
+
+TEST_F(EmbeddingBatcherTest, FullBatchIsSentRightAway) {
+  Upstream upstream;
+  EmbeddingBatcher batcher(upstream.Sender());
+  batcher.Add("m", Request("m", "a"), 1h, 2,
+              [](EmbeddingBatcher::Result&&) {});
+  EXPECT_EQ(upstream.Size(), 0u);
+  batcher.Add("m", Request("m", "b"), 1h, 2,
+              [](EmbeddingBatcher::Result&&) {});
+  ASSERT_EQ(upstream.Size(), 1u);
+  EXPECT_EQ(upstream.sent[0].first["input"].size(), 2u);
+}
+
+TEST_F(EmbeddingBatcherTest, DifferentParametersAreNotMixed) {
+  Upstream upstream;
+  {
+    EmbeddingBatcher batcher(upstream.Sender());
+    auto base64 = Request("m", "a");
+    base64["encoding_format"] = "base64";
+    batcher.Add("m", base64, 1h, 64, [](EmbeddingBatcher::Result&&) {});
+    batcher.Add("m", Request("m", "b"), 1h, 64,
+                [](EmbeddingBatcher::Result&&) {});
+    batcher.Add("other", Request("other", "c"), 1h, 64,
+                [](EmbeddingBatcher::Result&&) {});
+  }
+  // Sent on destruction
+  EXPECT_EQ(upstream.sent.size(), 3u);
+}
+
+TEST_F(EmbeddingBatcherTest, FailedBatchIsRetriedPerRequest) {
+  Upstream upstream;
+  EmbeddingBatcher batcher(upstream.Sender());
+  int ok = 0;
+  int failed = 0;
+  auto on_done = [&](EmbeddingBatcher::Result&& res) {
+    res.has_value() ? ok++ : failed++;
+  };
+  batcher.Add("m", Request("m", "good"), 1h, 2, on_done);
+  batcher.Add("m", Request("m", "bad"), 1h, 2, on_done);
+  ASSERT_EQ(upstream.Size(), 1u);
+  Json::Value error;
+  error["error"] = "input is too large";
+  upstream.sent[0].second(
+      cpp::fail(cortex::local::CompletionFanOut::Error{400, error}));
+
+  ASSERT_EQ(upstream.Size(), 3u);
+  upstream.sent[1].second(Embed(upstream.sent[1].first));
+  upstream.sent[2].second(
+      cpp::fail(cortex::local::CompletionFanOut::Error{400, error}));
+  EXPECT_EQ(ok, 1);
+  EXPECT_EQ(failed, 1);
+}
+
+TEST_F(EmbeddingBatcherTest, AbortedBatchIsNotRetried) {
+  Upstream upstream;
+  EmbeddingBatcher batcher(upstream.Sender());
+  int failed = 0;
+  auto on_done = [&](EmbeddingBatcher::Result&& res) {
+    EXPECT_TRUE(res.has_error());
+    failed++;
+  };
+  batcher.Add("m", Request("m", "a"), 1h, 2, on_done);
+  batcher.Add("m", Request("m", "b"), 1h, 2, on_done);
+  ASSERT_EQ(upstream.Size(), 1u);
+  Json::Value error;
+  error["error"] = "Callback aborted";
+  upstream.sent[0].second(
+      cpp::fail(cortex::local::CompletionFanOut::Error{500, error, true}));
+
+  EXPECT_EQ(upstream.Size(), 1u);
+  EXPECT_EQ(failed, 2);
+}
+
+TEST_F(EmbeddingBatcherTest, NothingIsRetriedOnceStopped) {
+  Upstream upstream;
+  EmbeddingBatcher batcher(upstream.Sender());
+  int failed = 0;
+  auto on_done = [&](EmbeddingBatcher::Result&& res) {
+    EXPECT_TRUE(res.has_error());
+    failed++;
+  };
+  batcher.Add("m", Request("m", "a"), 1h, 3, on_done);
+  batcher.Add("m", Request("m", "b"), 1h, 3, on_done);
+  // Stopping sends the batch that is still waiting
+  batcher.Stop();
+  ASSERT_EQ(upstream.Size(), 1u);
+  Json::Value error;
+  error["error"] = "input is too large";
+  upstream.sent[0].second(
+      cpp::fail(cortex::local::CompletionFanOut::Error{400, error}));
+
+  EXPECT_EQ(upstream.Size(), 1u);
+  EXPECT_EQ(failed, 2);
+}
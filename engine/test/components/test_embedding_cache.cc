@@ -0,0 +1,90 @@
+#include <filesystem>
+#include "extensions/local-engine/embedding_cache.h"
+#include "gtest/gtest.h"
+
+using cortex::local::EmbeddingCache;
+
+class EmbeddingCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    spill_dir_ =
+        std::filesystem::temp_directory_path() / "cortex_embedding_cache_test";
+  }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove_all(spill_dir_, ec);
+  }
+
+  std::filesystem::path spill_dir_;
+};
+
+TEST_F(EmbeddingCacheTest, DisabledByDefault) {
+  EmbeddingCache cache;
+  EXPECT_FALSE(cache.Enabled());
+  cache.Put("a", {1.0f});
+  EXPECT_FALSE(cache.Get("a"));
+}
+
+TEST_F(EmbeddingCacheTest, EvictsLeastRecentlyUsed) {
+  EmbeddingCache cache;
+  cache.Configure(2, {}, 0);
+  cache.Put("a", {1.0f});
+  cache.Put("b", {2.0f});
+  ASSERT_TRUE(cache.Get("a"));
+  cache.Put("c", {3.0f});
+
+  EXPECT_FALSE(cache.Get("b"));
+  auto a = cache.Get("a");
+  ASSERT_TRUE(a);
+  EXPECT_EQ((*a)[0], 1.0f);
+  EXPECT_TRUE(cache.Get("c"));
+
+  auto stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 3u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.entries, 2u);
+}
+
+TEST_F(EmbeddingCacheTest, EvictedEntriesAreReadBackFromDisk) {
+  EmbeddingCache cache;
+  cache.Configure(1, spill_dir_, 1);
+  cache.Put("a", {1.0f, 2.0f});
+  cache.Put("b", {3.0f});
+  EXPECT_EQ(cache.GetStats().disk_entries, 1u);
+
+  auto a = cache.Get("a");
+  ASSERT_TRUE(a);
+  EXPECT_EQ(*a, (EmbeddingCache::Embedding{1.0f, 2.0f}));
+  // "a" is back in memory, and "b" was spilled in its place
+  auto stats = cache.GetStats();
+  EXPECT_EQ(stats.disk_hits, 1u);
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.disk_entries, 1u);
+  EXPECT_TRUE(cache.Get("b"));
+}
+
+TEST_F(EmbeddingCacheTest, DiskIsBounded) {
+  EmbeddingCache cache;
+  cache.Configure(1, spill_dir_, 1);
+  cache.Put("a", {1.0f});
+  cache.Put("b", {2.0f});
+  cache.Put("c", {3.0f});
+  EXPECT_FALSE(cache.Get("a"));
+  EXPECT_TRUE(cache.Get("b"));
+  size_t files = 0;
+  for (auto const& _ : std::filesystem::directory_iterator(spill_dir_)) {
+    (void)_;
+    files++;
+  }
+  EXPECT_EQ(files, 1u);
+}
+
+TEST_F(EmbeddingCacheTest, KeysSeparateModelsAndParams) {
+  auto key = EmbeddingCache::MakeKey("m", "f", "{}", "text");
+  EXPECT_NE(key, EmbeddingCache::MakeKey("m", "f2", "{}", "text"));
+  EXPECT_NE(key, EmbeddingCache::MakeKey("m", "f", "{\"dimensions\":8}",
+                                         "text"));
+  EXPECT_NE(EmbeddingCache::MakeKey("ab", "", "", ""),
+            EmbeddingCache::MakeKey("a", "b", "", ""));
+}
@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+#include "utils/hardware/gguf/gguf_file_estimate.h"
+
+namespace {
+// Shaped like a Q4 quantized 8B llama
+hardware::GgufLayout Llama8B() {
+  hardware::GgufLayout layout;
+  layout.embedding_length = 4096;
+  layout.n_vocab = 128256;
+  layout.num_block = 32;
+  layout.quant_bit_in = 4.5;
+  layout.quant_bit_out = 6.5;
+  layout.file_size = 4920734272;
+  return layout;
+}
+
+hardware::RunConfig Config(int ngl, int64_t free_vram_MiB) {
+  return {/* .ngl = */ ngl,
+          /* .ctx_len = */ 8192,
+          /* .n_batch = */ 2048,
+          /* .n_ubatch = */ 2048,
+          /* .kv_cache_type = */ "f16",
+          /* .free_vram_MiB = */ free_vram_MiB};
+}
+}  // namespace
+
+class GgufFileEstimateTest : public ::testing::Test {};
+
+TEST_F(GgufFileEstimateTest, EstimatesFromLayout) {
+  auto layout = Llama8B();
+  // Every layer offloaded: only the token embeddings stay in RAM
+  auto es = hardware::EstimateLLaMACppRun(layout, Config(33, 100000));
+  auto token_embd = static_cast<int64_t>(128256 * 4096 * 2 * 4.5 / 16);
+  EXPECT_EQ(es.gpu_mode.ram_MiB, hardware::BytesToMiB(token_embd));
+  EXPECT_EQ(es.gpu_mode.ngl, 33);
+  EXPECT_EQ(es.gpu_mode.ctx_len, 8192);
+  EXPECT_EQ(es.gpu_mode.recommend_ngl, 33);
+  // 1 GiB of f16 kv cache for 8k tokens of 4096 wide, 32 layers
+  EXPECT_GT(es.gpu_mode.vram_MiB,
+            hardware::BytesToMiB(layout.file_size - token_embd) + 900);
+
+  // Nothing offloaded: the whole model is in RAM
+  auto cpu = hardware::EstimateLLaMACppRun(layout, Config(0, 100000));
+  EXPECT_GE(cpu.gpu_mode.ram_MiB, hardware::BytesToMiB(layout.file_size) - 1);
+  EXPECT_LT(cpu.gpu_mode.vram_MiB, es.gpu_mode.vram_MiB);
+  // Weights, kv cache and buffers
+  EXPECT_GT(cpu.cpu_mode.ram_MiB, hardware::BytesToMiB(layout.file_size) + 900);
+}
+
+TEST_F(GgufFileEstimateTest, FreeVramOnlyChangesRecommendation) {
+  auto layout = Llama8B();
+  auto roomy = hardware::EstimateLLaMACppRun(layout, Config(33, 100000));
+  auto tight = hardware::EstimateLLaMACppRun(
+      layout, Config(33, roomy.gpu_mode.vram_MiB / 2));
+  EXPECT_EQ(tight.gpu_mode.vram_MiB, roomy.gpu_mode.vram_MiB);
+  EXPECT_EQ(tight.gpu_mode.ram_MiB, roomy.gpu_mode.ram_MiB);
+  EXPECT_EQ(tight.cpu_mode.ram_MiB, roomy.cpu_mode.ram_MiB);
+  EXPECT_EQ(roomy.gpu_mode.recommend_ngl, 33);
+  EXPECT_GE(tight.gpu_mode.recommend_ngl, 15);
+  EXPECT_LE(tight.gpu_mode.recommend_ngl, 16);
+}
+
+TEST_F(GgufFileEstimateTest, EmptyLayoutDoesNotDivideByZero) {
+  auto es = hardware::EstimateLLaMACppRun(hardware::GgufLayout{},
+                                          Config(0, 0));
+  EXPECT_EQ(es.gpu_mode.ram_MiB, 0);
+  EXPECT_EQ(es.cpu_mode.ram_MiB, 0);
+}
@@ -0,0 +1,168 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "utils/gguf_index.h"
+
+namespace {
+using cortex_utils::GgufIndex;
+
+class GgufWriter {
+ public:
+  void String(const std::string& s) {
+    Pod(static_cast<uint64_t>(s.size()));
+    buf_ += s;
+  }
+
+  template <typename T>
+  void Pod(T v) {
+    buf_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  void Kv(const std::string& key, uint32_t type) {
+    String(key);
+    Pod(type);
+  }
+
+  void Tensor(const std::string& name, std::vector<uint64_t> dims,
+              uint32_t type, uint64_t offset) {
+    String(name);
+    Pod(static_cast<uint32_t>(dims.size()));
+    for (auto d : dims) {
+      Pod(d);
+    }
+    Pod(type);
+    Pod(offset);
+  }
+
+  void Save(const std::filesystem::path& path, size_t trailing = 64) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f << buf_ << std::string(trailing, '\0');
+  }
+
+  std::string buf_;
+};
+
+class GgufIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = std::filesystem::temp_directory_path() / "test_gguf_index";
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  std::filesystem::path WriteModel(const std::string& name,
+                                   uint64_t split_count = 0) {
+    GgufWriter w;
+    w.Pod(cortex_utils::kGgufMagic);
+    w.Pod(uint32_t(3));
+    w.Pod(uint64_t(2));                      // tensors
+    w.Pod(uint64_t(split_count ? 6 : 5));  // kvs
+    w.Kv("general.name", cortex_utils::kGgufString);
+    w.String("tiny model");
+    w.Kv("llama.block_count", cortex_utils::kGgufUint32);
+    w.Pod(uint32_t(22));
+    w.Kv("tokenizer.ggml.eos_token_id", cortex_utils::kGgufUint32);
+    w.Pod(uint32_t(2));
+    w.Kv("tokenizer.ggml.tokens", cortex_utils::kGgufArray);
+    w.Pod(uint32_t(cortex_utils::kGgufString));
+    w.Pod(uint64_t(3));
+    w.String("<unk>");
+    w.String("<s>");
+    w.String("</s>");
+    w.Kv("tokenizer.ggml.scores", cortex_utils::kGgufArray);
+    w.Pod(uint32_t(cortex_utils::kGgufFloat32));
+    w.Pod(uint64_t(2));
+    w.Pod(0.5f);
+    w.Pod(-1.0f);
+    if (split_count) {
+      w.Kv("split.count", cortex_utils::kGgufUint16);
+      w.Pod(uint16_t(split_count));
+    }
+    w.Tensor("token_embd.weight", {64, 3}, 8, 0);
+    w.Tensor("output.weight", {64, 3}, 1, 256);
+    header_size_ = w.buf_.size();
+    auto path = dir_ / name;
+    w.Save(path);
+    return path;
+  }
+
+  std::filesystem::path dir_;
+  size_t header_size_ = 0;
+};
+}  // namespace
+
+TEST_F(GgufIndexTest, IndexesMetadataAndTensors) {
+  auto index = GgufIndex::Parse(WriteModel("tiny.gguf"));
+  ASSERT_TRUE(index.has_value()) << index.error();
+  auto& gi = *index.value();
+
+  EXPECT_EQ(gi.version(), 3u);
+  EXPECT_EQ(gi.kvs().size(), 5u);
+  EXPECT_EQ(gi.GetString("general.name").value(), "tiny model");
+  EXPECT_EQ(gi.GetUint("llama.block_count").value(), 22u);
+  EXPECT_FALSE(gi.GetUint("general.name").has_value());
+  EXPECT_FALSE(gi.GetString("missing").has_value());
+
+  auto tokens = gi.GetArray("tokenizer.ggml.tokens").value();
+  EXPECT_EQ(tokens.size, 3u);
+  EXPECT_EQ(tokens.StringAt(0).value(), "<unk>");
+  EXPECT_EQ(tokens.StringAt(2).value(), "</s>");
+  EXPECT_FALSE(tokens.StringAt(3).has_value());
+  auto scores = gi.GetArray("tokenizer.ggml.scores").value();
+  EXPECT_DOUBLE_EQ(scores.NumberAt(1).value(), -1.0);
+
+  ASSERT_EQ(gi.tensors().size(), 2u);
+  EXPECT_EQ(gi.tensors()[1].name, "output.weight");
+  EXPECT_EQ(gi.tensors()[1].dimensions, (std::vector<uint64_t>{64, 3}));
+  EXPECT_EQ(gi.tensors()[1].offset, 256u);
+  EXPECT_EQ(gi.tensor_data_offset(), (header_size_ + 31) / 32 * 32);
+  EXPECT_EQ(gi.file_size(), header_size_ + 64);
+}
+
+TEST_F(GgufIndexTest, RejectsTruncatedAndForeignFiles) {
+  auto path = WriteModel("tiny.gguf");
+  std::filesystem::resize_file(path, header_size_ - 10);
+  EXPECT_TRUE(GgufIndex::Parse(path).has_error());
+
+  std::ofstream(dir_ / "not.gguf") << "not a gguf file at all";
+  EXPECT_TRUE(GgufIndex::Parse(dir_ / "not.gguf").has_error());
+  EXPECT_TRUE(GgufIndex::Parse(dir_ / "missing.gguf").has_error());
+}
+
+TEST_F(GgufIndexTest, CachesUntilFileChanges) {
+  auto path = WriteModel("tiny.gguf");
+  auto first = GgufIndex::Get(path);
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(GgufIndex::Get(path).value(), first.value());
+
+  // Same content, bigger file
+  GgufWriter w;
+  w.buf_ = std::string(header_size_ + 64, '\0');
+  {
+    std::ifstream in(path, std::ios::binary);
+    in.read(w.buf_.data(), w.buf_.size());
+  }
+  w.Save(path, 128);
+  auto second = GgufIndex::Get(path);
+  ASSERT_TRUE(second.has_value());
+  EXPECT_NE(second.value(), first.value());
+  EXPECT_EQ(second.value()->GetString("general.name").value(), "tiny model");
+}
+
+TEST_F(GgufIndexTest, ListsSplitFiles) {
+  auto path = WriteModel("big-00001-of-00003.gguf", 3);
+  auto index = GgufIndex::Parse(path);
+  ASSERT_TRUE(index.has_value());
+  auto paths = index.value()->SplitPaths(path);
+  ASSERT_EQ(paths.size(), 3u);
+  EXPECT_EQ(paths[0], path);
+  EXPECT_EQ(paths[2], dir_ / "big-00003-of-00003.gguf");
+
+  auto single = WriteModel("tiny.gguf");
+  EXPECT_EQ(GgufIndex::Parse(single).value()->SplitPaths(single),
+            std::vector<std::filesystem::path>{single});
+}
@@ -155,3 +155,46 @@ ctx_len: 4096
     FAIL() << "Exception thrown: " << e.what();
   }
 }
+
+TEST_F(GGUFParserTest, StopTokenFromLargeVocabulary) {
+  std::string gguf_path = getTempFilePath("mock_large_vocab", ".gguf");
+  {
+    std::ofstream file(gguf_path, std::ios::binary);
+    auto writeU32 = [&file](uint32_t v) {
+      file.write(reinterpret_cast<char*>(&v), sizeof(v));
+    };
+    auto writeU64 = [&file](uint64_t v) {
+      file.write(reinterpret_cast<char*>(&v), sizeof(v));
+    };
+    auto writeString = [&](const std::string& str) {
+      writeU64(str.length());
+      file.write(str.c_str(), str.length());
+    };
+
+    constexpr uint32_t kVocab = 150000;
+    constexpr uint32_t kEos = 149999;
+    writeU32(0x46554747);
+    writeU32(3);
+    writeU64(0);  // tensors
+    writeU64(3);  // kvs
+    writeString("general.name");
+    writeU32(8);
+    writeString("large vocab");
+    writeString("tokenizer.ggml.eos_token_id");
+    writeU32(4);
+    writeU32(kEos);
+    writeString("tokenizer.ggml.tokens");
+    writeU32(9);
+    writeU32(8);
+    writeU64(kVocab);
+    for (uint32_t i = 0; i < kVocab; i++) {
+      writeString(i == kEos ? "<|eot_id|>" : "tok" + std::to_string(i));
+    }
+  }
+
+  gguf_handler->Parse(gguf_path);
+  const config::ModelConfig& gguf_config = gguf_handler->GetModelConfig();
+  EXPECT_EQ(gguf_config.name, "large-vocab");
+  EXPECT_EQ(gguf_config.stop, std::vector<std::string>{"<|eot_id|>"});
+  std::remove(gguf_path.c_str());
+}
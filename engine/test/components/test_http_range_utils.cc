@@ -0,0 +1,65 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "utils/http_range_utils.h"
+
+namespace {
+using http_range_utils::ParseRange;
+
+std::pair<uint64_t, uint64_t> Span(std::string_view header, uint64_t size) {
+  auto range = ParseRange(header, size);
+  EXPECT_TRUE(range.has_value() && range->has_value()) << header;
+  if (range.has_error() || !range->has_value()) {
+    return {0, 0};
+  }
+  return {range->value().offset, range->value().length};
+}
+}  // namespace
+
+class HttpRangeUtilsTest : public ::testing::Test {};
+
+TEST_F(HttpRangeUtilsTest, ResolvesSingleRanges) {
+  using Pair = std::pair<uint64_t, uint64_t>;
+  EXPECT_EQ(Span("bytes=0-99", 1000), (Pair{0, 100}));
+  EXPECT_EQ(Span("bytes=500-", 1000), (Pair{500, 500}));
+  EXPECT_EQ(Span("bytes=900-2000", 1000), (Pair{900, 100}));
+  EXPECT_EQ(Span("bytes=-100", 1000), (Pair{900, 100}));
+  EXPECT_EQ(Span("bytes=-5000", 1000), (Pair{0, 1000}));
+  EXPECT_EQ(Span(" bytes= 10 - 19 ", 1000), (Pair{10, 10}));
+}
+
+TEST_F(HttpRangeUtilsTest, IgnoresWhatItDoesNotServe) {
+  for (auto header : {"", "items=0-1", "bytes=0-1,5-6", "bytes=abc",
+                      "bytes=5-1", "bytes=-", "bytes=1-x"}) {
+    auto range = ParseRange(header, 1000);
+    ASSERT_TRUE(range.has_value()) << header;
+    EXPECT_FALSE(range->has_value()) << header;
+  }
+}
+
+TEST_F(HttpRangeUtilsTest, RejectsUnsatisfiableRanges) {
+  EXPECT_TRUE(ParseRange("bytes=1000-", 1000).has_error());
+  EXPECT_TRUE(ParseRange("bytes=2000-3000", 1000).has_error());
+  EXPECT_TRUE(ParseRange("bytes=-0", 1000).has_error());
+  EXPECT_TRUE(ParseRange("bytes=0-", 0).has_error());
+}
+
+TEST_F(HttpRangeUtilsTest, ETagFollowsFileMetadata) {
+  auto path = std::filesystem::temp_directory_path() / "test_http_range_etag";
+  std::ofstream(path) << "hello";
+  auto mtime = std::filesystem::last_write_time(path);
+  auto etag = http_range_utils::MakeETag(mtime, 5);
+  EXPECT_EQ(etag, http_range_utils::MakeETag(mtime, 5));
+  EXPECT_NE(etag, http_range_utils::MakeETag(mtime, 6));
+  EXPECT_NE(etag, http_range_utils::MakeETag(
+                      mtime + std::chrono::seconds(1), 5));
+  EXPECT_EQ(etag.front(), '"');
+  EXPECT_EQ(etag.back(), '"');
+  std::filesystem::remove(path);
+
+  EXPECT_TRUE(http_range_utils::EtagMatches(etag, etag));
+  EXPECT_TRUE(http_range_utils::EtagMatches("\"x\", W/" + etag, etag));
+  EXPECT_TRUE(http_range_utils::EtagMatches("*", etag));
+  EXPECT_FALSE(http_range_utils::EtagMatches("\"x\", \"y\"", etag));
+}
@@ -0,0 +1,160 @@
+#include <string>
+#include <vector>
+#include "common/infer_channel.h"
+#include "gtest/gtest.h"
+
+class InferChannelTest : public ::testing::Test {};
+
+namespace {
+std::vector<std::string> DrainAll(InferChannel& q) {
+  std::vector<std::string> out;
+  q.Drain([&out](InferMessage&& m) { out.push_back(std::move(m.raw)); });
+  return out;
+}
+}  // namespace
+
+TEST_F(InferChannelTest, NotifiesOncePerDrain) {
+  InferChannel q(8);
+  int notified = 0;
+  q.SetNotifier([&notified] { notified++; });
+  // Setting the notifier schedules a first drain
+  EXPECT_EQ(notified, 1);
+  EXPECT_TRUE(DrainAll(q).empty());
+
+  q.Write("a", false);
+  q.Write("b", false);
+  EXPECT_EQ(notified, 2);
+  EXPECT_EQ(DrainAll(q), (std::vector<std::string>{"a", "b"}));
+
+  q.Write("c", true);
+  EXPECT_EQ(notified, 3);
+}
+
+TEST_F(InferChannelTest, MessagesPushedBeforeNotifierAreDelivered) {
+  InferChannel q(8);
+  Json::Value status;
+  status["is_done"] = true;
+  q.Push(std::make_pair(status, Json::Value("result")));
+
+  std::vector<InferMessage> got;
+  q.SetNotifier([&q, &got] {
+    q.Drain([&got](InferMessage&& m) { got.push_back(std::move(m)); });
+  });
+  ASSERT_EQ(got.size(), 1u);
+  EXPECT_FALSE(got[0].is_raw);
+  EXPECT_EQ(got[0].result.second.asString(), "result");
+}
+
+TEST_F(InferChannelTest, WriteReportsBackpressure) {
+  InferChannel q(8);
+  // High watermark is 6
+  for (int i = 0; i < 5; i++) {
+    EXPECT_TRUE(q.Write(std::to_string(i), false));
+  }
+  EXPECT_FALSE(q.Write("5", false));
+
+  bool writable = false;
+  q.OnWritable([&writable] { writable = true; });
+  EXPECT_FALSE(writable);
+
+  // Low watermark is 2
+  size_t popped = 0;
+  q.Drain([&popped](InferMessage&&) { popped++; }, 3);
+  EXPECT_FALSE(writable);
+  q.Drain([&popped](InferMessage&&) { popped++; }, 1);
+  EXPECT_TRUE(writable);
+  EXPECT_EQ(popped, 4u);
+}
+
+TEST_F(InferChannelTest, OnWritableRunsRightAwayWhenNotSaturated) {
+  InferChannel q(8);
+  bool writable = false;
+  q.OnWritable([&writable] { writable = true; });
+  EXPECT_TRUE(writable);
+}
+
+TEST_F(InferChannelTest, FullChannelFailsStreamWithoutBlocking) {
+  InferChannel q(4);
+  int closed = 0;
+  q.OnClosed([&closed] { closed++; });
+  for (int i = 0; i < 4; i++) {
+    q.Write(std::to_string(i), false);
+  }
+  EXPECT_EQ(closed, 0);
+
+  // Returns right away, the producer is told to cancel
+  EXPECT_TRUE(q.Write("4", false));
+  EXPECT_EQ(closed, 1);
+  EXPECT_TRUE(q.Write("5", true));
+
+  std::vector<InferMessage> got;
+  q.Drain([&got](InferMessage&& m) { got.push_back(std::move(m)); });
+  ASSERT_EQ(got.size(), 5u);
+  EXPECT_EQ(got[3].raw, "3");
+  EXPECT_FALSE(got.back().is_raw);
+  EXPECT_TRUE(got.back().result.first["has_error"].asBool());
+  EXPECT_TRUE(got.back().result.first["is_done"].asBool());
+  EXPECT_TRUE(DrainAll(q).empty());
+}
+
+TEST_F(InferChannelTest, PushSpillsWhatDoesNotFit) {
+  InferChannel q(4);
+  int closed = 0;
+  q.OnClosed([&closed] { closed++; });
+  auto push = [&q](int i) {
+    q.Push(std::make_pair(Json::Value(), Json::Value(i)));
+  };
+  std::vector<int> got;
+  auto drain = [&q, &got](size_t n) {
+    return q.Drain(
+        [&got](InferMessage&& m) { got.push_back(m.result.second.asInt()); },
+        n);
+  };
+  for (int i = 0; i < 10; i++) {
+    push(i);
+  }
+  // Pushed while spilled messages are left, queued behind them
+  EXPECT_TRUE(drain(6));
+  push(10);
+  EXPECT_FALSE(drain(SIZE_MAX));
+  push(11);
+  EXPECT_FALSE(drain(SIZE_MAX));
+
+  EXPECT_EQ(closed, 0);
+  ASSERT_EQ(got.size(), 12u);
+  for (int i = 0; i < 12; i++) {
+    EXPECT_EQ(got[i], i);
+  }
+}
+
+TEST_F(InferChannelTest, CloseReleasesProducer) {
+  InferChannel q(4);
+  EXPECT_TRUE(q.Write("0", false));
+  EXPECT_TRUE(q.Write("1", false));
+  EXPECT_FALSE(q.Write("2", false));
+  bool writable = false;
+  q.OnWritable([&writable] { writable = true; });
+
+  q.Close();
+  EXPECT_TRUE(writable);
+  EXPECT_TRUE(q.IsClosed());
+  // Dropped without blocking
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(q.Write("x", false));
+  }
+}
+
+TEST_F(InferChannelTest, CloseNotifiesProducer) {
+  InferChannel q(4);
+  int closed = 0;
+  EXPECT_FALSE(q.IsCancellable());
+  q.OnClosed([&closed] { closed++; });
+  EXPECT_TRUE(q.IsCancellable());
+  EXPECT_EQ(closed, 0);
+  q.Close();
+  EXPECT_EQ(closed, 1);
+
+  // Registered after the consumer went away
+  q.OnClosed([&closed] { closed++; });
+  EXPECT_EQ(closed, 2);
+}
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "extensions/local-engine/inference_executor.h"
+#include "gtest/gtest.h"
+
+using cortex::local::InferenceExecutor;
+
+class InferenceExecutorTest : public ::testing::Test {};
+
+namespace {
+template <typename Pred>
+bool WaitFor(Pred&& pred) {
+  for (int i = 0; i < 500; i++) {
+    if (pred())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+}  // namespace
+
+TEST_F(InferenceExecutorTest, RespectsPerModelConcurrency) {
+  InferenceExecutor executor(8);
+  executor.SetModelConcurrency("model-a", 2);
+
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  std::atomic<int> done{0};
+  std::atomic<bool> release{false};
+  for (int i = 0; i < 6; i++) {
+    executor.Submit("model-a", [&] {
+      auto r = ++running;
+      int prev = max_running.load();
+      while (r > prev && !max_running.compare_exchange_weak(prev, r)) {
+      }
+      while (!release) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      --running;
+      ++done;
+    });
+  }
+
+  EXPECT_TRUE(WaitFor([&] { return running == 2; }));
+  auto stats = executor.GetStats("model-a");
+  EXPECT_EQ(stats.limit, 2);
+  EXPECT_EQ(stats.active, 2);
+  EXPECT_EQ(stats.queue_depth, 4u);
+
+  release = true;
+  EXPECT_TRUE(WaitFor([&] { return done == 6; }));
+  EXPECT_EQ(max_running, 2);
+  EXPECT_EQ(executor.GetStats("model-a").total, 6u);
+}
+
+TEST_F(InferenceExecutorTest, ModelsDoNotBlockEachOther) {
+  InferenceExecutor executor(8);
+  executor.SetModelConcurrency("slow", 1);
+  executor.SetModelConcurrency("fast", 1);
+
+  std::atomic<bool> release{false};
+  std::atomic<bool> fast_done{false};
+  executor.Submit("slow", [&] {
+    while (!release) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  executor.Submit("fast", [&] { fast_done = true; });
+
+  EXPECT_TRUE(WaitFor([&] { return fast_done.load(); }));
+  release = true;
+}
+
+TEST_F(InferenceExecutorTest, RemoveModelRunsPendingJobs) {
+  InferenceExecutor executor(4);
+  executor.SetModelConcurrency("model", 1);
+
+  std::atomic<bool> release{false};
+  std::atomic<int> done{0};
+  executor.Submit("model", [&] {
+    while (!release) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ++done;
+  });
+  executor.Submit("model", [&] { ++done; });
+
+  executor.RemoveModel("model");
+  release = true;
+  EXPECT_TRUE(WaitFor([&] { return done == 2; }));
+  EXPECT_EQ(executor.GetStats("model").limit, 0);
+}
+
+TEST_F(InferenceExecutorTest, AsyncJobHoldsSlotUntilReleased) {
+  InferenceExecutor executor(1);
+  executor.SetModelConcurrency("model", 1);
+
+  InferenceExecutor::Release saved;
+  std::mutex mtx;
+  std::atomic<int> started{0};
+  for (int i = 0; i < 2; i++) {
+    executor.SubmitAsync("model", [&](InferenceExecutor::Release&& release) {
+      std::lock_guard<std::mutex> l(mtx);
+      saved = std::move(release);
+      ++started;
+    });
+  }
+
+  EXPECT_TRUE(WaitFor([&] { return started == 1; }));
+  // The job returned but did not release its slot yet
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(started, 1);
+  EXPECT_EQ(executor.GetStats("model").queue_depth, 1u);
+
+  InferenceExecutor::Release release;
+  {
+    std::lock_guard<std::mutex> l(mtx);
+    release = std::move(saved);
+  }
+  release();
+  EXPECT_TRUE(WaitFor([&] { return started == 2; }));
+}
+
+TEST_F(InferenceExecutorTest, StopDropsJobsWaitingForASlot) {
+  InferenceExecutor executor(1);
+  executor.SetModelConcurrency("model", 1);
+
+  std::atomic<bool> release{false};
+  std::atomic<int> done{0};
+  executor.Submit("model", [&] {
+    while (!release) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ++done;
+  });
+  executor.Submit("model", [&] { ++done; });
+  EXPECT_TRUE(WaitFor([&] { return executor.GetStats("model").active == 1; }));
+
+  std::thread stopper([&] { executor.Stop(); });
+  // Stop() waits for the running job, which should not free its slot before
+  // Stop() has begun
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  release = true;
+  stopper.join();
+  // The running job finished, the waiting one and later ones never run
+  EXPECT_EQ(done, 1);
+  executor.Submit("model", [&] { ++done; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(done, 1);
+}
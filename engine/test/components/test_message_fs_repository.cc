@@ -0,0 +1,301 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "repositories/message_fs_repository.h"
+
+namespace {
+class MessageFsRepositoryTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = std::filesystem::temp_directory_path() / "test_message_fs_repo";
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_ / "threads" / kThread);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  static OpenAi::Message Make(const std::string& id, const std::string& text,
+                              const std::string& run_id = "") {
+    OpenAi::Message msg;
+    msg.id = id;
+    msg.created_at = 1;
+    msg.thread_id = kThread;
+    msg.status = OpenAi::Status::COMPLETED;
+    msg.role = OpenAi::Role::USER;
+    auto content = std::make_unique<OpenAi::TextContent>();
+    content->text.value = text;
+    msg.content.push_back(std::move(content));
+    if (!run_id.empty()) {
+      msg.run_id = run_id;
+    }
+    return msg;
+  }
+
+  static std::vector<std::string> IdsOf(
+      const cpp::result<std::vector<OpenAi::Message>, std::string>& res) {
+    std::vector<std::string> ids;
+    for (const auto& m : res.value()) {
+      ids.push_back(m.id);
+    }
+    return ids;
+  }
+
+  std::filesystem::path LogPath() const {
+    return dir_ / "threads" / kThread / "messages.jsonl";
+  }
+
+  std::filesystem::path IndexPath() const {
+    return dir_ / "threads" / kThread / "messages.idx";
+  }
+
+  std::string ReadLog() const {
+    std::ifstream log(LogPath(), std::ios::binary);
+    std::stringstream ss;
+    ss << log.rdbuf();
+    return ss.str();
+  }
+
+  static constexpr auto kThread = "thread_1";
+  std::filesystem::path dir_;
+};
+
+using Ids = std::vector<std::string>;
+}  // namespace
+
+TEST_F(MessageFsRepositoryTest, PaginatesWithoutReadingWholeLog) {
+  MessageFsRepository repo(dir_);
+  ASSERT_TRUE(repo.InitializeMessages(kThread, std::nullopt).has_value());
+  for (auto id : {"01A", "01B", "01C", "01D", "01E"}) {
+    auto msg = Make(id, std::string("text ") + id, id[2] == 'C' ? "run" : "");
+    ASSERT_TRUE(repo.CreateMessage(msg).has_value());
+  }
+
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 2, "asc", "", "", "")),
+            (Ids{"01A", "01B"}));
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 2, "desc", "", "", "")),
+            (Ids{"01E", "01D"}));
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "01B", "01E", "")),
+            (Ids{"01C", "01D"}));
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 1, "desc", "01A", "01E", "")),
+            (Ids{"01D"}));
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "run")),
+            (Ids{"01C"}));
+  EXPECT_TRUE(repo.ListMessages(kThread, 10, "asc", "01E", "", "")->empty());
+  EXPECT_TRUE(repo.ListMessages(kThread, 10, "asc", "01D", "01B", "")
+                  .has_error());
+
+  auto msg = repo.RetrieveMessage(kThread, "01C");
+  ASSERT_TRUE(msg.has_value());
+  EXPECT_EQ(msg->run_id.value_or(""), "run");
+  EXPECT_TRUE(repo.RetrieveMessage(kThread, "01Z").has_error());
+}
+
+TEST_F(MessageFsRepositoryTest, EditsAndDeletesAreAppended) {
+  {
+    MessageFsRepository repo(dir_, /* background_compaction = */ false);
+    ASSERT_TRUE(repo.InitializeMessages(kThread, std::nullopt).has_value());
+    for (auto id : {"01A", "01B", "01C"}) {
+      auto msg = Make(id, "first");
+      ASSERT_TRUE(repo.CreateMessage(msg).has_value());
+    }
+    auto size = std::filesystem::file_size(LogPath());
+
+    auto edited = Make("01B", "second");
+    ASSERT_TRUE(repo.ModifyMessage(edited).has_value());
+    ASSERT_TRUE(repo.DeleteMessage(kThread, "01A").has_value());
+    EXPECT_TRUE(repo.DeleteMessage(kThread, "01A").has_error());
+    auto missing = Make("01Z", "none");
+    EXPECT_TRUE(repo.ModifyMessage(missing).has_error());
+    EXPECT_GT(std::filesystem::file_size(LogPath()), size);
+
+    EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+              (Ids{"01B", "01C"}));
+  }
+
+  // A new instance reads the index, and rebuilds it from the log without one
+  for (int i = 0; i < 2; i++) {
+    MessageFsRepository repo(dir_);
+    EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+              (Ids{"01B", "01C"}));
+    auto msg = repo.RetrieveMessage(kThread, "01B");
+    ASSERT_TRUE(msg.has_value());
+    auto text = dynamic_cast<OpenAi::TextContent*>(msg->content[0].get());
+    ASSERT_NE(text, nullptr);
+    EXPECT_EQ(text->text.value, "second");
+    std::filesystem::remove(IndexPath());
+  }
+}
+
+TEST_F(MessageFsRepositoryTest, IndexesLegacyLogAndDropsTornRecord) {
+  {
+    std::ofstream log(LogPath(), std::ios::binary);
+    log << Make("01A", "a").ToSingleLineJsonString().value()
+        << Make("01B", "b").ToSingleLineJsonString().value()
+        << R"({"id":"01C","object":"thread.mes)";
+  }
+  MessageFsRepository repo(dir_);
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01A", "01B"}));
+
+  auto msg = Make("01D", "d");
+  ASSERT_TRUE(repo.CreateMessage(msg).has_value());
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "desc", "", "", "")),
+            (Ids{"01D", "01B", "01A"}));
+
+  // Records appended by another writer are picked up
+  {
+    std::ofstream log(LogPath(), std::ios::binary | std::ios::app);
+    log << Make("01E", "e").ToSingleLineJsonString().value();
+  }
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 1, "desc", "", "", "")),
+            (Ids{"01E"}));
+}
+
+// ULIDs made in the same millisecond don't sort by creation
+TEST_F(MessageFsRepositoryTest, ListsMessagesInCreationOrder) {
+  MessageFsRepository repo(dir_, /* background_compaction = */ false);
+  ASSERT_TRUE(repo.InitializeMessages(kThread, std::nullopt).has_value());
+  for (auto id : {"01C", "01A", "01B"}) {
+    auto msg = Make(id, "first");
+    ASSERT_TRUE(repo.CreateMessage(msg).has_value());
+  }
+  auto edited = Make("01C", "second");
+  ASSERT_TRUE(repo.ModifyMessage(edited).has_value());
+
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01C", "01A", "01B"}));
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "desc", "", "", "")),
+            (Ids{"01B", "01A", "01C"}));
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "01C", "", "")),
+            (Ids{"01A", "01B"}));
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "01B", "")),
+            (Ids{"01C", "01A"}));
+  EXPECT_TRUE(repo.ListMessages(kThread, 10, "asc", "01B", "01C", "")
+                  .has_error());
+
+  ASSERT_TRUE(repo.CompactMessages(kThread).has_value());
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01C", "01A", "01B"}));
+  MessageFsRepository reopened(dir_);
+  EXPECT_EQ(IdsOf(reopened.ListMessages(kThread, 10, "asc", "01C", "", "")),
+            (Ids{"01A", "01B"}));
+}
+
+TEST_F(MessageFsRepositoryTest, CompactionKeepsLiveMessages) {
+  MessageFsRepository repo(dir_, /* background_compaction = */ false);
+  ASSERT_TRUE(repo.InitializeMessages(kThread, std::nullopt).has_value());
+  for (auto id : {"01A", "01B", "01C"}) {
+    auto msg = Make(id, std::string(1000, 'x'));
+    ASSERT_TRUE(repo.CreateMessage(msg).has_value());
+  }
+  for (int i = 0; i < 10; i++) {
+    auto msg = Make("01B", std::string(1000, 'a' + i));
+    ASSERT_TRUE(repo.ModifyMessage(msg).has_value());
+  }
+  ASSERT_TRUE(repo.DeleteMessage(kThread, "01C").has_value());
+  auto size = std::filesystem::file_size(LogPath());
+
+  ASSERT_TRUE(repo.CompactMessages(kThread).has_value());
+  EXPECT_LT(std::filesystem::file_size(LogPath()), size / 4);
+  EXPECT_FALSE(std::filesystem::exists(LogPath().string() + ".tmp"));
+
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01A", "01B"}));
+  auto msg = repo.RetrieveMessage(kThread, "01B");
+  ASSERT_TRUE(msg.has_value());
+  auto text = dynamic_cast<OpenAi::TextContent*>(msg->content[0].get());
+  ASSERT_NE(text, nullptr);
+  EXPECT_EQ(text->text.value, std::string(1000, 'j'));
+
+  MessageFsRepository reopened(dir_);
+  EXPECT_EQ(IdsOf(reopened.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01A", "01B"}));
+}
+
+TEST_F(MessageFsRepositoryTest, ReadersLeaveIncompleteRecordAlone) {
+  auto c = Make("01C", "c").ToSingleLineJsonString().value();
+  {
+    std::ofstream log(LogPath(), std::ios::binary);
+    log << Make("01A", "a").ToSingleLineJsonString().value()
+        << c.substr(0, 20);
+  }
+  auto size = std::filesystem::file_size(LogPath());
+  MessageFsRepository repo(dir_);
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01A"}));
+  EXPECT_TRUE(repo.RetrieveMessage(kThread, "01C").has_error());
+  EXPECT_EQ(std::filesystem::file_size(LogPath()), size);
+
+  // Another writer finishes its record
+  {
+    std::ofstream log(LogPath(), std::ios::binary | std::ios::app);
+    log << c.substr(20);
+  }
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01A", "01C"}));
+}
+
+TEST_F(MessageFsRepositoryTest, ReindexesLogRewrittenLarger) {
+  MessageFsRepository repo(dir_);
+  ASSERT_TRUE(repo.InitializeMessages(kThread, std::nullopt).has_value());
+  for (auto id : {"01A", "01B"}) {
+    auto msg = Make(id, "short");
+    ASSERT_TRUE(repo.CreateMessage(msg).has_value());
+  }
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01A", "01B"}));
+
+  // Another application rewrites the thread with longer messages
+  {
+    std::ofstream log(LogPath(), std::ios::binary | std::ios::trunc);
+    for (auto id : {"01X", "01Y", "01Z"}) {
+      log << Make(id, std::string(100, 'x')).ToSingleLineJsonString().value();
+    }
+  }
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01X", "01Y", "01Z"}));
+  auto msg = repo.RetrieveMessage(kThread, "01Y");
+  ASSERT_TRUE(msg.has_value());
+  auto text = dynamic_cast<OpenAi::TextContent*>(msg->content[0].get());
+  ASSERT_NE(text, nullptr);
+  EXPECT_EQ(text->text.value, std::string(100, 'x'));
+}
+
+TEST_F(MessageFsRepositoryTest, RebuildsIndexWithEmptyEntry) {
+  {
+    std::ofstream log(LogPath(), std::ios::binary);
+    log << Make("01A", "a").ToSingleLineJsonString().value()
+        << Make("01B", "b").ToSingleLineJsonString().value();
+    std::ofstream index(IndexPath(), std::ios::binary);
+    index << "+\t01A\t0\t0\t\n";
+  }
+  MessageFsRepository repo(dir_);
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01A", "01B"}));
+}
+
+TEST_F(MessageFsRepositoryTest, SmallLogsAreCompactedInBackground) {
+  MessageFsRepository repo(dir_);
+  ASSERT_TRUE(repo.InitializeMessages(kThread, std::nullopt).has_value());
+  for (auto id : {"01A", "01B", "01C"}) {
+    auto msg = Make(id, "first");
+    ASSERT_TRUE(repo.CreateMessage(msg).has_value());
+  }
+  auto edited = Make("01B", "second");
+  ASSERT_TRUE(repo.ModifyMessage(edited).has_value());
+  ASSERT_TRUE(repo.DeleteMessage(kThread, "01A").has_value());
+
+  // Left with the live records only, as older versions expect
+  auto expected = Make("01B", "second").ToSingleLineJsonString().value() +
+                  Make("01C", "first").ToSingleLineJsonString().value();
+  for (int i = 0; i < 500 && ReadLog() != expected; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(ReadLog(), expected);
+  EXPECT_EQ(IdsOf(repo.ListMessages(kThread, 10, "asc", "", "", "")),
+            (Ids{"01B", "01C"}));
+}
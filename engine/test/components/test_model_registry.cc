@@ -0,0 +1,81 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "extensions/local-engine/model_registry.h"
+#include "gtest/gtest.h"
+
+using cortex::local::ModelRegistry;
+
+class ModelRegistryTest : public ::testing::Test {};
+
+TEST_F(ModelRegistryTest, InsertKeepsExistingEntry) {
+  ModelRegistry<int> registry;
+  auto first = std::make_shared<const int>(1);
+  EXPECT_TRUE(registry.Insert("m", first));
+  EXPECT_FALSE(registry.Insert("m", std::make_shared<const int>(2)));
+  EXPECT_EQ(registry.Find("m"), first);
+  EXPECT_EQ(registry.Find("other"), nullptr);
+}
+
+TEST_F(ModelRegistryTest, StaleWritesAreRejected) {
+  ModelRegistry<int> registry;
+  auto first = std::make_shared<const int>(1);
+  auto second = std::make_shared<const int>(2);
+  registry.Insert("m", first);
+  EXPECT_TRUE(registry.Replace("m", first, second));
+  EXPECT_FALSE(registry.Replace("m", first, std::make_shared<const int>(3)));
+  EXPECT_FALSE(registry.Erase("m", first));
+  EXPECT_EQ(*registry.Find("m"), 2);
+  EXPECT_TRUE(registry.Erase("m", second));
+  EXPECT_EQ(registry.Find("m"), nullptr);
+}
+
+TEST_F(ModelRegistryTest, SnapshotOutlivesWrites) {
+  ModelRegistry<int> registry;
+  auto entry = std::make_shared<const int>(1);
+  registry.Insert("m", entry);
+  auto snapshot = registry.Snapshot();
+  registry.Erase("m", entry);
+  entry.reset();
+  ASSERT_EQ(snapshot->size(), 1u);
+  EXPECT_EQ(*snapshot->at("m"), 1);
+  EXPECT_TRUE(registry.Snapshot()->empty());
+}
+
+TEST_F(ModelRegistryTest, ClearReturnsEntries) {
+  ModelRegistry<int> registry;
+  registry.Insert("a", std::make_shared<const int>(1));
+  registry.Insert("b", std::make_shared<const int>(2));
+  auto cleared = registry.Clear();
+  EXPECT_EQ(cleared.size(), 2u);
+  EXPECT_TRUE(registry.Snapshot()->empty());
+}
+
+TEST_F(ModelRegistryTest, ReadersSeeWholeEntries) {
+  ModelRegistry<std::pair<int, int>> registry;
+  std::atomic<bool> done{false};
+  std::atomic<int> torn{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&] {
+      while (!done) {
+        if (auto e = registry.Find("m"); e && e->first != e->second) {
+          torn++;
+        }
+      }
+    });
+  }
+  auto current = std::make_shared<const std::pair<int, int>>(0, 0);
+  registry.Insert("m", current);
+  for (int i = 1; i < 2000; i++) {
+    auto next = std::make_shared<const std::pair<int, int>>(i, i);
+    EXPECT_TRUE(registry.Replace("m", current, next));
+    current = std::move(next);
+  }
+  done = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(torn, 0);
+  EXPECT_EQ(registry.Find("m")->first, 1999);
+}
@@ -0,0 +1,58 @@
+#include <unordered_set>
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "extensions/local-engine/port_allocator.h"
+#include "gtest/gtest.h"
+#include "utils/port_utils.h"
+
+using cortex::local::PortAllocator;
+
+class PortAllocatorTest : public ::testing::Test {};
+
+TEST_F(PortAllocatorTest, HandsOutLowestFreePort) {
+  PortAllocator allocator(100, 103, [](int) { return true; });
+  EXPECT_EQ(allocator.Acquire(), 100);
+  EXPECT_EQ(allocator.Acquire(), 101);
+  allocator.Release(100);
+  EXPECT_EQ(allocator.Acquire(), 100);
+  EXPECT_EQ(allocator.InUse(), 2u);
+}
+
+TEST_F(PortAllocatorTest, SkipsPortsBoundElsewhere) {
+  std::unordered_set<int> bound = {100, 102};
+  PortAllocator allocator(100, 103,
+                          [&bound](int port) { return !bound.count(port); });
+  EXPECT_EQ(allocator.Acquire(), 101);
+  EXPECT_EQ(allocator.Acquire(), 103);
+  EXPECT_EQ(allocator.Acquire(), std::nullopt);
+}
+
+#if !defined(_WIN32)
+TEST_F(PortAllocatorTest, ProbeDetectsBoundPort) {
+  PortAllocator allocator(39400, 39999, [](int port) {
+    return port_utils::IsPortAvailable("127.0.0.1", port);
+  });
+  auto port = allocator.Acquire();
+  ASSERT_TRUE(port.has_value());
+  allocator.Release(*port);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(*port));
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  ASSERT_EQ(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  ASSERT_EQ(listen(fd, 1), 0);
+
+  EXPECT_FALSE(port_utils::IsPortAvailable("127.0.0.1", *port));
+  auto next = allocator.Acquire();
+  ASSERT_TRUE(next.has_value());
+  EXPECT_NE(*next, *port);
+  close(fd);
+}
+#endif
@@ -0,0 +1,42 @@
+#include "extensions/remote-engine/rate_limiter.h"
+#include "gtest/gtest.h"
+
+using remote_engine::RateLimiter;
+using namespace std::chrono_literals;
+
+class RateLimiterTest : public ::testing::Test {
+ protected:
+  RateLimiter::Clock::time_point t0_ = RateLimiter::Clock::now();
+};
+
+TEST_F(RateLimiterTest, AllowsBurstUpToLimit) {
+  RateLimiter limiter(3, t0_);
+  EXPECT_TRUE(limiter.TryAcquire(t0_));
+  EXPECT_TRUE(limiter.TryAcquire(t0_));
+  EXPECT_TRUE(limiter.TryAcquire(t0_));
+  EXPECT_FALSE(limiter.TryAcquire(t0_));
+}
+
+TEST_F(RateLimiterTest, RefillsOverTime) {
+  RateLimiter limiter(60, t0_);
+  for (int i = 0; i < 60; i++) {
+    EXPECT_TRUE(limiter.TryAcquire(t0_));
+  }
+  EXPECT_FALSE(limiter.TryAcquire(t0_));
+  EXPECT_GT(limiter.RetryAfter(t0_).count(), 0);
+  EXPECT_LE(limiter.RetryAfter(t0_).count(), 1001);
+
+  // One token per second
+  EXPECT_FALSE(limiter.TryAcquire(t0_ + 500ms));
+  EXPECT_TRUE(limiter.TryAcquire(t0_ + 1s));
+  EXPECT_FALSE(limiter.TryAcquire(t0_ + 1s));
+}
+
+TEST_F(RateLimiterTest, DoesNotAccumulateBeyondLimit) {
+  RateLimiter limiter(2, t0_);
+  auto later = t0_ + 10min;
+  EXPECT_TRUE(limiter.TryAcquire(later));
+  EXPECT_TRUE(limiter.TryAcquire(later));
+  EXPECT_FALSE(limiter.TryAcquire(later));
+  EXPECT_EQ(limiter.RetryAfter(t0_ + 10min).count(), 30001);
+}
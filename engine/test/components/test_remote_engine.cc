@@ -475,4 +475,25 @@ TEST_F(RemoteEngineTest, HeaderTemplate) {
 
     EXPECT_EQ(result[0], "Authorization: Bearer test");
   }
-}
\ No newline at end of file
+}
+
+TEST_F(RemoteEngineTest, TemplateRendererReusesCompiledTemplates) {
+  std::string tpl =
+      R"({"model": "{{ input_request.model }}", "text": {{ tojson(input_request.text) }}})";
+  std::string other_tpl = R"({"model": "{{ input_request.model }}"})";
+  extensions::TemplateRenderer rdr;
+
+  auto compiled = rdr.Compile(tpl);
+  EXPECT_EQ(compiled, rdr.Compile(tpl));
+  EXPECT_NE(compiled, rdr.Compile(other_tpl));
+
+  for (const auto& text : {"Hello", "world"}) {
+    Json::Value data;
+    data["model"] = "gpt-4o";
+    data["text"] = text;
+    auto res_json = json_helper::ParseJsonString(rdr.Render(tpl, data));
+    EXPECT_EQ(res_json["model"].asString(), "gpt-4o");
+    EXPECT_EQ(res_json["text"].asString(), text);
+  }
+  EXPECT_EQ(compiled, rdr.Compile(tpl));
+}
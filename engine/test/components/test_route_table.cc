@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+#include "utils/route_table.h"
+#include "utils/string_utils.h"
+
+using cortex::utils::RouteTable;
+
+class RouteTableTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (auto const& [path, method] : routes_) {
+      table_.Add(path, method);
+    }
+  }
+
+  // Methods the linear scan in the pre-routing advice used to return
+  std::string LinearMethods(const std::string& path) {
+    std::string methods;
+    for (auto const& [route, method] : routes_) {
+      if (string_utils::AreUrlPathsEqual(path, route) &&
+          methods.find(method) == std::string::npos) {
+        methods += method;
+        methods += ", ";
+      }
+    }
+    return methods.size() < 2 ? "" : methods.substr(0, methods.size() - 2);
+  }
+
+  std::vector<std::pair<std::string, std::string>> routes_ = {
+      {"/v1/models", "Get"},
+      {"/v1/models", "Post"},
+      {"/v1/models/{1}", "Get"},
+      {"/v1/models/{1}", "Delete"},
+      {"/v1/models/pull", "Post"},
+      {"/v1/models/pull", "Delete"},
+      {"/v1/threads/{1}/messages/{2}", "Get"},
+      {"/v1/chat/completions", "Post"},
+      {"/healthz", "Get"},
+  };
+  RouteTable table_;
+};
+
+TEST_F(RouteTableTest, MatchesLiteralRoutes) {
+  EXPECT_TRUE(table_.Contains("/v1/chat/completions"));
+  EXPECT_EQ(table_.Methods("/v1/chat/completions"), "Post");
+  EXPECT_EQ(table_.Methods("/v1/models"), "Get, Post");
+  EXPECT_FALSE(table_.Contains("/v1/chat"));
+  EXPECT_FALSE(table_.Contains("/v1/unknown"));
+}
+
+TEST_F(RouteTableTest, PlaceholdersMatchAnySegment) {
+  EXPECT_EQ(table_.Methods("/v1/models/tinyllama"), "Get, Delete");
+  EXPECT_EQ(table_.Methods("/v1/threads/abc/messages/def"), "Get");
+  EXPECT_FALSE(table_.Contains("/v1/threads/abc/messages"));
+}
+
+TEST_F(RouteTableTest, LiteralAndPlaceholderRoutesAreMerged) {
+  // Both "/v1/models/pull" and "/v1/models/{1}" match
+  EXPECT_EQ(table_.Methods("/v1/models/pull"), "Get, Delete, Post");
+}
+
+TEST_F(RouteTableTest, IgnoresEmptySegments) {
+  EXPECT_EQ(table_.Methods("//v1//models/"), "Get, Post");
+  EXPECT_FALSE(table_.Contains("/"));
+}
+
+TEST_F(RouteTableTest, AgreesWithLinearScan) {
+  for (auto const& path :
+       {"/v1/models", "/v1/models/pull", "/v1/models/x", "/v1/models/x/y",
+        "/healthz", "/v1/threads/1/messages/2", "/v1/{id}/completions",
+        "/nope", "/"}) {
+    EXPECT_EQ(table_.Methods(path), LinearMethods(path)) << path;
+  }
+}
@@ -0,0 +1,67 @@
+#include <memory>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "utils/spsc_ring.h"
+
+using cortex::utils::SpscRing;
+
+class SpscRingTest : public ::testing::Test {};
+
+TEST_F(SpscRingTest, CapacityIsRoundedUpToPowerOfTwo) {
+  SpscRing<int> ring(5);
+  EXPECT_EQ(ring.Capacity(), 8u);
+}
+
+TEST_F(SpscRingTest, PushPopInOrderAndRejectsWhenFull) {
+  SpscRing<std::string> ring(4);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(ring.TryPush(std::to_string(i)));
+  }
+  std::string extra = "extra";
+  EXPECT_FALSE(ring.TryPush(std::move(extra)));
+  // A rejected value is left untouched
+  EXPECT_EQ(extra, "extra");
+  EXPECT_EQ(ring.Size(), 4u);
+
+  for (int i = 0; i < 4; i++) {
+    auto v = ring.TryPop();
+    ASSERT_TRUE(v.has_value());
+    EXPECT_EQ(*v, std::to_string(i));
+  }
+  EXPECT_FALSE(ring.TryPop().has_value());
+  EXPECT_TRUE(ring.Empty());
+}
+
+TEST_F(SpscRingTest, HoldsMoveOnlyValues) {
+  SpscRing<std::unique_ptr<int>> ring(2);
+  EXPECT_TRUE(ring.TryPush(std::make_unique<int>(42)));
+  auto v = ring.TryPop();
+  ASSERT_TRUE(v.has_value());
+  EXPECT_EQ(**v, 42);
+}
+
+TEST_F(SpscRingTest, TransfersAcrossThreads) {
+  constexpr int kCount = 100000;
+  SpscRing<int> ring(64);
+  std::thread producer([&ring] {
+    for (int i = 0; i < kCount; i++) {
+      int v = i;
+      while (!ring.TryPush(std::move(v))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int expected = 0;
+  while (expected < kCount) {
+    if (auto v = ring.TryPop()) {
+      ASSERT_EQ(*v, expected);
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(ring.Empty());
+}
@@ -0,0 +1,63 @@
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "utils/sse_utils.h"
+
+class SseParserTest : public ::testing::Test {
+ protected:
+  void Feed(std::string_view chunk) {
+    parser_.Feed(chunk, [this](std::string_view frame, std::string_view data) {
+      frames_.emplace_back(frame);
+      data_.emplace_back(data);
+    });
+  }
+
+  sse_utils::SseParser parser_;
+  std::vector<std::string> frames_;
+  std::vector<std::string> data_;
+};
+
+TEST_F(SseParserTest, SingleEvent) {
+  Feed("data: {\"a\":1}\n\n");
+  ASSERT_EQ(data_.size(), 1u);
+  EXPECT_EQ(frames_[0], "data: {\"a\":1}");
+  EXPECT_EQ(data_[0], "{\"a\":1}");
+  EXPECT_FALSE(parser_.HasPendingData());
+}
+
+TEST_F(SseParserTest, SeveralEventsInOneChunk) {
+  Feed("data: 1\n\ndata: 2\n\ndata: [DONE]\n\n");
+  ASSERT_EQ(data_.size(), 3u);
+  EXPECT_EQ(data_[0], "1");
+  EXPECT_EQ(data_[1], "2");
+  EXPECT_EQ(data_[2], sse_utils::kDoneData);
+}
+
+TEST_F(SseParserTest, EventSplitAcrossChunks) {
+  std::string body = "data: {\"content\":\"hello\"}\n\ndata: [DONE]\n\n";
+  for (char c : body) {
+    Feed(std::string_view(&c, 1));
+  }
+  ASSERT_EQ(data_.size(), 2u);
+  EXPECT_EQ(data_[0], "{\"content\":\"hello\"}");
+  EXPECT_EQ(data_[1], "[DONE]");
+  EXPECT_FALSE(parser_.HasPendingData());
+}
+
+TEST_F(SseParserTest, IncompleteEventIsKept) {
+  Feed("data: 1\n\ndata: 2");
+  ASSERT_EQ(data_.size(), 1u);
+  EXPECT_TRUE(parser_.HasPendingData());
+  Feed("\n\n");
+  ASSERT_EQ(data_.size(), 2u);
+  EXPECT_EQ(data_[1], "2");
+}
+
+TEST_F(SseParserTest, CrlfAndMultilineData) {
+  Feed("event: message\r\ndata: a\r\ndata: b\r\n\r\n: comment\n\n");
+  ASSERT_EQ(data_.size(), 2u);
+  EXPECT_EQ(frames_[0], "event: message\r\ndata: a\r\ndata: b");
+  EXPECT_EQ(data_[0], "a\nb");
+  // Comment only event has no data
+  EXPECT_EQ(data_[1], "");
+}
@@ -0,0 +1,166 @@
+#include <sqlite3.h>
+#include <filesystem>
+#include <set>
+#include "database/threads.h"
+#include "gtest/gtest.h"
+#include "migrations/v4/migration.h"
+
+namespace cortex::db {
+namespace {
+constexpr const auto kTestDb = "./test_threads.db";
+}
+
+class ThreadsTestSuite : public ::testing::Test {
+ public:
+  ThreadsTestSuite()
+      : db_(kTestDb, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE),
+        threads_(db_) {}
+  void SetUp() { ASSERT_TRUE(cortex::migr::v4::MigrateDBUp(db_).has_value()); }
+
+  void TearDown() {
+    ASSERT_TRUE(cortex::migr::v4::MigrateDBDown(db_).has_value());
+  }
+
+  std::vector<std::string> IdsOf(uint8_t limit, const std::string& order,
+                               const std::string& after = "",
+                               const std::string& before = "") {
+    std::vector<std::string> ids;
+    auto entries = threads_.GetThreadEntries(limit, order, after, before);
+    for (const auto& e : entries.value()) {
+      ids.push_back(e.id);
+    }
+    return ids;
+  }
+
+ protected:
+  SQLite::Database db_;
+  cortex::db::Threads threads_;
+};
+
+TEST_F(ThreadsTestSuite, ListsPagesByCreationTime) {
+  EXPECT_TRUE(threads_.GetThreadModifiedTimes()->empty());
+  ASSERT_TRUE(threads_
+                  .UpsertThreadEntries({{"01C", 30, R"({"id":"01C"})"},
+                                        {"01A", 10, R"({"id":"01A"})"},
+                                        {"01B", 20, R"({"id":"01B"})"}})
+                  .has_value());
+  ASSERT_TRUE(threads_.UpsertThreadEntry({"01D", 40, "{}"}).has_value());
+  EXPECT_EQ(threads_.GetThreadModifiedTimes()->size(), 4u);
+
+  using Ids = std::vector<std::string>;
+  EXPECT_EQ(IdsOf(2, "asc"), (Ids{"01A", "01B"}));
+  EXPECT_EQ(IdsOf(2, "desc"), (Ids{"01D", "01C"}));
+  EXPECT_EQ(IdsOf(10, "asc", "01A", "01D"), (Ids{"01B", "01C"}));
+  EXPECT_EQ(IdsOf(10, "desc", "01B"), (Ids{"01D", "01C"}));
+
+  auto page = threads_.GetThreadEntries(1, "asc", "", "").value();
+  ASSERT_EQ(page.size(), 1u);
+  EXPECT_EQ(page[0].created_at, 10u);
+  EXPECT_EQ(page[0].data, R"({"id":"01A"})");
+}
+
+TEST_F(ThreadsTestSuite, UpsertReplacesAndDeleteRemoves) {
+  ASSERT_TRUE(threads_.UpsertThreadEntry({"01A", 10, "old", 1}).has_value());
+  ASSERT_TRUE(threads_.UpsertThreadEntry({"01B", 20, "b", 2}).has_value());
+  ASSERT_TRUE(threads_.UpsertThreadEntry({"01A", 30, "new", 3}).has_value());
+  EXPECT_EQ(threads_.GetThreadModifiedTimes().value(),
+            (std::unordered_map<std::string, int64_t>{{"01A", 3}, {"01B", 2}}));
+
+  auto all = threads_.GetThreadEntries(10, "asc", "", "").value();
+  ASSERT_EQ(all.size(), 2u);
+  EXPECT_EQ(all[1].id, "01A");
+  EXPECT_EQ(all[1].data, "new");
+
+  ASSERT_TRUE(threads_.DeleteThreadEntry("01A").has_value());
+  ASSERT_TRUE(threads_.DeleteThreadEntry("01Z").has_value());
+  EXPECT_EQ(IdsOf(10, "asc"), (std::vector<std::string>{"01B"}));
+
+  ASSERT_TRUE(threads_.UpsertThreadEntry({"01C", 40, "c"}).has_value());
+  ASSERT_TRUE(threads_.DeleteThreadEntries({"01B", "01Z"}).has_value());
+  EXPECT_EQ(threads_.GetThreadModifiedTimes().value(),
+            (std::unordered_map<std::string, int64_t>{{"01C", 0}}));
+}
+
+TEST_F(ThreadsTestSuite, FailedUpsertWritesNothing) {
+  db_.exec(
+      "CREATE TRIGGER reject_bad BEFORE INSERT ON threads WHEN NEW.id = 'bad' "
+      "BEGIN SELECT RAISE(ABORT, 'rejected'); END");
+  EXPECT_TRUE(threads_
+                  .UpsertThreadEntries({{"01A", 10, "a"},
+                                        {"bad", 20, "b"},
+                                        {"01C", 30, "c"}})
+                  .has_error());
+  EXPECT_TRUE(threads_.GetThreadModifiedTimes()->empty());
+  EXPECT_TRUE(threads_.UpsertThreadEntries({{"01A", 10, "a"}}).has_value());
+  EXPECT_EQ(IdsOf(10, "asc"), (std::vector<std::string>{"01A"}));
+}
+
+TEST_F(ThreadsTestSuite, PagesSeekTheCreationTimeIndex) {
+  // Threads created in the same second are ordered by id
+  std::vector<ThreadEntry> entries;
+  for (int i = 0; i < 1000; i++) {
+    char id[8];
+    snprintf(id, sizeof(id), "t%04d", 999 - i);
+    entries.push_back({id, static_cast<uint64_t>(i / 10), "{}"});
+  }
+  ASSERT_TRUE(threads_.UpsertThreadEntries(entries).has_value());
+
+  std::set<std::string> statements;
+  sqlite3_trace_v2(
+      db_.getHandle(), SQLITE_TRACE_STMT,
+      [](unsigned, void* ctx, void* stmt, void*) {
+        static_cast<std::set<std::string>*>(ctx)->insert(
+            sqlite3_sql(static_cast<sqlite3_stmt*>(stmt)));
+        return 0;
+      },
+      &statements);
+
+  // Walking every page in both orders visits every thread once, in order
+  for (auto order : {"asc", "desc"}) {
+    std::vector<std::string> seen;
+    std::string after;
+    while (true) {
+      auto page = order == std::string("asc") ? IdsOf(64, order, after)
+                                              : IdsOf(64, order, "", after);
+      if (page.empty()) {
+        break;
+      }
+      seen.insert(seen.end(), page.begin(), page.end());
+      after = page.back();
+    }
+    ASSERT_EQ(seen.size(), entries.size()) << order;
+    for (size_t i = 0; i < seen.size(); i++) {
+      auto& expected = entries[order == std::string("asc")
+                                   ? i / 10 * 10 + 9 - i % 10
+                                   : 999 - (i / 10 * 10 + 9 - i % 10)];
+      EXPECT_EQ(seen[i], expected.id) << order << " " << i;
+    }
+  }
+  // From the end of one second to the start of the next
+  EXPECT_EQ(IdsOf(10, "asc", "t0508", "t0492"),
+            (std::vector<std::string>{"t0509", "t0490", "t0491"}));
+  EXPECT_TRUE(IdsOf(10, "asc", "missing").empty());
+  sqlite3_trace_v2(db_.getHandle(), 0, nullptr, nullptr);
+
+  ASSERT_GE(statements.size(), 3u);
+  // Pages with a cursor start with a search of the index, the first ones
+  // read it from one end, and none sorts
+  for (const auto& sql : statements) {
+    SQLite::Statement plan(db_, "EXPLAIN QUERY PLAN " + sql);
+    bool bounded = sql.find("?1") != std::string::npos ||
+                   sql.find("?2") != std::string::npos;
+    bool seeks = false;
+    while (plan.executeStep()) {
+      std::string detail = plan.getColumn(3).getString();
+      if (detail.find("threads") != std::string::npos) {
+        EXPECT_NE(detail.find("INDEX"), std::string::npos) << sql << detail;
+      }
+      EXPECT_EQ(detail.find("TEMP B-TREE"), std::string::npos) << sql << detail;
+      seeks |= detail.rfind("SEARCH threads USING", 0) == 0 &&
+               detail.find("threads_created_at (created_at") !=
+                   std::string::npos;
+    }
+    EXPECT_EQ(seeks, bounded) << sql;
+  }
+}
+}  // namespace cortex::db
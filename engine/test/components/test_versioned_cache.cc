@@ -0,0 +1,81 @@
+#include <atomic>
+#include <string>
+#include "gtest/gtest.h"
+#include "utils/versioned_cache.h"
+
+namespace {
+using Cache = cortex::utils::VersionedCache<std::string>;
+
+// A source with a version bumped by every write
+struct Source {
+  std::shared_ptr<const std::string> Load(const std::string& key) {
+    loads++;
+    if (key.rfind("missing", 0) == 0) {
+      return nullptr;
+    }
+    return std::make_shared<const std::string>(key + "@" +
+                                               std::to_string(version));
+  }
+
+  std::atomic<uint64_t> version{0};
+  int loads = 0;
+};
+}  // namespace
+
+class VersionedCacheTest : public ::testing::Test {
+ protected:
+  Source src_;
+  Cache cache_{[this] { return src_.version.load(); }};
+
+  std::shared_ptr<const std::string> Get(const std::string& key) {
+    return cache_.Get(key,
+                      [this](const std::string& k) { return src_.Load(k); });
+  }
+};
+
+TEST_F(VersionedCacheTest, KeepsEntriesUntilVersionMoves) {
+  EXPECT_EQ(*Get("a"), "a@0");
+  EXPECT_EQ(*Get("a"), "a@0");
+  EXPECT_EQ(src_.loads, 1);
+
+  src_.version++;
+  EXPECT_EQ(*Get("a"), "a@1");
+  EXPECT_EQ(src_.loads, 2);
+  EXPECT_EQ(cache_.Size(), 1u);
+}
+
+TEST_F(VersionedCacheTest, DoesNotCacheMisses) {
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(Get("missing" + std::to_string(i)), nullptr);
+  }
+  EXPECT_EQ(Get("missing0"), nullptr);
+  EXPECT_EQ(src_.loads, 101);
+  EXPECT_EQ(cache_.Size(), 0u);
+}
+
+TEST_F(VersionedCacheTest, InvalidateDropsEntries) {
+  Get("a");
+  Get("b");
+  cache_.Invalidate("a");
+  EXPECT_EQ(cache_.Size(), 1u);
+  Get("a");
+  Get("b");
+  EXPECT_EQ(src_.loads, 3);
+
+  cache_.Clear();
+  EXPECT_EQ(cache_.Size(), 0u);
+  Get("b");
+  EXPECT_EQ(src_.loads, 4);
+}
+
+TEST_F(VersionedCacheTest, SkipsEntryLoadedWhileSourceChanged) {
+  auto e = cache_.Get("a", [this](const std::string& k) {
+    auto res = src_.Load(k);
+    src_.version++;
+    return res;
+  });
+  EXPECT_EQ(*e, "a@0");
+  EXPECT_EQ(cache_.Size(), 0u);
+  EXPECT_EQ(*Get("a"), "a@1");
+  EXPECT_EQ(cache_.Size(), 1u);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+namespace cortex::utils {
+
+// Delays for retrying an operation: |initial|, then doubling up to |max|.
+// Cheap checks that usually succeed soon (e.g. waiting for a server to come
+// up) get a fast first retry without hammering the target afterwards.
+class ExponentialBackoff {
+ public:
+  using Duration = std::chrono::milliseconds;
+
+  ExponentialBackoff(Duration initial, Duration max)
+      : initial_(initial), max_(std::max(initial, max)), next_(initial) {}
+
+  // Returns the delay before the next attempt
+  Duration Next() {
+    auto d = next_;
+    next_ = std::min(max_, next_ * 2);
+    return d;
+  }
+
+  void Reset() { next_ = initial_; }
+
+ private:
+  Duration initial_;
+  Duration max_;
+  Duration next_;
+};
+
+}  // namespace cortex::utils
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+
+namespace cortex::utils {
+
+// Buffers the chunks of a streaming response so that a burst of small frames
+// goes out in one write. Data is flushed once |max_bytes| are buffered or
+// |min_interval| has passed since the previous flush, so an isolated frame is
+// never delayed and a burst is delayed by at most |min_interval|.
+class ChunkCoalescer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  ChunkCoalescer(size_t max_bytes, Clock::duration min_interval)
+      : max_bytes_(max_bytes), min_interval_(min_interval) {}
+
+  // Returns true if the buffer should be flushed right away
+  bool Append(std::string&& chunk, Clock::time_point now) {
+    if (buf_.empty()) {
+      buf_ = std::move(chunk);
+    } else {
+      buf_.append(chunk);
+    }
+    return !buf_.empty() &&
+           (buf_.size() >= max_bytes_ || now >= FlushDeadline());
+  }
+
+  // Latest time to flush the buffered data
+  Clock::time_point FlushDeadline() const {
+    return last_flush_ + min_interval_;
+  }
+
+  std::string Take(Clock::time_point now) {
+    last_flush_ = now;
+    return std::exchange(buf_, std::string());
+  }
+
+  bool Empty() const { return buf_.empty(); }
+
+  size_t Size() const { return buf_.size(); }
+
+ private:
+  size_t max_bytes_;
+  Clock::duration min_interval_;
+  Clock::time_point last_flush_;
+  std::string buf_;
+};
+
+}  // namespace cortex::utils
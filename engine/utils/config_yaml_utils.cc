@@ -51,9 +51,15 @@ cpp::result<void, std::string> CortexConfigMgr::DumpYamlConfig(
     node["supportedEngines"] = config.supportedEngines;
     node["checkedForSyncHubAt"] = config.checkedForSyncHubAt;
     node["apiKeys"] = config.apiKeys;
+    node["llamaServerUnixSocket"] = config.llamaServerUnixSocket;
+    node["embeddingBatchWindowMs"] = config.embeddingBatchWindowMs;
+    node["embeddingBatchMaxInputs"] = config.embeddingBatchMaxInputs;
+    node["embeddingCacheMaxEntries"] = config.embeddingCacheMaxEntries;
+    node["embeddingCacheDiskEntries"] = config.embeddingCacheDiskEntries;
 
     out_file << node;
     out_file.close();
+    Publish(path, config);
     return {};
   } catch (const std::exception& e) {
     CTL_ERR("Error writing to file: " << e.what());
@@ -86,7 +92,11 @@ CortexConfig CortexConfigMgr::FromYaml(const std::string& path,
          !node["verifyProxySsl"] || !node["verifyProxyHostSsl"] ||
          !node["supportedEngines"] || !node["sslCertPath"] ||
          !node["sslKeyPath"] || !node["noProxy"] ||
-         !node["checkedForSyncHubAt"] || !node["apiKeys"]);
+         !node["checkedForSyncHubAt"] || !node["apiKeys"] ||
+         !node["llamaServerUnixSocket"] || !node["embeddingBatchWindowMs"] ||
+         !node["embeddingBatchMaxInputs"] ||
+         !node["embeddingCacheMaxEntries"] ||
+         !node["embeddingCacheDiskEntries"]);
 
     CortexConfig config = {
         /* .logFolderPath = */ node["logFolderPath"]
@@ -189,6 +199,26 @@ CortexConfig CortexConfigMgr::FromYaml(const std::string& path,
         /* .apiKeys = */
             node["apiKeys"] ? node["apiKeys"].as<std::vector<std::string>>()
                             : default_cfg.apiKeys,
+        /* .llamaServerUnixSocket = */
+            node["llamaServerUnixSocket"]
+            ? node["llamaServerUnixSocket"].as<bool>()
+            : default_cfg.llamaServerUnixSocket,
+        /* .embeddingBatchWindowMs = */
+            node["embeddingBatchWindowMs"]
+            ? node["embeddingBatchWindowMs"].as<int>()
+            : default_cfg.embeddingBatchWindowMs,
+        /* .embeddingBatchMaxInputs = */
+            node["embeddingBatchMaxInputs"]
+            ? node["embeddingBatchMaxInputs"].as<int>()
+            : default_cfg.embeddingBatchMaxInputs,
+        /* .embeddingCacheMaxEntries = */
+            node["embeddingCacheMaxEntries"]
+            ? node["embeddingCacheMaxEntries"].as<int>()
+            : default_cfg.embeddingCacheMaxEntries,
+        /* .embeddingCacheDiskEntries = */
+            node["embeddingCacheDiskEntries"]
+            ? node["embeddingCacheDiskEntries"].as<int>()
+            : default_cfg.embeddingCacheDiskEntries,
 
     };
     if (should_update_config) {
@@ -204,4 +234,49 @@ CortexConfig CortexConfigMgr::FromYaml(const std::string& path,
     throw;
   }
 }
+
+std::shared_ptr<const CortexConfig> CortexConfigMgr::Snapshot(
+    const std::string& path, const std::function<CortexConfig()>& default_cfg,
+    std::chrono::milliseconds check_interval) {
+  using Clock = std::chrono::steady_clock;
+  auto loaded = std::atomic_load(&loaded_);
+  auto now = Clock::now();
+  auto last_check = Clock::time_point(Clock::duration(last_check_.load()));
+  if (loaded && loaded->path == path && now < last_check + check_interval) {
+    return loaded->config;
+  }
+
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  auto size = ec ? 0 : std::filesystem::file_size(path, ec);
+  last_check_ = now.time_since_epoch().count();
+  if (!ec && loaded && loaded->path == path && loaded->mtime == mtime &&
+      loaded->size == size) {
+    return loaded->config;
+  }
+
+  // Throws if the file is gone, like FromYaml()
+  auto config = std::make_shared<const CortexConfig>(
+      FromYaml(path, default_cfg()));
+  if (!ec) {
+    // Unless DumpYamlConfig() published a newer one while parsing
+    std::shared_ptr<const Loaded> parsed =
+        std::make_shared<const Loaded>(Loaded{path, mtime, size, config});
+    std::atomic_compare_exchange_strong(&loaded_, &loaded, parsed);
+  }
+  return config;
+}
+
+void CortexConfigMgr::Publish(const std::string& path, CortexConfig config) {
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  auto size = ec ? 0 : std::filesystem::file_size(path, ec);
+  if (ec) {
+    std::atomic_store(&loaded_, std::shared_ptr<const Loaded>());
+    return;
+  }
+  auto loaded = std::make_shared<const Loaded>(Loaded{
+      path, mtime, size, std::make_shared<const CortexConfig>(std::move(config))});
+  std::atomic_store(&loaded_, std::move(loaded));
+}
 }  // namespace config_yaml_utils
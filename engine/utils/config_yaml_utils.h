@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include "utils/engine_constants.h"
@@ -25,6 +30,11 @@ const std::vector<std::string> kDefaultEnabledOrigins{
     "http://localhost:39281", "http://127.0.0.1:39281", "http://0.0.0.0:39281"};
 constexpr const auto kDefaultNoProxy = "example.com,::1,localhost,127.0.0.1";
 const std::vector<std::string> kDefaultSupportedEngines{kLlamaEngine};
+constexpr const auto kDefaultLlamaServerUnixSocket = false;
+constexpr const int kDefaultEmbeddingBatchWindowMs = 5;
+constexpr const int kDefaultEmbeddingBatchMaxInputs = 64;
+constexpr const int kDefaultEmbeddingCacheMaxEntries = 0;
+constexpr const int kDefaultEmbeddingCacheDiskEntries = 0;
 
 struct CortexConfig {
   std::string logFolderPath;
@@ -67,13 +77,48 @@ struct CortexConfig {
   std::vector<std::string> supportedEngines;
   uint64_t checkedForSyncHubAt;
   std::vector<std::string> apiKeys;
+  /**
+   * Talk to local llama-server processes over unix domain sockets instead of
+   * TCP loopback. Ignored on Windows.
+   */
+  bool llamaServerUnixSocket;
+  /**
+   * How long an embeddings request waits for others to the same model to be
+   * batched with. 0 sends every request on its own.
+   */
+  int embeddingBatchWindowMs;
+  int embeddingBatchMaxInputs;
+  /**
+   * Number of embeddings cached in memory, 0 disables the cache. Up to
+   * embeddingCacheDiskEntries evicted ones are spilled to the data folder.
+   */
+  int embeddingCacheMaxEntries;
+  int embeddingCacheDiskEntries;
 };
 
+// How often Snapshot() checks the config file for changes made by other
+// processes or by hand
+constexpr const std::chrono::milliseconds kConfigCheckInterval{1000};
+
 class CortexConfigMgr {
  private:
   CortexConfigMgr() {}
   std::mutex mtx_;
 
+  // The parsed config file and the file state it was parsed from
+  struct Loaded {
+    std::string path;
+    std::filesystem::file_time_type mtime;
+    std::uintmax_t size;
+    std::shared_ptr<const CortexConfig> config;
+  };
+  // Only accessed with std::atomic_load() and std::atomic_store()
+  std::shared_ptr<const Loaded> loaded_;
+  // steady_clock time the file was last looked at
+  std::atomic<std::chrono::steady_clock::rep> last_check_{0};
+
+  void Publish(const std::string& path, CortexConfig config);
+
  public:
   CortexConfigMgr(CortexConfigMgr const&) = delete;
   CortexConfigMgr& operator=(CortexConfigMgr const&) = delete;
@@ -89,5 +134,14 @@ class CortexConfigMgr {
 
   CortexConfig FromYaml(const std::string& path,
                         const CortexConfig& default_cfg);
+
+  // Returns the config of |path| without parsing the file again, unless it
+  // was written with DumpYamlConfig() or changed on disk since the last
+  // parse. The file is looked at, not parsed, at most once per
+  // |check_interval|. |default_cfg| is only invoked when the file is parsed.
+  std::shared_ptr<const CortexConfig> Snapshot(
+      const std::string& path,
+      const std::function<CortexConfig()>& default_cfg,
+      std::chrono::milliseconds check_interval = kConfigCheckInterval);
 };
 }  // namespace config_yaml_utils
@@ -4,9 +4,11 @@
 #include <drogon/HttpResponse.h>
 #include <sys/stat.h>
 #include <ctime>
+#include <filesystem>
 #include <iomanip>
 #include <string>
 #include <utility>
+#include "utils/http_range_utils.h"
 #if defined(__linux__)
 #include <limits.h>
 #include <unistd.h>
@@ -71,12 +73,40 @@ inline drogon::HttpResponsePtr CreateCortexHttpJsonResponse(
   return res;
 };
 
-inline drogon::HttpResponsePtr CreateCortexContentResponse(
-    std::pair<std::unique_ptr<char[]>, size_t> content) {
-  auto [buffer, size] = std::move(content);
-  auto resp = drogon::HttpResponse::newHttpResponse();
-  resp->setBody(std::string(buffer.get(), size));
-  resp->setContentTypeCode(drogon::CT_APPLICATION_OCTET_STREAM);
+// Sends the file at |path| as an octet stream. The body is not read into
+// memory; drogon sends it from the file, with sendfile where available. A
+// single byte range is honored with a 206, and a request that already has
+// |etag| gets a 304.
+inline drogon::HttpResponsePtr CreateCortexFileResponse(
+    const drogon::HttpRequestPtr& req, const std::filesystem::path& path,
+    uint64_t size, const std::string& etag) {
+  drogon::HttpResponsePtr resp;
+  auto& if_none_match = req->getHeader("if-none-match");
+  auto& if_range = req->getHeader("if-range");
+  if (!if_none_match.empty() &&
+      http_range_utils::EtagMatches(if_none_match, etag)) {
+    resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(drogon::k304NotModified);
+  } else if (auto range = http_range_utils::ParseRange(
+                 if_range.empty() || if_range == etag
+                     ? req->getHeader("range")
+                     : std::string_view{},
+                 size);
+             range.has_error()) {
+    resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(drogon::k416RequestedRangeNotSatisfiable);
+    resp->addHeader("Content-Range", "bytes */" + std::to_string(size));
+  } else if (range->has_value()) {
+    // Sets the 206 status and Content-Range
+    resp = drogon::HttpResponse::newFileResponse(
+        path.string(), range->value().offset, range->value().length, true, "",
+        drogon::CT_APPLICATION_OCTET_STREAM);
+  } else {
+    resp = drogon::HttpResponse::newFileResponse(
+        path.string(), "", drogon::CT_APPLICATION_OCTET_STREAM);
+  }
+  resp->addHeader("ETag", etag);
+  resp->addHeader("Accept-Ranges", "bytes");
 
 #if defined(_WIN32)
   resp->addHeader("date", GetDateRFC1123());
@@ -95,11 +125,12 @@ inline drogon::HttpResponsePtr CreateTextPlainResponse(
   return resp;
 }
 
-inline drogon::HttpResponsePtr CreateCortexStreamResponse(
-    const std::function<std::size_t(char*, std::size_t)>& callback,
-    const std::string& attachmentFileName = "") {
-  auto res = drogon::HttpResponse::newStreamResponse(
-      callback, attachmentFileName, drogon::CT_NONE, "text/event-stream");
+// The response is written through the ResponseStream passed to |callback|,
+// which may be used from any thread
+inline drogon::HttpResponsePtr CreateCortexAsyncStreamResponse(
+    const std::function<void(drogon::ResponseStreamPtr)>& callback) {
+  auto res = drogon::HttpResponse::newAsyncStreamResponse(callback);
+  res->setContentTypeString("text/event-stream");
 #if defined(_WIN32)
   res->addHeader("date", GetDateRFC1123());
 #endif
@@ -0,0 +1,238 @@
+#include "curl_multi_loop.h"
+
+#include "utils/logging_utils.h"
+
+namespace curl_utils {
+namespace {
+constexpr const int kPollTimeoutMs = 1000;
+// Number of idle connections kept alive by the multi handle
+constexpr const long kMaxCachedConnections = 256;
+// Number of idle easy handles kept for reuse
+constexpr const size_t kMaxIdleHandles = 64;
+}  // namespace
+
+CurlMultiLoop::CurlMultiLoop(const std::string& name,
+                             long max_connections_per_host)
+    : name_(name) {
+  multi_ = curl_multi_init();
+  curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, kMaxCachedConnections);
+  if (max_connections_per_host > 0) {
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS,
+                      max_connections_per_host);
+  }
+  thread_ = std::thread([this] { Run(); });
+}
+
+CurlMultiLoop::~CurlMultiLoop() {
+  Stop();
+  for (auto h : idle_handles_) {
+    curl_easy_cleanup(h);
+  }
+  curl_multi_cleanup(multi_);
+}
+
+void CurlMultiLoop::Stop() {
+  stop_ = true;
+  curl_multi_wakeup(multi_);
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+uint64_t CurlMultiLoop::Add(Request&& req) {
+  auto t = std::make_unique<Transfer>();
+  t->id = req.id != 0 ? req.id : ++next_id_;
+  t->req = std::move(req);
+  auto id = t->id;
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    if (!closed_) {
+      // Counted before the loop thread can finish it
+      inflight_count_++;
+      pending_.push_back(std::move(t));
+    }
+  }
+  if (t) {
+    CTL_WRN(name_ << ": loop is stopped, dropping request to " << t->req.url);
+    if (t->req.on_done) {
+      t->req.on_done(CURLE_ABORTED_BY_CALLBACK, 0);
+    }
+    return id;
+  }
+  curl_multi_wakeup(multi_);
+  return id;
+}
+
+void CurlMultiLoop::Resume(uint64_t id) {
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    resumed_.push_back(id);
+  }
+  curl_multi_wakeup(multi_);
+}
+
+void CurlMultiLoop::Cancel(uint64_t id) {
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    cancelled_.push_back(id);
+  }
+  curl_multi_wakeup(multi_);
+}
+
+size_t CurlMultiLoop::WriteCallback(char* ptr, size_t size, size_t nmemb,
+                                    void* userdata) {
+  auto* t = static_cast<Transfer*>(userdata);
+  auto data_length = size * nmemb;
+  if (!t->req.on_data) {
+    return data_length;
+  }
+  switch (t->req.on_data(ptr, data_length)) {
+    case DataAction::kPause:
+      return CURL_WRITEFUNC_PAUSE;
+    case DataAction::kAbort:
+      // Returning a different size aborts the transfer
+      return 0;
+    default:
+      return data_length;
+  }
+}
+
+void CurlMultiLoop::AttachPending() {
+  std::vector<std::unique_ptr<Transfer>> pending;
+  std::vector<uint64_t> resumed;
+  std::vector<uint64_t> cancelled;
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    pending.swap(pending_);
+    resumed.swap(resumed_);
+    cancelled.swap(cancelled_);
+  }
+
+  for (auto id : resumed) {
+    // The transfer may have finished already
+    if (auto it = inflight_ids_.find(id); it != inflight_ids_.end()) {
+      curl_easy_pause(it->second, CURLPAUSE_CONT);
+    }
+  }
+
+  for (auto& t : pending) {
+    CURL* easy = nullptr;
+    if (!idle_handles_.empty()) {
+      easy = idle_handles_.back();
+      idle_handles_.pop_back();
+    } else {
+      easy = curl_easy_init();
+    }
+    if (!easy) {
+      CTL_WRN(name_ << ": failed to initialize CURL");
+      inflight_count_--;
+      if (t->req.on_done) {
+        t->req.on_done(CURLE_FAILED_INIT, 0);
+      }
+      continue;
+    }
+
+    t->easy = easy;
+    curl_easy_setopt(easy, CURLOPT_URL, t->req.url.c_str());
+    if (!t->req.body.empty()) {
+      curl_easy_setopt(easy, CURLOPT_POST, 1L);
+      curl_easy_setopt(easy, CURLOPT_POSTFIELDS, t->req.body.c_str());
+      curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, t->req.body.length());
+    }
+    for (auto const& h : t->req.headers) {
+      t->headers = curl_slist_append(t->headers, h.c_str());
+    }
+    if (t->headers) {
+      curl_easy_setopt(easy, CURLOPT_HTTPHEADER, t->headers);
+    }
+    if (!t->req.unix_socket_path.empty()) {
+      curl_easy_setopt(easy, CURLOPT_UNIX_SOCKET_PATH,
+                       t->req.unix_socket_path.c_str());
+    }
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, t.get());
+
+    curl_multi_add_handle(multi_, easy);
+    inflight_ids_[t->id] = easy;
+    inflight_[easy] = std::move(t);
+  }
+
+  // After attaching, so that a transfer cancelled right after Add() is found
+  for (auto id : cancelled) {
+    if (auto it = inflight_ids_.find(id); it != inflight_ids_.end()) {
+      Finish(it->second, CURLE_ABORTED_BY_CALLBACK);
+    }
+  }
+}
+
+void CurlMultiLoop::Finish(CURL* easy, CURLcode code) {
+  auto it = inflight_.find(easy);
+  if (it == inflight_.end()) {
+    return;
+  }
+  auto t = std::move(it->second);
+  inflight_.erase(it);
+  inflight_ids_.erase(t->id);
+
+  long http_status = 0;
+  curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &http_status);
+  curl_multi_remove_handle(multi_, easy);
+  inflight_count_--;
+
+  if (t->req.on_done) {
+    t->req.on_done(code, http_status);
+  }
+
+  if (t->headers) {
+    curl_slist_free_all(t->headers);
+  }
+  if (idle_handles_.size() < kMaxIdleHandles) {
+    curl_easy_reset(easy);
+    idle_handles_.push_back(easy);
+  } else {
+    curl_easy_cleanup(easy);
+  }
+}
+
+void CurlMultiLoop::Run() {
+  while (!stop_) {
+    AttachPending();
+
+    int running = 0;
+    auto mc = curl_multi_perform(multi_, &running);
+    if (mc != CURLM_OK) {
+      CTL_WRN(name_ << ": curl_multi_perform failed: "
+                    << curl_multi_strerror(mc));
+    }
+
+    CURLMsg* msg = nullptr;
+    int msgs_left = 0;
+    while ((msg = curl_multi_info_read(multi_, &msgs_left))) {
+      if (msg->msg == CURLMSG_DONE) {
+        Finish(msg->easy_handle, msg->data.result);
+      }
+    }
+
+    curl_multi_poll(multi_, nullptr, 0, kPollTimeoutMs, nullptr);
+  }
+
+  // Shutting down, let every owner know its transfer is gone. Requests added
+  // from now on are failed by Add().
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    closed_ = true;
+  }
+  AttachPending();
+  std::vector<CURL*> handles;
+  for (auto const& [easy, _] : inflight_) {
+    handles.push_back(easy);
+  }
+  for (auto easy : handles) {
+    Finish(easy, CURLE_ABORTED_BY_CALLBACK);
+  }
+}
+
+}  // namespace curl_utils
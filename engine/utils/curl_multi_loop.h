@@ -0,0 +1,173 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace curl_utils {
+
+// A single thread driving many concurrent HTTP transfers through one
+// curl_multi handle. Connections are kept alive in the multi handle's
+// connection cache, so consecutive requests to the same host:port reuse them
+// instead of paying a new TCP handshake.
+//
+// All callbacks are invoked on the loop thread and must not block.
+class CurlMultiLoop {
+ public:
+  enum class DataAction {
+    kContinue,
+    // Leave the chunk unconsumed and pause the transfer until Resume(), the
+    // chunk is delivered again then
+    kPause,
+    kAbort,
+  };
+  using DataCallback =
+      std::function<DataAction(const char* data, size_t size)>;
+  using DoneCallback = std::function<void(CURLcode code, long http_status)>;
+
+  struct Request {
+    // Optional, from ReserveId()
+    uint64_t id = 0;
+    std::string url;
+    std::string body;
+    std::vector<std::string> headers;
+    // Connect through this unix domain socket instead of the URL's host
+    std::string unix_socket_path;
+    DataCallback on_data;
+    DoneCallback on_done;
+  };
+
+  explicit CurlMultiLoop(const std::string& name,
+                         long max_connections_per_host = 0);
+  ~CurlMultiLoop();
+
+  CurlMultiLoop(const CurlMultiLoop&) = delete;
+  CurlMultiLoop& operator=(const CurlMultiLoop&) = delete;
+
+  // Queues a POST request (or GET if body is empty). Returns the transfer id.
+  // Once the loop is stopped the request fails right away: its done callback
+  // gets CURLE_ABORTED_BY_CALLBACK on the calling thread.
+  uint64_t Add(Request&& req);
+
+  // Returns an id for a request that is added later, so that callbacks can
+  // refer to their transfer before Add() returns
+  uint64_t ReserveId() { return ++next_id_; }
+
+  // Resumes a transfer paused by its data callback. Thread safe.
+  void Resume(uint64_t id);
+
+  // Aborts a transfer, its done callback gets CURLE_ABORTED_BY_CALLBACK.
+  // Transfers that finished already are left alone. Thread safe.
+  void Cancel(uint64_t id);
+
+  size_t GetInflightCount() const { return inflight_count_; }
+
+  // Finishes every transfer with CURLE_ABORTED_BY_CALLBACK and joins the loop
+  // thread. Called by the destructor.
+  void Stop();
+
+ private:
+  struct Transfer {
+    uint64_t id;
+    CURL* easy = nullptr;
+    curl_slist* headers = nullptr;
+    Request req;
+  };
+
+  static size_t WriteCallback(char* ptr, size_t size, size_t nmemb,
+                              void* userdata);
+
+  void Run();
+  void AttachPending();
+  void Finish(CURL* easy, CURLcode code);
+
+  std::string name_;
+  CURLM* multi_ = nullptr;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> next_id_{0};
+  std::atomic<size_t> inflight_count_{0};
+
+  std::mutex mtx_;
+  // Set once the loop thread stopped taking requests
+  bool closed_ = false;
+  std::vector<std::unique_ptr<Transfer>> pending_;
+  std::vector<uint64_t> resumed_;
+  std::vector<uint64_t> cancelled_;
+
+  // Only touched by the loop thread
+  std::unordered_map<CURL*, std::unique_ptr<Transfer>> inflight_;
+  std::unordered_map<uint64_t, CURL*> inflight_ids_;
+  std::vector<CURL*> idle_handles_;
+
+  std::thread thread_;
+};
+
+// Resumes or cancels one transfer of a loop on behalf of callbacks that may
+// outlive the transfer and the loop, such as the ones registered with a
+// StreamSink. The transfer's done callback must call Disarm(), later calls
+// do nothing then.
+//
+// A handle can also be created before its transfer exists, so that callbacks
+// are registered right away, and bound once the transfer was added. Calls made
+// in between are replayed by Bind().
+class TransferHandle {
+ public:
+  TransferHandle() = default;
+
+  TransferHandle(CurlMultiLoop& loop, uint64_t id) : loop_(&loop), id_(id) {}
+
+  // Binds the handle to transfer |id| of |loop|, which must have been added
+  // already. Does nothing if the transfer is done already.
+  void Bind(CurlMultiLoop& loop, uint64_t id) {
+    std::lock_guard<std::mutex> l(mtx_);
+    if (disarmed_) {
+      return;
+    }
+    loop_ = &loop;
+    id_ = id;
+    if (cancelled_) {
+      loop_->Cancel(id_);
+    } else if (resumed_) {
+      loop_->Resume(id_);
+    }
+  }
+
+  void Resume() {
+    std::lock_guard<std::mutex> l(mtx_);
+    resumed_ = true;
+    if (loop_) {
+      loop_->Resume(id_);
+    }
+  }
+
+  void Cancel() {
+    std::lock_guard<std::mutex> l(mtx_);
+    cancelled_ = true;
+    if (loop_) {
+      loop_->Cancel(id_);
+    }
+  }
+
+  void Disarm() {
+    std::lock_guard<std::mutex> l(mtx_);
+    loop_ = nullptr;
+    disarmed_ = true;
+  }
+
+ private:
+  std::mutex mtx_;
+  CurlMultiLoop* loop_ = nullptr;
+  uint64_t id_ = 0;
+  bool resumed_ = false;
+  bool cancelled_ = false;
+  bool disarmed_ = false;
+};
+
+}  // namespace curl_utils
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <array>
+#include <mutex>
+
+namespace curl_utils {
+
+// Shares the DNS cache and TLS sessions between easy handles that are used
+// from several threads, so that concurrent requests to the same host skip
+// name resolution and full TLS handshakes.
+//
+// Connections are not shared: libcurl does not support sharing them between
+// concurrent threads. Use ThreadLocalHandle() to keep them alive per thread.
+class CurlShare {
+ public:
+  CurlShare() {
+    share_ = curl_share_init();
+    if (share_) {
+      curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, Lock);
+      curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, Unlock);
+      curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+      curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+  }
+
+  ~CurlShare() {
+    if (share_) {
+      curl_share_cleanup(share_);
+    }
+  }
+
+  CurlShare(const CurlShare&) = delete;
+  CurlShare& operator=(const CurlShare&) = delete;
+
+  void Attach(CURL* easy) const {
+    if (share_) {
+      curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+    }
+  }
+
+ private:
+  static void Lock(CURL*, curl_lock_data data, curl_lock_access, void* ptr) {
+    static_cast<CurlShare*>(ptr)->mtx_[data].lock();
+  }
+
+  static void Unlock(CURL*, curl_lock_data data, void* ptr) {
+    static_cast<CurlShare*>(ptr)->mtx_[data].unlock();
+  }
+
+  CURLSH* share_ = nullptr;
+  std::array<std::mutex, CURL_LOCK_DATA_LAST> mtx_;
+};
+
+// Returns this thread's easy handle with its options reset. Live connections
+// stay in the handle, so consecutive requests from a worker thread reuse them.
+// The handle must not be cleaned up by the caller, and a CurlShare attached to
+// it must outlive the thread.
+inline CURL* ThreadLocalHandle() {
+  struct Holder {
+    CURL* handle = curl_easy_init();
+    ~Holder() {
+      if (handle) {
+        curl_easy_cleanup(handle);
+      }
+    }
+  };
+  thread_local Holder holder;
+  if (holder.handle) {
+    curl_easy_reset(holder.handle);
+  }
+  return holder.handle;
+}
+
+}  // namespace curl_utils
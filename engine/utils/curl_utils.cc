@@ -28,6 +28,27 @@ class CurlResponse {
   std::string data_;
 };
 
+size_t EtagHeaderCallback(char* buffer, size_t size, size_t nitems,
+                          void* userdata) {
+  auto* etag = static_cast<std::string*>(userdata);
+  std::string line(buffer, size * nitems);
+  const std::string kEtag = "etag:";
+  // Headers of redirects come first, the last response's ETag wins
+  if (line.size() > kEtag.size() &&
+      string_utils::EqualsIgnoreCase(line.substr(0, kEtag.size()), kEtag)) {
+    *etag = line.substr(kEtag.size());
+    string_utils::Trim(*etag);
+  }
+  return size * nitems;
+}
+
+// Called at least once a second, also while waiting for the server
+int AbortProgressCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t,
+                          curl_off_t) {
+  auto* should_abort = static_cast<std::function<bool()>*>(clientp);
+  return (*should_abort)() ? 1 : 0;
+}
+
 void SetUpProxy(CURL* handle, const std::string& url) {
   auto config = file_manager_utils::GetCortexConfig();
   if (!config.proxyUrl.empty()) {
@@ -175,6 +196,75 @@ cpp::result<std::string, std::string> SimpleGet(const std::string& url,
   return response->GetData();
 }
 
+cpp::result<ConditionalResponse, std::string> ConditionalGet(
+    const std::string& url, const std::string& etag, const int timeout,
+    std::function<bool()> should_abort) {
+  auto curl = curl_easy_init();
+
+  if (!curl) {
+    return cpp::fail("Failed to init CURL");
+  }
+
+  auto headers = GetHeaders(url);
+  curl_slist* curl_headers = nullptr;
+  if (headers) {
+    for (const auto& [key, value] : headers->m) {
+      auto header = key + ": " + value;
+      curl_headers = curl_slist_append(curl_headers, header.c_str());
+    }
+  }
+  if (!etag.empty()) {
+    auto header = "If-None-Match: " + etag;
+    curl_headers = curl_slist_append(curl_headers, header.c_str());
+  }
+
+  CurlResponse response;
+  ConditionalResponse res;
+  SetUpProxy(curl, url);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_headers);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlResponse::WriteCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, EtagHeaderCallback);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &res.etag);
+  if (timeout > 0) {
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+  }
+  if (should_abort) {
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, AbortProgressCallback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &should_abort);
+  }
+
+  auto code = curl_easy_perform(curl);
+
+  auto http_code = 0L;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_slist_free_all(curl_headers);
+  curl_easy_cleanup(curl);
+  if (code != CURLE_OK) {
+    return cpp::fail("CURL request failed: " +
+                     static_cast<std::string>(curl_easy_strerror(code)));
+  }
+  if (http_code >= 400) {
+    CTL_ERR("HTTP request failed with status code: " +
+            std::to_string(http_code));
+    return cpp::fail(response.GetData());
+  }
+
+  if (http_code == 304) {
+    res.not_modified = true;
+    // Servers may leave the ETag out of a 304
+    if (res.etag.empty()) {
+      res.etag = etag;
+    }
+  } else {
+    res.body = response.GetData();
+  }
+  return res;
+}
+
 cpp::result<std::string, std::string> SimpleRequest(
     const std::string& url, const RequestType& request_type,
     const std::string& body) {
@@ -5,6 +5,7 @@
 #include <json/value.h>
 #include <yaml-cpp/node/node.h>
 #include <yaml-cpp/node/parse.h>
+#include <functional>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -24,6 +25,23 @@ std::shared_ptr<Header> GetHeaders(const std::string& url);
 cpp::result<std::string, std::string> SimpleGet(const std::string& url,
                                                 const int timeout = -1);
 
+struct ConditionalResponse {
+  // The server answered 304, |body| is empty and the cached copy is current
+  bool not_modified = false;
+  std::string body;
+  std::string etag;
+};
+
+/**
+ * ConditionalGet sends a GET request with If-None-Match set to [etag] when it
+ * is not empty, and returns the ETag of the response for the next request.
+ * The request is aborted within about a second once [should_abort] returns
+ * true.
+ */
+cpp::result<ConditionalResponse, std::string> ConditionalGet(
+    const std::string& url, const std::string& etag, const int timeout = -1,
+    std::function<bool()> should_abort = nullptr);
+
 cpp::result<std::string, std::string> SimpleRequest(
     const std::string& url, const RequestType& request_type,
     const std::string& body = "");
@@ -224,6 +224,16 @@ config_yaml_utils::CortexConfig GetDefaultConfig() {
       /* .supportedEngines = */ config_yaml_utils::kDefaultSupportedEngines,
       /* .checkedForSyncHubAt = */ 0u,
       /* .apiKeys = */ {},
+      /* .llamaServerUnixSocket = */
+          config_yaml_utils::kDefaultLlamaServerUnixSocket,
+      /* .embeddingBatchWindowMs = */
+          config_yaml_utils::kDefaultEmbeddingBatchWindowMs,
+      /* .embeddingBatchMaxInputs = */
+          config_yaml_utils::kDefaultEmbeddingBatchMaxInputs,
+      /* .embeddingCacheMaxEntries = */
+          config_yaml_utils::kDefaultEmbeddingCacheMaxEntries,
+      /* .embeddingCacheDiskEntries = */
+          config_yaml_utils::kDefaultEmbeddingCacheDiskEntries,
   };
 }
 
@@ -246,11 +256,14 @@ cpp::result<void, std::string> CreateConfigFileIfNotExist() {
 }
 
 config_yaml_utils::CortexConfig GetCortexConfig() {
-  auto config_path = GetConfigurationPath();
+  return *GetCortexConfigSnapshot();
+}
 
-  auto default_cfg = GetDefaultConfig();
-  return config_yaml_utils::CortexConfigMgr::GetInstance().FromYaml(
-      config_path.string(), default_cfg);
+std::shared_ptr<const config_yaml_utils::CortexConfig>
+GetCortexConfigSnapshot() {
+  auto config_path = GetConfigurationPath();
+  return config_yaml_utils::CortexConfigMgr::GetInstance().Snapshot(
+      config_path.string(), GetDefaultConfig);
 }
 
 std::filesystem::path GetCortexDataPath() {
@@ -1,5 +1,6 @@
 #pragma once
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <string_view>
 #include "common/download_task.h"
@@ -38,6 +39,11 @@ cpp::result<void, std::string> CreateConfigFileIfNotExist();
 
 config_yaml_utils::CortexConfig GetCortexConfig();
 
+// Same as GetCortexConfig() without copying, for hot paths. The snapshot is
+// immutable: later config changes are picked up by calling this again.
+std::shared_ptr<const config_yaml_utils::CortexConfig>
+GetCortexConfigSnapshot();
+
 std::filesystem::path GetCortexDataPath();
 
 std::filesystem::path GetCortexLogPath();
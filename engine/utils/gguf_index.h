@@ -0,0 +1,591 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include "utils/logging_utils.h"
+#include "utils/result.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>     // For file descriptors
+#include <sys/mman.h>  // For memory-mapped file
+#include <unistd.h>    // For file descriptors
+#endif
+
+/**
+ * One parse of a GGUF file's header, metadata and tensor infos, shared by
+ * model import, tokenizer extraction and resource estimation.
+ *
+ * Reference: https://github.com/ggml-org/ggml/blob/master/docs/gguf.md
+ */
+namespace cortex_utils {
+#undef min
+#undef max
+
+// present in the first 4 bytes of a GGUF file
+constexpr const uint32_t kGgufMagic = 0x46554747;
+
+enum GgufValueType : uint32_t {
+  kGgufUint8 = 0,
+  kGgufInt8,
+  kGgufUint16,
+  kGgufInt16,
+  kGgufUint32,
+  kGgufInt32,
+  kGgufFloat32,
+  kGgufBool,
+  kGgufString,
+  kGgufArray,
+  kGgufUint64,
+  kGgufInt64,
+  kGgufFloat64,
+};
+
+// Size of a value of |type|, 0 for strings and arrays
+inline size_t GgufScalarSize(uint32_t type) {
+  switch (type) {
+    case kGgufUint8:
+    case kGgufInt8:
+    case kGgufBool:
+      return 1;
+    case kGgufUint16:
+    case kGgufInt16:
+      return 2;
+    case kGgufUint32:
+    case kGgufInt32:
+    case kGgufFloat32:
+      return 4;
+    case kGgufUint64:
+    case kGgufInt64:
+    case kGgufFloat64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// Read-only view of a whole file, unmapped on destruction
+class MappedFile {
+ public:
+  static cpp::result<std::unique_ptr<MappedFile>, std::string> Open(
+      const std::filesystem::path& path) {
+    std::unique_ptr<MappedFile> f(new MappedFile());
+#ifdef _WIN32
+    HANDLE file_handle =
+        CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+      return cpp::fail("Failed to open file: " + path.string());
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size)) {
+      CloseHandle(file_handle);
+      return cpp::fail("Failed to get file size: " + path.string());
+    }
+    f->size_ = static_cast<size_t>(file_size.QuadPart);
+    if (f->size_ == 0) {
+      CloseHandle(file_handle);
+      return std::move(f);
+    }
+    HANDLE file_mapping =
+        CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The view keeps the file open
+    CloseHandle(file_handle);
+    if (file_mapping == nullptr) {
+      return cpp::fail("Failed to create file mapping: " + path.string());
+    }
+    f->data_ = static_cast<const char*>(
+        MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, f->size_));
+    CloseHandle(file_mapping);
+    if (f->data_ == nullptr) {
+      return cpp::fail("Failed to map file: " + path.string());
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return cpp::fail("Failed to open file: " + path.string() +
+                       ", error: " + std::to_string(errno));
+    }
+    f->size_ = static_cast<size_t>(lseek(fd, 0, SEEK_END));
+    if (f->size_ == 0) {
+      close(fd);
+      return std::move(f);
+    }
+    auto* data = mmap(nullptr, f->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      return cpp::fail("Failed to map file: " + path.string());
+    }
+    f->data_ = static_cast<const char*>(data);
+#endif
+    return std::move(f);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data_ == nullptr) {
+      return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<char*>(data_), size_);
+#endif
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile() = default;
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// The header, metadata key-values and tensor infos of a GGUF file. Keys and
+// values are views into a copy of the file's header bytes, which is a few MiB
+// at most even for the largest vocabularies: the index does not keep the model
+// file mapped, so it can be cached without pinning the file (Windows cannot
+// delete a mapped file).
+class GgufIndex {
+ public:
+  // Elements of an array value, decoded on access
+  struct Array {
+    uint32_t type = 0;
+    uint64_t size = 0;
+    // The encoded elements
+    std::string_view data;
+
+    // Walks the strings before |i|, cheap for the special token ids that are
+    // looked up, which are near the start of the vocabulary
+    std::optional<std::string_view> StringAt(uint64_t i) const {
+      if (type != kGgufString || i >= size) {
+        return std::nullopt;
+      }
+      size_t pos = 0;
+      for (uint64_t n = 0;; n++) {
+        uint64_t length;
+        std::memcpy(&length, data.data() + pos, sizeof(length));
+        if (n == i) {
+          return data.substr(pos + sizeof(length), length);
+        }
+        pos += sizeof(length) + length;
+      }
+    }
+
+    // Numeric elements, as a double
+    std::optional<double> NumberAt(uint64_t i) const {
+      auto size_of = GgufScalarSize(type);
+      if (size_of == 0 || i >= size) {
+        return std::nullopt;
+      }
+      return ToNumber(type, data.data() + i * size_of);
+    }
+  };
+
+  struct Kv {
+    std::string_view key;
+    uint32_t type = 0;
+    // The encoded scalar, the string's characters, or an array's elements
+    std::string_view data;
+    uint32_t array_type = 0;
+    uint64_t array_size = 0;
+  };
+
+  struct TensorInfo {
+    std::string_view name;
+    uint32_t n_dimensions = 0;
+    std::vector<uint64_t> dimensions;
+    // A ggml type
+    uint32_t type = 0;
+    // Relative to the start of the tensor data
+    uint64_t offset = 0;
+  };
+
+  // Parses the file at |path|
+  static cpp::result<std::shared_ptr<const GgufIndex>, std::string> Parse(
+      const std::filesystem::path& path) {
+    auto start = std::chrono::steady_clock::now();
+    auto mapped = MappedFile::Open(path);
+    if (mapped.has_error()) {
+      return cpp::fail(mapped.error());
+    }
+    auto index = std::shared_ptr<GgufIndex>(new GgufIndex());
+    auto res = index->ParseHeader((*mapped)->data(), (*mapped)->size());
+    if (res.has_error()) {
+      return cpp::fail(res.error() + ": " + path.string());
+    }
+    CTL_DBG("Indexed " << path.string() << ": " << index->kvs_.size()
+                       << " kvs, " << index->tensors_.size() << " tensors, "
+                       << index->header_.size() << " header bytes in "
+                       << std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count()
+                       << " us");
+    return std::move(index);
+  }
+
+  // Returns the index of |path| from a small cache, which is only used while
+  // the file keeps its size and modification time
+  static cpp::result<std::shared_ptr<const GgufIndex>, std::string> Get(
+      const std::filesystem::path& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) {
+      return cpp::fail("Gguf file does not exist at " + path.string());
+    }
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    auto key = path.lexically_normal().string();
+
+    auto& cache = GetCache();
+    {
+      std::lock_guard<std::mutex> l(cache.mtx);
+      for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+        if (it->path == key) {
+          if (it->size == size && it->mtime == mtime) {
+            cache.entries.splice(cache.entries.begin(), cache.entries, it);
+            return it->index;
+          }
+          cache.entries.erase(it);
+          break;
+        }
+      }
+    }
+
+    // Parsed outside of the lock, concurrent misses on one file may parse it
+    // twice
+    auto index = Parse(path);
+    if (index.has_error()) {
+      return index;
+    }
+    std::lock_guard<std::mutex> l(cache.mtx);
+    cache.entries.push_front(CacheEntry{key, size, mtime, index.value()});
+    while (cache.entries.size() > kMaxCachedIndexes) {
+      cache.entries.pop_back();
+    }
+    return index;
+  }
+
+  // The files of a model split with gguf-split, which are named
+  // <name>-00001-of-0000N.gguf. Only the first one has the model's metadata.
+  // Returns |path| alone if the model is not split.
+  std::vector<std::filesystem::path> SplitPaths(
+      const std::filesystem::path& path) const {
+    auto count = GetUint("split.count").value_or(1);
+    static const std::regex kSplitName(R"((.*)-(\d{5})-of-(\d{5})\.gguf)");
+    std::smatch m;
+    auto name = path.filename().string();
+    if (count <= 1 || !std::regex_match(name, m, kSplitName) ||
+        std::stoull(m[3].str()) != count) {
+      return {path};
+    }
+    std::vector<std::filesystem::path> paths;
+    for (uint64_t i = 1; i <= count; i++) {
+      char n[6];
+      std::snprintf(n, sizeof(n), "%05llu", static_cast<unsigned long long>(i));
+      paths.push_back(path.parent_path() /
+                      (m[1].str() + "-" + n + "-of-" + m[3].str() + ".gguf"));
+    }
+    return paths;
+  }
+
+  uint32_t version() const { return version_; }
+  uint64_t file_size() const { return file_size_; }
+  // Where the tensor data starts, after the header and its padding
+  uint64_t tensor_data_offset() const { return tensor_data_offset_; }
+  const std::vector<Kv>& kvs() const { return kvs_; }
+  const std::vector<TensorInfo>& tensors() const { return tensors_; }
+
+  const Kv* Find(std::string_view key) const {
+    for (const auto& kv : kvs_) {
+      if (kv.key == key) {
+        return &kv;
+      }
+    }
+    return nullptr;
+  }
+
+  // Any integer or bool value
+  std::optional<uint64_t> GetUint(std::string_view key) const {
+    auto kv = Find(key);
+    if (!kv || !IsInteger(kv->type)) {
+      return std::nullopt;
+    }
+    return static_cast<uint64_t>(ToNumber(kv->type, kv->data.data()));
+  }
+
+  std::optional<double> GetNumber(std::string_view key) const {
+    auto kv = Find(key);
+    if (!kv || GgufScalarSize(kv->type) == 0) {
+      return std::nullopt;
+    }
+    return ToNumber(kv->type, kv->data.data());
+  }
+
+  std::optional<bool> GetBool(std::string_view key) const {
+    auto kv = Find(key);
+    if (!kv || kv->type != kGgufBool) {
+      return std::nullopt;
+    }
+    return kv->data[0] != 0;
+  }
+
+  std::optional<std::string_view> GetString(std::string_view key) const {
+    auto kv = Find(key);
+    if (!kv || kv->type != kGgufString) {
+      return std::nullopt;
+    }
+    return kv->data;
+  }
+
+  std::optional<Array> GetArray(std::string_view key) const {
+    auto kv = Find(key);
+    if (!kv || kv->type != kGgufArray) {
+      return std::nullopt;
+    }
+    return ToArray(*kv);
+  }
+
+  static Array ToArray(const Kv& kv) {
+    return Array{kv.array_type, kv.array_size, kv.data};
+  }
+
+  static bool IsInteger(uint32_t type) {
+    return type != kGgufFloat32 && type != kGgufFloat64 &&
+           GgufScalarSize(type) != 0;
+  }
+
+  // |p| must point to a scalar of |type|
+  static double ToNumber(uint32_t type, const char* p) {
+    switch (type) {
+      case kGgufUint8:
+        return Load<uint8_t>(p);
+      case kGgufInt8:
+        return Load<int8_t>(p);
+      case kGgufUint16:
+        return Load<uint16_t>(p);
+      case kGgufInt16:
+        return Load<int16_t>(p);
+      case kGgufUint32:
+        return Load<uint32_t>(p);
+      case kGgufInt32:
+        return Load<int32_t>(p);
+      case kGgufFloat32:
+        return Load<float>(p);
+      case kGgufBool:
+        return Load<uint8_t>(p) != 0;
+      case kGgufUint64:
+        return static_cast<double>(Load<uint64_t>(p));
+      case kGgufInt64:
+        return static_cast<double>(Load<int64_t>(p));
+      case kGgufFloat64:
+        return Load<double>(p);
+      default:
+        return 0;
+    }
+  }
+
+  template <typename T>
+  static T Load(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+  }
+
+ private:
+  static constexpr const size_t kMaxCachedIndexes = 16;
+  static constexpr const uint64_t kDefaultAlignment = 32;
+
+  struct CacheEntry {
+    std::string path;
+    uintmax_t size;
+    std::filesystem::file_time_type mtime;
+    std::shared_ptr<const GgufIndex> index;
+  };
+
+  struct Cache {
+    std::mutex mtx;
+    // Most recently used first
+    std::list<CacheEntry> entries;
+  };
+
+  static Cache& GetCache() {
+    static Cache cache;
+    return cache;
+  }
+
+  // Bounds-checked reads over the mapped file
+  class Reader {
+   public:
+    Reader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    bool Has(uint64_t n) const { return n <= size_ - pos_; }
+
+    template <typename T>
+    std::optional<T> Read() {
+      if (!Has(sizeof(T))) {
+        return std::nullopt;
+      }
+      auto v = Load<T>(data_ + pos_);
+      pos_ += sizeof(T);
+      return v;
+    }
+
+    std::optional<std::string_view> ReadString() {
+      auto length = Read<uint64_t>();
+      if (!length || !Has(*length)) {
+        return std::nullopt;
+      }
+      std::string_view s(data_ + pos_, *length);
+      pos_ += *length;
+      return s;
+    }
+
+    // Skips the value of |type| and returns its bytes
+    std::optional<std::string_view> SkipValue(uint32_t type) {
+      if (type == kGgufString) {
+        return ReadString();
+      }
+      auto n = GgufScalarSize(type);
+      if (n == 0 || !Has(n)) {
+        return std::nullopt;
+      }
+      std::string_view s(data_ + pos_, n);
+      pos_ += n;
+      return s;
+    }
+
+    size_t pos() const { return pos_; }
+    const char* data() const { return data_; }
+
+   private:
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+  };
+
+  GgufIndex() = default;
+
+  cpp::result<void, std::string> ParseHeader(const char* data, size_t size) {
+    Reader r(data, size);
+    auto magic = r.Read<uint32_t>();
+    if (!magic || *magic != kGgufMagic) {
+      return cpp::fail("Invalid GGUF file: incorrect magic number");
+    }
+    auto version = r.Read<uint32_t>();
+    auto tensor_count = r.Read<uint64_t>();
+    auto kv_count = r.Read<uint64_t>();
+    if (!version || !tensor_count || !kv_count) {
+      return cpp::fail("Invalid GGUF file: truncated header");
+    }
+    version_ = *version;
+    file_size_ = size;
+
+    // Counts come from the file, only reserve what it can hold
+    kvs_.reserve(std::min<uint64_t>(*kv_count, size / 16));
+    for (uint64_t i = 0; i < *kv_count; i++) {
+      Kv kv;
+      auto key = r.ReadString();
+      auto type = r.Read<uint32_t>();
+      if (!key || !type) {
+        return cpp::fail("Invalid GGUF file: truncated metadata");
+      }
+      kv.key = *key;
+      kv.type = *type;
+      if (kv.type == kGgufArray) {
+        auto array_type = r.Read<uint32_t>();
+        auto array_size = r.Read<uint64_t>();
+        if (!array_type || !array_size || *array_type == kGgufArray) {
+          return cpp::fail("Invalid GGUF file: bad array '" +
+                           std::string(kv.key) + "'");
+        }
+        kv.array_type = *array_type;
+        kv.array_size = *array_size;
+        auto begin = r.pos();
+        for (uint64_t j = 0; j < kv.array_size; j++) {
+          if (!r.SkipValue(kv.array_type)) {
+            return cpp::fail("Invalid GGUF file: bad array '" +
+                             std::string(kv.key) + "'");
+          }
+        }
+        kv.data = std::string_view(data + begin, r.pos() - begin);
+      } else {
+        auto value = r.SkipValue(kv.type);
+        if (!value) {
+          return cpp::fail("Invalid GGUF file: bad value for '" +
+                           std::string(kv.key) + "'");
+        }
+        kv.data = *value;
+      }
+      kvs_.push_back(kv);
+    }
+
+    tensors_.reserve(std::min<uint64_t>(*tensor_count, size / 24));
+    for (uint64_t i = 0; i < *tensor_count; i++) {
+      TensorInfo ti;
+      auto name = r.ReadString();
+      auto n_dimensions = r.Read<uint32_t>();
+      if (!name || !n_dimensions || !r.Has(*n_dimensions * 8ull)) {
+        return cpp::fail("Invalid GGUF file: truncated tensor infos");
+      }
+      ti.name = *name;
+      ti.n_dimensions = *n_dimensions;
+      ti.dimensions.resize(ti.n_dimensions);
+      for (auto& d : ti.dimensions) {
+        d = *r.Read<uint64_t>();
+      }
+      auto type = r.Read<uint32_t>();
+      auto offset = r.Read<uint64_t>();
+      if (!type || !offset) {
+        return cpp::fail("Invalid GGUF file: truncated tensor infos");
+      }
+      ti.type = *type;
+      ti.offset = *offset;
+      tensors_.push_back(std::move(ti));
+    }
+
+    auto alignment = GetUint("general.alignment").value_or(kDefaultAlignment);
+    if (alignment == 0) {
+      alignment = kDefaultAlignment;
+    }
+    tensor_data_offset_ = (r.pos() + alignment - 1) / alignment * alignment;
+
+    // Move the views from the mapping to a copy of the header
+    header_.assign(data, r.pos());
+    auto rebase = [this, data](std::string_view v) {
+      return std::string_view(header_.data() + (v.data() - data), v.size());
+    };
+    for (auto& kv : kvs_) {
+      kv.key = rebase(kv.key);
+      kv.data = rebase(kv.data);
+    }
+    for (auto& ti : tensors_) {
+      ti.name = rebase(ti.name);
+    }
+    return {};
+  }
+
+  std::string header_;
+  uint32_t version_ = 0;
+  uint64_t file_size_ = 0;
+  uint64_t tensor_data_offset_ = 0;
+  std::vector<Kv> kvs_;
+  std::vector<TensorInfo> tensors_;
+};
+}  // namespace cortex_utils
@@ -1,7 +1,9 @@
 #pragma once
 #include <algorithm>
 #include <regex>
-#include "gguf_file.h"
+#include "ggml.h"
+#include "utils/gguf_index.h"
+#include "utils/logging_utils.h"
 #include "json/json.h"
 
 namespace hardware {
@@ -62,49 +64,75 @@ inline float GetQuantBit(const std::string& kv_cache_t) {
   return 16.0;
 }
 
-inline std::optional<Estimation> EstimateLLaMACppRun(
-    const std::string& file_path, const RunConfig& rc) {
-  // token_embeddings_size = n_vocab * embedding_length * 2 * quant_bit/16 bytes
-  //RAM = token_embeddings_size + ((total_ngl-ngl) >=1 ? Output_layer_size +  (total_ngl - ngl - 1 ) / (total_ngl-1) * (total_file_size - token_embeddings_size - Output_layer_size) : 0  )  (bytes)
-
-  // VRAM = total_file_size - RAM (bytes)
-  auto gf = ParseGgufFile(file_path);
-  if (!gf)
-    return std::nullopt;
-  Estimation res;
+// What an estimation needs from a GGUF file. Reading it parses the file, so
+// it is worth keeping for as long as the file does not change, while the
+// estimation itself is cheap to redo for another run config.
+struct GgufLayout {
   int32_t embedding_length = 0;
   int64_t n_vocab = 0;
   int32_t num_block = 0;
-  int32_t total_ngl = 0;
-  auto file_size = std::filesystem::file_size(file_path);
-  for (auto const& kv : (*gf).header.metadata_kv) {
-    if (kv.key.find("embedding_length") != std::string::npos) {
-      embedding_length = std::any_cast<uint32_t>(kv.value);
-    } else if (kv.key == "tokenizer.ggml.tokens") {
-      n_vocab = std::any_cast<GGUFMetadataKVArrayValue>(kv.value).arr.size();
-    } else if (kv.key.find("block_count") != std::string::npos) {
-      num_block = std::any_cast<uint32_t>(kv.value);
-      total_ngl = num_block + 1;
-    }
-  }
-
-  // std::cout << n_vocab << std::endl;
-
-  // token_embeddings_size = n_vocab * embedding_length * 2 * quant_bit_in/16 bytes
   float quant_bit_in = 0;
   float quant_bit_out = 0;
+  uint64_t file_size = 0;
+};
 
-  for (auto const& ti : (*gf).tensor_infos) {
-    if (ti->name == "output.weight") {
-      quant_bit_out = GetQuantBit(ti->type);
-      // std::cout << ti->type << std::endl;
-    } else if (ti->name == "token_embd.weight") {
-      quant_bit_in = GetQuantBit(ti->type);
-      // std::cout << ti->type << std::endl;
+// A model split with gguf-split has its metadata in the first file and its
+// tensors spread over all of them
+inline std::optional<GgufLayout> ReadGgufLayout(const std::string& file_path) {
+  using cortex_utils::GgufIndex;
+  auto index = GgufIndex::Get(file_path);
+  if (index.has_error()) {
+    CTL_INF(index.error());
+    return std::nullopt;
+  }
+  const auto& gi = *index.value();
+  GgufLayout layout;
+  for (auto const& kv : gi.kvs()) {
+    if (kv.key.find("embedding_length") != std::string_view::npos) {
+      layout.embedding_length =
+          static_cast<int32_t>(gi.GetUint(kv.key).value_or(0));
+    } else if (kv.key == "tokenizer.ggml.tokens") {
+      layout.n_vocab = static_cast<int64_t>(kv.array_size);
+    } else if (kv.key.find("block_count") != std::string_view::npos) {
+      layout.num_block = static_cast<int32_t>(gi.GetUint(kv.key).value_or(0));
     }
   }
+
   // output.weight
   // token_embd.weight
+  for (auto const& path : gi.SplitPaths(file_path)) {
+    auto split = path == file_path ? index : GgufIndex::Get(path);
+    if (split.has_error()) {
+      CTL_INF(split.error());
+      return std::nullopt;
+    }
+    layout.file_size += split.value()->file_size();
+    for (auto const& ti : split.value()->tensors()) {
+      if (ti.name == "output.weight") {
+        layout.quant_bit_out = GetQuantBit(static_cast<GGMLType>(ti.type));
+      } else if (ti.name == "token_embd.weight") {
+        layout.quant_bit_in = GetQuantBit(static_cast<GGMLType>(ti.type));
+      }
+    }
+  }
+  return layout;
+}
+
+inline Estimation EstimateLLaMACppRun(const GgufLayout& layout,
+                                      const RunConfig& rc) {
+  // token_embeddings_size = n_vocab * embedding_length * 2 * quant_bit/16 bytes
+  //RAM = token_embeddings_size + ((total_ngl-ngl) >=1 ? Output_layer_size +  (total_ngl - ngl - 1 ) / (total_ngl-1) * (total_file_size - token_embeddings_size - Output_layer_size) : 0  )  (bytes)
+
+  // VRAM = total_file_size - RAM (bytes)
+  Estimation res;
+  auto const embedding_length = layout.embedding_length;
+  auto const n_vocab = layout.n_vocab;
+  auto const num_block = layout.num_block;
+  auto const total_ngl = num_block > 0 ? num_block + 1 : 0;
+  auto const file_size = layout.file_size;
+  auto const quant_bit_in = layout.quant_bit_in;
+  auto const quant_bit_out = layout.quant_bit_out;
+
   // std::cout << "embedding_length: " << embedding_length << std::endl;
   // std::cout << "n_vocab: " << n_vocab << std::endl;
   // std::cout << "file_size: " << file_size << std::endl;
@@ -184,4 +212,12 @@ inline std::optional<Estimation> EstimateLLaMACppRun(
   }
   return res;
 }
+
+inline std::optional<Estimation> EstimateLLaMACppRun(
+    const std::string& file_path, const RunConfig& rc) {
+  auto layout = ReadGgufLayout(file_path);
+  if (!layout)
+    return std::nullopt;
+  return EstimateLLaMACppRun(*layout, rc);
+}
 }  // namespace hardware
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include "utils/result.hpp"
+
+namespace http_range_utils {
+
+// A satisfiable byte range of a representation
+struct ByteRange {
+  uint64_t offset;
+  uint64_t length;
+};
+
+namespace detail {
+inline std::string_view Trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+inline std::optional<uint64_t> ParseUint(std::string_view s) {
+  if (s.empty() || s.size() > 19) {
+    return std::nullopt;
+  }
+  uint64_t v = 0;
+  for (auto c : s) {
+    if (c < '0' || c > '9') {
+      return std::nullopt;
+    }
+    v = v * 10 + (c - '0');
+  }
+  return v;
+}
+}  // namespace detail
+
+// Resolves the Range header |header| against a representation of |size|
+// bytes. Returns nullopt when the whole representation should be sent: no
+// header, a malformed one, another unit or several ranges, which servers may
+// ignore. Fails when the range can't be satisfied and a 416 is due.
+inline cpp::result<std::optional<ByteRange>, std::string> ParseRange(
+    std::string_view header, uint64_t size) {
+  header = detail::Trim(header);
+  constexpr std::string_view kUnit = "bytes=";
+  if (header.substr(0, kUnit.size()) != kUnit) {
+    return std::nullopt;
+  }
+  auto spec = detail::Trim(header.substr(kUnit.size()));
+  auto dash = spec.find('-');
+  if (spec.find(',') != std::string_view::npos ||
+      dash == std::string_view::npos) {
+    return std::nullopt;
+  }
+  auto first = detail::Trim(spec.substr(0, dash));
+  auto last = detail::Trim(spec.substr(dash + 1));
+
+  if (first.empty()) {
+    // Suffix range: the final |n| bytes
+    auto n = detail::ParseUint(last);
+    if (!n) {
+      return std::nullopt;
+    }
+    if (*n == 0 || size == 0) {
+      return cpp::fail("Range not satisfiable");
+    }
+    auto length = std::min(*n, size);
+    return ByteRange{size - length, length};
+  }
+
+  auto start = detail::ParseUint(first);
+  if (!start) {
+    return std::nullopt;
+  }
+  uint64_t end = size == 0 ? 0 : size - 1;
+  if (!last.empty()) {
+    auto e = detail::ParseUint(last);
+    if (!e || *e < *start) {
+      return std::nullopt;
+    }
+    end = std::min(*e, end);
+  }
+  if (*start >= size) {
+    return cpp::fail("Range not satisfiable");
+  }
+  return ByteRange{*start, end - *start + 1};
+}
+
+// A strong validator derived from the file's metadata, in the form nginx uses:
+// the modification time and size in hex
+inline std::string MakeETag(std::filesystem::file_time_type mtime,
+                            uint64_t size) {
+  auto ticks = mtime.time_since_epoch().count();
+  std::ostringstream ss;
+  ss << "\"" << std::hex << static_cast<uint64_t>(ticks) << "-" << size
+     << "\"";
+  return ss.str();
+}
+
+// Whether an If-None-Match header lists |etag|. Matching is weak, as RFC 9110
+// asks for this header.
+inline bool EtagMatches(std::string_view if_none_match,
+                        std::string_view etag) {
+  auto opaque = [](std::string_view tag) {
+    tag = detail::Trim(tag);
+    if (tag.substr(0, 2) == "W/") {
+      tag.remove_prefix(2);
+    }
+    return tag;
+  };
+  if (detail::Trim(if_none_match) == "*") {
+    return true;
+  }
+  auto want = opaque(etag);
+  while (!if_none_match.empty()) {
+    auto comma = if_none_match.find(',');
+    if (opaque(if_none_match.substr(0, comma)) == want) {
+      return true;
+    }
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    if_none_match.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+}  // namespace http_range_utils
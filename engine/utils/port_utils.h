@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+namespace port_utils {
+
+// Returns true if a TCP listener could bind |host|:|port| right now. Ports in
+// TIME_WAIT count as taken since the probe does not set SO_REUSEADDR.
+bool IsPortAvailable(const std::string& host, int port);
+
+}  // namespace port_utils
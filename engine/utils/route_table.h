@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace cortex::utils {
+
+// Path segment trie over the registered routes, built once so that matching a
+// request path costs one walk over its segments instead of splitting and
+// comparing it against every route. Matches like string_utils::
+// AreUrlPathsEqual: empty segments are ignored and a "{...}" segment on either
+// side matches any segment.
+class RouteTable {
+ public:
+  void Add(std::string_view path, std::string_view method) {
+    auto* node = &root_;
+    ForEachSegment(path, [&node](std::string_view seg) {
+      if (IsPlaceholder(seg)) {
+        if (!node->placeholder) {
+          node->placeholder = std::make_unique<Node>();
+        }
+        node = node->placeholder.get();
+      } else {
+        auto& child = node->children[std::string(seg)];
+        if (!child) {
+          child = std::make_unique<Node>();
+        }
+        node = child.get();
+      }
+    });
+    node->routes.push_back({order_++, std::string(method)});
+    std::vector<const Route*> routes;
+    for (auto const& r : node->routes) {
+      routes.push_back(&r);
+    }
+    node->methods = JoinMethods(routes);
+  }
+
+  bool Contains(std::string_view path) const {
+    std::vector<const Node*> found;
+    Match(path, found);
+    return !found.empty();
+  }
+
+  // Returns the distinct methods of the routes matching |path| in the order
+  // they were added, joined with ", "
+  std::string Methods(std::string_view path) const {
+    std::vector<const Node*> found;
+    Match(path, found);
+    if (found.size() == 1) {
+      return found[0]->methods;
+    }
+    // A literal and a placeholder route may both match
+    std::vector<const Route*> routes;
+    for (auto const* n : found) {
+      for (auto const& r : n->routes) {
+        routes.push_back(&r);
+      }
+    }
+    std::sort(routes.begin(), routes.end(),
+              [](auto const* a, auto const* b) { return a->order < b->order; });
+    return JoinMethods(routes);
+  }
+
+ private:
+  struct Route {
+    size_t order;
+    std::string method;
+  };
+
+  struct Node {
+    std::unordered_map<std::string, std::unique_ptr<Node>> children;
+    std::unique_ptr<Node> placeholder;
+    // Routes ending at this node, and their joined methods
+    std::vector<Route> routes;
+    std::string methods;
+  };
+
+  static bool IsPlaceholder(std::string_view seg) {
+    return !seg.empty() && seg.find_first_of('{') < seg.find_last_of('}');
+  }
+
+  static std::string JoinMethods(const std::vector<const Route*>& routes) {
+    std::string methods;
+    std::unordered_set<std::string_view> seen;
+    for (auto const* r : routes) {
+      if (seen.insert(r->method).second) {
+        methods += methods.empty() ? "" : ", ";
+        methods += r->method;
+      }
+    }
+    return methods;
+  }
+
+  template <typename F>
+  static void ForEachSegment(std::string_view path, F&& f) {
+    size_t pos = 0;
+    while (pos < path.size()) {
+      auto end = path.find('/', pos);
+      if (end == std::string_view::npos) {
+        end = path.size();
+      }
+      if (end > pos) {
+        f(path.substr(pos, end - pos));
+      }
+      pos = end + 1;
+    }
+  }
+
+  void Match(std::string_view path, std::vector<const Node*>& found) const {
+    std::vector<std::string_view> segs;
+    ForEachSegment(path, [&segs](std::string_view seg) { segs.push_back(seg); });
+    MatchFrom(&root_, segs, 0, found);
+  }
+
+  static void MatchFrom(const Node* node,
+                        const std::vector<std::string_view>& segs, size_t i,
+                        std::vector<const Node*>& found) {
+    if (i == segs.size()) {
+      if (!node->routes.empty()) {
+        found.push_back(node);
+      }
+      return;
+    }
+    if (IsPlaceholder(segs[i])) {
+      for (auto const& [_, child] : node->children) {
+        MatchFrom(child.get(), segs, i + 1, found);
+      }
+    } else if (auto it = node->children.find(std::string(segs[i]));
+               it != node->children.end()) {
+      MatchFrom(it->second.get(), segs, i + 1, found);
+    }
+    if (node->placeholder) {
+      MatchFrom(node->placeholder.get(), segs, i + 1, found);
+    }
+  }
+
+  Node root_;
+  size_t order_ = 0;
+};
+
+}  // namespace cortex::utils
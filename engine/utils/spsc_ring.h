@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace cortex::utils {
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Elements are moved in and out, never copied.
+template <typename T>
+class SpscRing {
+ public:
+  // |capacity| is rounded up to a power of two
+  explicit SpscRing(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) {
+      cap <<= 1;
+    }
+    mask_ = cap - 1;
+    slots_ = std::make_unique<std::optional<T>[]>(cap);
+  }
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Producer side. Returns false, leaving |value| untouched, if full.
+  bool TryPush(T&& value) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        return false;
+      }
+    }
+    slots_[tail & mask_].emplace(std::move(value));
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  std::optional<T> TryPop() {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return std::nullopt;
+      }
+    }
+    auto& slot = slots_[head & mask_];
+    std::optional<T> value(std::move(slot));
+    slot.reset();
+    head_.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+  // Approximate when called concurrently with the other side
+  size_t Size() const {
+    auto tail = tail_.load(std::memory_order_acquire);
+    auto head = head_.load(std::memory_order_acquire);
+    return tail - head;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+ private:
+  static constexpr size_t kCacheLine = 64;
+
+  size_t mask_;
+  std::unique_ptr<std::optional<T>[]> slots_;
+
+  // Each index and the other side's cached copy of it live on their own
+  // cache line so that the two threads do not false share
+  alignas(kCacheLine) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+  alignas(kCacheLine) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+};
+
+}  // namespace cortex::utils
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace sse_utils {
+
+constexpr std::string_view kDoneData = "[DONE]";
+
+// Incremental parser for a text/event-stream body. Bytes can be fed in chunks
+// of any size; an event split across chunks is kept until it is complete and a
+// chunk carrying several events yields all of them.
+//
+// For every complete event |on_event(frame, data)| is invoked, where |frame|
+// is the raw event text without its terminating blank line and |data| is the
+// value of its `data:` field(s). Both views are only valid during the call.
+class SseParser {
+ public:
+  template <typename F>
+  void Feed(std::string_view chunk, F&& on_event) {
+    if (buf_.empty()) {
+      // Fast path: parse straight out of the caller's buffer and only keep
+      // the incomplete tail
+      auto consumed = Parse(chunk, on_event);
+      buf_.assign(chunk.substr(consumed));
+      return;
+    }
+    buf_.append(chunk);
+    auto consumed = Parse(buf_, on_event);
+    buf_.erase(0, consumed);
+  }
+
+  bool HasPendingData() const { return !buf_.empty(); }
+
+  void Reset() { buf_.clear(); }
+
+ private:
+  // Returns the number of bytes consumed from |input|
+  template <typename F>
+  size_t Parse(std::string_view input, F& on_event) {
+    size_t pos = 0;
+    while (pos < input.size()) {
+      auto [frame_end, next] = FindFrameEnd(input, pos);
+      if (frame_end == std::string_view::npos) {
+        break;
+      }
+      auto frame = input.substr(pos, frame_end - pos);
+      pos = next;
+      if (frame.empty()) {
+        continue;
+      }
+      on_event(frame, ExtractData(frame));
+    }
+    return pos;
+  }
+
+  // Events are terminated by a blank line, either "\n\n" or "\r\n\r\n"
+  static std::pair<size_t, size_t> FindFrameEnd(std::string_view input,
+                                                size_t from) {
+    for (size_t i = from; i < input.size(); i++) {
+      if (input[i] != '\n')
+        continue;
+      if (i + 1 < input.size() && input[i + 1] == '\n') {
+        return {i, i + 2};
+      }
+      if (i + 2 < input.size() && input[i + 1] == '\r' &&
+          input[i + 2] == '\n') {
+        return {i > from && input[i - 1] == '\r' ? i - 1 : i, i + 3};
+      }
+    }
+    return {std::string_view::npos, std::string_view::npos};
+  }
+
+  std::string_view ExtractData(std::string_view frame) {
+    std::string_view single;
+    bool multi = false;
+    size_t pos = 0;
+    while (pos <= frame.size()) {
+      auto eol = frame.find('\n', pos);
+      auto line = frame.substr(
+          pos, eol == std::string_view::npos ? std::string_view::npos
+                                             : eol - pos);
+      if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+      if (line.substr(0, 5) == "data:") {
+        auto value = line.substr(5);
+        if (!value.empty() && value.front() == ' ') {
+          value.remove_prefix(1);
+        }
+        if (!multi && single.data() == nullptr) {
+          single = value;
+        } else {
+          // Several data lines are joined with '\n'
+          if (!multi) {
+            data_.assign(single);
+            multi = true;
+          }
+          data_.push_back('\n');
+          data_.append(value);
+        }
+      }
+      if (eol == std::string_view::npos)
+        break;
+      pos = eol + 1;
+    }
+    return multi ? std::string_view(data_) : single;
+  }
+
+  std::string buf_;
+  std::string data_;
+};
+
+}  // namespace sse_utils
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace cortex::utils {
+
+// Entries read from a source that has a version number changing with every
+// write, such as a database table. The whole cache is dropped when the
+// version moves, single entries can be dropped for changes the version does
+// not see.
+//
+// Only hits are kept: a key the source does not have is looked up again every
+// time, so that lookups of arbitrary keys do not grow the cache.
+template <typename T>
+class VersionedCache {
+ public:
+  using Entry = std::shared_ptr<const T>;
+
+  explicit VersionedCache(std::function<uint64_t()> version)
+      : version_(std::move(version)) {}
+
+  VersionedCache(const VersionedCache&) = delete;
+  VersionedCache& operator=(const VersionedCache&) = delete;
+
+  // Returns the entry of |key|, calling |load| to read it from the source on
+  // a miss. |load| returns nullptr if the source does not have |key|.
+  template <typename Load>
+  Entry Get(const std::string& key, Load&& load) {
+    auto version = version_();
+    {
+      std::shared_lock l(mtx_);
+      if (cached_version_ == version) {
+        if (auto it = entries_.find(key); it != entries_.end()) {
+          return it->second;
+        }
+      }
+    }
+
+    Entry entry = load(key);
+    std::unique_lock l(mtx_);
+    if (cached_version_ != version) {
+      entries_.clear();
+      cached_version_ = version;
+    }
+    // Not cached if the source changed while loading, the next lookup loads
+    // it again
+    if (entry && version_() == version) {
+      entries_[key] = entry;
+    }
+    return entry;
+  }
+
+  void Invalidate(const std::string& key) {
+    std::unique_lock l(mtx_);
+    entries_.erase(key);
+  }
+
+  void Clear() {
+    std::unique_lock l(mtx_);
+    entries_.clear();
+  }
+
+  size_t Size() const {
+    std::shared_lock l(mtx_);
+    return entries_.size();
+  }
+
+ private:
+  std::function<uint64_t()> version_;
+  mutable std::shared_mutex mtx_;
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t cached_version_ = 0;
+};
+
+}  // namespace cortex::utils